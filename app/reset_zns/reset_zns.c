@@ -10,6 +10,8 @@
 #include "spdk/nvme_spec.h"
 #include "spdk/log.h"
 #include "trace_io.h"
+#include <linux/fs.h>
+#include <linux/blkzoned.h>
 
 struct ctrlr_entry {
     struct spdk_nvme_ctrlr *ctrlr;
@@ -37,6 +39,8 @@ static bool g_spdk_trace = false;
 static const char *g_tpoint_group_name = NULL;
 /* variables for pool command complete */
 static uint32_t outstanding_commands = 0;
+/* zoned block device, e.g. zoned null_blk, reset through the kernel */
+static const char *g_blkdev = NULL;
 
 static void
 register_ns(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_ns *ns)
@@ -195,12 +199,51 @@ alloc_qpair(struct spdk_env_opts *opts)
 }
 /* allocate io qpair & free io qpair end */
 
+/* reset zoned block device start */
+static int
+reset_blkdev(const char *path)
+{
+    struct blk_zone_range range;
+    uint64_t byte = 0;
+    uint32_t zone_sectors = 0;
+
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    if (ioctl(fd, BLKGETZONESZ, &zone_sectors) != 0 || zone_sectors == 0) {
+        fprintf(stderr, "%s is not a zoned block device\n", path);
+        close(fd);
+        return 1;
+    }
+    if (ioctl(fd, BLKGETSIZE64, &byte) != 0) {
+        fprintf(stderr, "Fail to get the size of %s: %s\n", path, strerror(errno));
+        close(fd);
+        return 1;
+    }
+
+    /* a range of the whole device resets all zones */
+    range.sector = 0;
+    range.nr_sectors = byte >> 9;
+    if (ioctl(fd, BLKRESETZONE, &range) != 0) {
+        fprintf(stderr, "Reset all zones failed: %s\n", strerror(errno));
+        close(fd);
+        return 1;
+    }
+    close(fd);
+    printf("Reset all zone complete.\n");
+    return 0;
+}
+/* reset zoned block device end */
+
 static void
 usage(const char *program_name)
 {
     printf("usage:\n");
     printf("%s <options>\n", program_name);
     printf("\n");
+    printf(" -d, zoned block device to reset through the kernel, e.g. /dev/nullb0, instead of an NVMe controller\n");
     spdk_trace_mask_usage(stdout, "-e");
 }
 
@@ -209,8 +252,11 @@ parse_args(int argc, char **argv)
 {
     int op;
 
-    while ((op = getopt(argc, argv, "e:")) != -1) {
+    while ((op = getopt(argc, argv, "e:d:")) != -1) {
         switch (op) {
+        case 'd':
+            g_blkdev = optarg;
+            break;
         case 'e':
             g_spdk_trace = true;
             g_tpoint_group_name = optarg;
@@ -234,6 +280,10 @@ main(int argc, char **argv)
         return rc;
     }
 
+    if (g_blkdev) {
+        return reset_blkdev(g_blkdev);
+    }
+
     /* Initialize env */
     spdk_env_opts_init(&env_opts);
     env_opts.name = "reset_zns";
@@ -56,6 +56,142 @@ pid_t enable_spdk_trace_record(const char *app_name, pid_t app_pid);
  */
 int disable_spdk_trace_record(pid_t spdk_pid);
 
+/*
+ * Log-linear histogram shared by trace tools.
+ * Values below 2^TRACE_IO_HIST_SUB_BITS are counted exactly, larger values fall into
+ * 2^TRACE_IO_HIST_SUB_BITS buckets per power of two (relative error < 1/16).
+ */
+#define TRACE_IO_HIST_SUB_BITS 4
+#define TRACE_IO_HIST_BUCKET ((64 - TRACE_IO_HIST_SUB_BITS + 1) << TRACE_IO_HIST_SUB_BITS)
+
+struct trace_io_hist {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    double   sum;
+    uint64_t bucket[TRACE_IO_HIST_BUCKET];
+};
+
+/**
+ * Reset a histogram to empty.
+ *
+ * \param hist histogram to reset.
+ */
+void trace_io_hist_init(struct trace_io_hist *hist);
+
+/**
+ * Add one value (e.g. latency in tsc) to a histogram.
+ *
+ * \param hist histogram to update.
+ * \param val value to record.
+ */
+void trace_io_hist_record(struct trace_io_hist *hist, uint64_t val);
+
+/**
+ * Add all values of a histogram into another one.
+ *
+ * \param dst histogram to update.
+ * \param src histogram to be added.
+ */
+void trace_io_hist_merge(struct trace_io_hist *dst, const struct trace_io_hist *src);
+
+/**
+ * Get the value at a given percentile.
+ *
+ * \param hist histogram to query.
+ * \param percentile between 0 and 100.
+ * \return upper bound of the bucket containing the percentile, 0 if histogram is empty.
+ */
+uint64_t trace_io_hist_percentile(const struct trace_io_hist *hist, double percentile);
+
+/**
+ * Get the average of all recorded values.
+ *
+ * \param hist histogram to query.
+ * \return average value, 0 if histogram is empty.
+ */
+double trace_io_hist_mean(const struct trace_io_hist *hist);
+
+/**
+ * Get the index of the bucket a value falls into, and the value range of a bucket.
+ */
+uint32_t trace_io_hist_bucket_index(uint64_t val);
+uint64_t trace_io_hist_bucket_lower(uint32_t index);
+uint64_t trace_io_hist_bucket_upper(uint32_t index);
+
+/**
+ * Sparse index of a trace_io file, saved as <trace file>.idx next to it.
+ * Every TRACE_IO_INDEX_STRIDE entries form a block, the index keeps the timestamp of the
+ * first entry of each block and which lcores and opcodes appear in it, so that a tool can
+ * seek to a timestamp and skip blocks a filter rejects without reading them.
+ */
+#define TRACE_IO_INDEX_MAGIC 0x32444954     /* "TID2" */
+#define TRACE_IO_INDEX_STRIDE 4096
+#define TRACE_IO_INDEX_LCORE_WORD ((SPDK_TRACE_MAX_LCORE + 63) / 64)
+
+struct trace_io_index_hdr {
+    uint32_t magic;
+    uint32_t stride;
+    uint64_t num_entry;         /* entries of the trace file when the index was built */
+    uint64_t num_block;
+    uint64_t first_tsc;         /* timestamp of the first entry, tells a recaptured trace apart */
+};
+
+struct trace_io_index_block {
+    uint64_t tsc;               /* timestamp of the first entry */
+    uint64_t lcore_mask[TRACE_IO_INDEX_LCORE_WORD];
+    uint32_t opc_mask;          /* bit (opc & 31) of every submitted opcode */
+    uint32_t rsvd;
+};
+
+struct trace_io_index {
+    struct trace_io_index_hdr hdr;
+    struct trace_io_index_block *block;
+};
+
+/**
+ * Account one entry to the block it belongs to, the first entry sets the block timestamp.
+ */
+static inline void
+trace_io_index_block_add(struct trace_io_index_block *block, const struct trace_io_entry *entry, bool first)
+{
+    if (first) {
+        memset(block, 0, sizeof(*block));
+        block->tsc = entry->tsc_timestamp;
+    }
+    if (entry->lcore < SPDK_TRACE_MAX_LCORE) {
+        block->lcore_mask[entry->lcore / 64] |= 1ULL << (entry->lcore % 64);
+    }
+    if (strcmp(entry->tpoint_name, "NVME_IO_SUBMIT") == 0) {
+        block->opc_mask |= 1U << (entry->opc & 31);
+    }
+}
+
+/**
+ * Load the index of a trace file, it is built and saved if missing or stale.
+ * A read-only directory only costs the build on every use.
+ *
+ * \param file_name trace file.
+ * \param index index to fill, released by trace_io_index_free().
+ * \return 0 on success, else non-zero indicates a failure.
+ */
+int trace_io_index_load(const char *file_name, struct trace_io_index *index);
+
+/**
+ * Release the memory of an index.
+ */
+void trace_io_index_free(struct trace_io_index *index);
+
+/**
+ * Get the range of entries holding the first entry with a timestamp not less than tsc.
+ *
+ * \param index index of the trace.
+ * \param tsc recorded timestamp to seek.
+ * \param lo first entry of the range.
+ * \param hi entry after the range, the entry is in [lo, hi) or is hi.
+ */
+void trace_io_index_range(const struct trace_io_index *index, uint64_t tsc, size_t *lo, size_t *hi);
+
 /* in spdk/nvme_spec.h
 
 // NVM command set opcodes
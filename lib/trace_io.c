@@ -152,3 +152,265 @@ disable_spdk_trace_record(pid_t spdk_pid)
     sigint_handler(spdk_pid);
     return 0;
 }
+
+uint32_t
+trace_io_hist_bucket_index(uint64_t val)
+{
+    if (val < (1ULL << TRACE_IO_HIST_SUB_BITS)) {
+        return (uint32_t)val;
+    }
+    uint32_t msb = 63 - __builtin_clzll(val);
+    uint32_t shift = msb - TRACE_IO_HIST_SUB_BITS;
+    uint32_t sub = (val >> shift) & ((1U << TRACE_IO_HIST_SUB_BITS) - 1);
+
+    return ((shift + 1) << TRACE_IO_HIST_SUB_BITS) + sub;
+}
+
+uint64_t
+trace_io_hist_bucket_lower(uint32_t index)
+{
+    if (index < (1U << TRACE_IO_HIST_SUB_BITS)) {
+        return index;
+    }
+    uint32_t shift = (index >> TRACE_IO_HIST_SUB_BITS) - 1;
+    uint64_t sub = index & ((1U << TRACE_IO_HIST_SUB_BITS) - 1);
+
+    return ((1ULL << TRACE_IO_HIST_SUB_BITS) + sub) << shift;
+}
+
+uint64_t
+trace_io_hist_bucket_upper(uint32_t index)
+{
+    if (index < (1U << TRACE_IO_HIST_SUB_BITS)) {
+        return index;
+    }
+    uint32_t shift = (index >> TRACE_IO_HIST_SUB_BITS) - 1;
+
+    return trace_io_hist_bucket_lower(index) + ((1ULL << shift) - 1);
+}
+
+void
+trace_io_hist_init(struct trace_io_hist *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+}
+
+void
+trace_io_hist_record(struct trace_io_hist *hist, uint64_t val)
+{
+    if (!hist->count || val < hist->min) {
+        hist->min = val;
+    }
+    if (val > hist->max) {
+        hist->max = val;
+    }
+    hist->count++;
+    hist->sum += val;
+    hist->bucket[trace_io_hist_bucket_index(val)]++;
+}
+
+void
+trace_io_hist_merge(struct trace_io_hist *dst, const struct trace_io_hist *src)
+{
+    if (!src->count) {
+        return;
+    }
+    if (!dst->count || src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    for (uint32_t i = 0; i < TRACE_IO_HIST_BUCKET; i++) {
+        dst->bucket[i] += src->bucket[i];
+    }
+}
+
+uint64_t
+trace_io_hist_percentile(const struct trace_io_hist *hist, double percentile)
+{
+    if (!hist->count) {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)(percentile * hist->count / 100);
+    uint64_t cnt = 0;
+    if (target >= hist->count) {
+        return hist->max;
+    }
+
+    for (uint32_t i = 0; i < TRACE_IO_HIST_BUCKET; i++) {
+        cnt += hist->bucket[i];
+        if (cnt > target) {
+            return spdk_min(trace_io_hist_bucket_upper(i), hist->max);
+        }
+    }
+    return hist->max;
+}
+
+double
+trace_io_hist_mean(const struct trace_io_hist *hist)
+{
+    return hist->count ? hist->sum / hist->count : 0;
+}
+
+static int
+trace_io_index_build(const char *file_name, struct trace_io_index *index)
+{
+    struct trace_io_entry *buf;
+    size_t num_entry, idx = 0;
+    int rc = 0;
+
+    FILE *fptr = fopen(file_name, "rb");
+    if (fptr == NULL) {
+        fprintf(stderr, "Failed to open input file %s\n", file_name);
+        return 1;
+    }
+    fseek(fptr, 0, SEEK_END);
+    index->hdr.magic = TRACE_IO_INDEX_MAGIC;
+    index->hdr.stride = TRACE_IO_INDEX_STRIDE;
+    index->hdr.num_entry = ftell(fptr) / sizeof(struct trace_io_entry);
+    index->hdr.num_block = (index->hdr.num_entry + TRACE_IO_INDEX_STRIDE - 1) / TRACE_IO_INDEX_STRIDE;
+    rewind(fptr);
+
+    index->block = (struct trace_io_index_block *)calloc(spdk_max(index->hdr.num_block, 1),
+                   sizeof(struct trace_io_index_block));
+    buf = (struct trace_io_entry *)malloc(TRACE_IO_INDEX_STRIDE * sizeof(struct trace_io_entry));
+    if (!index->block || !buf) {
+        fprintf(stderr, "Fail to allocate memory for trace index\n");
+        rc = 1;
+        goto out;
+    }
+    while ((num_entry = fread(buf, sizeof(struct trace_io_entry), TRACE_IO_INDEX_STRIDE, fptr)) > 0) {
+        for (size_t i = 0; i < num_entry; i++, idx++) {
+            trace_io_index_block_add(&index->block[idx / TRACE_IO_INDEX_STRIDE], &buf[i],
+                                     idx % TRACE_IO_INDEX_STRIDE == 0);
+        }
+    }
+    if (ferror(fptr) || idx != index->hdr.num_entry) {
+        fprintf(stderr, "Fail to read input file\n");
+        rc = 1;
+    }
+    index->hdr.first_tsc = idx ? index->block[0].tsc : 0;
+
+out:
+    free(buf);
+    fclose(fptr);
+    return rc;
+}
+
+static int
+trace_io_index_save(const char *idx_name, const struct trace_io_index *index)
+{
+    FILE *fptr = fopen(idx_name, "wb");
+    int rc = 0;
+
+    if (fptr == NULL) {
+        return 1;
+    }
+    if (fwrite(&index->hdr, sizeof(index->hdr), 1, fptr) != 1 ||
+        fwrite(index->block, sizeof(struct trace_io_index_block), index->hdr.num_block, fptr) !=
+        index->hdr.num_block) {
+        rc = 1;
+    }
+    if (fclose(fptr) != 0 || rc) {
+        unlink(idx_name);
+        return 1;
+    }
+    return 0;
+}
+
+/* timestamp of the first entry of the trace file, 0 if it is empty */
+static int
+trace_io_first_tsc(const char *file_name, uint64_t *tsc)
+{
+    struct trace_io_entry entry;
+
+    *tsc = 0;
+    FILE *fptr = fopen(file_name, "rb");
+    if (fptr == NULL) {
+        return 1;
+    }
+    if (fread(&entry, sizeof(entry), 1, fptr) == 1) {
+        *tsc = entry.tsc_timestamp;
+    }
+    int rc = ferror(fptr) ? 1 : 0;
+    fclose(fptr);
+    return rc;
+}
+
+int
+trace_io_index_load(const char *file_name, struct trace_io_index *index)
+{
+    char idx_name[PATH_MAX];
+    struct stat st;
+
+    memset(index, 0, sizeof(*index));
+    if (stat(file_name, &st) != 0) {
+        fprintf(stderr, "Failed to open input file %s\n", file_name);
+        return 1;
+    }
+    snprintf(idx_name, sizeof(idx_name), "%s.idx", file_name);
+
+    uint64_t first_tsc;
+    FILE *fptr = fopen(idx_name, "rb");
+    if (fptr) {
+        bool valid = fread(&index->hdr, sizeof(index->hdr), 1, fptr) == 1 &&
+                     index->hdr.magic == TRACE_IO_INDEX_MAGIC && index->hdr.stride == TRACE_IO_INDEX_STRIDE &&
+                     index->hdr.num_entry == st.st_size / sizeof(struct trace_io_entry) &&
+                     index->hdr.num_block == (index->hdr.num_entry + TRACE_IO_INDEX_STRIDE - 1) / TRACE_IO_INDEX_STRIDE &&
+                     !trace_io_first_tsc(file_name, &first_tsc) && index->hdr.first_tsc == first_tsc;
+        if (valid) {
+            index->block = (struct trace_io_index_block *)calloc(spdk_max(index->hdr.num_block, 1),
+                           sizeof(struct trace_io_index_block));
+            valid = index->block && fread(index->block, sizeof(struct trace_io_index_block),
+                                          index->hdr.num_block, fptr) == index->hdr.num_block;
+        }
+        fclose(fptr);
+        if (valid) {
+            return 0;
+        }
+        trace_io_index_free(index);
+    }
+
+    /* missing or stale, e.g. the trace was captured again, maybe with as many entries */
+    if (trace_io_index_build(file_name, index)) {
+        trace_io_index_free(index);
+        return 1;
+    }
+    if (trace_io_index_save(idx_name, index)) {
+        fprintf(stderr, "Fail to save trace index %s, it is rebuilt on every use\n", idx_name);
+    }
+    return 0;
+}
+
+void
+trace_io_index_free(struct trace_io_index *index)
+{
+    free(index->block);
+    memset(index, 0, sizeof(*index));
+}
+
+void
+trace_io_index_range(const struct trace_io_index *index, uint64_t tsc, size_t *lo, size_t *hi)
+{
+    /* last block starting before tsc, the entry is in it or is the first of the next block */
+    size_t lo_blk = 0, hi_blk = index->hdr.num_block;
+
+    while (lo_blk < hi_blk) {
+        size_t mid = lo_blk + (hi_blk - lo_blk) / 2;
+        if (index->block[mid].tsc < tsc) {
+            lo_blk = mid + 1;
+        } else {
+            hi_blk = mid;
+        }
+    }
+    if (lo_blk == 0) {
+        *lo = *hi = 0;
+        return;
+    }
+    *lo = (lo_blk - 1) * TRACE_IO_INDEX_STRIDE;
+    *hi = spdk_min(lo_blk * TRACE_IO_INDEX_STRIDE, index->hdr.num_entry);
+}
@@ -0,0 +1,412 @@
+#include "spdk/stdinc.h"
+#include "spdk/util.h"
+#include "export.h"
+
+#define EXPORT_BUF_SIZE (1 << 20)   /* flush output buffer when it is nearly full */
+#define EXPORT_NUM_MAX 64           /* max length of a formatted number */
+
+struct export_buf {
+    FILE   *fptr;
+    size_t len;
+    char   data[EXPORT_BUF_SIZE];
+};
+
+/* in-memory column of the columnar format */
+struct export_col_data {
+    uint64_t *val;
+    uint64_t size;
+};
+
+static enum export_format g_format = EXPORT_FORMAT_NONE;
+static char g_prefix[256];
+static struct export_buf *g_buf = NULL;
+/* current table */
+static const struct export_column *g_col = NULL;
+static uint32_t g_num_col = 0;
+static uint64_t g_num_row = 0;
+static bool g_first_table = true;
+static struct export_col_data *g_col_data = NULL;
+
+static const char g_digit_pair[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* buffered writer start */
+static int
+buf_flush(struct export_buf *buf)
+{
+    if (buf->len && fwrite(buf->data, 1, buf->len, buf->fptr) != buf->len) {
+        fprintf(stderr, "Fail to write export file\n");
+        buf->len = 0;
+        return 1;
+    }
+    buf->len = 0;
+    return 0;
+}
+
+static char *
+buf_reserve(struct export_buf *buf, size_t len)
+{
+    if (buf->len + len > EXPORT_BUF_SIZE) {
+        buf_flush(buf);
+    }
+    return &buf->data[buf->len];
+}
+
+static void
+buf_put_str(struct export_buf *buf, const char *str)
+{
+    size_t len = strlen(str);
+
+    if (len > EXPORT_BUF_SIZE) {
+        buf_flush(buf);
+        fwrite(str, 1, len, buf->fptr);
+        return;
+    }
+    memcpy(buf_reserve(buf, len), str, len);
+    buf->len += len;
+}
+
+static void
+buf_put_char(struct export_buf *buf, char c)
+{
+    *buf_reserve(buf, 1) = c;
+    buf->len++;
+}
+
+/* write decimal digits of val to the end of out, return length */
+static size_t
+format_u64(char *out, uint64_t val)
+{
+    char tmp[24];
+    char *p = tmp + sizeof(tmp);
+
+    while (val >= 100) {
+        uint32_t pair = (uint32_t)(val % 100) * 2;
+        val /= 100;
+        *--p = g_digit_pair[pair + 1];
+        *--p = g_digit_pair[pair];
+    }
+    if (val >= 10) {
+        *--p = g_digit_pair[val * 2 + 1];
+        *--p = g_digit_pair[val * 2];
+    } else {
+        *--p = (char)('0' + val);
+    }
+
+    size_t len = tmp + sizeof(tmp) - p;
+    memcpy(out, p, len);
+    return len;
+}
+
+static void
+buf_put_u64(struct export_buf *buf, uint64_t val)
+{
+    char *out = buf_reserve(buf, EXPORT_NUM_MAX);
+    buf->len += format_u64(out, val);
+}
+
+/* fixed 3 decimals, e.g. 12.345; returns false for NaN / inf */
+static bool
+buf_put_f64(struct export_buf *buf, double val)
+{
+    char *out = buf_reserve(buf, EXPORT_NUM_MAX);
+    size_t len = 0;
+
+    if (isnan(val) || isinf(val)) {
+        return false;
+    }
+    if (val >= 1e15 || val <= -1e15) {
+        buf->len += snprintf(out, EXPORT_NUM_MAX, "%.3f", val);
+        return true;
+    }
+
+    if (val < 0) {
+        out[len++] = '-';
+        val = -val;
+    }
+    uint64_t milli = (uint64_t)(val * 1000 + 0.5);
+    len += format_u64(&out[len], milli / 1000);
+    out[len++] = '.';
+    milli %= 1000;
+    out[len++] = (char)('0' + milli / 100);
+    out[len++] = (char)('0' + milli / 10 % 10);
+    out[len++] = (char)('0' + milli % 10);
+    buf->len += len;
+    return true;
+}
+
+static int
+buf_open(const char *file_name)
+{
+    g_buf->len = 0;
+    g_buf->fptr = fopen(file_name, "wb");
+    if (g_buf->fptr == NULL) {
+        fprintf(stderr, "Failed to open export file %s\n", file_name);
+        return 1;
+    }
+    printf("Export file: %s\n", file_name);
+    return 0;
+}
+
+static int
+buf_close(void)
+{
+    int rc = 0;
+
+    if (g_buf->fptr) {
+        rc = buf_flush(g_buf);
+        fclose(g_buf->fptr);
+        g_buf->fptr = NULL;
+    }
+    return rc;
+}
+/* buffered writer end */
+
+enum export_format
+export_parse_format(const char *name)
+{
+    if (strcmp(name, "json") == 0) {
+        return EXPORT_FORMAT_JSON;
+    } else if (strcmp(name, "csv") == 0) {
+        return EXPORT_FORMAT_CSV;
+    } else if (strcmp(name, "col") == 0) {
+        return EXPORT_FORMAT_COLUMNAR;
+    }
+    return EXPORT_FORMAT_NONE;
+}
+
+bool
+export_enabled(void)
+{
+    return g_format != EXPORT_FORMAT_NONE;
+}
+
+int
+export_open(enum export_format format, const char *prefix)
+{
+    g_buf = (struct export_buf *)malloc(sizeof(struct export_buf));
+    if (!g_buf) {
+        fprintf(stderr, "Fail to allocate memory for export buffer\n");
+        return 1;
+    }
+    g_buf->fptr = NULL;
+    g_buf->len = 0;
+    g_format = format;
+    g_first_table = true;
+    snprintf(g_prefix, sizeof(g_prefix), "%s", prefix);
+
+    if (format == EXPORT_FORMAT_JSON) {
+        char file_name[sizeof(g_prefix) + 8];
+        snprintf(file_name, sizeof(file_name), "%s.json", g_prefix);
+        if (buf_open(file_name)) {
+            free(g_buf);
+            g_buf = NULL;
+            g_format = EXPORT_FORMAT_NONE;
+            return 1;
+        }
+        buf_put_char(g_buf, '{');
+    }
+    return 0;
+}
+
+int
+export_table_begin(const char *name, const struct export_column *col, uint32_t num_col)
+{
+    char file_name[sizeof(g_prefix) + 80];
+
+    if (!export_enabled()) {
+        return 0;
+    }
+
+    g_col = NULL;
+    g_num_col = num_col;
+    g_num_row = 0;
+
+    switch (g_format) {
+    case EXPORT_FORMAT_JSON:
+        if (!g_first_table) {
+            buf_put_char(g_buf, ',');
+        }
+        buf_put_str(g_buf, "\n\"");
+        buf_put_str(g_buf, name);
+        buf_put_str(g_buf, "\":[");
+        break;
+    case EXPORT_FORMAT_CSV:
+        snprintf(file_name, sizeof(file_name), "%s_%s.csv", g_prefix, name);
+        if (buf_open(file_name)) {
+            return 1;
+        }
+        for (uint32_t i = 0; i < num_col; i++) {
+            if (i) {
+                buf_put_char(g_buf, ',');
+            }
+            buf_put_str(g_buf, col[i].name);
+        }
+        buf_put_char(g_buf, '\n');
+        break;
+    case EXPORT_FORMAT_COLUMNAR:
+        snprintf(file_name, sizeof(file_name), "%s_%s.col", g_prefix, name);
+        if (buf_open(file_name)) {
+            return 1;
+        }
+        g_col_data = (struct export_col_data *)calloc(num_col, sizeof(struct export_col_data));
+        if (!g_col_data) {
+            fprintf(stderr, "Fail to allocate memory for export column\n");
+            buf_close();
+            return 1;
+        }
+        break;
+    default:
+        break;
+    }
+    /* only a fully opened table accepts rows */
+    g_col = col;
+    g_first_table = false;
+    return 0;
+}
+
+static int
+col_append(struct export_col_data *col, uint64_t val, uint64_t row)
+{
+    if (row >= col->size) {
+        uint64_t size = spdk_max(col->size * 2, 4096);
+        uint64_t *buf = (uint64_t *)realloc(col->val, size * sizeof(uint64_t));
+        if (!buf) {
+            fprintf(stderr, "Fail to allocate memory for export column\n");
+            return 1;
+        }
+        col->val = buf;
+        col->size = size;
+    }
+    col->val[row] = val;
+    return 0;
+}
+
+int
+export_row(const union export_value *val)
+{
+    if (!export_enabled() || !g_col) {
+        return 0;
+    }
+
+    switch (g_format) {
+    case EXPORT_FORMAT_JSON:
+        buf_put_str(g_buf, g_num_row ? ",\n{" : "\n{");
+        for (uint32_t i = 0; i < g_num_col; i++) {
+            buf_put_str(g_buf, i ? ",\"" : "\"");
+            buf_put_str(g_buf, g_col[i].name);
+            buf_put_str(g_buf, "\":");
+            if (g_col[i].type == EXPORT_TYPE_U64) {
+                buf_put_u64(g_buf, val[i].u64);
+            } else if (!buf_put_f64(g_buf, val[i].f64)) {
+                buf_put_str(g_buf, "null");
+            }
+        }
+        buf_put_char(g_buf, '}');
+        break;
+    case EXPORT_FORMAT_CSV:
+        for (uint32_t i = 0; i < g_num_col; i++) {
+            if (i) {
+                buf_put_char(g_buf, ',');
+            }
+            if (g_col[i].type == EXPORT_TYPE_U64) {
+                buf_put_u64(g_buf, val[i].u64);
+            } else {
+                buf_put_f64(g_buf, val[i].f64);
+            }
+        }
+        buf_put_char(g_buf, '\n');
+        break;
+    case EXPORT_FORMAT_COLUMNAR:
+        for (uint32_t i = 0; i < g_num_col; i++) {
+            if (col_append(&g_col_data[i], val[i].u64, g_num_row)) {
+                return 1;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    g_num_row++;
+    return 0;
+}
+
+static int
+columnar_write(void)
+{
+    FILE *fptr = g_buf->fptr;
+    uint32_t num_col = g_num_col;
+    uint64_t num_row = g_num_row;
+    int rc = 0;
+
+    rc |= fwrite(EXPORT_COLUMNAR_MAGIC, 1, 8, fptr) != 8;
+    rc |= fwrite(&num_col, sizeof(num_col), 1, fptr) != 1;
+    rc |= fwrite(&num_row, sizeof(num_row), 1, fptr) != 1;
+    for (uint32_t i = 0; i < num_col; i++) {
+        uint8_t type = (uint8_t)g_col[i].type;
+        uint16_t name_len = (uint16_t)strlen(g_col[i].name);
+        rc |= fwrite(&type, sizeof(type), 1, fptr) != 1;
+        rc |= fwrite(&name_len, sizeof(name_len), 1, fptr) != 1;
+        rc |= fwrite(g_col[i].name, 1, name_len, fptr) != name_len;
+    }
+    for (uint32_t i = 0; i < num_col; i++) {
+        if (num_row) {
+            rc |= fwrite(g_col_data[i].val, sizeof(uint64_t), num_row, fptr) != num_row;
+        }
+        free(g_col_data[i].val);
+    }
+    free(g_col_data);
+    g_col_data = NULL;
+
+    if (rc) {
+        fprintf(stderr, "Fail to write export file\n");
+    }
+    return rc;
+}
+
+int
+export_table_end(void)
+{
+    int rc = 0;
+
+    if (!export_enabled() || !g_col) {
+        return 0;
+    }
+
+    switch (g_format) {
+    case EXPORT_FORMAT_JSON:
+        buf_put_char(g_buf, ']');
+        break;
+    case EXPORT_FORMAT_CSV:
+        rc = buf_close();
+        break;
+    case EXPORT_FORMAT_COLUMNAR:
+        rc = columnar_write();
+        rc |= buf_close();
+        break;
+    default:
+        break;
+    }
+    g_col = NULL;
+    return rc;
+}
+
+void
+export_close(void)
+{
+    if (!export_enabled()) {
+        return;
+    }
+    if (g_col) {
+        export_table_end();
+    }
+    if (g_format == EXPORT_FORMAT_JSON) {
+        buf_put_str(g_buf, "\n}\n");
+        buf_close();
+    }
+    free(g_buf);
+    g_buf = NULL;
+    g_format = EXPORT_FORMAT_NONE;
+}
@@ -0,0 +1,90 @@
+#include "spdk/stdinc.h"
+
+#ifndef TRACE_ANALYZER_EXPORT_H
+#define TRACE_ANALYZER_EXPORT_H
+
+enum export_format {
+    EXPORT_FORMAT_NONE = 0,
+    EXPORT_FORMAT_JSON,     /* <prefix>.json, one array of objects per table */
+    EXPORT_FORMAT_CSV,      /* <prefix>_<table>.csv per table */
+    EXPORT_FORMAT_COLUMNAR, /* <prefix>_<table>.col per table, see below */
+};
+
+/*
+ * Columnar file layout (little endian):
+ *   char     magic[8] = "TIOCOL1"
+ *   uint32_t num_col
+ *   uint64_t num_row
+ *   per column: uint8_t type, uint16_t name_len, char name[name_len]
+ *   per column: num_row values of 8 bytes (uint64_t or double)
+ */
+#define EXPORT_COLUMNAR_MAGIC "TIOCOL1"
+
+enum export_type {
+    EXPORT_TYPE_U64 = 0,
+    EXPORT_TYPE_F64,
+};
+
+struct export_column {
+    const char *name;
+    enum export_type type;
+};
+
+union export_value {
+    uint64_t u64;
+    double   f64;
+};
+
+/**
+ * Parse export format name.
+ *
+ * \param name "json", "csv" or "col".
+ * \return export format, EXPORT_FORMAT_NONE if the name is unknown.
+ */
+enum export_format export_parse_format(const char *name);
+
+/**
+ * Open the export sink. Tables are written under the path prefix.
+ *
+ * \param format output format.
+ * \param prefix path prefix of output files.
+ * \return 0 on success, else non-zero indicates a failure.
+ */
+int export_open(enum export_format format, const char *prefix);
+
+/**
+ * Start a new table, only one table can be open at a time.
+ *
+ * \param name table name.
+ * \param col column definitions, must be valid until export_table_end().
+ * \param num_col number of columns.
+ * \return 0 on success, else non-zero indicates a failure.
+ */
+int export_table_begin(const char *name, const struct export_column *col, uint32_t num_col);
+
+/**
+ * Append a row to the current table.
+ *
+ * \param val one value per column.
+ * \return 0 on success, else non-zero indicates a failure.
+ */
+int export_row(const union export_value *val);
+
+/**
+ * Finish the current table and write it out.
+ *
+ * \return 0 on success, else non-zero indicates a failure.
+ */
+int export_table_end(void);
+
+/**
+ * Flush and close the export sink.
+ */
+void export_close(void);
+
+/**
+ * Check if the export sink is open.
+ */
+bool export_enabled(void);
+
+#endif
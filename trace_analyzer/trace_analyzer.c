@@ -7,7 +7,8 @@
 #include "spdk/vmd.h"
 #include "spdk/nvme_zns.h"
 #include "spdk/nvme_spec.h"
-#include "../include/trace_io.h"
+#include "trace_io.h"
+#include "export.h"
 
 #define ENTRY_MAX 10000 /* number of trace_io_entry */
 
@@ -33,11 +34,22 @@ static bool g_print_trace = false;
 static bool g_input_file = false;
 static bool g_print_rwblock = false;
 static bool g_print_rwzone = false;
+static bool g_stream_analysis = false;
+static uint64_t g_coalesce_window_us = 50; /* max submit gap of two I/Os to be merged */
+static bool g_arrival_analysis = false;
+static uint64_t g_idle_threshold_us = 1000; /* min length of a reported idle period */
+static bool g_lcore_analysis = false;
+static uint64_t g_lcore_interval_ms = 1000; /* interval of per-lcore time-series */
+static bool g_compare = false;
+static bool g_sim_analysis = false;
+static enum export_format g_export_format = EXPORT_FORMAT_NONE;
+static const char *g_export_prefix = NULL;
 /* info about nvme device & zone*/
 static bool g_zone = false;     /* namespace is ZNS */
 static uint64_t g_ns_block = 0; /* number of blocks in a namespace */
 static uint64_t g_ns_zone = 0;  /* number of zones in a namespace */
-static size_t g_max_transfer_block = 0;
+static size_t g_mdts_block = 0;    /* MDTS in blocks, bounds coalescing */
+static uint32_t g_block_byte = 0;
 static uint64_t g_zone_size_lba = 0;
 
 static float
@@ -161,6 +173,9 @@ rw_ratio(uint64_t read, uint64_t write)
     return ratio = (read + write) ? (read * 100) / (read + write) : 0;
 }
 
+/* request size histogram, indexed by the 0-based NLB of the command */
+#define IOSIZE_MAX (UINT16BIT_MASK + 1)
+
 static int
 iosize_rw_counter(uint8_t opc, uint32_t nlb, uint32_t *r_iosize, uint32_t *w_iosize)
 {
@@ -203,6 +218,7 @@ static TAILQ_HEAD(latency_list, latency) g_latency_sum = TAILQ_HEAD_INITIALIZER(
 static uint64_t g_tsc_rate = 0;
 static uint64_t g_latency_tsc_min = 0, g_latency_tsc_max = 0, g_latency_tsc_avg = 0;
 static float g_latency_us_min = 0.0, g_latency_us_max = 0.0, g_latency_us_avg = 0.0;
+static struct trace_io_hist g_latency_hist; /* for calculate latency percentile */
 
 static void
 latency_min_max(uint64_t tsc_sc_time, uint64_t tsc_rate)
@@ -269,150 +285,1858 @@ latency_avg(int number_of_io)
     g_latency_us_avg = get_us_from_tsc(g_latency_tsc_avg, g_tsc_rate);
 }
 
-static int
-block_counter(uint8_t opc, uint64_t slba, uint16_t nlb, uint16_t *r_block, uint16_t *w_block)
+static int
+block_counter(uint8_t opc, uint64_t slba, uint16_t nlb, uint16_t *r_block, uint16_t *w_block)
+{
+    int rc = 0;
+    uint64_t idx = slba;
+
+    switch (opc) {
+    case SPDK_NVME_OPC_READ:
+    case SPDK_NVME_OPC_COMPARE: 
+        for (int i = 0; i < nlb; i++) {
+            r_block[idx + i]++;
+        }
+        break;        
+    case SPDK_NVME_OPC_WRITE:
+    case SPDK_NVME_OPC_ZONE_APPEND:
+    case SPDK_NVME_OPC_WRITE_ZEROES:
+        for (int i = 0; i < nlb; i++) {
+            w_block[idx + i]++;
+        }
+        break;
+    case SPDK_NVME_OPC_WRITE_UNCORRECTABLE:
+    case SPDK_NVME_OPC_COPY:
+    case SPDK_NVME_OPC_VERIFY:
+    case SPDK_NVME_OPC_DATASET_MANAGEMENT:
+    case SPDK_NVME_OPC_FLUSH:
+    case SPDK_NVME_OPC_ZONE_MGMT_RECV:
+    case SPDK_NVME_OPC_ZONE_MGMT_SEND:
+    case SPDK_NVME_OPC_RESERVATION_REGISTER: 
+    case SPDK_NVME_OPC_RESERVATION_REPORT:
+    case SPDK_NVME_OPC_RESERVATION_ACQUIRE:
+    case SPDK_NVME_OPC_RESERVATION_RELEASE:
+        break;
+    default:
+        rc = 1;
+        break; 
+    }   
+    return rc;    
+}
+
+static int
+zone_counter(uint8_t opc, uint64_t slba, uint16_t *r_zone, uint16_t *w_zone)
+{
+    int rc = 0;
+    uint64_t zidx = slba / g_zone_size_lba;
+
+    switch (opc) {
+    case SPDK_NVME_OPC_READ:
+    case SPDK_NVME_OPC_COMPARE:
+        r_zone[zidx]++;
+        break;
+    case SPDK_NVME_OPC_WRITE:
+    case SPDK_NVME_OPC_ZONE_APPEND:
+    case SPDK_NVME_OPC_WRITE_ZEROES:
+        w_zone[zidx]++;
+        break;
+    case SPDK_NVME_OPC_WRITE_UNCORRECTABLE:
+    case SPDK_NVME_OPC_COPY:
+    case SPDK_NVME_OPC_VERIFY:
+    case SPDK_NVME_OPC_DATASET_MANAGEMENT:
+    case SPDK_NVME_OPC_FLUSH:
+    case SPDK_NVME_OPC_ZONE_MGMT_RECV:
+    case SPDK_NVME_OPC_ZONE_MGMT_SEND:
+    case SPDK_NVME_OPC_RESERVATION_REGISTER:
+    case SPDK_NVME_OPC_RESERVATION_REPORT:
+    case SPDK_NVME_OPC_RESERVATION_ACQUIRE:
+    case SPDK_NVME_OPC_RESERVATION_RELEASE:
+        break;
+    default:
+        rc = 1;
+        break;
+    }
+    return rc;
+}
+
+static uint64_t g_end_tsc = 0;
+static uint64_t g_req_num = 0;
+static float
+iops(uint64_t end_tsc, uint64_t req_num)
+{
+    float IOPS = 0.0;
+    if (req_num ==0 || end_tsc == 0) {
+        return IOPS;
+    }
+    float end_sec = get_us_from_tsc(end_tsc, g_tsc_rate) / (1000 * 1000);
+    return IOPS = (float)req_num / end_sec;
+}
+
+static int
+process_analysis_round1(struct trace_io_entry *d, uint32_t *r_iosize, uint32_t *w_iosize)
+{
+    if (!g_tsc_rate) { /* for calculate g_latency_us_avg */
+        g_tsc_rate = d->tsc_rate;
+    }
+
+    int rc;
+    uint32_t nlb = d->cdw12 & UINT16BIT_MASK;
+    if (strcmp(d->tpoint_name, "NVME_IO_SUBMIT") == 0) {
+        rc = iosize_rw_counter(d->opc, nlb, r_iosize, w_iosize);    /* for calculate request size */
+        if (rc) {
+            printf("Unknown Opcode\n");
+            return rc;
+        }
+    }
+
+    if (strcmp(d->tpoint_name, "NVME_IO_COMPLETE") == 0) {
+        g_end_tsc = d->tsc_timestamp;                               /* for calculate IOPS */
+        latency_min_max(d->tsc_sc_time, d->tsc_rate);               /* for calculate latency (min & max) */
+        latency_total(d->tsc_sc_time);                              /* for calculate latency (avg) */
+        trace_io_hist_record(&g_latency_hist, d->tsc_sc_time);      /* for calculate latency percentile */
+    }
+
+    return rc;
+}
+
+static int
+process_analysis_round2(struct trace_io_entry *d, uint16_t *r_blk, uint16_t *w_blk,  uint16_t *r_zone, uint16_t *w_zone)
+{
+    int rc;
+    uint64_t slba = 0;    
+    if (strcmp(d->tpoint_name, "NVME_IO_SUBMIT") == 0 && d->opc != SPDK_NVME_OPC_DATASET_MANAGEMENT) {
+        slba = (uint64_t)d->cdw10 | ((uint64_t)d->cdw11 & UINT32BIT_MASK) << 32;
+
+        if (d->opc != SPDK_NVME_OPC_ZONE_MGMT_RECV && 
+            d->opc != SPDK_NVME_OPC_ZONE_MGMT_SEND &&
+            d->opc != SPDK_NVME_OPC_COPY) {
+            uint32_t nlb = (d->cdw12 & UINT16BIT_MASK) + 1;
+            rc = block_counter(d->opc, slba, nlb, r_blk, w_blk);      /* for calculate r/w # in a block */
+            if (rc) {
+                printf("Count block read / write fail\n");
+                return rc;
+            }  
+            
+        }
+
+        if (g_zone) {
+            rc = zone_counter(d->opc, slba, r_zone, w_zone);          /* for calculate r/w # in a zone */
+            if (rc) {
+                printf("Count block read / write fail\n");
+                return rc;
+            }
+        }
+    }
+    return rc;
+}
+/* trace analysis end */
+
+/* export start */
+static void
+export_hist_table(const char *name, const struct trace_io_hist *hist)
+{
+    static const struct export_column col[] = {
+        {"lower_us", EXPORT_TYPE_F64}, {"upper_us", EXPORT_TYPE_F64}, {"count", EXPORT_TYPE_U64},
+    };
+    union export_value val[SPDK_COUNTOF(col)];
+
+    if (export_table_begin(name, col, SPDK_COUNTOF(col))) {
+        return;
+    }
+    for (uint32_t i = 0; i < TRACE_IO_HIST_BUCKET; i++) {
+        if (!hist->bucket[i]) {
+            continue;
+        }
+        val[0].f64 = get_us_from_tsc(trace_io_hist_bucket_lower(i), g_tsc_rate);
+        val[1].f64 = get_us_from_tsc(trace_io_hist_bucket_upper(i), g_tsc_rate);
+        val[2].u64 = hist->bucket[i];
+        export_row(val);
+    }
+    export_table_end();
+}
+
+static void
+export_summary(uint32_t *r_iosize, uint32_t *w_iosize)
+{
+    static const struct export_column summary_col[] = {
+        {"iops", EXPORT_TYPE_F64}, {"latency_min_us", EXPORT_TYPE_F64}, {"latency_max_us", EXPORT_TYPE_F64},
+        {"latency_avg_us", EXPORT_TYPE_F64}, {"latency_p50_us", EXPORT_TYPE_F64},
+        {"latency_p99_us", EXPORT_TYPE_F64}, {"latency_p999_us", EXPORT_TYPE_F64},
+        {"read", EXPORT_TYPE_U64}, {"write", EXPORT_TYPE_U64}, {"read_ratio", EXPORT_TYPE_F64},
+    };
+    static const struct export_column iosize_col[] = {
+        {"blocks", EXPORT_TYPE_U64}, {"read", EXPORT_TYPE_U64}, {"write", EXPORT_TYPE_U64},
+    };
+    union export_value val[SPDK_COUNTOF(summary_col)];
+
+    if (export_table_begin("summary", summary_col, SPDK_COUNTOF(summary_col))) {
+        return;
+    }
+    val[0].f64 = iops(g_end_tsc, g_req_num);
+    val[1].f64 = g_latency_us_min;
+    val[2].f64 = g_latency_us_max;
+    val[3].f64 = g_latency_us_avg;
+    val[4].f64 = get_us_from_tsc(trace_io_hist_percentile(&g_latency_hist, 50), g_tsc_rate);
+    val[5].f64 = get_us_from_tsc(trace_io_hist_percentile(&g_latency_hist, 99), g_tsc_rate);
+    val[6].f64 = get_us_from_tsc(trace_io_hist_percentile(&g_latency_hist, 99.9), g_tsc_rate);
+    val[7].u64 = g_read_cnt;
+    val[8].u64 = g_write_cnt;
+    val[9].f64 = rw_ratio(g_read_cnt, g_write_cnt);
+    export_row(val);
+    export_table_end();
+
+    export_hist_table("latency_hist", &g_latency_hist);
+
+    if (export_table_begin("iosize", iosize_col, SPDK_COUNTOF(iosize_col))) {
+        return;
+    }
+    for (uint64_t i = 0; i < IOSIZE_MAX; i++) {
+        if (!r_iosize[i] && !w_iosize[i]) {
+            continue;
+        }
+        val[0].u64 = i + 1;
+        val[1].u64 = r_iosize[i];
+        val[2].u64 = w_iosize[i];
+        export_row(val);
+    }
+    export_table_end();
+}
+
+static void
+export_rw_count(const char *name, const char *key, uint64_t num, uint64_t key_scale,
+                uint16_t *r_cnt, uint16_t *w_cnt)
+{
+    const struct export_column col[] = {
+        {key, EXPORT_TYPE_U64}, {"read", EXPORT_TYPE_U64}, {"write", EXPORT_TYPE_U64},
+    };
+    union export_value val[SPDK_COUNTOF(col)];
+
+    if (export_table_begin(name, col, SPDK_COUNTOF(col))) {
+        return;
+    }
+    for (uint64_t i = 0; i < num; i++) {
+        if (!r_cnt[i] && !w_cnt[i]) {
+            continue;
+        }
+        val[0].u64 = i * key_scale;
+        val[1].u64 = r_cnt[i];
+        val[2].u64 = w_cnt[i];
+        export_row(val);
+    }
+    export_table_end();
+}
+/* export end */
+
+/* sequential stream analysis start */
+#define STREAM_TABLE_SIZE 16    /* number of concurrent streams tracked by a table */
+#define STREAM_RUN_BUCKET 21    /* run length histogram: 1, 2-3, 4-7, ..., >= 2^20 I/Os */
+
+struct stream_entry {
+    bool     valid;
+    bool     write;
+    uint64_t next_lba;      /* next expected LBA (zslba for zone append) */
+    uint64_t last_tsc;      /* submit time of the last I/O of the stream */
+    uint64_t run_len;       /* number of I/Os in the stream */
+    uint64_t merge_blk;     /* blocks in the coalesced request currently being built */
+};
+
+struct stream_table {
+    struct stream_entry entry[STREAM_TABLE_SIZE];
+    uint64_t num_io;        /* read / write / append requests seen */
+    uint64_t num_seq_io;    /* requests continuing an existing stream */
+    uint64_t num_coalesce;  /* requests that could be merged into the previous one */
+    uint64_t num_stream;    /* runs with at least 2 I/Os */
+    uint64_t run_hist[STREAM_RUN_BUCKET];
+};
+
+static struct stream_table g_stream_global;
+static struct stream_table *g_stream_lcore[SPDK_TRACE_MAX_LCORE];
+static uint64_t g_coalesce_window_tsc = 0;
+
+static uint32_t
+run_len_bucket(uint64_t run_len)
+{
+    uint32_t bucket = 63 - __builtin_clzll(run_len);
+    return (bucket < STREAM_RUN_BUCKET) ? bucket : STREAM_RUN_BUCKET - 1;
+}
+
+static void
+stream_retire(struct stream_table *table, struct stream_entry *s)
+{
+    if (!s->valid) {
+        return;
+    }
+    table->run_hist[run_len_bucket(s->run_len)]++;
+    if (s->run_len > 1) {
+        table->num_stream++;
+    }
+    s->valid = false;
+}
+
+static void
+stream_update(struct stream_table *table, bool write, bool append, uint64_t slba, uint32_t nlb, uint64_t tsc)
+{
+    struct stream_entry *s, *victim = NULL;
+
+    table->num_io++;
+
+    for (int i = 0; i < STREAM_TABLE_SIZE; i++) {
+        s = &table->entry[i];
+        if (!s->valid) {
+            if (!victim || victim->valid) {
+                victim = s;     /* prefer a free entry */
+            }
+            continue;
+        }
+        if (s->next_lba != slba || s->write != write) {
+            if (!victim || (victim->valid && s->last_tsc < victim->last_tsc)) {
+                victim = s;     /* least recently used stream */
+            }
+            continue;
+        }
+
+        /* I/O continues the stream, check if it could be merged into the previous request */
+        table->num_seq_io++;
+        if (tsc - s->last_tsc <= g_coalesce_window_tsc &&
+            (!g_mdts_block || s->merge_blk + nlb <= g_mdts_block)) {
+            table->num_coalesce++;
+            s->merge_blk += nlb;
+        } else {
+            s->merge_blk = nlb;
+        }
+        s->run_len++;
+        s->next_lba = append ? slba : slba + nlb;
+        s->last_tsc = tsc;
+        return;
+    }
+
+    /* start a new stream */
+    stream_retire(table, victim);
+    victim->valid = true;
+    victim->write = write;
+    victim->next_lba = append ? slba : slba + nlb;
+    victim->last_tsc = tsc;
+    victim->run_len = 1;
+    victim->merge_blk = nlb;
+}
+
+static int
+process_stream_analysis(struct trace_io_entry *d)
+{
+    bool write, append = false;
+
+    if (strcmp(d->tpoint_name, "NVME_IO_SUBMIT") != 0) {
+        return 0;
+    }
+
+    switch (d->opc) {
+    case SPDK_NVME_OPC_READ:
+        write = false;
+        break;
+    case SPDK_NVME_OPC_ZONE_APPEND:
+        append = true;
+        /* fallthrough */
+    case SPDK_NVME_OPC_WRITE:
+        write = true;
+        break;
+    default:
+        return 0;
+    }
+
+    if (d->lcore >= SPDK_TRACE_MAX_LCORE) {
+        fprintf(stderr, "Invalid lcore %u\n", d->lcore);
+        return 1;
+    }
+
+    if (!g_coalesce_window_tsc) {
+        g_coalesce_window_tsc = g_coalesce_window_us * d->tsc_rate / (1000 * 1000);
+    }
+
+    struct stream_table *table = g_stream_lcore[d->lcore];
+    if (!table) {
+        table = (struct stream_table *)calloc(1, sizeof(struct stream_table));
+        if (!table) {
+            fprintf(stderr, "Fail to allocate memory for stream table\n");
+            return 1;
+        }
+        g_stream_lcore[d->lcore] = table;
+    }
+
+    uint64_t slba = (uint64_t)d->cdw10 | ((uint64_t)d->cdw11 & UINT32BIT_MASK) << 32;
+    uint32_t nlb = (d->cdw12 & UINT16BIT_MASK) + 1;
+    stream_update(&g_stream_global, write, append, slba, nlb, d->tsc_timestamp);
+    stream_update(table, write, append, slba, nlb, d->tsc_timestamp);
+
+    return 0;
+}
+
+static void
+print_stream_table(const char *name, struct stream_table *table)
+{
+    float seq_ratio = table->num_io ? (float)table->num_seq_io * 100 / table->num_io : 0;
+    float coalesce_ratio = table->num_io ? (float)table->num_coalesce * 100 / table->num_io : 0;
+
+    printf("%-20s:  ", name);
+    printf("I/O %-12ju STREAM %-10ju SEQ %7.3f %%  COALESCE %7.3f %%  MERGED I/O %-12ju\n",
+           table->num_io, table->num_stream, seq_ratio, coalesce_ratio, table->num_io - table->num_coalesce);
+}
+
+static void
+print_stream_analysis(void)
+{
+    struct stream_table lcore_sum;
+    memset(&lcore_sum, 0, sizeof(lcore_sum));
+
+    /* flush the streams still in the table */
+    for (int i = 0; i < STREAM_TABLE_SIZE; i++) {
+        stream_retire(&g_stream_global, &g_stream_global.entry[i]);
+    }
+    for (int lcore = 0; lcore < SPDK_TRACE_MAX_LCORE; lcore++) {
+        struct stream_table *table = g_stream_lcore[lcore];
+        if (!table) {
+            continue;
+        }
+        for (int i = 0; i < STREAM_TABLE_SIZE; i++) {
+            stream_retire(table, &table->entry[i]);
+        }
+        lcore_sum.num_io += table->num_io;
+        lcore_sum.num_seq_io += table->num_seq_io;
+        lcore_sum.num_coalesce += table->num_coalesce;
+        lcore_sum.num_stream += table->num_stream;
+        for (int i = 0; i < STREAM_RUN_BUCKET; i++) {
+            lcore_sum.run_hist[i] += table->run_hist[i];
+        }
+    }
+
+    print_uline('=', printf("\nSequential Stream Analysis\n"));
+    printf("%-20s:  %ju (us)  MDTS %zu (blocks)\n", "Coalesce window", g_coalesce_window_us, g_mdts_block);
+    print_stream_table("Global", &g_stream_global);
+    print_stream_table("Per lcore", &lcore_sum);
+    for (int lcore = 0; lcore < SPDK_TRACE_MAX_LCORE; lcore++) {
+        if (g_stream_lcore[lcore]) {
+            char name[16];
+            snprintf(name, sizeof(name), "  lcore %d", lcore);
+            print_stream_table(name, g_stream_lcore[lcore]);
+        }
+    }
+
+    printf("%-20s:\n", "Run length (I/O)");
+    for (int i = 0; i < STREAM_RUN_BUCKET; i++) {
+        if (!g_stream_global.run_hist[i] && !lcore_sum.run_hist[i]) {
+            continue;
+        }
+        printf("%7ju - %-10ju  ", (uint64_t)1 << i, ((uint64_t)1 << (i + 1)) - 1);
+        printf("global %-10ju ", g_stream_global.run_hist[i]);
+        printf("lcore %-10ju ", lcore_sum.run_hist[i]);
+        printf("\n");
+    }
+
+    if (export_enabled()) {
+        static const struct export_column stream_col[] = {
+            {"lcore", EXPORT_TYPE_U64}, {"io", EXPORT_TYPE_U64}, {"seq_io", EXPORT_TYPE_U64},
+            {"coalesce_io", EXPORT_TYPE_U64}, {"stream", EXPORT_TYPE_U64},
+        };
+        static const struct export_column run_col[] = {
+            {"run_min", EXPORT_TYPE_U64}, {"run_max", EXPORT_TYPE_U64},
+            {"global", EXPORT_TYPE_U64}, {"lcore", EXPORT_TYPE_U64},
+        };
+        union export_value val[SPDK_COUNTOF(stream_col)];
+
+        /* lcore is UINT64_MAX for the global table */
+        if (!export_table_begin("stream", stream_col, SPDK_COUNTOF(stream_col))) {
+            for (int lcore = -1; lcore < SPDK_TRACE_MAX_LCORE; lcore++) {
+                struct stream_table *table = (lcore < 0) ? &g_stream_global : g_stream_lcore[lcore];
+                if (!table) {
+                    continue;
+                }
+                val[0].u64 = (lcore < 0) ? UINT64_MAX : (uint64_t)lcore;
+                val[1].u64 = table->num_io;
+                val[2].u64 = table->num_seq_io;
+                val[3].u64 = table->num_coalesce;
+                val[4].u64 = table->num_stream;
+                export_row(val);
+            }
+            export_table_end();
+        }
+
+        if (!export_table_begin("stream_run", run_col, SPDK_COUNTOF(run_col))) {
+            for (int i = 0; i < STREAM_RUN_BUCKET; i++) {
+                val[0].u64 = (uint64_t)1 << i;
+                val[1].u64 = ((uint64_t)1 << (i + 1)) - 1;
+                val[2].u64 = g_stream_global.run_hist[i];
+                val[3].u64 = lcore_sum.run_hist[i];
+                export_row(val);
+            }
+            export_table_end();
+        }
+    }
+
+    for (int lcore = 0; lcore < SPDK_TRACE_MAX_LCORE; lcore++) {
+        free(g_stream_lcore[lcore]);
+        g_stream_lcore[lcore] = NULL;
+    }
+}
+/* sequential stream analysis end */
+
+/* arrival analysis start */
+#define ARRIVAL_HIST_BUCKET 41  /* inter-arrival / idle histogram: [2^i, 2^(i+1)) ns */
+#define WINDOW_HIST_BUCKET 33   /* arrivals per window histogram: 0, 1, 2-3, 4-7, ... */
+
+/* time scales for index of dispersion and peak-to-mean */
+static const uint64_t g_arrival_scale_us[] = {100, 1000, 10000, 100000, 1000000};
+#define ARRIVAL_SCALE_NUM SPDK_COUNTOF(g_arrival_scale_us)
+
+struct arrival_scale {
+    uint64_t window_tsc;
+    uint64_t cur_window;    /* index of the current window */
+    uint64_t cur_cnt;       /* arrivals in the current window */
+    uint64_t num_window;    /* closed windows, including empty ones */
+    uint64_t max_cnt;
+    double   sum;
+    double   sum_sq;
+    uint64_t cnt_hist[WINDOW_HIST_BUCKET];
+};
+
+struct arrival_stat {
+    uint64_t num_arrival;
+    uint64_t last_submit_tsc;
+    double   iat_sum;       /* inter-arrival time in ns */
+    double   iat_sum_sq;
+    uint64_t iat_hist[ARRIVAL_HIST_BUCKET];
+    struct arrival_scale scale[ARRIVAL_SCALE_NUM];
+    /* idle period: no I/O outstanding on the device */
+    uint64_t outstanding;
+    uint64_t idle_start_tsc;
+    uint64_t idle_threshold_tsc;
+    uint64_t num_idle;
+    uint64_t idle_total_tsc;
+    uint64_t idle_max_tsc;
+    uint64_t idle_hist[ARRIVAL_HIST_BUCKET];
+    uint64_t last_tsc;
+    uint64_t tsc_rate;
+};
+
+static struct arrival_stat g_arrival;
+
+static uint32_t
+log2_bucket(uint64_t val, uint32_t num_bucket)
+{
+    uint32_t bucket = val ? 63 - __builtin_clzll(val) : 0;
+    return (bucket < num_bucket) ? bucket : num_bucket - 1;
+}
+
+static uint64_t
+get_ns_from_tsc(uint64_t tsc, uint64_t tsc_rate)
+{
+    return (uint64_t)((double)tsc * 1000 * 1000 * 1000 / tsc_rate);
+}
+
+static void
+arrival_window_close(struct arrival_scale *sc, uint64_t num_empty)
+{
+    sc->sum += sc->cur_cnt;
+    sc->sum_sq += (double)sc->cur_cnt * sc->cur_cnt;
+    sc->max_cnt = spdk_max(sc->max_cnt, sc->cur_cnt);
+    sc->cnt_hist[sc->cur_cnt ? log2_bucket(sc->cur_cnt, WINDOW_HIST_BUCKET - 1) + 1 : 0]++;
+    sc->num_window += 1 + num_empty;
+    sc->cnt_hist[0] += num_empty;
+}
+
+static void
+arrival_submit(struct arrival_stat *st, uint64_t tsc)
+{
+    bool first = st->num_arrival == 0;
+
+    if (!first) {
+        uint64_t iat_ns = get_ns_from_tsc(tsc - st->last_submit_tsc, st->tsc_rate);
+        st->iat_sum += iat_ns;
+        st->iat_sum_sq += (double)iat_ns * iat_ns;
+        st->iat_hist[log2_bucket(iat_ns, ARRIVAL_HIST_BUCKET)]++;
+    }
+    st->num_arrival++;
+    st->last_submit_tsc = tsc;
+
+    for (size_t i = 0; i < ARRIVAL_SCALE_NUM; i++) {
+        struct arrival_scale *sc = &st->scale[i];
+        uint64_t window = tsc / sc->window_tsc;
+        if (first) {
+            /* windows start with the trace, not at tsc 0 */
+            sc->cur_window = window;
+        } else if (window != sc->cur_window) {
+            arrival_window_close(sc, window - sc->cur_window - 1);
+            sc->cur_window = window;
+            sc->cur_cnt = 0;
+        }
+        sc->cur_cnt++;
+    }
+
+    /* end of an idle period, the time before the first request is not one */
+    if (st->outstanding == 0 && !first) {
+        uint64_t idle_tsc = tsc - st->idle_start_tsc;
+        if (idle_tsc >= st->idle_threshold_tsc) {
+            st->num_idle++;
+            st->idle_total_tsc += idle_tsc;
+            st->idle_max_tsc = spdk_max(st->idle_max_tsc, idle_tsc);
+            st->idle_hist[log2_bucket(get_ns_from_tsc(idle_tsc, st->tsc_rate), ARRIVAL_HIST_BUCKET)]++;
+        }
+    }
+    st->outstanding++;
+}
+
+static void
+arrival_complete(struct arrival_stat *st, uint64_t tsc)
+{
+    /* completion of an I/O submitted before the trace start */
+    if (st->outstanding == 0) {
+        return;
+    }
+    if (--st->outstanding == 0) {
+        st->idle_start_tsc = tsc;
+    }
+}
+
+static void
+process_arrival_analysis(struct trace_io_entry *d)
+{
+    struct arrival_stat *st = &g_arrival;
+
+    if (!st->tsc_rate) {
+        st->tsc_rate = d->tsc_rate;
+        st->idle_threshold_tsc = g_idle_threshold_us * d->tsc_rate / (1000 * 1000);
+        for (size_t i = 0; i < ARRIVAL_SCALE_NUM; i++) {
+            st->scale[i].window_tsc = spdk_max(g_arrival_scale_us[i] * d->tsc_rate / (1000 * 1000), 1);
+        }
+    }
+    st->last_tsc = d->tsc_timestamp;
+
+    if (strcmp(d->tpoint_name, "NVME_IO_SUBMIT") == 0) {
+        arrival_submit(st, d->tsc_timestamp);
+    } else if (strcmp(d->tpoint_name, "NVME_IO_COMPLETE") == 0) {
+        arrival_complete(st, d->tsc_timestamp);
+    }
+}
+
+static void
+print_arrival_hist(const char *name, uint64_t *hist)
+{
+    printf("%-20s:\n", name);
+    for (int i = 0; i < ARRIVAL_HIST_BUCKET; i++) {
+        if (!hist[i]) {
+            continue;
+        }
+        printf("%16.3f - %-16.3f  %-12ju\n", (float)((uint64_t)1 << i) / 1000,
+               (float)((uint64_t)1 << (i + 1)) / 1000, hist[i]);
+    }
+}
+
+static void
+print_arrival_analysis(void)
+{
+    struct arrival_stat *st = &g_arrival;
+
+    print_uline('=', printf("\nArrival Analysis\n"));
+    if (st->num_arrival < 2) {
+        printf("Not enough requests\n");
+        return;
+    }
+
+    /* close the last window of each time scale */
+    for (size_t i = 0; i < ARRIVAL_SCALE_NUM; i++) {
+        arrival_window_close(&st->scale[i], 0);
+    }
+
+    uint64_t num_iat = st->num_arrival - 1;
+    double iat_mean = st->iat_sum / num_iat;
+    double iat_var = st->iat_sum_sq / num_iat - iat_mean * iat_mean;
+    double iat_std = iat_var > 0 ? sqrt(iat_var) : 0;
+    printf("%-20s:  ", "Inter-arrival (us)");
+    printf("AVG   %-20.3f STD   %-20.3f CV  %-20.3f\n", iat_mean / 1000, iat_std / 1000,
+           iat_mean > 0 ? iat_std / iat_mean : 0);
+    print_arrival_hist("Inter-arrival (us)", st->iat_hist);
+
+    printf("%-20s:\n", "Dispersion / burst");
+    for (size_t i = 0; i < ARRIVAL_SCALE_NUM; i++) {
+        struct arrival_scale *sc = &st->scale[i];
+        double mean = sc->sum / sc->num_window;
+        double var = sc->sum_sq / sc->num_window - mean * mean;
+        printf("window %8ju us  ", g_arrival_scale_us[i]);
+        printf("windows %-12ju ", sc->num_window);
+        printf("mean %-12.3f ", mean);
+        printf("IDC %-12.3f ", mean > 0 ? var / mean : 0);
+        printf("peak %-10ju ", sc->max_cnt);
+        printf("peak/mean %-10.3f\n", mean > 0 ? sc->max_cnt / mean : 0);
+    }
+    printf("%-20s:\n", "Arrivals per window");
+    for (int b = 0; b < WINDOW_HIST_BUCKET; b++) {
+        bool used = false;
+        for (size_t i = 0; i < ARRIVAL_SCALE_NUM; i++) {
+            used |= st->scale[i].cnt_hist[b] != 0;
+        }
+        if (!used) {
+            continue;
+        }
+        if (b == 0) {
+            printf("%21s  ", "0");
+        } else {
+            printf("%10ju - %-8ju  ", (uint64_t)1 << (b - 1), ((uint64_t)1 << b) - 1);
+        }
+        for (size_t i = 0; i < ARRIVAL_SCALE_NUM; i++) {
+            printf("%-12ju ", st->scale[i].cnt_hist[b]);
+        }
+        printf("\n");
+    }
+
+    float span_us = get_us_from_tsc(st->last_tsc, st->tsc_rate);
+    float idle_us = get_us_from_tsc(st->idle_total_tsc, st->tsc_rate);
+    printf("%-20s:  ", "Idle period");
+    printf("THRESHOLD %ju us  COUNT %-12ju TOTAL %.3f us (%.3f %%)  MAX %.3f us\n", g_idle_threshold_us,
+           st->num_idle, idle_us, span_us > 0 ? idle_us * 100 / span_us : 0,
+           get_us_from_tsc(st->idle_max_tsc, st->tsc_rate));
+    print_arrival_hist("Idle period (us)", st->idle_hist);
+
+    if (export_enabled()) {
+        static const struct export_column hist_col[] = {
+            {"lower_us", EXPORT_TYPE_F64}, {"upper_us", EXPORT_TYPE_F64},
+            {"inter_arrival", EXPORT_TYPE_U64}, {"idle", EXPORT_TYPE_U64},
+        };
+        static const struct export_column scale_col[] = {
+            {"window_us", EXPORT_TYPE_U64}, {"windows", EXPORT_TYPE_U64}, {"mean", EXPORT_TYPE_F64},
+            {"idc", EXPORT_TYPE_F64}, {"peak", EXPORT_TYPE_U64}, {"peak_to_mean", EXPORT_TYPE_F64},
+        };
+        union export_value val[SPDK_COUNTOF(scale_col)];
+
+        if (!export_table_begin("arrival_hist", hist_col, SPDK_COUNTOF(hist_col))) {
+            for (int i = 0; i < ARRIVAL_HIST_BUCKET; i++) {
+                if (!st->iat_hist[i] && !st->idle_hist[i]) {
+                    continue;
+                }
+                val[0].f64 = (double)((uint64_t)1 << i) / 1000;
+                val[1].f64 = (double)((uint64_t)1 << (i + 1)) / 1000;
+                val[2].u64 = st->iat_hist[i];
+                val[3].u64 = st->idle_hist[i];
+                export_row(val);
+            }
+            export_table_end();
+        }
+
+        if (!export_table_begin("arrival_window", scale_col, SPDK_COUNTOF(scale_col))) {
+            for (size_t i = 0; i < ARRIVAL_SCALE_NUM; i++) {
+                struct arrival_scale *sc = &st->scale[i];
+                double mean = sc->sum / sc->num_window;
+                double var = sc->sum_sq / sc->num_window - mean * mean;
+                val[0].u64 = g_arrival_scale_us[i];
+                val[1].u64 = sc->num_window;
+                val[2].f64 = mean;
+                val[3].f64 = mean > 0 ? var / mean : 0;
+                val[4].u64 = sc->max_cnt;
+                val[5].f64 = mean > 0 ? sc->max_cnt / mean : 0;
+                export_row(val);
+            }
+            export_table_end();
+        }
+    }
+}
+/* arrival analysis end */
+
+/* lcore analysis start */
+enum lcore_opc_class {
+    LCORE_OPC_READ = 0,
+    LCORE_OPC_WRITE,
+    LCORE_OPC_APPEND,
+    LCORE_OPC_ZONE_MGMT,
+    LCORE_OPC_OTHER,
+    LCORE_OPC_NUM,
+};
+
+static const char *g_lcore_opc_name[LCORE_OPC_NUM] = {"READ", "WRITE", "APPEND", "ZONE MGMT", "OTHER"};
+
+struct lcore_interval {
+    uint64_t num_cpl;
+    uint64_t latency_tsc;
+};
+
+struct lcore_stat {
+    uint64_t num_submit;
+    uint64_t num_cpl;
+    uint64_t opc_cnt[LCORE_OPC_NUM];
+    uint64_t read_blk;
+    uint64_t write_blk;
+    struct trace_io_hist latency;
+    struct lcore_interval *interval;    /* time-series of completions */
+    uint64_t num_interval;
+};
+
+static struct lcore_stat *g_lcore_stat[SPDK_TRACE_MAX_LCORE];
+static uint64_t g_lcore_interval_tsc = 0;
+static uint64_t g_lcore_num_interval = 0;
+
+static enum lcore_opc_class
+lcore_opc_class(uint16_t opc)
+{
+    switch (opc) {
+    case SPDK_NVME_OPC_READ:
+    case SPDK_NVME_OPC_COMPARE:
+        return LCORE_OPC_READ;
+    case SPDK_NVME_OPC_WRITE:
+    case SPDK_NVME_OPC_WRITE_ZEROES:
+        return LCORE_OPC_WRITE;
+    case SPDK_NVME_OPC_ZONE_APPEND:
+        return LCORE_OPC_APPEND;
+    case SPDK_NVME_OPC_ZONE_MGMT_SEND:
+    case SPDK_NVME_OPC_ZONE_MGMT_RECV:
+        return LCORE_OPC_ZONE_MGMT;
+    default:
+        return LCORE_OPC_OTHER;
+    }
+}
+
+static int
+lcore_interval_add(struct lcore_stat *st, uint64_t tsc, uint64_t latency_tsc)
+{
+    uint64_t idx = tsc / g_lcore_interval_tsc;
+
+    if (idx >= st->num_interval) {
+        uint64_t num = spdk_max(idx + 1, st->num_interval * 2);
+        struct lcore_interval *interval = (struct lcore_interval *)realloc(st->interval,
+                                           num * sizeof(struct lcore_interval));
+        if (!interval) {
+            fprintf(stderr, "Fail to allocate memory for lcore interval\n");
+            return 1;
+        }
+        memset(&interval[st->num_interval], 0, (num - st->num_interval) * sizeof(struct lcore_interval));
+        st->interval = interval;
+        st->num_interval = num;
+    }
+    st->interval[idx].num_cpl++;
+    st->interval[idx].latency_tsc += latency_tsc;
+    g_lcore_num_interval = spdk_max(g_lcore_num_interval, idx + 1);
+
+    return 0;
+}
+
+static int
+process_lcore_analysis(struct trace_io_entry *d)
+{
+    if (d->lcore >= SPDK_TRACE_MAX_LCORE) {
+        fprintf(stderr, "Invalid lcore %u\n", d->lcore);
+        return 1;
+    }
+
+    if (!g_lcore_interval_tsc) {
+        g_lcore_interval_tsc = spdk_max(g_lcore_interval_ms * d->tsc_rate / 1000, 1);
+    }
+
+    struct lcore_stat *st = g_lcore_stat[d->lcore];
+    if (!st) {
+        st = (struct lcore_stat *)calloc(1, sizeof(struct lcore_stat));
+        if (!st) {
+            fprintf(stderr, "Fail to allocate memory for lcore stat\n");
+            return 1;
+        }
+        trace_io_hist_init(&st->latency);
+        g_lcore_stat[d->lcore] = st;
+    }
+
+    if (strcmp(d->tpoint_name, "NVME_IO_SUBMIT") == 0) {
+        enum lcore_opc_class opc_class = lcore_opc_class(d->opc);
+        uint32_t nlb = (d->cdw12 & UINT16BIT_MASK) + 1;
+        st->num_submit++;
+        st->opc_cnt[opc_class]++;
+        if (opc_class == LCORE_OPC_READ) {
+            st->read_blk += nlb;
+        } else if (opc_class == LCORE_OPC_WRITE || opc_class == LCORE_OPC_APPEND) {
+            st->write_blk += nlb;
+        }
+    } else if (strcmp(d->tpoint_name, "NVME_IO_COMPLETE") == 0) {
+        st->num_cpl++;
+        trace_io_hist_record(&st->latency, d->tsc_sc_time);
+        return lcore_interval_add(st, d->tsc_timestamp, d->tsc_sc_time);
+    }
+
+    return 0;
+}
+
+/* Gini coefficient of the values, 0 means perfectly balanced */
+static double
+gini(const double *val, int num)
+{
+    double diff = 0, sum = 0;
+
+    for (int i = 0; i < num; i++) {
+        sum += val[i];
+        for (int j = 0; j < num; j++) {
+            diff += fabs(val[i] - val[j]);
+        }
+    }
+    return (num && sum > 0) ? diff / (2.0 * num * sum) : 0;
+}
+
+static void
+print_lcore_analysis(void)
+{
+    double lcore_iops[SPDK_TRACE_MAX_LCORE];
+    int lcore_id[SPDK_TRACE_MAX_LCORE];
+    int num_lcore = 0;
+    float span_sec = get_us_from_tsc(g_end_tsc, g_tsc_rate) / (1000 * 1000);
+
+    print_uline('=', printf("\nLcore Analysis\n"));
+
+    for (int lcore = 0; lcore < SPDK_TRACE_MAX_LCORE; lcore++) {
+        struct lcore_stat *st = g_lcore_stat[lcore];
+        if (!st) {
+            continue;
+        }
+        lcore_id[num_lcore] = lcore;
+        lcore_iops[num_lcore] = span_sec > 0 ? st->num_cpl / span_sec : 0;
+
+        printf("lcore %-3d:  ", lcore);
+        printf("IOPS %-14.3f ", lcore_iops[num_lcore]);
+        printf("READ %-10.3f (MB/s) ", span_sec > 0 ? st->read_blk * g_block_byte / span_sec / 1000000 : 0);
+        printf("WRITE %-10.3f (MB/s)\n", span_sec > 0 ? st->write_blk * g_block_byte / span_sec / 1000000 : 0);
+        printf("%12s", "");
+        printf("Latency (us) AVG %-10.3f P50 %-10.3f P99 %-10.3f P99.9 %-10.3f MAX %-10.3f\n",
+               get_us_from_tsc(trace_io_hist_mean(&st->latency), g_tsc_rate),
+               get_us_from_tsc(trace_io_hist_percentile(&st->latency, 50), g_tsc_rate),
+               get_us_from_tsc(trace_io_hist_percentile(&st->latency, 99), g_tsc_rate),
+               get_us_from_tsc(trace_io_hist_percentile(&st->latency, 99.9), g_tsc_rate),
+               get_us_from_tsc(st->latency.max, g_tsc_rate));
+        printf("%12s", "");
+        for (int i = 0; i < LCORE_OPC_NUM; i++) {
+            printf("%s %-10ju ", g_lcore_opc_name[i], st->opc_cnt[i]);
+        }
+        printf("\n");
+        num_lcore++;
+    }
+
+    if (!num_lcore) {
+        return;
+    }
+
+    double max_iops = 0, sum_iops = 0;
+    for (int i = 0; i < num_lcore; i++) {
+        max_iops = spdk_max(max_iops, lcore_iops[i]);
+        sum_iops += lcore_iops[i];
+    }
+    printf("%-20s:  ", "Lcore skew");
+    printf("MAX/MEAN %-10.3f GINI %-10.3f\n", sum_iops > 0 ? max_iops * num_lcore / sum_iops : 0,
+           gini(lcore_iops, num_lcore));
+
+    /* time-series: IOPS and average latency of each lcore in each interval */
+    printf("\n%-20s:  interval %ju ms, IOPS / avg latency (us)\n", "Lcore time-series", g_lcore_interval_ms);
+    printf("%-12s", "time (ms)");
+    for (int i = 0; i < num_lcore; i++) {
+        printf("lcore %-18d ", lcore_id[i]);
+    }
+    printf("MAX/MEAN\n");
+
+    float interval_sec = (float)g_lcore_interval_ms / 1000;
+    for (uint64_t t = 0; t < g_lcore_num_interval; t++) {
+        double max_cpl = 0, sum_cpl = 0;
+        printf("%-12ju", t * g_lcore_interval_ms);
+        for (int i = 0; i < num_lcore; i++) {
+            struct lcore_stat *st = g_lcore_stat[lcore_id[i]];
+            struct lcore_interval cur = {0};
+            if (t < st->num_interval) {
+                cur = st->interval[t];
+            }
+            max_cpl = spdk_max(max_cpl, (double)cur.num_cpl);
+            sum_cpl += cur.num_cpl;
+            printf("%10.0f / %-10.3f ", cur.num_cpl / interval_sec,
+                   cur.num_cpl ? get_us_from_tsc(cur.latency_tsc / cur.num_cpl, g_tsc_rate) : 0);
+        }
+        printf("%-10.3f\n", sum_cpl > 0 ? max_cpl * num_lcore / sum_cpl : 0);
+    }
+
+    if (export_enabled()) {
+        static const struct export_column lcore_col[] = {
+            {"lcore", EXPORT_TYPE_U64}, {"iops", EXPORT_TYPE_F64}, {"read_mbps", EXPORT_TYPE_F64},
+            {"write_mbps", EXPORT_TYPE_F64}, {"latency_avg_us", EXPORT_TYPE_F64},
+            {"latency_p50_us", EXPORT_TYPE_F64}, {"latency_p99_us", EXPORT_TYPE_F64},
+            {"latency_p999_us", EXPORT_TYPE_F64}, {"latency_max_us", EXPORT_TYPE_F64},
+            {"read", EXPORT_TYPE_U64}, {"write", EXPORT_TYPE_U64}, {"append", EXPORT_TYPE_U64},
+            {"zone_mgmt", EXPORT_TYPE_U64}, {"other", EXPORT_TYPE_U64},
+        };
+        static const struct export_column series_col[] = {
+            {"time_ms", EXPORT_TYPE_U64}, {"lcore", EXPORT_TYPE_U64}, {"iops", EXPORT_TYPE_F64},
+            {"latency_avg_us", EXPORT_TYPE_F64},
+        };
+        union export_value val[SPDK_COUNTOF(lcore_col)];
+
+        if (!export_table_begin("lcore", lcore_col, SPDK_COUNTOF(lcore_col))) {
+            for (int i = 0; i < num_lcore; i++) {
+                struct lcore_stat *st = g_lcore_stat[lcore_id[i]];
+                val[0].u64 = lcore_id[i];
+                val[1].f64 = lcore_iops[i];
+                val[2].f64 = span_sec > 0 ? st->read_blk * g_block_byte / span_sec / 1000000 : 0;
+                val[3].f64 = span_sec > 0 ? st->write_blk * g_block_byte / span_sec / 1000000 : 0;
+                val[4].f64 = get_us_from_tsc(trace_io_hist_mean(&st->latency), g_tsc_rate);
+                val[5].f64 = get_us_from_tsc(trace_io_hist_percentile(&st->latency, 50), g_tsc_rate);
+                val[6].f64 = get_us_from_tsc(trace_io_hist_percentile(&st->latency, 99), g_tsc_rate);
+                val[7].f64 = get_us_from_tsc(trace_io_hist_percentile(&st->latency, 99.9), g_tsc_rate);
+                val[8].f64 = get_us_from_tsc(st->latency.max, g_tsc_rate);
+                for (int j = 0; j < LCORE_OPC_NUM; j++) {
+                    val[9 + j].u64 = st->opc_cnt[j];
+                }
+                export_row(val);
+            }
+            export_table_end();
+        }
+
+        if (!export_table_begin("lcore_series", series_col, SPDK_COUNTOF(series_col))) {
+            for (uint64_t t = 0; t < g_lcore_num_interval; t++) {
+                for (int i = 0; i < num_lcore; i++) {
+                    struct lcore_stat *st = g_lcore_stat[lcore_id[i]];
+                    struct lcore_interval cur = {0};
+                    if (t < st->num_interval) {
+                        cur = st->interval[t];
+                    }
+                    val[0].u64 = t * g_lcore_interval_ms;
+                    val[1].u64 = lcore_id[i];
+                    val[2].f64 = cur.num_cpl / interval_sec;
+                    val[3].f64 = cur.num_cpl ? get_us_from_tsc(cur.latency_tsc / cur.num_cpl, g_tsc_rate) : 0;
+                    export_row(val);
+                }
+            }
+            export_table_end();
+        }
+    }
+
+    for (int lcore = 0; lcore < SPDK_TRACE_MAX_LCORE; lcore++) {
+        if (g_lcore_stat[lcore]) {
+            free(g_lcore_stat[lcore]->interval);
+            free(g_lcore_stat[lcore]);
+            g_lcore_stat[lcore] = NULL;
+        }
+    }
+}
+/* lcore analysis end */
+
+/* device simulation start */
+#define SIM_MODEL_MAX 16    /* number of '-S' device models simulated in one pass */
+
+enum sim_dist_type {
+    SIM_DIST_FIXED = 0,
+    SIM_DIST_UNIFORM,
+    SIM_DIST_EXP,
+};
+
+/* service time distribution, in us until the tsc rate of the trace is known, then in tsc */
+struct sim_dist {
+    enum sim_dist_type type;
+    double a;                   /* fixed value, uniform min or exponential mean */
+    double b;                   /* uniform max */
+};
+
+/*
+ * Queueing model of a device: a request is served by the channel of its LBA (its zone
+ * on zoned models, else a stripe), in arrival order. Writes and zone management to
+ * the same zone are also serialized. Open loop issues requests at their trace time,
+ * closed loop keeps qd requests in flight and ignores the trace time.
+ */
+struct sim_model {
+    const char *spec;
+    uint32_t num_ch;
+    uint64_t zone_blk;          /* 0 means no zones */
+    uint64_t stripe_blk;
+    uint32_t qd;                /* 0 means open loop */
+    double time_scale;          /* open loop inter-arrival time is divided by it */
+    struct sim_dist dist[LCORE_OPC_NUM];
+    bool ready;
+    uint64_t *ch_free_tsc;
+    uint64_t *zone_free_tsc;
+    uint64_t num_zone;
+    uint64_t *inflight;         /* closed loop completion times, a min heap */
+    uint32_t num_inflight;
+    uint64_t clock_tsc;         /* closed loop issue time */
+    uint64_t rand;
+    uint64_t first_tsc;
+    uint64_t last_done_tsc;
+    uint64_t busy_tsc;
+    uint64_t num_io;
+    struct trace_io_hist latency[LCORE_OPC_NUM + 1];    /* last one is all opcodes, merged at the end */
+};
+
+static struct sim_model g_sim_model[SIM_MODEL_MAX];
+static int g_sim_num_model = 0;
+static uint64_t g_sim_wall_tsc = 0;
+
+/* fixed:<us>, uniform:<min us>:<max us> or exp:<mean us> */
+static int
+sim_dist_parse(const char *str, struct sim_dist *dist)
+{
+    char *end = NULL;
+
+    dist->b = 0;
+    if (strncmp(str, "fixed:", 6) == 0) {
+        dist->type = SIM_DIST_FIXED;
+        dist->a = strtod(str + 6, &end);
+    } else if (strncmp(str, "uniform:", 8) == 0) {
+        dist->type = SIM_DIST_UNIFORM;
+        dist->a = strtod(str + 8, &end);
+        if (*end != ':') {
+            return 1;
+        }
+        dist->b = strtod(end + 1, &end);
+        if (dist->b < dist->a) {
+            return 1;
+        }
+    } else if (strncmp(str, "exp:", 4) == 0) {
+        dist->type = SIM_DIST_EXP;
+        dist->a = strtod(str + 4, &end);
+    } else {
+        return 1;
+    }
+    return *end != '\0' || dist->a < 0;
+}
+
+/* <key>=<value>[,<key>=<value>...], see usage of '-S' */
+static int
+sim_model_parse(const char *spec)
+{
+    static const char *lat_key[LCORE_OPC_NUM] = {"rlat", "wlat", "alat", "mlat", "olat"};
+    static const char *default_lat[LCORE_OPC_NUM] = {"fixed:80", "fixed:20", "fixed:20", "fixed:10", "fixed:10"};
+    struct sim_model *m;
+    char *buf, *save = NULL;
+    int rc = 0;
+
+    if (g_sim_num_model == SIM_MODEL_MAX) {
+        fprintf(stderr, "At most %d device models can be simulated\n", SIM_MODEL_MAX);
+        return 1;
+    }
+    m = &g_sim_model[g_sim_num_model];
+    memset(m, 0, sizeof(*m));
+    m->spec = spec;
+    m->num_ch = 8;
+    m->stripe_blk = 64;
+    m->time_scale = 1.0;
+    m->zone_blk = UINT64_MAX;   /* default is the zone size of the namespace */
+    for (int i = 0; i < LCORE_OPC_NUM; i++) {
+        sim_dist_parse(default_lat[i], &m->dist[i]);
+    }
+
+    buf = strdup(spec);
+    if (!buf) {
+        return 1;
+    }
+    for (char *kv = strtok_r(buf, ",", &save); kv && !rc; kv = strtok_r(NULL, ",", &save)) {
+        char *val = strchr(kv, '=');
+        if (!val) {
+            rc = 1;
+            break;
+        }
+        *val++ = '\0';
+        if (strcmp(kv, "ch") == 0) {
+            m->num_ch = (uint32_t)strtoul(val, NULL, 10);
+        } else if (strcmp(kv, "zone") == 0) {
+            m->zone_blk = strtoull(val, NULL, 0);
+        } else if (strcmp(kv, "stripe") == 0) {
+            m->stripe_blk = strtoull(val, NULL, 0);
+        } else if (strcmp(kv, "qd") == 0) {
+            m->qd = (uint32_t)strtoul(val, NULL, 10);
+        } else if (strcmp(kv, "scale") == 0) {
+            m->time_scale = strtod(val, NULL);
+        } else {
+            int i;
+            for (i = 0; i < LCORE_OPC_NUM && strcmp(kv, lat_key[i]) != 0; i++);
+            rc = i == LCORE_OPC_NUM || sim_dist_parse(val, &m->dist[i]);
+        }
+    }
+    free(buf);
+
+    if (rc || !m->num_ch || !m->stripe_blk || m->time_scale <= 0) {
+        fprintf(stderr, "Invalid device model %s\n", spec);
+        return 1;
+    }
+    g_sim_num_model++;
+    return 0;
+}
+
+static int
+sim_model_init(struct sim_model *m, uint64_t tsc_rate, uint64_t seed)
+{
+    double tsc_per_us = (double)tsc_rate / (1000 * 1000);
+
+    for (int i = 0; i < LCORE_OPC_NUM; i++) {
+        m->dist[i].a *= tsc_per_us;
+        m->dist[i].b *= tsc_per_us;
+    }
+    for (int i = 0; i <= LCORE_OPC_NUM; i++) {
+        trace_io_hist_init(&m->latency[i]);
+    }
+    if (m->zone_blk == UINT64_MAX) {
+        m->zone_blk = g_zone ? g_zone_size_lba : 0;
+    }
+    if (m->zone_blk) {
+        m->num_zone = spdk_max(g_ns_block / m->zone_blk, 1);
+        m->zone_free_tsc = (uint64_t *)calloc(m->num_zone, sizeof(uint64_t));
+    }
+    m->ch_free_tsc = (uint64_t *)calloc(m->num_ch, sizeof(uint64_t));
+    m->inflight = (uint64_t *)calloc(spdk_max(m->qd, 1), sizeof(uint64_t));
+    if (!m->ch_free_tsc || !m->inflight || (m->zone_blk && !m->zone_free_tsc)) {
+        fprintf(stderr, "Fail to allocate memory for device model %s\n", m->spec);
+        return 1;
+    }
+    m->rand = 0x9E3779B97F4A7C15ULL * (seed + 1);
+    m->first_tsc = UINT64_MAX;
+    m->ready = true;
+    return 0;
+}
+
+static uint64_t
+sim_dist_sample(const struct sim_dist *dist, uint64_t *rand)
+{
+    double u;
+
+    if (dist->type == SIM_DIST_FIXED) {
+        return (uint64_t)dist->a;
+    }
+    /* xorshift64*, uniform in [0, 1) */
+    *rand ^= *rand >> 12;
+    *rand ^= *rand << 25;
+    *rand ^= *rand >> 27;
+    u = (double)((*rand * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+    if (dist->type == SIM_DIST_UNIFORM) {
+        return (uint64_t)(dist->a + (dist->b - dist->a) * u);
+    }
+    return (uint64_t)(-dist->a * log(1 - u));
+}
+
+/* pop the earliest completion of the closed loop heap and push a new one in its place */
+static uint64_t
+sim_inflight_replace(struct sim_model *m, uint64_t done_tsc)
+{
+    uint64_t *heap = m->inflight;
+    uint64_t earliest = heap[0];
+    uint32_t i = 0;
+
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= m->num_inflight) {
+            break;
+        }
+        if (child + 1 < m->num_inflight && heap[child + 1] < heap[child]) {
+            child++;
+        }
+        if (heap[child] >= done_tsc) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = done_tsc;
+    return earliest;
+}
+
+static void
+sim_inflight_push(struct sim_model *m, uint64_t done_tsc)
+{
+    uint32_t i = m->num_inflight++;
+
+    while (i && m->inflight[(i - 1) / 2] > done_tsc) {
+        m->inflight[i] = m->inflight[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    m->inflight[i] = done_tsc;
+}
+
+static void
+sim_model_submit(struct sim_model *m, const struct trace_io_entry *d)
+{
+    enum lcore_opc_class opc_class = lcore_opc_class(d->opc);
+    uint64_t slba = (uint64_t)d->cdw10 | ((uint64_t)d->cdw11 << 32);
+    uint64_t issue_tsc, start_tsc, service_tsc, done_tsc;
+    uint64_t zone = 0, *zone_free = NULL;
+    uint32_t ch;
+
+    if (m->qd) {
+        /* the next request is issued when the earliest one in flight completes */
+        issue_tsc = m->num_inflight < m->qd ? m->clock_tsc : m->inflight[0];
+        m->clock_tsc = issue_tsc;
+    } else {
+        issue_tsc = m->time_scale == 1.0 ? d->tsc_timestamp : (uint64_t)(d->tsc_timestamp / m->time_scale);
+    }
+
+    if (m->zone_blk) {
+        zone = (slba / m->zone_blk) % m->num_zone;
+        ch = (uint32_t)(zone % m->num_ch);
+        if (opc_class == LCORE_OPC_WRITE || opc_class == LCORE_OPC_ZONE_MGMT) {
+            zone_free = &m->zone_free_tsc[zone];
+        }
+    } else {
+        ch = (uint32_t)((slba / m->stripe_blk) % m->num_ch);
+    }
+
+    service_tsc = sim_dist_sample(&m->dist[opc_class], &m->rand);
+    start_tsc = spdk_max(issue_tsc, m->ch_free_tsc[ch]);
+    if (zone_free) {
+        start_tsc = spdk_max(start_tsc, *zone_free);
+        *zone_free = start_tsc + service_tsc;
+    }
+    done_tsc = start_tsc + service_tsc;
+    m->ch_free_tsc[ch] = done_tsc;
+
+    if (m->qd) {
+        if (m->num_inflight < m->qd) {
+            sim_inflight_push(m, done_tsc);
+        } else {
+            sim_inflight_replace(m, done_tsc);
+        }
+    }
+
+    m->first_tsc = spdk_min(m->first_tsc, issue_tsc);
+    m->last_done_tsc = spdk_max(m->last_done_tsc, done_tsc);
+    m->busy_tsc += service_tsc;
+    m->num_io++;
+    trace_io_hist_record(&m->latency[opc_class], done_tsc - issue_tsc);
+}
+
+/* feed a batch of trace entries to every device model */
+static int
+process_sim_analysis(struct trace_io_entry *d, size_t num)
+{
+    static const struct trace_io_entry *submit[ENTRY_MAX];
+    uint64_t start_tsc = spdk_get_ticks();
+    size_t num_submit = 0;
+
+    /* the submits of a batch are picked once and shared by the models */
+    for (size_t j = 0; j < num && num_submit < ENTRY_MAX; j++) {
+        if (strcmp(d[j].tpoint_name, "NVME_IO_SUBMIT") == 0) {
+            submit[num_submit++] = &d[j];
+        }
+    }
+    for (int i = 0; i < g_sim_num_model; i++) {
+        struct sim_model *m = &g_sim_model[i];
+        if (!m->ready && num && sim_model_init(m, d[0].tsc_rate, i) != 0) {
+            return 1;
+        }
+        for (size_t j = 0; j < num_submit; j++) {
+            sim_model_submit(m, submit[j]);
+        }
+    }
+    g_sim_wall_tsc += spdk_get_ticks() - start_tsc;
+    return 0;
+}
+
+static void
+print_sim_analysis(void)
+{
+    uint64_t total_io = 0;
+
+    print_uline('=', printf("\nDevice Simulation\n"));
+
+    for (int i = 0; i < g_sim_num_model; i++) {
+        struct sim_model *m = &g_sim_model[i];
+        if (!m->num_io) {
+            continue;
+        }
+        float span_sec = get_us_from_tsc(m->last_done_tsc - m->first_tsc, g_tsc_rate) / (1000 * 1000);
+        total_io += m->num_io;
+        for (int j = 0; j < LCORE_OPC_NUM; j++) {
+            trace_io_hist_merge(&m->latency[LCORE_OPC_NUM], &m->latency[j]);
+        }
+
+        printf("%-20s:  %s\n", "Model", m->spec);
+        printf("%-20s:  ", "Mode");
+        if (m->qd) {
+            printf("closed loop, QD %u\n", m->qd);
+        } else {
+            printf("open loop, time scale %.3f\n", m->time_scale);
+        }
+        printf("%-20s:  %u channels, ", "Device", m->num_ch);
+        if (m->zone_blk) {
+            printf("zone %ju blocks\n", m->zone_blk);
+        } else {
+            printf("stripe %ju blocks\n", m->stripe_blk);
+        }
+        printf("%-20s:  %-20.3f\n", "Predicted IOPS", span_sec > 0 ? m->num_io / span_sec : 0);
+        printf("%-20s:  %-20.3f\n", "Channel busy (%)", m->last_done_tsc > m->first_tsc ?
+               100.0 * m->busy_tsc / m->num_ch / (m->last_done_tsc - m->first_tsc) : 0);
+        for (int j = 0; j <= LCORE_OPC_NUM; j++) {
+            const struct trace_io_hist *h = &m->latency[j];
+            if (!h->count) {
+                continue;
+            }
+            printf("%-20s:  %-10ju AVG %-10.3f P50 %-10.3f P99 %-10.3f P99.9 %-10.3f MAX %-10.3f\n",
+                   j < LCORE_OPC_NUM ? g_lcore_opc_name[j] : "ALL", h->count,
+                   get_us_from_tsc(trace_io_hist_mean(h), g_tsc_rate),
+                   get_us_from_tsc(trace_io_hist_percentile(h, 50), g_tsc_rate),
+                   get_us_from_tsc(trace_io_hist_percentile(h, 99), g_tsc_rate),
+                   get_us_from_tsc(trace_io_hist_percentile(h, 99.9), g_tsc_rate),
+                   get_us_from_tsc(h->max, g_tsc_rate));
+        }
+        printf("\n");
+    }
+    if (g_sim_wall_tsc) {
+        printf("%-20s:  %-20.3f (M I/O per second of wall time)\n", "Simulation rate",
+               total_io / get_us_from_tsc(g_sim_wall_tsc, spdk_get_ticks_hz()));
+    }
+
+    if (export_enabled()) {
+        static const struct export_column sim_col[] = {
+            {"model", EXPORT_TYPE_U64}, {"opc_class", EXPORT_TYPE_U64}, {"count", EXPORT_TYPE_U64},
+            {"iops", EXPORT_TYPE_F64}, {"latency_avg_us", EXPORT_TYPE_F64},
+            {"latency_p50_us", EXPORT_TYPE_F64}, {"latency_p99_us", EXPORT_TYPE_F64},
+            {"latency_p999_us", EXPORT_TYPE_F64}, {"latency_max_us", EXPORT_TYPE_F64},
+        };
+        union export_value val[SPDK_COUNTOF(sim_col)];
+
+        /* opc_class is read, write, append, zone mgmt, other and all */
+        if (!export_table_begin("sim", sim_col, SPDK_COUNTOF(sim_col))) {
+            for (int i = 0; i < g_sim_num_model; i++) {
+                struct sim_model *m = &g_sim_model[i];
+                float span_sec = get_us_from_tsc(m->last_done_tsc - m->first_tsc, g_tsc_rate) / (1000 * 1000);
+                for (int j = 0; j <= LCORE_OPC_NUM; j++) {
+                    const struct trace_io_hist *h = &m->latency[j];
+                    if (!h->count) {
+                        continue;
+                    }
+                    val[0].u64 = i;
+                    val[1].u64 = j;
+                    val[2].u64 = h->count;
+                    val[3].f64 = span_sec > 0 ? h->count / span_sec : 0;
+                    val[4].f64 = get_us_from_tsc(trace_io_hist_mean(h), g_tsc_rate);
+                    val[5].f64 = get_us_from_tsc(trace_io_hist_percentile(h, 50), g_tsc_rate);
+                    val[6].f64 = get_us_from_tsc(trace_io_hist_percentile(h, 99), g_tsc_rate);
+                    val[7].f64 = get_us_from_tsc(trace_io_hist_percentile(h, 99.9), g_tsc_rate);
+                    val[8].f64 = get_us_from_tsc(h->max, g_tsc_rate);
+                    export_row(val);
+                }
+            }
+            export_table_end();
+        }
+    }
+
+    for (int i = 0; i < g_sim_num_model; i++) {
+        free(g_sim_model[i].ch_free_tsc);
+        free(g_sim_model[i].zone_free_tsc);
+        free(g_sim_model[i].inflight);
+    }
+}
+/* device simulation end */
+
+/* trace compare start */
+#define KS_COEF_ALPHA_001 1.628 /* Kolmogorov-Smirnov coefficient for 99% confidence */
+
+/* submit info of in-flight requests, keyed by object id */
+struct inflight_table {
+    uint64_t *obj_id;
+    uint8_t  *opc_class;
+    bool     *used;
+    uint64_t *submit_tsc;
+    uint64_t mask;
+    uint64_t count;
+};
+
+struct trace_summary {
+    const char *file_name;
+    int rc;
+    uint64_t tsc_rate;
+    uint64_t num_submit;
+    uint64_t num_cpl;
+    uint64_t num_unmatched;     /* completions without submit in the trace */
+    uint64_t end_tsc;
+    uint64_t read_blk;
+    uint64_t write_blk;
+    uint64_t opc_cnt[LCORE_OPC_NUM];
+    struct trace_io_hist latency[LCORE_OPC_NUM + 1];    /* last one is all opcodes */
+    /* queue depth */
+    uint64_t outstanding;
+    uint64_t qd_max;
+    uint64_t last_event_tsc;
+    double   qd_area;       /* integral of outstanding over time in tsc */
+    /* zone */
+    uint8_t  *zone_flag;    /* ZONE_FLAG_* of each zone */
+    uint64_t zone_action[SPDK_NVME_ZONE_OFFLINE + 1];
+    struct inflight_table inflight;
+};
+
+#define ZONE_FLAG_READ  0x1
+#define ZONE_FLAG_WRITE 0x2
+
+static int
+inflight_init(struct inflight_table *t, uint64_t size)
+{
+    t->mask = size - 1;
+    t->count = 0;
+    t->obj_id = (uint64_t *)calloc(size, sizeof(uint64_t));
+    t->submit_tsc = (uint64_t *)calloc(size, sizeof(uint64_t));
+    t->opc_class = (uint8_t *)calloc(size, sizeof(uint8_t));
+    t->used = (bool *)calloc(size, sizeof(bool));
+    if (!t->obj_id || !t->submit_tsc || !t->opc_class || !t->used) {
+        return 1;
+    }
+    return 0;
+}
+
+static void
+inflight_fini(struct inflight_table *t)
+{
+    free(t->obj_id);
+    free(t->submit_tsc);
+    free(t->opc_class);
+    free(t->used);
+}
+
+static uint64_t
+inflight_hash(uint64_t obj_id)
+{
+    return (obj_id * 0x9E3779B97F4A7C15ULL) >> 17;
+}
+
+static int
+inflight_insert(struct inflight_table *t, uint64_t obj_id, uint8_t opc_class, uint64_t tsc);
+
+static int
+inflight_grow(struct inflight_table *t)
+{
+    struct inflight_table old = *t;
+
+    if (inflight_init(t, (old.mask + 1) * 2)) {
+        inflight_fini(t);
+        *t = old;
+        return 1;
+    }
+    for (uint64_t i = 0; i <= old.mask; i++) {
+        if (old.used[i]) {
+            inflight_insert(t, old.obj_id[i], old.opc_class[i], old.submit_tsc[i]);
+        }
+    }
+    inflight_fini(&old);
+    return 0;
+}
+
+static int
+inflight_insert(struct inflight_table *t, uint64_t obj_id, uint8_t opc_class, uint64_t tsc)
+{
+    if ((t->count + 1) * 2 > t->mask + 1 && inflight_grow(t)) {
+        return 1;
+    }
+
+    uint64_t i = inflight_hash(obj_id) & t->mask;
+    while (t->used[i] && t->obj_id[i] != obj_id) {
+        i = (i + 1) & t->mask;
+    }
+    if (!t->used[i]) {
+        t->count++;
+    }
+    t->used[i] = true;
+    t->obj_id[i] = obj_id;
+    t->opc_class[i] = opc_class;
+    t->submit_tsc[i] = tsc;
+    return 0;
+}
+
+/* remove obj_id from the table, return false if not found */
+static bool
+inflight_remove(struct inflight_table *t, uint64_t obj_id, uint8_t *opc_class)
+{
+    uint64_t i = inflight_hash(obj_id) & t->mask;
+
+    while (t->used[i] && t->obj_id[i] != obj_id) {
+        i = (i + 1) & t->mask;
+    }
+    if (!t->used[i]) {
+        return false;
+    }
+    *opc_class = t->opc_class[i];
+    t->used[i] = false;
+    t->count--;
+
+    /* backward shift the following entries of the probe sequence */
+    uint64_t hole = i;
+    for (uint64_t j = (i + 1) & t->mask; t->used[j]; j = (j + 1) & t->mask) {
+        uint64_t home = inflight_hash(t->obj_id[j]) & t->mask;
+        if (((j - home) & t->mask) >= ((j - hole) & t->mask)) {
+            t->used[hole] = true;
+            t->obj_id[hole] = t->obj_id[j];
+            t->opc_class[hole] = t->opc_class[j];
+            t->submit_tsc[hole] = t->submit_tsc[j];
+            t->used[j] = false;
+            hole = j;
+        }
+    }
+    return true;
+}
+
+static void
+summary_qd_update(struct trace_summary *sum, uint64_t tsc)
+{
+    if (tsc > sum->last_event_tsc) {
+        sum->qd_area += (double)sum->outstanding * (tsc - sum->last_event_tsc);
+        sum->last_event_tsc = tsc;
+    }
+}
+
+static int
+summary_process_entry(struct trace_summary *sum, struct trace_io_entry *d)
+{
+    sum->tsc_rate = d->tsc_rate;
+
+    if (strcmp(d->tpoint_name, "NVME_IO_SUBMIT") == 0) {
+        enum lcore_opc_class opc_class = lcore_opc_class(d->opc);
+        uint64_t slba = (uint64_t)d->cdw10 | ((uint64_t)d->cdw11 & UINT32BIT_MASK) << 32;
+        uint32_t nlb = (d->cdw12 & UINT16BIT_MASK) + 1;
+
+        sum->num_submit++;
+        sum->opc_cnt[opc_class]++;
+        if (opc_class == LCORE_OPC_READ) {
+            sum->read_blk += nlb;
+        } else if (opc_class == LCORE_OPC_WRITE || opc_class == LCORE_OPC_APPEND) {
+            sum->write_blk += nlb;
+        }
+
+        if (g_zone && sum->zone_flag && d->opc != SPDK_NVME_OPC_DATASET_MANAGEMENT) {
+            uint64_t zidx = slba / g_zone_size_lba;
+            if (zidx < g_ns_zone) {
+                if (opc_class == LCORE_OPC_READ) {
+                    sum->zone_flag[zidx] |= ZONE_FLAG_READ;
+                } else if (opc_class == LCORE_OPC_WRITE || opc_class == LCORE_OPC_APPEND) {
+                    sum->zone_flag[zidx] |= ZONE_FLAG_WRITE;
+                }
+            }
+            if (d->opc == SPDK_NVME_OPC_ZONE_MGMT_SEND && (d->cdw13 & UINT8BIT_MASK) <= SPDK_NVME_ZONE_OFFLINE) {
+                sum->zone_action[d->cdw13 & UINT8BIT_MASK]++;
+            }
+        }
+
+        summary_qd_update(sum, d->tsc_timestamp);
+        sum->outstanding++;
+        sum->qd_max = spdk_max(sum->qd_max, sum->outstanding);
+        if (inflight_insert(&sum->inflight, d->obj_id, opc_class, d->tsc_timestamp)) {
+            fprintf(stderr, "Fail to allocate memory for in-flight table\n");
+            return 1;
+        }
+    } else if (strcmp(d->tpoint_name, "NVME_IO_COMPLETE") == 0) {
+        uint8_t opc_class;
+
+        sum->num_cpl++;
+        sum->end_tsc = spdk_max(sum->end_tsc, d->tsc_timestamp);
+        trace_io_hist_record(&sum->latency[LCORE_OPC_NUM], d->tsc_sc_time);
+        if (inflight_remove(&sum->inflight, d->obj_id, &opc_class)) {
+            trace_io_hist_record(&sum->latency[opc_class], d->tsc_sc_time);
+            summary_qd_update(sum, d->tsc_timestamp);
+            sum->outstanding--;
+        } else {
+            sum->num_unmatched++;
+        }
+    }
+    return 0;
+}
+
+static void *
+summary_thread(void *arg)
 {
-    int rc = 0;
-    uint64_t idx = slba;
+    struct trace_summary *sum = (struct trace_summary *)arg;
+    struct trace_io_entry *buffer = NULL;
+    FILE *fptr = NULL;
 
-    switch (opc) {
-    case SPDK_NVME_OPC_READ:
-    case SPDK_NVME_OPC_COMPARE: 
-        for (int i = 0; i < nlb; i++) {
-            r_block[idx + i]++;
+    sum->rc = 1;
+    for (int i = 0; i <= LCORE_OPC_NUM; i++) {
+        trace_io_hist_init(&sum->latency[i]);
+    }
+    if (inflight_init(&sum->inflight, 1024)) {
+        fprintf(stderr, "Fail to allocate memory for in-flight table\n");
+        goto exit;
+    }
+    if (g_zone) {
+        sum->zone_flag = (uint8_t *)calloc(g_ns_zone, sizeof(uint8_t));
+        if (!sum->zone_flag) {
+            fprintf(stderr, "Fail to allocate memory for zone flag\n");
+            goto exit;
         }
-        break;        
-    case SPDK_NVME_OPC_WRITE:
-    case SPDK_NVME_OPC_ZONE_APPEND:
-    case SPDK_NVME_OPC_WRITE_ZEROES:
-        for (int i = 0; i < nlb; i++) {
-            w_block[idx + i]++;
+    }
+
+    buffer = (struct trace_io_entry *)malloc(ENTRY_MAX * sizeof(struct trace_io_entry));
+    if (!buffer) {
+        fprintf(stderr, "Fail to allocate memory for read buffer\n");
+        goto exit;
+    }
+
+    fptr = fopen(sum->file_name, "rb");
+    if (fptr == NULL) {
+        fprintf(stderr, "Failed to open input file %s\n", sum->file_name);
+        goto exit;
+    }
+
+    size_t read_entry;
+    while ((read_entry = fread(buffer, sizeof(struct trace_io_entry), ENTRY_MAX, fptr)) > 0) {
+        for (size_t i = 0; i < read_entry; i++) {
+            if (summary_process_entry(sum, &buffer[i])) {
+                goto exit;
+            }
         }
-        break;
-    case SPDK_NVME_OPC_WRITE_UNCORRECTABLE:
-    case SPDK_NVME_OPC_COPY:
-    case SPDK_NVME_OPC_VERIFY:
-    case SPDK_NVME_OPC_DATASET_MANAGEMENT:
-    case SPDK_NVME_OPC_FLUSH:
-    case SPDK_NVME_OPC_ZONE_MGMT_RECV:
-    case SPDK_NVME_OPC_ZONE_MGMT_SEND:
-    case SPDK_NVME_OPC_RESERVATION_REGISTER: 
-    case SPDK_NVME_OPC_RESERVATION_REPORT:
-    case SPDK_NVME_OPC_RESERVATION_ACQUIRE:
-    case SPDK_NVME_OPC_RESERVATION_RELEASE:
-        break;
-    default:
-        rc = 1;
-        break; 
-    }   
-    return rc;    
+    }
+    sum->rc = 0;
+
+exit:
+    if (fptr) {
+        fclose(fptr);
+    }
+    free(buffer);
+    inflight_fini(&sum->inflight);
+    return NULL;
 }
 
-static int
-zone_counter(uint8_t opc, uint64_t slba, uint16_t *r_zone, uint16_t *w_zone)
+/* Kolmogorov-Smirnov distance between two histograms */
+static double
+hist_ks_distance(const struct trace_io_hist *a, const struct trace_io_hist *b)
 {
-    int rc = 0;
-    uint64_t zidx = slba / g_zone_size_lba;
+    double dist = 0;
+    uint64_t cnt_a = 0, cnt_b = 0;
 
-    switch (opc) {
-    case SPDK_NVME_OPC_READ:
-    case SPDK_NVME_OPC_COMPARE:
-        r_zone[zidx]++;
-        break;
-    case SPDK_NVME_OPC_WRITE:
-    case SPDK_NVME_OPC_ZONE_APPEND:
-    case SPDK_NVME_OPC_WRITE_ZEROES:
-        w_zone[zidx]++;
-        break;
-    case SPDK_NVME_OPC_WRITE_UNCORRECTABLE:
-    case SPDK_NVME_OPC_COPY:
-    case SPDK_NVME_OPC_VERIFY:
-    case SPDK_NVME_OPC_DATASET_MANAGEMENT:
-    case SPDK_NVME_OPC_FLUSH:
-    case SPDK_NVME_OPC_ZONE_MGMT_RECV:
-    case SPDK_NVME_OPC_ZONE_MGMT_SEND:
-    case SPDK_NVME_OPC_RESERVATION_REGISTER:
-    case SPDK_NVME_OPC_RESERVATION_REPORT:
-    case SPDK_NVME_OPC_RESERVATION_ACQUIRE:
-    case SPDK_NVME_OPC_RESERVATION_RELEASE:
-        break;
-    default:
-        rc = 1;
-        break;
+    if (!a->count || !b->count) {
+        return 0;
     }
-    return rc;
+    for (uint32_t i = 0; i < TRACE_IO_HIST_BUCKET; i++) {
+        cnt_a += a->bucket[i];
+        cnt_b += b->bucket[i];
+        double diff = fabs((double)cnt_a / a->count - (double)cnt_b / b->count);
+        dist = spdk_max(dist, diff);
+    }
+    return dist;
 }
 
-static uint64_t g_end_tsc = 0;
-static uint64_t g_req_num = 0;
-static float
-iops(uint64_t end_tsc, uint64_t req_num)
+static void
+print_compare_row(const char *name, double a, double b)
 {
-    float IOPS = 0.0;
-    if (req_num ==0 || end_tsc == 0) {
-        return IOPS;
+    printf("%-24s %-16.3f %-16.3f %-16.3f ", name, a, b, b - a);
+    if (a != 0) {
+        printf("%+10.3f %%\n", (b - a) * 100 / a);
+    } else {
+        printf("%10s\n", "-");
     }
-    float end_sec = get_us_from_tsc(end_tsc, g_tsc_rate) / (1000 * 1000);
-    return IOPS = (float)req_num / end_sec;
 }
 
-static int
-process_analysis_round1(struct trace_io_entry *d, uint32_t *r_iosize, uint32_t *w_iosize)
+static float
+summary_sec(struct trace_summary *sum)
 {
-    if (!g_tsc_rate) { /* for calculate g_latency_us_avg */
-        g_tsc_rate = d->tsc_rate;
-    }
+    return sum->tsc_rate ? get_us_from_tsc(sum->end_tsc, sum->tsc_rate) / (1000 * 1000) : 0;
+}
 
-    int rc;
-    uint32_t nlb = d->cdw12 & UINT16BIT_MASK;
-    if (strcmp(d->tpoint_name, "NVME_IO_SUBMIT") == 0) {
-        rc = iosize_rw_counter(d->opc, nlb, r_iosize, w_iosize);    /* for calculate request size */
-        if (rc) {
-            printf("Unknown Opcode\n");
-            return rc;
-        }
+static void
+print_compare_latency(const char *name, struct trace_summary *a, struct trace_summary *b, int opc_class)
+{
+    const struct trace_io_hist *ha = &a->latency[opc_class], *hb = &b->latency[opc_class];
+    static const double pct[] = {50, 90, 99, 99.9};
+    char row[64];
+
+    if (!ha->count && !hb->count) {
+        return;
     }
 
-    if (strcmp(d->tpoint_name, "NVME_IO_COMPLETE") == 0) {
-        g_end_tsc = d->tsc_timestamp;                               /* for calculate IOPS */
-        latency_min_max(d->tsc_sc_time, d->tsc_rate);               /* for calculate latency (min & max) */
-        latency_total(d->tsc_sc_time);                              /* for calculate latency (avg) */
+    snprintf(row, sizeof(row), "%s AVG (us)", name);
+    print_compare_row(row, get_us_from_tsc(trace_io_hist_mean(ha), a->tsc_rate),
+                      get_us_from_tsc(trace_io_hist_mean(hb), b->tsc_rate));
+    for (size_t i = 0; i < SPDK_COUNTOF(pct); i++) {
+        snprintf(row, sizeof(row), "%s P%g (us)", name, pct[i]);
+        print_compare_row(row, get_us_from_tsc(trace_io_hist_percentile(ha, pct[i]), a->tsc_rate),
+                          get_us_from_tsc(trace_io_hist_percentile(hb, pct[i]), b->tsc_rate));
     }
 
-    return rc;
+    /* two-sample KS test on the latency distributions, both traces must use the same tsc rate */
+    double dist = hist_ks_distance(ha, hb);
+    double crit = (ha->count && hb->count) ?
+                  KS_COEF_ALPHA_001 * sqrt((double)(ha->count + hb->count) / ((double)ha->count * hb->count)) : 0;
+    const char *verdict = "no significant change";
+    if (a->tsc_rate != b->tsc_rate) {
+        verdict = "tsc rate differs, not tested";
+    } else if (ha->count && hb->count && dist > crit) {
+        verdict = trace_io_hist_percentile(hb, 50) > trace_io_hist_percentile(ha, 50) ?
+                  "REGRESSION" : "IMPROVEMENT";
+    }
+    snprintf(row, sizeof(row), "%s KS distance", name);
+    printf("%-24s %-16.4f (critical %.4f, 99%%)  %s\n", row, dist, crit, verdict);
 }
 
 static int
-process_analysis_round2(struct trace_io_entry *d, uint16_t *r_blk, uint16_t *w_blk,  uint16_t *r_zone, uint16_t *w_zone)
+compare_trace(const char *file_a, const char *file_b)
 {
-    int rc;
-    uint64_t slba = 0;    
-    if (strcmp(d->tpoint_name, "NVME_IO_SUBMIT") == 0 && d->opc != SPDK_NVME_OPC_DATASET_MANAGEMENT) {
-        slba = (uint64_t)d->cdw10 | ((uint64_t)d->cdw11 & UINT32BIT_MASK) << 32;
+    struct trace_summary *sum = (struct trace_summary *)calloc(2, sizeof(struct trace_summary));
+    pthread_t tid[2];
 
-        if (d->opc != SPDK_NVME_OPC_ZONE_MGMT_RECV && 
-            d->opc != SPDK_NVME_OPC_ZONE_MGMT_SEND &&
-            d->opc != SPDK_NVME_OPC_COPY) {
-            uint32_t nlb = (d->cdw12 & UINT16BIT_MASK) + 1;
-            rc = block_counter(d->opc, slba, nlb, r_blk, w_blk);      /* for calculate r/w # in a block */
-            if (rc) {
-                printf("Count block read / write fail\n");
-                return rc;
-            }  
-            
+    if (!sum) {
+        fprintf(stderr, "Fail to allocate memory for trace summary\n");
+        return 1;
+    }
+    sum[0].file_name = file_a;
+    sum[1].file_name = file_b;
+
+    /* summarize both traces in parallel */
+    for (int i = 0; i < 2; i++) {
+        if (pthread_create(&tid[i], NULL, summary_thread, &sum[i]) != 0) {
+            fprintf(stderr, "Fail to create summary thread\n");
+            sum[i].rc = 1;
+            summary_thread(&sum[i]);
+            tid[i] = 0;
         }
+    }
+    for (int i = 0; i < 2; i++) {
+        if (tid[i]) {
+            pthread_join(tid[i], NULL);
+        }
+    }
 
-        if (g_zone) {
-            rc = zone_counter(d->opc, slba, r_zone, w_zone);          /* for calculate r/w # in a zone */
-            if (rc) {
-                printf("Count block read / write fail\n");
-                return rc;
+    int rc = sum[0].rc || sum[1].rc;
+    if (rc) {
+        fprintf(stderr, "Trace summary error\n");
+        goto exit;
+    }
+
+    struct trace_summary *a = &sum[0], *b = &sum[1];
+    float sec_a = summary_sec(a), sec_b = summary_sec(b);
+
+    print_uline('=', printf("\nTrace Compare\n"));
+    printf("%-24s %s\n", "A", file_a);
+    printf("%-24s %s\n", "B", file_b);
+    printf("%-24s %-16s %-16s %-16s %10s\n", "", "A", "B", "B-A", "B/A-1");
+    print_compare_row("Requests", a->num_submit, b->num_submit);
+    print_compare_row("Duration (s)", sec_a, sec_b);
+    print_compare_row("IOPS", sec_a > 0 ? a->num_cpl / sec_a : 0, sec_b > 0 ? b->num_cpl / sec_b : 0);
+    print_compare_row("Read (MB/s)", sec_a > 0 ? a->read_blk * g_block_byte / sec_a / 1000000 : 0,
+                      sec_b > 0 ? b->read_blk * g_block_byte / sec_b / 1000000 : 0);
+    print_compare_row("Write (MB/s)", sec_a > 0 ? a->write_blk * g_block_byte / sec_a / 1000000 : 0,
+                      sec_b > 0 ? b->write_blk * g_block_byte / sec_b / 1000000 : 0);
+    for (int i = 0; i < LCORE_OPC_NUM; i++) {
+        char row[64];
+        snprintf(row, sizeof(row), "%s requests", g_lcore_opc_name[i]);
+        print_compare_row(row, a->opc_cnt[i], b->opc_cnt[i]);
+    }
+    print_compare_row("QD AVG", a->last_event_tsc ? a->qd_area / a->last_event_tsc : 0,
+                      b->last_event_tsc ? b->qd_area / b->last_event_tsc : 0);
+    print_compare_row("QD MAX", a->qd_max, b->qd_max);
+
+    print_compare_latency("ALL", a, b, LCORE_OPC_NUM);
+    for (int i = 0; i < LCORE_OPC_NUM; i++) {
+        print_compare_latency(g_lcore_opc_name[i], a, b, i);
+    }
+
+    if (g_zone) {
+        uint64_t zone_cnt[2][2] = {{0}};
+        for (int t = 0; t < 2; t++) {
+            for (uint64_t z = 0; z < g_ns_zone; z++) {
+                zone_cnt[t][0] += (sum[t].zone_flag[z] & ZONE_FLAG_READ) ? 1 : 0;
+                zone_cnt[t][1] += (sum[t].zone_flag[z] & ZONE_FLAG_WRITE) ? 1 : 0;
             }
         }
+        print_compare_row("Zones read", zone_cnt[0][0], zone_cnt[1][0]);
+        print_compare_row("Zones written", zone_cnt[0][1], zone_cnt[1][1]);
+        print_compare_row("Zone open", a->zone_action[SPDK_NVME_ZONE_OPEN], b->zone_action[SPDK_NVME_ZONE_OPEN]);
+        print_compare_row("Zone close", a->zone_action[SPDK_NVME_ZONE_CLOSE], b->zone_action[SPDK_NVME_ZONE_CLOSE]);
+        print_compare_row("Zone finish", a->zone_action[SPDK_NVME_ZONE_FINISH], b->zone_action[SPDK_NVME_ZONE_FINISH]);
+        print_compare_row("Zone reset", a->zone_action[SPDK_NVME_ZONE_RESET], b->zone_action[SPDK_NVME_ZONE_RESET]);
+    }
+
+    if (a->num_unmatched || b->num_unmatched) {
+        printf("%-24s %-16ju %-16ju\n", "Unmatched completions", a->num_unmatched, b->num_unmatched);
     }
+
+exit:
+    free(sum[0].zone_flag);
+    free(sum[1].zone_flag);
+    free(sum);
     return rc;
 }
-/* trace analysis end */
+/* trace compare end */
 
 /* print trace start */
 static const char *
@@ -672,14 +2396,11 @@ static void
 get_ns_info(void)
 {
     struct ns_entry *ns_entry = TAILQ_FIRST(&g_namespaces);
-    
-    if (spdk_nvme_ns_get_csi(ns_entry->ns) != SPDK_NVME_CSI_ZNS) {
-        return;
-    }
 
     const struct spdk_nvme_ns_data *ndata = spdk_nvme_ns_get_data(ns_entry->ns);
     g_ns_block = ndata->ncap;
-    g_max_transfer_block = spdk_nvme_ns_get_max_io_xfer_size(ns_entry->ns);
+    g_block_byte = spdk_nvme_ns_get_sector_size(ns_entry->ns);
+    g_mdts_block = spdk_nvme_ns_get_max_io_xfer_size(ns_entry->ns) / g_block_byte;
 
     if (spdk_nvme_ns_get_csi(ns_entry->ns) == SPDK_NVME_CSI_ZNS) {
         g_zone = true;
@@ -688,6 +2409,36 @@ get_ns_info(void)
     }
 
 }
+
+static int
+probe_ns_info(void)
+{
+    /* Get trid */
+    spdk_nvme_trid_populate_transport(&g_trid, SPDK_NVME_TRANSPORT_PCIE);
+    snprintf(g_trid.subnqn, sizeof(g_trid.subnqn), "%s", SPDK_NVMF_DISCOVERY_NQN);
+
+    /* Register ctrlr & register ns */
+    printf("Initializing NVMe Controllers\n");
+
+    int rc = spdk_nvme_probe(&g_trid, NULL, probe_cb, attach_cb, NULL);
+    if (rc != 0) {
+        fprintf(stderr, "spdk_nvme_probe() failed\n");
+        cleanup();
+        return rc;
+    }
+
+    if (TAILQ_EMPTY(&g_namespaces)) {
+        fprintf(stderr, "no NVMe namespaces found\n");
+        cleanup();
+        return 1;
+    }
+    printf("Initialization complete.\n");
+
+    /* Get namespace data */
+    get_ns_info();
+    cleanup();
+    return 0;
+}
 /* Get namespace data end */
 
 static void
@@ -695,21 +2446,53 @@ usage(const char *program_name)
 {
     printf("usage:\n");
     printf("   %s <options>\n", program_name);
+    printf("   %s --compare <a.bin> <b.bin>\n", program_name);
     printf("\n");
     printf("         '-f' specify the input file which generated by trace_io_record\n");
     printf("         '-d' to display each event\n");
     printf("         '-t' to display TSC for each event\n");
     printf("         '-b' to display anzlysis result of r/w in a block\n");
     printf("         '-z' to display anzlysis result of r/w in a zone\n");
+    printf("         '-s' to display sequential stream and I/O coalescing analysis\n");
+    printf("         '-w' coalescing window in us for '-s', default is 50 us\n");
+    printf("         '-a' to display inter-arrival time, burstiness and idle period analysis\n");
+    printf("         '-i' min idle period in us for '-a', default is 1000 us\n");
+    printf("         '-c' to display per-lcore breakdown and cross-core imbalance\n");
+    printf("         '-I' interval in ms of per-lcore time-series for '-c', default is 1000 ms\n");
+    printf("         '-o' to export analysis result, format is json, csv or col (columnar binary)\n");
+    printf("         '-O' path prefix of export files for '-o', default is the input file name\n");
+    printf("         '-S' to simulate the trace on a device model, repeat it to compare models in one pass.\n");
+    printf("              The model is <key>=<value>[,...], keys are ch (channels, default 8), zone (zone size\n");
+    printf("              in blocks, default is the namespace), stripe (blocks per channel without zones, default\n");
+    printf("              64), qd (closed loop depth, default 0 replays open loop at the trace time), scale\n");
+    printf("              (open loop time scale) and rlat, wlat, alat, mlat, olat (service time of read, write,\n");
+    printf("              append, zone mgmt and other, fixed:<us>, uniform:<min>:<max> or exp:<mean>)\n");
+    printf("         '--compare' to compare summaries of trace a and b, e.g. before / after an upgrade\n");
 }
 
 static int
-parse_args(int argc, char **argv, char *file_name, size_t file_name_size)
+parse_args(int argc, char **argv, char *file_name, size_t file_name_size, char *cmp_file_name,
+           size_t cmp_file_name_size)
 {
     int op;
+    static const struct option long_options[] = {
+        {"compare", required_argument, NULL, 'C'},
+        {NULL, 0, NULL, 0},
+    };
 
-    while ((op = getopt(argc, argv, "f:dtbz")) != -1) {
+    while ((op = getopt_long(argc, argv, "f:dtbzsw:ai:cI:o:O:S:", long_options, NULL)) != -1) {
         switch (op) {
+        case 'C':
+            /* --compare a.bin b.bin */
+            if (optind >= argc) {
+                fprintf(stderr, "--compare requires two input files\n");
+                usage(argv[0]);
+                return 1;
+            }
+            g_compare = true;
+            snprintf(file_name, file_name_size, "%s", optarg);
+            snprintf(cmp_file_name, cmp_file_name_size, "%s", argv[optind++]);
+            break;
         case 'f':
             g_input_file = true;
             snprintf(file_name, file_name_size, "%s", optarg);
@@ -726,6 +2509,46 @@ parse_args(int argc, char **argv, char *file_name, size_t file_name_size)
         case 't':
             g_print_tsc = true;
             break;
+        case 's':
+            g_stream_analysis = true;
+            break;
+        case 'w':
+            g_coalesce_window_us = strtoull(optarg, NULL, 10);
+            break;
+        case 'a':
+            g_arrival_analysis = true;
+            break;
+        case 'i':
+            g_idle_threshold_us = strtoull(optarg, NULL, 10);
+            break;
+        case 'c':
+            g_lcore_analysis = true;
+            break;
+        case 'o':
+            g_export_format = export_parse_format(optarg);
+            if (g_export_format == EXPORT_FORMAT_NONE) {
+                fprintf(stderr, "Unknown export format %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'O':
+            g_export_prefix = optarg;
+            break;
+        case 'S':
+            if (sim_model_parse(optarg) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            g_sim_analysis = true;
+            break;
+        case 'I':
+            g_lcore_interval_ms = strtoull(optarg, NULL, 10);
+            if (g_lcore_interval_ms == 0) {
+                fprintf(stderr, "-I interval must be greater than 0\n");
+                return 1;
+            }
+            break;
         default:
             usage(argv[0]);
             return 1;
@@ -740,7 +2563,8 @@ main(int argc, char **argv)
 {
     int rc = 0;    
     char input_file_name[68];
-    rc = parse_args(argc, argv, input_file_name, sizeof(input_file_name));
+    char cmp_file_name[68];
+    rc = parse_args(argc, argv, input_file_name, sizeof(input_file_name), cmp_file_name, sizeof(cmp_file_name));
     if (rc != 0) {
         return rc;
     }
@@ -750,7 +2574,7 @@ main(int argc, char **argv)
         exit(1);
     }
 
-    if (input_file_name == NULL || !g_input_file) {
+    if (!g_compare && (input_file_name == NULL || !g_input_file)) {
         fprintf(stderr, "-f input file must be specified\n");
         exit(1);
     }
@@ -765,6 +2589,16 @@ main(int argc, char **argv)
         return rc; 
     }   
 
+    /* Compare two traces */
+    if (g_compare) {
+        rc = probe_ns_info();
+        if (rc == 0) {
+            rc = compare_trace(input_file_name, cmp_file_name);
+        }
+        spdk_env_fini();
+        return rc;
+    }
+
     /* Read input file */
     FILE *fptr = NULL;
     fptr = fopen(input_file_name, "rb");
@@ -808,28 +2642,21 @@ main(int argc, char **argv)
     printf("\n");
 
     /* In order to get namespace information, we need to initialize NVMe controller */
-    /* Get trid */
-    spdk_nvme_trid_populate_transport(&g_trid, SPDK_NVME_TRANSPORT_PCIE);
-    snprintf(g_trid.subnqn, sizeof(g_trid.subnqn), "%s", SPDK_NVMF_DISCOVERY_NQN);
-
-    /* Register ctrlr & register ns */
-    printf("Initializing NVMe Controllers\n");
-    
-    rc = spdk_nvme_probe(&g_trid, NULL, probe_cb, attach_cb, NULL);
+    rc = probe_ns_info();
     if (rc != 0) {
-        fprintf(stderr, "spdk_nvme_probe() failed\n");
-        cleanup();
-    }
-    
-    if (TAILQ_EMPTY(&g_controllers)) {
-        fprintf(stderr, "no NVMe controllers found\n");
-        cleanup();
+        fclose(fptr);
+        return rc;
     }
-    printf("Initialization complete.\n");
 
-    /* Get namespace data */
-    get_ns_info();
-    cleanup();
+    /* Open export sink, from here on every exit goes through out so that the export is terminated */
+    uint32_t *r_iosize = NULL, *w_iosize = NULL;
+    uint16_t *r_blk = NULL, *w_blk = NULL, *r_zone = NULL, *w_zone = NULL;
+    if (g_export_format != EXPORT_FORMAT_NONE) {
+        rc = export_open(g_export_format, g_export_prefix ? g_export_prefix : input_file_name);
+        if (rc != 0) {
+            goto out;
+        }
+    }
 
     /*
      * Trace analysis round 1: 
@@ -837,23 +2664,26 @@ main(int argc, char **argv)
      * 2. IOPS
      * 3. Total number of read write
      * 4. IO request size
+     * 5. Sequential streams and coalescing opportunity (if '-s' is specified)
+     * 6. Inter-arrival time, burstiness and idle period (if '-a' is specified)
+     * 7. Per-lcore breakdown and imbalance (if '-c' is specified)
+     * 8. Latency and IOPS predicted by device models (if '-S' is specified)
      */
-    uint32_t *r_iosize = (uint32_t *)malloc(g_max_transfer_block * sizeof(uint32_t));
+    r_iosize = (uint32_t *)malloc(IOSIZE_MAX * sizeof(uint32_t));
     if (!r_iosize) {
         fprintf(stderr, "Fall to allocate memory for r_iosize\n");
         rc = 1;
-        return rc;
+        goto out;
     }
-    uint32_t *w_iosize = (uint32_t *)malloc(g_max_transfer_block * sizeof(uint32_t));
+    w_iosize = (uint32_t *)malloc(IOSIZE_MAX * sizeof(uint32_t));
     if (!w_iosize) {
         fprintf(stderr, "Fall to allocate memory for w_iosize\n");
         rc = 1;
-        free(r_iosize);
-        return rc;
+        goto out;
     }
 
-    memset(r_iosize, 0, g_max_transfer_block * sizeof(uint32_t));
-    memset(w_iosize, 0, g_max_transfer_block * sizeof(uint32_t));
+    memset(r_iosize, 0, IOSIZE_MAX * sizeof(uint32_t));
+    memset(w_iosize, 0, IOSIZE_MAX * sizeof(uint32_t));
     
     rewind(fptr);
     size_t remain_entry = total_entry;
@@ -870,10 +2700,35 @@ main(int argc, char **argv)
             rc = process_analysis_round1(&buffer[i], r_iosize, w_iosize);
             if (rc != 0) {
                 fprintf(stderr, "Analysis error\n");
-                free(r_iosize);
-                free(w_iosize);
-                fclose(fptr);
-                return rc;
+                goto out;
+            }
+
+            if (g_stream_analysis) {
+                rc = process_stream_analysis(&buffer[i]);
+                if (rc != 0) {
+                    fprintf(stderr, "Stream analysis error\n");
+                    goto out;
+                }
+            }
+
+            if (g_arrival_analysis) {
+                process_arrival_analysis(&buffer[i]);
+            }
+
+            if (g_lcore_analysis) {
+                rc = process_lcore_analysis(&buffer[i]);
+                if (rc != 0) {
+                    fprintf(stderr, "Lcore analysis error\n");
+                    goto out;
+                }
+            }
+        }
+
+        if (g_sim_analysis) {
+            rc = process_sim_analysis(buffer, read_entry);
+            if (rc != 0) {
+                fprintf(stderr, "Device simulation error\n");
+                goto out;
             }
         }
     }
@@ -893,7 +2748,7 @@ main(int argc, char **argv)
     printf("READ  %-20jd WRITE %-20jd R/W %6.3f %%\n", g_read_cnt, g_write_cnt, rw_ratio(g_read_cnt, g_write_cnt));
 
     printf("%-20s:\n", "R/W Request size");
-    for (uint64_t i = 0; i < g_max_transfer_block; i++) {
+    for (uint64_t i = 0; i < IOSIZE_MAX; i++) {
         if (!r_iosize[i] && !w_iosize[i])
             continue;
         printf("%ld blocks  ", i + 1); 
@@ -902,8 +2757,26 @@ main(int argc, char **argv)
         printf("r+w %-5d ", r_iosize[i] + w_iosize[i]);
         printf("\n");
     }
-    free(r_iosize);
-    free(w_iosize);
+
+    if (export_enabled()) {
+        export_summary(r_iosize, w_iosize);
+    }
+
+    if (g_stream_analysis) {
+        print_stream_analysis();
+    }
+
+    if (g_arrival_analysis) {
+        print_arrival_analysis();
+    }
+
+    if (g_lcore_analysis) {
+        print_lcore_analysis();
+    }
+
+    if (g_sim_analysis) {
+        print_sim_analysis();
+    }
 
     /*
      * Trace analysis round 2: 
@@ -911,39 +2784,33 @@ main(int argc, char **argv)
      * 5. The number of R/W in a zone (if the block device is ZNS SSD)
      */
 
-    uint16_t *r_blk = (uint16_t *)malloc(g_ns_block * sizeof(uint16_t));
+    r_blk = (uint16_t *)malloc(g_ns_block * sizeof(uint16_t));
     if (!r_blk) {
         fprintf(stderr, "Fall to allocate memory for r_blk\n");
         rc = 1;
-        return rc;
+        goto out;
     }
-    uint16_t *w_blk = (uint16_t *)malloc(g_ns_block * sizeof(uint16_t));
+    w_blk = (uint16_t *)malloc(g_ns_block * sizeof(uint16_t));
     if (!w_blk) {
         fprintf(stderr, "Fall to allocate memory for w_blk\n");
-        free(r_blk);
         rc = 1;
-        return rc;
+        goto out;
     }
     memset(r_blk, 0, g_ns_block * sizeof(uint16_t));
     memset(w_blk, 0, g_ns_block * sizeof(uint16_t)); 
 
-    uint16_t *r_zone = (uint16_t *)malloc(g_ns_zone * sizeof(uint16_t));
+    r_zone = (uint16_t *)malloc(g_ns_zone * sizeof(uint16_t));
     if (!r_zone) {
         fprintf(stderr, "Fall to allocate memory for r_zone\n");
-        free(r_blk);
-        free(w_blk);
         rc = 1;
-        return rc;
+        goto out;
     }
-    uint16_t *w_zone = (uint16_t *)malloc(g_ns_zone * sizeof(uint16_t));
-    if (!w_blk) {
+    w_zone = (uint16_t *)malloc(g_ns_zone * sizeof(uint16_t));
+    if (!w_zone) {
         fprintf(stderr, "Fall to allocate memory for w_zone\n");
-        free(r_blk);
-        free(w_blk);
-        free(r_zone);
         rc = 1;
-        return rc;
-    }    
+        goto out;
+    }
     memset(r_zone, 0, g_ns_zone * sizeof(uint16_t));
     memset(w_zone, 0, g_ns_zone * sizeof(uint16_t));
 
@@ -962,17 +2829,13 @@ main(int argc, char **argv)
             rc = process_analysis_round2(&buffer[i], r_blk, w_blk, r_zone, w_zone);
             if (rc != 0) {
                 fprintf(stderr, "Analysis error\n");
-                free(r_blk);
-                free(w_blk);
-                free(r_zone);
-                free(w_zone);
-                fclose(fptr);
-                return rc; 
+                goto out;
             }
         }
     }
 
     fclose(fptr);
+    fptr = NULL;
 
     if (g_print_rwblock) {
         printf("\nNumber of R/W in a block:\n");
@@ -1012,6 +2875,20 @@ main(int argc, char **argv)
         printf("\n");
     }
 
+    if (export_enabled()) {
+        export_rw_count("block", "lba", g_ns_block, 1, r_blk, w_blk);
+        if (g_zone) {
+            export_rw_count("zone", "zslba", g_ns_zone, g_zone_size_lba, r_zone, w_zone);
+        }
+    }
+
+out:
+    export_close();
+    if (fptr) {
+        fclose(fptr);
+    }
+    free(r_iosize);
+    free(w_iosize);
     free(r_blk);
     free(w_blk);
     free(r_zone);
@@ -7,6 +7,7 @@
 #include "../include/trace_io.h"
 
 #include <map>
+#include <vector>
 
 extern "C" {
 #include "spdk/trace_parser.h"
@@ -21,6 +22,9 @@ static char *g_exe_name;
 static bool g_debug_enable = false;
 static uint64_t g_tsc_base = 0;
 static uint64_t g_tsc_rate = 0;
+/* sparse index of the output file, saved as <output>.idx */
+static std::vector<struct trace_io_index_block> g_index_block;
+static uint64_t g_num_entry = 0;
 
 /* This is a bit ugly, but we don't want to include env_dpdk in the app, while spdk_util, which we
  * do need, uses some of the functions implemented there.  We're not actually using the functions
@@ -110,6 +114,42 @@ process_output_file(struct spdk_trace_parser_entry *entry, FILE *fptr)
         exit(1);
     }
     fwrite(&buffer, sizeof(struct trace_io_entry), 1, fptr);
+
+    if (g_num_entry % TRACE_IO_INDEX_STRIDE == 0) {
+        g_index_block.emplace_back();
+    }
+    trace_io_index_block_add(&g_index_block.back(), &buffer, g_num_entry % TRACE_IO_INDEX_STRIDE == 0);
+    g_num_entry++;
+}
+
+/* the replayer rebuilds the index on first use if this fails */
+static void
+write_index_file(const char *output_file_name)
+{
+    struct trace_io_index_hdr hdr;
+    char idx_name[sizeof(".idx") + 68];
+
+    hdr.magic = TRACE_IO_INDEX_MAGIC;
+    hdr.stride = TRACE_IO_INDEX_STRIDE;
+    hdr.num_entry = g_num_entry;
+    hdr.num_block = g_index_block.size();
+    hdr.first_tsc = g_index_block.empty() ? 0 : g_index_block[0].tsc;
+    snprintf(idx_name, sizeof(idx_name), "%s.idx", output_file_name);
+
+    FILE *fptr = fopen(idx_name, "wb");
+    if (fptr == NULL) {
+        fprintf(stderr, "Failed to open index file %s\n", idx_name);
+        return;
+    }
+    if (fwrite(&hdr, sizeof(hdr), 1, fptr) != 1 ||
+        fwrite(g_index_block.data(), sizeof(struct trace_io_index_block), hdr.num_block, fptr) != hdr.num_block) {
+        fprintf(stderr, "Fail to write index file %s\n", idx_name);
+        fclose(fptr);
+        unlink(idx_name);
+        return;
+    }
+    fclose(fptr);
+    printf("Output .idx file: %s\n", idx_name);
 }
 
 static void
@@ -268,6 +308,7 @@ main(int argc, char **argv)
         process_output_file(&entry, fptr);
     }
     fclose(fptr);
+    write_index_file(output_file_name);
 
     if (g_debug_enable) {
         printf("Debug mode enabled\n");
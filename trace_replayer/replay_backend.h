@@ -0,0 +1,123 @@
+#include "spdk/stdinc.h"
+#include "spdk/nvme.h"
+
+#ifndef TRACE_REPLAYER_REPLAY_BACKEND_H
+#define TRACE_REPLAYER_REPLAY_BACKEND_H
+
+/* device geometry reported by a backend */
+struct replay_geometry {
+    uint32_t nsid;
+    uint64_t num_blk;
+    uint32_t block_byte;
+    uint32_t max_xfer_byte;
+    uint32_t queue_size;        /* default queue depth */
+    bool     deallocate;        /* deallocate (trim / discard) is supported */
+    bool     write_zeroes;
+    uint64_t max_write_zeroes_blk;  /* 0 means only the NLB field limits it */
+    bool     zoned;
+    uint64_t num_zone;
+    uint64_t zone_sz_blk;
+    uint32_t max_open_zone;     /* 0 means no limit */
+    uint32_t max_active_zone;   /* 0 means no limit */
+    uint32_t max_append_byte;
+};
+
+struct replay_zone_desc {
+    uint64_t zslba;
+    uint64_t cap;
+    uint64_t wp;
+    uint8_t  state;             /* enum spdk_nvme_zns_zone_state */
+};
+
+/* queue of one worker, opaque to the replayer */
+struct replay_qpair;
+
+/*
+ * I/O path of the replayer. Every command completes through an NVMe style callback
+ * from poll() on the qpair it was submitted to, so that completion handlers do not
+ * depend on the backend. A submit function returns non-zero when the command was not
+ * queued, the callback is not called then.
+ */
+struct replay_backend {
+    const char *name;
+
+    /**
+     * Open the device and fill its geometry.
+     *
+     * \param target backend specific device, may be empty.
+     * \param geo geometry of the device.
+     * \return 0 on success, else non-zero indicates a failure.
+     */
+    int (*open)(const char *target, struct replay_geometry *geo);
+    void (*close)(void);
+
+    /**
+     * Allocate a queue, every queue is used by one thread only.
+     *
+     * \param depth max number of outstanding commands.
+     */
+    struct replay_qpair *(*alloc_qpair)(uint32_t depth);
+    void (*free_qpair)(struct replay_qpair *qpair);
+
+    /**
+     * Process completions of the queue.
+     *
+     * \return number of completions, negative on failure.
+     */
+    int32_t (*poll)(struct replay_qpair *qpair);
+
+    int (*read)(struct replay_qpair *qpair, void *buf, uint64_t slba, uint32_t nlb,
+                spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+    int (*write)(struct replay_qpair *qpair, void *buf, uint64_t slba, uint32_t nlb,
+                 spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+    int (*write_zeroes)(struct replay_qpair *qpair, uint64_t slba, uint32_t nlb,
+                        spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+    int (*deallocate)(struct replay_qpair *qpair, uint64_t slba, uint32_t nlb,
+                      spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+
+    /*
+     * Zone commands, only called on zoned devices. Backends that know the LBA written by a zone
+     * append return it in cdw0 (low) and cdw1 (high) of the completion.
+     */
+    int (*zone_append)(struct replay_qpair *qpair, void *buf, uint64_t zslba, uint32_t nlb,
+                       spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+    /**
+     * Zone management send.
+     *
+     * \param action enum spdk_nvme_zns_zone_send_action.
+     * \param select_all apply to all zones, zslba is ignored.
+     */
+    int (*zone_mgmt)(struct replay_qpair *qpair, uint64_t zslba, uint8_t action, bool select_all,
+                     spdk_nvme_cmd_cb cb_fn, void *cb_arg);
+    /**
+     * Report zones starting from the zone of slba, waits for the result.
+     *
+     * \param desc array of *num_desc descriptors.
+     * \param num_desc size of desc, set to the number of zones reported.
+     * \return 0 on success, else non-zero indicates a failure.
+     */
+    int (*report_zones)(struct replay_qpair *qpair, uint64_t slba, struct replay_zone_desc *desc,
+                        uint32_t *num_desc);
+
+    /* print the zone report of the device, optional */
+    void (*print_zones)(uint64_t limit);
+};
+
+extern const struct replay_backend g_replay_backend_nvme;
+extern const struct replay_backend g_replay_backend_bdev;
+extern const struct replay_backend g_replay_backend_uring;
+extern const struct replay_backend g_replay_backend_null;
+extern const struct replay_backend g_replay_backend_emu;
+
+/* fill an NVMe completion for backends that are not NVMe */
+static inline void
+replay_backend_cpl(struct spdk_nvme_cpl *cpl, bool success)
+{
+    memset(cpl, 0, sizeof(*cpl));
+    if (!success) {
+        cpl->status.sct = SPDK_NVME_SCT_GENERIC;
+        cpl->status.sc = SPDK_NVME_SC_INTERNAL_DEVICE_ERROR;
+    }
+}
+
+#endif
@@ -0,0 +1,595 @@
+#include "spdk/stdinc.h"
+#include "spdk/env.h"
+#include "spdk/util.h"
+#include "spdk/thread.h"
+#include "spdk/init.h"
+#include "spdk/rpc.h"
+#include "spdk/bdev.h"
+#include "spdk/bdev_zone.h"
+#include "spdk/nvme.h"
+#include "spdk/nvme_spec.h"
+#include "replay_backend.h"
+
+/*
+ * SPDK bdev layer, the bdevs are created from a JSON config as in an SPDK application.
+ * Target is <config.json>:<bdev name>. Every qpair is an spdk_thread with its own io
+ * channel, polled by the worker that owns the qpair.
+ */
+
+#define BDEV_MAX_XFER_BYTE (128 * 1024)
+#define BDEV_QUEUE_SIZE 256
+#define BDEV_ZONE_SELECT_MAX 1024
+
+struct bdev_qpair;
+
+struct bdev_cmd {
+    struct bdev_qpair *qpair;
+    spdk_nvme_cmd_cb cb_fn;
+    void *cb_arg;
+    uint64_t pending;           /* zone commands of a select all */
+    bool error;
+    struct bdev_cmd *next;
+};
+
+struct bdev_qpair {
+    struct spdk_thread *thread;
+    struct spdk_io_channel *ch;
+    struct bdev_cmd *cmds;
+    struct bdev_cmd *free;
+    int32_t num_cpl;            /* completions in the current poll */
+};
+
+static struct spdk_thread *g_init_thread = NULL;
+static struct spdk_bdev_desc *g_desc = NULL;
+static struct spdk_bdev *g_bdev = NULL;
+static struct replay_geometry g_bdev_geo;
+
+/* run the init thread until *done is set */
+static void
+bdev_init_poll(bool *done)
+{
+    while (!*done) {
+        spdk_thread_poll(g_init_thread, 0, 0);
+    }
+}
+
+static void
+bdev_init_done(int rc, void *cb_arg)
+{
+    int *result = (int *)cb_arg;
+
+    *result = rc ? rc : 1;
+}
+
+static void
+bdev_fini_done(void *cb_arg)
+{
+    *(bool *)cb_arg = true;
+}
+
+static void
+bdev_event_cb(enum spdk_bdev_event_type type, struct spdk_bdev *bdev, void *event_ctx)
+{
+}
+
+/* stop the subsystems and the init thread, also unwinds a failed open */
+static void
+bdev_fini(void)
+{
+    bool done = false;
+
+    spdk_subsystem_fini(bdev_fini_done, &done);
+    bdev_init_poll(&done);
+
+    spdk_thread_exit(g_init_thread);
+    while (!spdk_thread_is_exited(g_init_thread)) {
+        spdk_thread_poll(g_init_thread, 0, 0);
+    }
+    spdk_thread_destroy(g_init_thread);
+    g_init_thread = NULL;
+    spdk_set_thread(NULL);
+    spdk_thread_lib_fini();
+}
+
+static int
+bdev_open(const char *target, struct replay_geometry *geo)
+{
+    char json[PATH_MAX];
+    const char *name = strrchr(target, ':');
+    int result = 0;
+
+    if (!name || name == target || (size_t)(name - target) >= sizeof(json) || !name[1]) {
+        fprintf(stderr, "Invalid bdev %s, expect <config.json>:<bdev name>\n", target);
+        return 1;
+    }
+    snprintf(json, sizeof(json), "%.*s", (int)(name - target), target);
+    name++;
+
+    if (spdk_thread_lib_init(NULL, 0) != 0) {
+        fprintf(stderr, "spdk_thread_lib_init() failed\n");
+        return 1;
+    }
+    g_init_thread = spdk_thread_create("replay_init", NULL);
+    if (!g_init_thread) {
+        fprintf(stderr, "spdk_thread_create() failed\n");
+        spdk_thread_lib_fini();
+        return 1;
+    }
+    spdk_set_thread(g_init_thread);
+
+    spdk_subsystem_init_from_json_config(json, SPDK_DEFAULT_RPC_ADDR, bdev_init_done, &result, true);
+    while (!result) {
+        spdk_thread_poll(g_init_thread, 0, 0);
+    }
+    if (result != 1) {
+        fprintf(stderr, "Failed to load bdev config %s\n", json);
+        goto err;
+    }
+
+    if (spdk_bdev_open_ext(name, true, bdev_event_cb, NULL, &g_desc) != 0) {
+        fprintf(stderr, "Failed to open bdev %s\n", name);
+        goto err;
+    }
+    g_bdev = spdk_bdev_desc_get_bdev(g_desc);
+
+    memset(geo, 0, sizeof(*geo));
+    geo->nsid = 1;
+    geo->num_blk = spdk_bdev_get_num_blocks(g_bdev);
+    geo->block_byte = spdk_bdev_get_block_size(g_bdev);
+    geo->max_xfer_byte = BDEV_MAX_XFER_BYTE;
+    geo->queue_size = BDEV_QUEUE_SIZE;
+    geo->deallocate = spdk_bdev_io_type_supported(g_bdev, SPDK_BDEV_IO_TYPE_UNMAP);
+    geo->write_zeroes = spdk_bdev_io_type_supported(g_bdev, SPDK_BDEV_IO_TYPE_WRITE_ZEROES);
+    if (spdk_bdev_is_zoned(g_bdev)) {
+        geo->zoned = true;
+        geo->zone_sz_blk = spdk_bdev_get_zone_size(g_bdev);
+        geo->num_zone = spdk_bdev_get_num_zones(g_bdev);
+        geo->max_open_zone = spdk_bdev_get_max_open_zones(g_bdev);
+        geo->max_active_zone = spdk_bdev_get_max_active_zones(g_bdev);
+        geo->max_append_byte = spdk_bdev_get_max_zone_append_size(g_bdev) * geo->block_byte;
+    }
+    g_bdev_geo = *geo;
+    return 0;
+
+err:
+    bdev_fini();
+    return 1;
+}
+
+static void
+bdev_close(void)
+{
+    if (!g_init_thread) {
+        return;
+    }
+    spdk_set_thread(g_init_thread);
+    if (g_desc) {
+        spdk_bdev_close(g_desc);
+        g_desc = NULL;
+    }
+    bdev_fini();
+}
+
+static struct replay_qpair *
+bdev_alloc_qpair(uint32_t depth)
+{
+    struct bdev_qpair *qpair = (struct bdev_qpair *)calloc(1, sizeof(struct bdev_qpair));
+
+    if (!qpair) {
+        fprintf(stderr, "Fail to allocate memory for bdev qpair\n");
+        return NULL;
+    }
+    depth = spdk_max(depth, 1);
+    qpair->cmds = (struct bdev_cmd *)calloc(depth, sizeof(struct bdev_cmd));
+    if (!qpair->cmds) {
+        fprintf(stderr, "Fail to allocate memory for bdev qpair\n");
+        free(qpair);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < depth; i++) {
+        qpair->cmds[i].next = qpair->free;
+        qpair->free = &qpair->cmds[i];
+    }
+    qpair->thread = spdk_thread_create("replay_qpair", NULL);
+    if (!qpair->thread) {
+        fprintf(stderr, "spdk_thread_create() failed\n");
+        free(qpair->cmds);
+        free(qpair);
+        return NULL;
+    }
+    spdk_set_thread(qpair->thread);
+    qpair->ch = spdk_bdev_get_io_channel(g_desc);
+    spdk_set_thread(g_init_thread);
+    if (!qpair->ch) {
+        fprintf(stderr, "spdk_bdev_get_io_channel() failed\n");
+        spdk_thread_exit(qpair->thread);
+        spdk_thread_destroy(qpair->thread);
+        free(qpair->cmds);
+        free(qpair);
+        return NULL;
+    }
+    return (struct replay_qpair *)qpair;
+}
+
+static void
+bdev_free_qpair(struct replay_qpair *replay_qpair)
+{
+    struct bdev_qpair *qpair = (struct bdev_qpair *)replay_qpair;
+
+    spdk_set_thread(qpair->thread);
+    spdk_put_io_channel(qpair->ch);
+    spdk_thread_exit(qpair->thread);
+    while (!spdk_thread_is_exited(qpair->thread)) {
+        spdk_thread_poll(qpair->thread, 0, 0);
+    }
+    spdk_thread_destroy(qpair->thread);
+    spdk_set_thread(g_init_thread);
+    free(qpair->cmds);
+    free(qpair);
+}
+
+static int32_t
+bdev_poll(struct replay_qpair *replay_qpair)
+{
+    struct bdev_qpair *qpair = (struct bdev_qpair *)replay_qpair;
+
+    qpair->num_cpl = 0;
+    spdk_thread_poll(qpair->thread, 0, 0);
+    return qpair->num_cpl;
+}
+
+/* one command per queue depth slot, kept on a free list of the qpair */
+static struct bdev_cmd *
+bdev_cmd_get(struct bdev_qpair *qpair, spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    struct bdev_cmd *cmd = qpair->free;
+
+    if (!cmd) {
+        return NULL;
+    }
+    qpair->free = cmd->next;
+    cmd->qpair = qpair;
+    cmd->cb_fn = cb_fn;
+    cmd->cb_arg = cb_arg;
+    cmd->pending = 1;
+    cmd->error = false;
+    cmd->next = NULL;
+    return cmd;
+}
+
+static void
+bdev_cmd_put(struct bdev_cmd *cmd)
+{
+    cmd->next = cmd->qpair->free;
+    cmd->qpair->free = cmd;
+}
+
+static void
+bdev_cmd_complete(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+    struct bdev_cmd *cmd = (struct bdev_cmd *)cb_arg;
+    struct spdk_nvme_cpl cpl;
+
+    replay_backend_cpl(&cpl, success && !cmd->error);
+    if (!success) {
+        uint32_t cdw0;
+        int sct, sc;
+        /* bdevs that are not NVMe translate their status */
+        spdk_bdev_io_get_nvme_status(bdev_io, &cdw0, &sct, &sc);
+        if (sct || sc) {
+            cpl.status.sct = sct;
+            cpl.status.sc = sc;
+        }
+        cmd->error = true;
+    }
+    spdk_bdev_free_io(bdev_io);
+
+    if (--cmd->pending) {
+        return;
+    }
+    spdk_nvme_cmd_cb cb_fn = cmd->cb_fn;
+    void *arg = cmd->cb_arg;
+    cmd->qpair->num_cpl++;
+    bdev_cmd_put(cmd);
+    cb_fn(arg, &cpl);
+}
+
+/* completion of a command that has no bdev_io left, run by the poll of the qpair */
+static void
+bdev_cmd_done(void *arg)
+{
+    struct bdev_cmd *cmd = (struct bdev_cmd *)arg;
+    spdk_nvme_cmd_cb cb_fn = cmd->cb_fn;
+    void *cb_arg = cmd->cb_arg;
+    struct spdk_nvme_cpl cpl;
+
+    replay_backend_cpl(&cpl, !cmd->error);
+    cmd->qpair->num_cpl++;
+    bdev_cmd_put(cmd);
+    cb_fn(cb_arg, &cpl);
+}
+
+enum bdev_cmd_type {
+    BDEV_CMD_READ = 0,
+    BDEV_CMD_WRITE,
+    BDEV_CMD_WRITE_ZEROES,
+    BDEV_CMD_UNMAP,
+    BDEV_CMD_ZONE_APPEND,
+    BDEV_CMD_ZONE_MGMT,
+};
+
+/* submit on the thread of the qpair, a full bdev queue is drained by polling */
+static int
+bdev_submit(struct bdev_qpair *qpair, struct bdev_cmd *cmd, enum bdev_cmd_type type, void *buf,
+            uint64_t slba, uint64_t nlb, enum spdk_bdev_zone_action action)
+{
+    int rc;
+
+    spdk_set_thread(qpair->thread);
+    do {
+        switch (type) {
+        case BDEV_CMD_READ:
+            rc = spdk_bdev_read_blocks(g_desc, qpair->ch, buf, slba, nlb, bdev_cmd_complete, cmd);
+            break;
+        case BDEV_CMD_WRITE:
+            rc = spdk_bdev_write_blocks(g_desc, qpair->ch, buf, slba, nlb, bdev_cmd_complete, cmd);
+            break;
+        case BDEV_CMD_WRITE_ZEROES:
+            rc = spdk_bdev_write_zeroes_blocks(g_desc, qpair->ch, slba, nlb, bdev_cmd_complete, cmd);
+            break;
+        case BDEV_CMD_UNMAP:
+            rc = spdk_bdev_unmap_blocks(g_desc, qpair->ch, slba, nlb, bdev_cmd_complete, cmd);
+            break;
+        case BDEV_CMD_ZONE_APPEND:
+            rc = spdk_bdev_zone_append(g_desc, qpair->ch, buf, slba, nlb, bdev_cmd_complete, cmd);
+            break;
+        default:
+            rc = spdk_bdev_zone_management(g_desc, qpair->ch, slba, action, bdev_cmd_complete, cmd);
+            break;
+        }
+        if (rc == -ENOMEM) {
+            spdk_thread_poll(qpair->thread, 0, 0);
+        }
+    } while (rc == -ENOMEM);
+    return rc;
+}
+
+static int
+bdev_cmd(struct replay_qpair *replay_qpair, enum bdev_cmd_type type, void *buf, uint64_t slba,
+         uint32_t nlb, spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    struct bdev_qpair *qpair = (struct bdev_qpair *)replay_qpair;
+    struct bdev_cmd *cmd = bdev_cmd_get(qpair, cb_fn, cb_arg);
+
+    if (!cmd) {
+        return -ENOMEM;
+    }
+    int rc = bdev_submit(qpair, cmd, type, buf, slba, nlb, SPDK_BDEV_ZONE_RESET);
+    if (rc) {
+        bdev_cmd_put(cmd);
+    }
+    return rc;
+}
+
+static int
+bdev_read(struct replay_qpair *qpair, void *buf, uint64_t slba, uint32_t nlb,
+          spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return bdev_cmd(qpair, BDEV_CMD_READ, buf, slba, nlb, cb_fn, cb_arg);
+}
+
+static int
+bdev_write(struct replay_qpair *qpair, void *buf, uint64_t slba, uint32_t nlb,
+           spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return bdev_cmd(qpair, BDEV_CMD_WRITE, buf, slba, nlb, cb_fn, cb_arg);
+}
+
+static int
+bdev_write_zeroes(struct replay_qpair *qpair, uint64_t slba, uint32_t nlb,
+                  spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return bdev_cmd(qpair, BDEV_CMD_WRITE_ZEROES, NULL, slba, nlb, cb_fn, cb_arg);
+}
+
+static int
+bdev_deallocate(struct replay_qpair *qpair, uint64_t slba, uint32_t nlb,
+                spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return bdev_cmd(qpair, BDEV_CMD_UNMAP, NULL, slba, nlb, cb_fn, cb_arg);
+}
+
+static int
+bdev_zone_append(struct replay_qpair *qpair, void *buf, uint64_t zslba, uint32_t nlb,
+                 spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return bdev_cmd(qpair, BDEV_CMD_ZONE_APPEND, buf, zslba, nlb, cb_fn, cb_arg);
+}
+
+static uint8_t
+bdev_zone_state(enum spdk_bdev_zone_state state)
+{
+    switch (state) {
+    case SPDK_BDEV_ZONE_STATE_EMPTY:
+        return SPDK_NVME_ZONE_STATE_EMPTY;
+    case SPDK_BDEV_ZONE_STATE_IMP_OPEN:
+        return SPDK_NVME_ZONE_STATE_IOPEN;
+    case SPDK_BDEV_ZONE_STATE_EXP_OPEN:
+        return SPDK_NVME_ZONE_STATE_EOPEN;
+    case SPDK_BDEV_ZONE_STATE_CLOSED:
+        return SPDK_NVME_ZONE_STATE_CLOSED;
+    case SPDK_BDEV_ZONE_STATE_READ_ONLY:
+        return SPDK_NVME_ZONE_STATE_RONLY;
+    case SPDK_BDEV_ZONE_STATE_OFFLINE:
+        return SPDK_NVME_ZONE_STATE_OFFLINE;
+    default:
+        return SPDK_NVME_ZONE_STATE_FULL;
+    }
+}
+
+static void
+bdev_zone_info_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+    *(int *)cb_arg = success ? 0 : 1;
+    spdk_bdev_free_io(bdev_io);
+}
+
+static int
+bdev_report_zones(struct replay_qpair *replay_qpair, uint64_t slba, struct replay_zone_desc *desc,
+                  uint32_t *num_desc)
+{
+    struct bdev_qpair *qpair = (struct bdev_qpair *)replay_qpair;
+    uint64_t zone = slba / g_bdev_geo.zone_sz_blk;
+    uint32_t num = (uint32_t)spdk_min((uint64_t)*num_desc, g_bdev_geo.num_zone - spdk_min(zone, g_bdev_geo.num_zone));
+    int rc = -1;
+
+    if (!num) {
+        *num_desc = 0;
+        return 0;
+    }
+    struct spdk_bdev_zone_info *info = (struct spdk_bdev_zone_info *)calloc(num, sizeof(struct spdk_bdev_zone_info));
+    if (!info) {
+        fprintf(stderr, "Fail to allocate memory for zone report\n");
+        return 1;
+    }
+    spdk_set_thread(qpair->thread);
+    if (spdk_bdev_get_zone_info(g_desc, qpair->ch, zone * g_bdev_geo.zone_sz_blk, num, info,
+                                bdev_zone_info_done, &rc) != 0) {
+        fprintf(stderr, "Report zones failed\n");
+        free(info);
+        return 1;
+    }
+    while (rc < 0) {
+        spdk_thread_poll(qpair->thread, 0, 0);
+    }
+    if (!rc) {
+        for (uint32_t i = 0; i < num; i++) {
+            desc[i].zslba = info[i].zone_id;
+            desc[i].cap = info[i].capacity;
+            desc[i].wp = info[i].write_pointer;
+            desc[i].state = bdev_zone_state(info[i].state);
+        }
+        *num_desc = num;
+    }
+    free(info);
+    return rc;
+}
+
+/* zones a select all applies to, the action fails on zones in other states */
+static bool
+bdev_zone_selected(uint8_t action, uint8_t state)
+{
+    bool open = state == SPDK_NVME_ZONE_STATE_IOPEN || state == SPDK_NVME_ZONE_STATE_EOPEN;
+
+    switch (action) {
+    case SPDK_NVME_ZONE_OPEN:
+        return state == SPDK_NVME_ZONE_STATE_CLOSED;
+    case SPDK_NVME_ZONE_CLOSE:
+        return open;
+    case SPDK_NVME_ZONE_FINISH:
+        return open || state == SPDK_NVME_ZONE_STATE_CLOSED;
+    case SPDK_NVME_ZONE_RESET:
+        return open || state == SPDK_NVME_ZONE_STATE_CLOSED || state == SPDK_NVME_ZONE_STATE_FULL;
+    case SPDK_NVME_ZONE_OFFLINE:
+        return state == SPDK_NVME_ZONE_STATE_RONLY;
+    default:
+        return false;
+    }
+}
+
+/*
+ * A select all is one command per zone it applies to, completed once all of them completed. Zone
+ * states are read first, like the controller skips the zones a select all does not apply to.
+ */
+static int
+bdev_zone_mgmt(struct replay_qpair *replay_qpair, uint64_t zslba, uint8_t action, bool select_all,
+               spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    struct bdev_qpair *qpair = (struct bdev_qpair *)replay_qpair;
+    enum spdk_bdev_zone_action zone_action;
+
+    switch (action) {
+    case SPDK_NVME_ZONE_OPEN:
+        zone_action = SPDK_BDEV_ZONE_OPEN;
+        break;
+    case SPDK_NVME_ZONE_CLOSE:
+        zone_action = SPDK_BDEV_ZONE_CLOSE;
+        break;
+    case SPDK_NVME_ZONE_FINISH:
+        zone_action = SPDK_BDEV_ZONE_FINISH;
+        break;
+    case SPDK_NVME_ZONE_RESET:
+        zone_action = SPDK_BDEV_ZONE_RESET;
+        break;
+    case SPDK_NVME_ZONE_OFFLINE:
+        zone_action = SPDK_BDEV_ZONE_OFFLINE;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    struct bdev_cmd *cmd = bdev_cmd_get(qpair, cb_fn, cb_arg);
+    if (!cmd) {
+        return -ENOMEM;
+    }
+    struct replay_zone_desc *desc = NULL;
+    if (select_all) {
+        desc = (struct replay_zone_desc *)calloc(BDEV_ZONE_SELECT_MAX, sizeof(struct replay_zone_desc));
+        if (!desc) {
+            bdev_cmd_put(cmd);
+            return -ENOMEM;
+        }
+    }
+    uint64_t first = select_all ? 0 : zslba / g_bdev_geo.zone_sz_blk;
+    uint64_t last = select_all ? g_bdev_geo.num_zone : first + 1;
+    uint64_t num_submit = 0;
+    /* one extra reference so that the command does not complete while submitting */
+    cmd->pending = 1;
+    for (uint64_t zone = first; zone < last; zone++) {
+        if (select_all) {
+            uint32_t num_desc = BDEV_ZONE_SELECT_MAX;
+            if (zone % BDEV_ZONE_SELECT_MAX == 0 &&
+                (bdev_report_zones(replay_qpair, zone * g_bdev_geo.zone_sz_blk, desc, &num_desc) || !num_desc)) {
+                cmd->error = true;
+                break;
+            }
+            if (!bdev_zone_selected(action, desc[zone % BDEV_ZONE_SELECT_MAX].state)) {
+                continue;
+            }
+        }
+        cmd->pending++;
+        if (bdev_submit(qpair, cmd, BDEV_CMD_ZONE_MGMT, NULL, zone * g_bdev_geo.zone_sz_blk, 0, zone_action)) {
+            cmd->pending--;
+            cmd->error = true;
+            break;
+        }
+        num_submit++;
+    }
+    free(desc);
+    if (cmd->error && !num_submit) {
+        bdev_cmd_put(cmd);
+        return -EIO;
+    }
+    /* every zone completed while submitting or none applied, complete on the next poll */
+    if (--cmd->pending == 0 && spdk_thread_send_msg(qpair->thread, bdev_cmd_done, cmd) != 0) {
+        bdev_cmd_put(cmd);
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+const struct replay_backend g_replay_backend_bdev = {
+    .name = "bdev",
+    .open = bdev_open,
+    .close = bdev_close,
+    .alloc_qpair = bdev_alloc_qpair,
+    .free_qpair = bdev_free_qpair,
+    .poll = bdev_poll,
+    .read = bdev_read,
+    .write = bdev_write,
+    .write_zeroes = bdev_write_zeroes,
+    .deallocate = bdev_deallocate,
+    .zone_append = bdev_zone_append,
+    .zone_mgmt = bdev_zone_mgmt,
+    .report_zones = bdev_report_zones,
+};
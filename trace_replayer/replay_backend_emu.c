@@ -0,0 +1,725 @@
+#include "spdk/stdinc.h"
+#include "spdk/env.h"
+#include "spdk/util.h"
+#include "spdk/nvme.h"
+#include "spdk/nvme_spec.h"
+#include "replay_backend.h"
+
+/*
+ * In-memory emulated namespace, conventional or zoned. Zoned namespaces follow the
+ * ZNS zone state machine: writes at the write pointer, implicit and explicit open,
+ * open and active zone limits and the ZNS status codes. Every command completes after
+ * a service time drawn from the latency model of its class. Commands are served by
+ * channels, a command starts when the channel of its LBA is free, which bounds the
+ * parallelism as on a device.
+ *
+ * Target is a comma separated list of key=value, all optional:
+ *   blocks=<n>           size of the namespace in blocks, default 1<<24
+ *   bs=<bytes>           block size, default 4096
+ *   zone=<blocks>        zone size, makes the namespace zoned
+ *   cap=<blocks>         zone capacity, default is the zone size
+ *   open=<n>,active=<n>  max open and active zones, default 0 (no limit)
+ *   ch=<n>               channels, default 8
+ *   stripe=<blocks>      blocks per channel on conventional namespaces, default 64
+ *   rlat=,wlat=,mlat=,olat=<dist>
+ *                        service time of read, write (and append), zone management and
+ *                        other commands (write zeroes, deallocate). <dist> is fixed:<us>,
+ *                        uniform:<min us>:<max us> or exp:<mean us>
+ *   data=1               keep the data in memory, reads return what was written
+ */
+
+#define EMU_NUM_BLK_DEFAULT (1ULL << 24)
+#define EMU_BLOCK_BYTE 4096
+#define EMU_MAX_XFER_BYTE (128 * 1024)
+#define EMU_QUEUE_SIZE 256
+#define EMU_NUM_CH_DEFAULT 8
+#define EMU_STRIPE_BLK_DEFAULT 64
+
+enum emu_dist_type {
+    EMU_DIST_FIXED = 0,
+    EMU_DIST_UNIFORM,
+    EMU_DIST_EXP,
+};
+
+/* service time distribution, in ticks */
+struct emu_dist {
+    enum emu_dist_type type;
+    double a;                   /* fixed value, uniform min or exponential mean */
+    double b;                   /* uniform max */
+};
+
+enum emu_op {
+    EMU_OP_READ = 0,
+    EMU_OP_WRITE,
+    EMU_OP_ZONE_MGMT,
+    EMU_OP_OTHER,
+    EMU_OP_MAX,
+};
+
+struct emu_zone {
+    uint64_t wp;                /* blocks written from zslba */
+    uint8_t  state;             /* enum spdk_nvme_zns_zone_state */
+};
+
+struct emu_cmd {
+    uint64_t done_tsc;
+    spdk_nvme_cmd_cb cb_fn;
+    void *cb_arg;
+    struct spdk_nvme_cpl cpl;
+};
+
+/* commands in flight, a min heap on the completion time */
+struct emu_qpair {
+    struct emu_cmd *heap;
+    uint32_t num;
+    uint32_t size;
+    uint64_t rand;              /* xorshift state of the latency model */
+};
+
+static struct replay_geometry g_emu_geo;
+static uint64_t g_emu_zone_cap = 0;
+static uint32_t g_emu_num_ch = EMU_NUM_CH_DEFAULT;
+static uint64_t g_emu_stripe_blk = EMU_STRIPE_BLK_DEFAULT;
+static struct emu_dist g_emu_dist[EMU_OP_MAX];
+static bool g_emu_keep_data = false;
+/* device state shared by the qpairs, protected by g_emu_lock */
+static pthread_mutex_t g_emu_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct emu_zone *g_emu_zone = NULL;
+static uint64_t *g_emu_ch_free_tsc = NULL; /* time each channel becomes free */
+static uint8_t *g_emu_data = NULL;
+static uint32_t g_emu_num_open = 0;
+static uint32_t g_emu_num_active = 0;
+static uint64_t g_emu_close_cursor = 0;    /* next zone to look at for an implicit close */
+static uint32_t g_emu_qpair_seed = 0;
+
+/* fixed:<us>, uniform:<min us>:<max us> or exp:<mean us> */
+static int
+emu_dist_parse(const char *str, struct emu_dist *dist)
+{
+    double tick_per_us = (double)spdk_get_ticks_hz() / (1000 * 1000);
+    char *end = NULL;
+
+    if (strncmp(str, "fixed:", 6) == 0) {
+        dist->type = EMU_DIST_FIXED;
+        dist->a = strtod(str + 6, &end);
+    } else if (strncmp(str, "uniform:", 8) == 0) {
+        dist->type = EMU_DIST_UNIFORM;
+        dist->a = strtod(str + 8, &end);
+        if (*end != ':') {
+            return 1;
+        }
+        dist->b = strtod(end + 1, &end);
+        if (dist->b < dist->a) {
+            return 1;
+        }
+    } else if (strncmp(str, "exp:", 4) == 0) {
+        dist->type = EMU_DIST_EXP;
+        dist->a = strtod(str + 4, &end);
+    } else {
+        return 1;
+    }
+    if (*end != '\0' || dist->a < 0) {
+        return 1;
+    }
+    dist->a *= tick_per_us;
+    dist->b *= tick_per_us;
+    return 0;
+}
+
+static uint64_t
+emu_dist_sample(const struct emu_dist *dist, uint64_t *rand)
+{
+    double u;
+
+    if (dist->type == EMU_DIST_FIXED) {
+        return (uint64_t)dist->a;
+    }
+    /* xorshift64*, uniform in [0, 1) */
+    *rand ^= *rand >> 12;
+    *rand ^= *rand << 25;
+    *rand ^= *rand >> 27;
+    u = (double)((*rand * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+    if (dist->type == EMU_DIST_UNIFORM) {
+        return (uint64_t)(dist->a + (dist->b - dist->a) * u);
+    }
+    return (uint64_t)(-dist->a * log(1 - u));
+}
+
+static int
+emu_parse(const char *target, struct replay_geometry *geo)
+{
+    static const char *lat_key[EMU_OP_MAX] = {"rlat", "wlat", "mlat", "olat"};
+    char *buf = strdup(target);
+    char *save = NULL;
+    int rc = 0;
+
+    if (!buf) {
+        return 1;
+    }
+    for (char *kv = strtok_r(buf, ",", &save); kv && !rc; kv = strtok_r(NULL, ",", &save)) {
+        char *val = strchr(kv, '=');
+        if (!val) {
+            rc = 1;
+            break;
+        }
+        *val++ = '\0';
+        if (strcmp(kv, "blocks") == 0) {
+            geo->num_blk = strtoull(val, NULL, 0);
+        } else if (strcmp(kv, "bs") == 0) {
+            geo->block_byte = (uint32_t)strtoul(val, NULL, 0);
+        } else if (strcmp(kv, "zone") == 0) {
+            geo->zone_sz_blk = strtoull(val, NULL, 0);
+        } else if (strcmp(kv, "cap") == 0) {
+            g_emu_zone_cap = strtoull(val, NULL, 0);
+        } else if (strcmp(kv, "open") == 0) {
+            geo->max_open_zone = (uint32_t)strtoul(val, NULL, 0);
+        } else if (strcmp(kv, "active") == 0) {
+            geo->max_active_zone = (uint32_t)strtoul(val, NULL, 0);
+        } else if (strcmp(kv, "ch") == 0) {
+            g_emu_num_ch = (uint32_t)strtoul(val, NULL, 0);
+        } else if (strcmp(kv, "stripe") == 0) {
+            g_emu_stripe_blk = strtoull(val, NULL, 0);
+        } else if (strcmp(kv, "data") == 0) {
+            g_emu_keep_data = atoi(val) != 0;
+        } else {
+            uint32_t op;
+            for (op = 0; op < EMU_OP_MAX && strcmp(kv, lat_key[op]) != 0; op++);
+            rc = op == EMU_OP_MAX || emu_dist_parse(val, &g_emu_dist[op]);
+        }
+    }
+    free(buf);
+    return rc;
+}
+
+static int
+emu_open(const char *target, struct replay_geometry *geo)
+{
+    static const char *default_lat[EMU_OP_MAX] = {"fixed:80", "fixed:20", "fixed:10", "fixed:10"};
+
+    memset(geo, 0, sizeof(*geo));
+    geo->nsid = 1;
+    geo->num_blk = EMU_NUM_BLK_DEFAULT;
+    geo->block_byte = EMU_BLOCK_BYTE;
+    geo->max_xfer_byte = EMU_MAX_XFER_BYTE;
+    geo->queue_size = EMU_QUEUE_SIZE;
+    geo->deallocate = true;
+    geo->write_zeroes = true;
+    for (uint32_t op = 0; op < EMU_OP_MAX; op++) {
+        emu_dist_parse(default_lat[op], &g_emu_dist[op]);
+    }
+
+    if (emu_parse(target, geo) || !geo->num_blk || !geo->block_byte || !g_emu_num_ch || !g_emu_stripe_blk) {
+        fprintf(stderr, "Invalid emulated namespace %s\n", target);
+        return 1;
+    }
+    if (geo->zone_sz_blk) {
+        geo->zoned = true;
+        geo->num_zone = geo->num_blk / geo->zone_sz_blk;
+        geo->num_blk = geo->num_zone * geo->zone_sz_blk;
+        geo->max_append_byte = EMU_MAX_XFER_BYTE;
+        g_emu_zone_cap = g_emu_zone_cap ? g_emu_zone_cap : geo->zone_sz_blk;
+        if (!geo->num_zone || g_emu_zone_cap > geo->zone_sz_blk) {
+            fprintf(stderr, "Invalid zone geometry of emulated namespace %s\n", target);
+            return 1;
+        }
+        g_emu_zone = (struct emu_zone *)calloc(geo->num_zone, sizeof(struct emu_zone));
+        if (!g_emu_zone) {
+            fprintf(stderr, "Fail to allocate memory for emulated zones\n");
+            return 1;
+        }
+        for (uint64_t i = 0; i < geo->num_zone; i++) {
+            g_emu_zone[i].state = SPDK_NVME_ZONE_STATE_EMPTY;
+        }
+    }
+    g_emu_ch_free_tsc = (uint64_t *)calloc(g_emu_num_ch, sizeof(uint64_t));
+    if (!g_emu_ch_free_tsc) {
+        fprintf(stderr, "Fail to allocate memory for emulated channels\n");
+        return 1;
+    }
+    if (g_emu_keep_data) {
+        g_emu_data = (uint8_t *)calloc(geo->num_blk, geo->block_byte);
+        if (!g_emu_data) {
+            fprintf(stderr, "Fail to allocate %ju bytes for emulated data\n", geo->num_blk * geo->block_byte);
+            return 1;
+        }
+    }
+    g_emu_num_open = 0;
+    g_emu_num_active = 0;
+    g_emu_geo = *geo;
+    return 0;
+}
+
+static void
+emu_close(void)
+{
+    free(g_emu_zone);
+    free(g_emu_ch_free_tsc);
+    free(g_emu_data);
+    g_emu_zone = NULL;
+    g_emu_ch_free_tsc = NULL;
+    g_emu_data = NULL;
+}
+
+static struct replay_qpair *
+emu_alloc_qpair(uint32_t depth)
+{
+    struct emu_qpair *qpair = (struct emu_qpair *)calloc(1, sizeof(struct emu_qpair));
+
+    if (!qpair) {
+        fprintf(stderr, "Fail to allocate memory for emulated qpair\n");
+        return NULL;
+    }
+    qpair->size = spdk_max(depth, 1);
+    qpair->heap = (struct emu_cmd *)calloc(qpair->size, sizeof(struct emu_cmd));
+    if (!qpair->heap) {
+        fprintf(stderr, "Fail to allocate memory for emulated qpair\n");
+        free(qpair);
+        return NULL;
+    }
+    qpair->rand = 0x9E3779B97F4A7C15ULL * (__atomic_add_fetch(&g_emu_qpair_seed, 1, __ATOMIC_RELAXED));
+    return (struct replay_qpair *)qpair;
+}
+
+static void
+emu_free_qpair(struct replay_qpair *replay_qpair)
+{
+    struct emu_qpair *qpair = (struct emu_qpair *)replay_qpair;
+
+    free(qpair->heap);
+    free(qpair);
+}
+
+static int
+emu_heap_push(struct emu_qpair *qpair, const struct emu_cmd *cmd)
+{
+    if (qpair->num == qpair->size) {
+        struct emu_cmd *heap = (struct emu_cmd *)realloc(qpair->heap, qpair->size * 2 * sizeof(struct emu_cmd));
+        if (!heap) {
+            return -ENOMEM;
+        }
+        qpair->heap = heap;
+        qpair->size *= 2;
+    }
+    uint32_t i = qpair->num++;
+    while (i && qpair->heap[(i - 1) / 2].done_tsc > cmd->done_tsc) {
+        qpair->heap[i] = qpair->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    qpair->heap[i] = *cmd;
+    return 0;
+}
+
+static void
+emu_heap_pop(struct emu_qpair *qpair)
+{
+    struct emu_cmd last = qpair->heap[--qpair->num];
+    uint32_t i = 0;
+
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= qpair->num) {
+            break;
+        }
+        if (child + 1 < qpair->num && qpair->heap[child + 1].done_tsc < qpair->heap[child].done_tsc) {
+            child++;
+        }
+        if (qpair->heap[child].done_tsc >= last.done_tsc) {
+            break;
+        }
+        qpair->heap[i] = qpair->heap[child];
+        i = child;
+    }
+    qpair->heap[i] = last;
+}
+
+static int32_t
+emu_poll(struct replay_qpair *replay_qpair)
+{
+    struct emu_qpair *qpair = (struct emu_qpair *)replay_qpair;
+    uint64_t now = spdk_get_ticks();
+    int32_t num = 0;
+
+    while (qpair->num && qpair->heap[0].done_tsc <= now) {
+        struct emu_cmd cmd = qpair->heap[0];
+        emu_heap_pop(qpair);
+        cmd.cb_fn(cmd.cb_arg, &cmd.cpl);
+        num++;
+    }
+    return num;
+}
+
+static void
+emu_status(struct spdk_nvme_cpl *cpl, uint8_t sct, uint8_t sc)
+{
+    cpl->status.sct = sct;
+    cpl->status.sc = sc;
+}
+
+static bool
+emu_zone_is_open(uint8_t state)
+{
+    return state == SPDK_NVME_ZONE_STATE_IOPEN || state == SPDK_NVME_ZONE_STATE_EOPEN;
+}
+
+static bool
+emu_zone_is_active(uint8_t state)
+{
+    return emu_zone_is_open(state) || state == SPDK_NVME_ZONE_STATE_CLOSED;
+}
+
+/* change the state of a zone and keep the open and active counts */
+static void
+emu_zone_set(uint64_t zone, uint8_t state)
+{
+    struct emu_zone *z = &g_emu_zone[zone];
+
+    g_emu_num_open += (uint32_t)emu_zone_is_open(state) - (uint32_t)emu_zone_is_open(z->state);
+    g_emu_num_active += (uint32_t)emu_zone_is_active(state) - (uint32_t)emu_zone_is_active(z->state);
+    z->state = state;
+}
+
+/* the controller may close an implicitly opened zone to open another one */
+static bool
+emu_zone_close_implicit(void)
+{
+    for (uint64_t i = 0; i < g_emu_geo.num_zone; i++) {
+        uint64_t zone = (g_emu_close_cursor + i) % g_emu_geo.num_zone;
+        if (g_emu_zone[zone].state == SPDK_NVME_ZONE_STATE_IOPEN) {
+            emu_zone_set(zone, SPDK_NVME_ZONE_STATE_CLOSED);
+            g_emu_close_cursor = zone + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* open an empty, closed or open zone within the open and active limits */
+static bool
+emu_zone_open(struct spdk_nvme_cpl *cpl, uint64_t zone, bool explicit)
+{
+    uint8_t state = g_emu_zone[zone].state;
+    uint8_t next = explicit ? SPDK_NVME_ZONE_STATE_EOPEN : SPDK_NVME_ZONE_STATE_IOPEN;
+
+    if (emu_zone_is_open(state)) {
+        if (explicit) {
+            emu_zone_set(zone, next);
+        }
+        return true;
+    }
+    if (state != SPDK_NVME_ZONE_STATE_EMPTY && state != SPDK_NVME_ZONE_STATE_CLOSED) {
+        emu_status(cpl, SPDK_NVME_SCT_COMMAND_SPECIFIC, SPDK_NVME_SC_INVALID_ZONE_STATE_TRANSITION);
+        return false;
+    }
+    if (state == SPDK_NVME_ZONE_STATE_EMPTY && g_emu_geo.max_active_zone &&
+        g_emu_num_active >= g_emu_geo.max_active_zone) {
+        emu_status(cpl, SPDK_NVME_SCT_COMMAND_SPECIFIC, SPDK_NVME_SC_TOO_MANY_ACTIVE_ZONES);
+        return false;
+    }
+    if (g_emu_geo.max_open_zone && g_emu_num_open >= g_emu_geo.max_open_zone && !emu_zone_close_implicit()) {
+        emu_status(cpl, SPDK_NVME_SCT_COMMAND_SPECIFIC, SPDK_NVME_SC_TOO_MANY_OPEN_ZONES);
+        return false;
+    }
+    emu_zone_set(zone, next);
+    return true;
+}
+
+/* write at the write pointer, lba is the zslba for an append and set to the written LBA */
+static bool
+emu_zone_write(struct spdk_nvme_cpl *cpl, uint64_t *lba, uint32_t nlb, bool append)
+{
+    uint64_t zone = *lba / g_emu_geo.zone_sz_blk;
+    uint64_t zslba = zone * g_emu_geo.zone_sz_blk;
+    struct emu_zone *z = &g_emu_zone[zone];
+
+    switch (z->state) {
+    case SPDK_NVME_ZONE_STATE_FULL:
+        emu_status(cpl, SPDK_NVME_SCT_COMMAND_SPECIFIC, SPDK_NVME_SC_ZONE_IS_FULL);
+        return false;
+    case SPDK_NVME_ZONE_STATE_RONLY:
+        emu_status(cpl, SPDK_NVME_SCT_COMMAND_SPECIFIC, SPDK_NVME_SC_ZONE_IS_READ_ONLY);
+        return false;
+    case SPDK_NVME_ZONE_STATE_OFFLINE:
+        emu_status(cpl, SPDK_NVME_SCT_COMMAND_SPECIFIC, SPDK_NVME_SC_ZONE_IS_OFFLINE);
+        return false;
+    default:
+        break;
+    }
+    if (append ? *lba != zslba : *lba != zslba + z->wp) {
+        emu_status(cpl, SPDK_NVME_SCT_COMMAND_SPECIFIC, append ? SPDK_NVME_SC_INVALID_FIELD :
+                   SPDK_NVME_SC_ZONE_INVALID_WRITE);
+        return false;
+    }
+    if (z->wp + nlb > g_emu_zone_cap) {
+        emu_status(cpl, SPDK_NVME_SCT_COMMAND_SPECIFIC, SPDK_NVME_SC_ZONE_BOUNDARY_ERROR);
+        return false;
+    }
+    if (!emu_zone_open(cpl, zone, false)) {
+        return false;
+    }
+    *lba = zslba + z->wp;
+    z->wp += nlb;
+    if (z->wp == g_emu_zone_cap) {
+        emu_zone_set(zone, SPDK_NVME_ZONE_STATE_FULL);
+    }
+    return true;
+}
+
+static void
+emu_zone_data_clear(uint64_t zone)
+{
+    if (g_emu_data) {
+        memset(g_emu_data + zone * g_emu_geo.zone_sz_blk * g_emu_geo.block_byte, 0,
+               g_emu_geo.zone_sz_blk * g_emu_geo.block_byte);
+    }
+}
+
+/* zone management send on one zone, select_all skips zones the action does not apply to */
+static bool
+emu_zone_mgmt_one(struct spdk_nvme_cpl *cpl, uint64_t zone, uint8_t action, bool select_all)
+{
+    uint8_t state = g_emu_zone[zone].state;
+
+    switch (action) {
+    case SPDK_NVME_ZONE_OPEN:
+        if (select_all && state != SPDK_NVME_ZONE_STATE_CLOSED) {
+            return true;
+        }
+        return emu_zone_open(cpl, zone, true);
+    case SPDK_NVME_ZONE_CLOSE:
+        if (emu_zone_is_open(state)) {
+            emu_zone_set(zone, g_emu_zone[zone].wp ? SPDK_NVME_ZONE_STATE_CLOSED : SPDK_NVME_ZONE_STATE_EMPTY);
+            return true;
+        }
+        break;
+    case SPDK_NVME_ZONE_FINISH:
+        if (select_all && !emu_zone_is_active(state)) {
+            return true;
+        }
+        if (emu_zone_is_active(state) || state == SPDK_NVME_ZONE_STATE_EMPTY) {
+            g_emu_zone[zone].wp = g_emu_zone_cap;
+            emu_zone_set(zone, SPDK_NVME_ZONE_STATE_FULL);
+            return true;
+        }
+        break;
+    case SPDK_NVME_ZONE_RESET:
+        if (emu_zone_is_active(state) || state == SPDK_NVME_ZONE_STATE_FULL || state == SPDK_NVME_ZONE_STATE_EMPTY) {
+            if (state != SPDK_NVME_ZONE_STATE_EMPTY) {
+                emu_zone_data_clear(zone);
+            }
+            g_emu_zone[zone].wp = 0;
+            emu_zone_set(zone, SPDK_NVME_ZONE_STATE_EMPTY);
+            return true;
+        }
+        break;
+    case SPDK_NVME_ZONE_OFFLINE:
+        if (state == SPDK_NVME_ZONE_STATE_RONLY) {
+            emu_zone_set(zone, SPDK_NVME_ZONE_STATE_OFFLINE);
+            return true;
+        }
+        break;
+    default:
+        emu_status(cpl, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_INVALID_FIELD);
+        return false;
+    }
+    /* closing a closed zone and finishing a full zone are no-ops */
+    if ((action == SPDK_NVME_ZONE_CLOSE && state == SPDK_NVME_ZONE_STATE_CLOSED) ||
+        (action == SPDK_NVME_ZONE_FINISH && state == SPDK_NVME_ZONE_STATE_FULL) || select_all) {
+        return true;
+    }
+    emu_status(cpl, SPDK_NVME_SCT_COMMAND_SPECIFIC, SPDK_NVME_SC_INVALID_ZONE_STATE_TRANSITION);
+    return false;
+}
+
+static uint32_t
+emu_channel(uint64_t lba)
+{
+    uint64_t unit = g_emu_geo.zoned ? g_emu_geo.zone_sz_blk : g_emu_stripe_blk;
+
+    return (uint32_t)((lba / unit) % g_emu_num_ch);
+}
+
+/* queue the completion of a command after its service time on the channel of lba */
+static int
+emu_complete(struct emu_qpair *qpair, enum emu_op op, uint64_t lba, bool channel, uint64_t now,
+             spdk_nvme_cmd_cb cb_fn, void *cb_arg, const struct spdk_nvme_cpl *cpl)
+{
+    struct emu_cmd cmd;
+    uint64_t service = emu_dist_sample(&g_emu_dist[op], &qpair->rand);
+
+    cmd.cb_fn = cb_fn;
+    cmd.cb_arg = cb_arg;
+    cmd.cpl = *cpl;
+    if (channel) {
+        uint64_t *free_tsc = &g_emu_ch_free_tsc[emu_channel(lba)];
+        cmd.done_tsc = spdk_max(now, *free_tsc) + service;
+        *free_tsc = cmd.done_tsc;
+    } else {
+        cmd.done_tsc = now + service;
+    }
+    return emu_heap_push(qpair, &cmd);
+}
+
+enum emu_cmd_type {
+    EMU_CMD_READ = 0,
+    EMU_CMD_WRITE,
+    EMU_CMD_APPEND,
+    EMU_CMD_WRITE_ZEROES,
+    EMU_CMD_DEALLOCATE,
+};
+
+static int
+emu_io(struct replay_qpair *replay_qpair, enum emu_cmd_type type, void *buf, uint64_t slba, uint32_t nlb,
+       spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    struct emu_qpair *qpair = (struct emu_qpair *)replay_qpair;
+    struct spdk_nvme_cpl cpl;
+    enum emu_op op = type == EMU_CMD_READ ? EMU_OP_READ :
+                     type == EMU_CMD_WRITE || type == EMU_CMD_APPEND ? EMU_OP_WRITE : EMU_OP_OTHER;
+    uint64_t byte = (uint64_t)nlb * g_emu_geo.block_byte;
+    int rc;
+
+    memset(&cpl, 0, sizeof(cpl));
+    pthread_mutex_lock(&g_emu_lock);
+    if (slba + nlb > g_emu_geo.num_blk || slba + nlb < slba) {
+        emu_status(&cpl, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_LBA_OUT_OF_RANGE);
+    } else if (g_emu_geo.zoned && type != EMU_CMD_READ && type != EMU_CMD_DEALLOCATE &&
+               !emu_zone_write(&cpl, &slba, nlb, type == EMU_CMD_APPEND)) {
+        /* status is set by the zone */
+    } else if (g_emu_data) {
+        uint8_t *data = g_emu_data + slba * g_emu_geo.block_byte;
+        switch (type) {
+        case EMU_CMD_READ:
+            memcpy(buf, data, byte);
+            break;
+        case EMU_CMD_WRITE:
+        case EMU_CMD_APPEND:
+            memcpy(data, buf, byte);
+            break;
+        default:
+            memset(data, 0, byte);
+            break;
+        }
+    }
+    if (type == EMU_CMD_APPEND && !spdk_nvme_cpl_is_error(&cpl)) {
+        /* the LBA of an append is returned in dw0 and dw1 */
+        cpl.cdw0 = (uint32_t)slba;
+        cpl.cdw1 = (uint32_t)(slba >> 32);
+    }
+    rc = emu_complete(qpair, op, slba, true, spdk_get_ticks(), cb_fn, cb_arg, &cpl);
+    pthread_mutex_unlock(&g_emu_lock);
+    return rc;
+}
+
+static int
+emu_read(struct replay_qpair *qpair, void *buf, uint64_t slba, uint32_t nlb,
+         spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return emu_io(qpair, EMU_CMD_READ, buf, slba, nlb, cb_fn, cb_arg);
+}
+
+static int
+emu_write(struct replay_qpair *qpair, void *buf, uint64_t slba, uint32_t nlb,
+          spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return emu_io(qpair, EMU_CMD_WRITE, buf, slba, nlb, cb_fn, cb_arg);
+}
+
+static int
+emu_write_zeroes(struct replay_qpair *qpair, uint64_t slba, uint32_t nlb,
+                 spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return emu_io(qpair, EMU_CMD_WRITE_ZEROES, NULL, slba, nlb, cb_fn, cb_arg);
+}
+
+static int
+emu_deallocate(struct replay_qpair *qpair, uint64_t slba, uint32_t nlb,
+               spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return emu_io(qpair, EMU_CMD_DEALLOCATE, NULL, slba, nlb, cb_fn, cb_arg);
+}
+
+static int
+emu_zone_append(struct replay_qpair *qpair, void *buf, uint64_t zslba, uint32_t nlb,
+                spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return emu_io(qpair, EMU_CMD_APPEND, buf, zslba, nlb, cb_fn, cb_arg);
+}
+
+static int
+emu_zone_mgmt(struct replay_qpair *replay_qpair, uint64_t zslba, uint8_t action, bool select_all,
+              spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    struct emu_qpair *qpair = (struct emu_qpair *)replay_qpair;
+    struct spdk_nvme_cpl cpl;
+    uint64_t zone = zslba / g_emu_geo.zone_sz_blk;
+    int rc;
+
+    memset(&cpl, 0, sizeof(cpl));
+    pthread_mutex_lock(&g_emu_lock);
+    if (select_all) {
+        for (uint64_t i = 0; i < g_emu_geo.num_zone && emu_zone_mgmt_one(&cpl, i, action, true); i++);
+    } else if (zone >= g_emu_geo.num_zone || zslba % g_emu_geo.zone_sz_blk) {
+        emu_status(&cpl, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_INVALID_FIELD);
+    } else {
+        emu_zone_mgmt_one(&cpl, zone, action, false);
+    }
+    /* a select all is served by the controller, not by one channel */
+    rc = emu_complete(qpair, EMU_OP_ZONE_MGMT, zslba, !select_all, spdk_get_ticks(), cb_fn, cb_arg, &cpl);
+    pthread_mutex_unlock(&g_emu_lock);
+    return rc;
+}
+
+static int
+emu_report_zones(struct replay_qpair *qpair, uint64_t slba, struct replay_zone_desc *desc,
+                 uint32_t *num_desc)
+{
+    uint64_t zone = slba / g_emu_geo.zone_sz_blk;
+    uint32_t num = 0;
+
+    pthread_mutex_lock(&g_emu_lock);
+    for (; num < *num_desc && zone < g_emu_geo.num_zone; num++, zone++) {
+        desc[num].zslba = zone * g_emu_geo.zone_sz_blk;
+        desc[num].cap = g_emu_zone_cap;
+        desc[num].wp = desc[num].zslba + g_emu_zone[zone].wp;
+        desc[num].state = g_emu_zone[zone].state;
+    }
+    pthread_mutex_unlock(&g_emu_lock);
+    *num_desc = num;
+    return 0;
+}
+
+static void
+emu_print_zones(uint64_t zones_to_print)
+{
+    static const char *state_name[16] = {
+        [SPDK_NVME_ZONE_STATE_EMPTY] = "Empty", [SPDK_NVME_ZONE_STATE_IOPEN] = "Implicit open",
+        [SPDK_NVME_ZONE_STATE_EOPEN] = "Explicit open", [SPDK_NVME_ZONE_STATE_CLOSED] = "Closed",
+        [SPDK_NVME_ZONE_STATE_RONLY] = "Read only", [SPDK_NVME_ZONE_STATE_FULL] = "Full",
+        [SPDK_NVME_ZONE_STATE_OFFLINE] = "Offline",
+    };
+
+    for (uint64_t zone = 0; zone < zones_to_print && zone < g_emu_geo.num_zone; zone++) {
+        uint64_t zslba = zone * g_emu_geo.zone_sz_blk;
+        printf("ZSLBA: 0x%-18" PRIx64 " ZCAP: 0x%-18" PRIx64 " WP: 0x%-18" PRIx64 " ZS: %-20s ZT: %-20s\n",
+               zslba, g_emu_zone_cap, zslba + g_emu_zone[zone].wp, state_name[g_emu_zone[zone].state & 0xF],
+               "SWR");
+    }
+    printf("\n");
+}
+
+const struct replay_backend g_replay_backend_emu = {
+    .name = "emu",
+    .open = emu_open,
+    .close = emu_close,
+    .alloc_qpair = emu_alloc_qpair,
+    .free_qpair = emu_free_qpair,
+    .poll = emu_poll,
+    .read = emu_read,
+    .write = emu_write,
+    .write_zeroes = emu_write_zeroes,
+    .deallocate = emu_deallocate,
+    .zone_append = emu_zone_append,
+    .zone_mgmt = emu_zone_mgmt,
+    .report_zones = emu_report_zones,
+    .print_zones = emu_print_zones,
+};
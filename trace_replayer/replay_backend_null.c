@@ -0,0 +1,205 @@
+#include "spdk/stdinc.h"
+#include "spdk/util.h"
+#include "spdk/nvme.h"
+#include "spdk/nvme_spec.h"
+#include "replay_backend.h"
+
+/*
+ * Null device, every command completes on the next poll without touching data. It
+ * measures the overhead ceiling of the replayer itself.
+ * Target is [<blocks>[:<zone blocks>]], a zone size makes the device zoned.
+ */
+
+#define NULL_NUM_BLK_DEFAULT (1ULL << 31)
+#define NULL_BLOCK_BYTE 4096
+#define NULL_MAX_XFER_BYTE (128 * 1024)
+#define NULL_QUEUE_SIZE 256
+
+struct null_cmd {
+    spdk_nvme_cmd_cb cb_fn;
+    void *cb_arg;
+};
+
+struct null_qpair {
+    struct null_cmd *pend;      /* submitted since the last poll */
+    struct null_cmd *run;       /* completing in the current poll */
+    uint32_t num_pend;
+    uint32_t size;
+};
+
+static struct replay_geometry g_null_geo;
+
+static int
+null_open(const char *target, struct replay_geometry *geo)
+{
+    char *end = NULL;
+
+    memset(geo, 0, sizeof(*geo));
+    geo->nsid = 1;
+    geo->num_blk = NULL_NUM_BLK_DEFAULT;
+    geo->block_byte = NULL_BLOCK_BYTE;
+    geo->max_xfer_byte = NULL_MAX_XFER_BYTE;
+    geo->queue_size = NULL_QUEUE_SIZE;
+    geo->deallocate = true;
+    geo->write_zeroes = true;
+
+    if (target[0]) {
+        geo->num_blk = strtoull(target, &end, 0);
+        if (*end == ':') {
+            geo->zone_sz_blk = strtoull(end + 1, &end, 0);
+        }
+        if (*end != '\0' || !geo->num_blk) {
+            fprintf(stderr, "Invalid null device %s\n", target);
+            return 1;
+        }
+    }
+    if (geo->zone_sz_blk) {
+        geo->zoned = true;
+        geo->num_zone = geo->num_blk / geo->zone_sz_blk;
+        geo->num_blk = geo->num_zone * geo->zone_sz_blk;
+        geo->max_append_byte = NULL_MAX_XFER_BYTE;
+    }
+    g_null_geo = *geo;
+    return 0;
+}
+
+static void
+null_close(void)
+{
+}
+
+static struct replay_qpair *
+null_alloc_qpair(uint32_t depth)
+{
+    struct null_qpair *qpair = (struct null_qpair *)calloc(1, sizeof(struct null_qpair));
+
+    if (!qpair) {
+        fprintf(stderr, "Fail to allocate memory for null qpair\n");
+        return NULL;
+    }
+    qpair->size = spdk_max(depth, 1);
+    qpair->pend = (struct null_cmd *)calloc(qpair->size, sizeof(struct null_cmd));
+    qpair->run = (struct null_cmd *)calloc(qpair->size, sizeof(struct null_cmd));
+    if (!qpair->pend || !qpair->run) {
+        fprintf(stderr, "Fail to allocate memory for null qpair\n");
+        free(qpair->pend);
+        free(qpair->run);
+        free(qpair);
+        return NULL;
+    }
+    return (struct replay_qpair *)qpair;
+}
+
+static void
+null_free_qpair(struct replay_qpair *replay_qpair)
+{
+    struct null_qpair *qpair = (struct null_qpair *)replay_qpair;
+
+    free(qpair->pend);
+    free(qpair->run);
+    free(qpair);
+}
+
+static int
+null_submit(struct replay_qpair *replay_qpair, spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    struct null_qpair *qpair = (struct null_qpair *)replay_qpair;
+
+    if (qpair->num_pend == qpair->size) {
+        /* both buffers keep the same size, so that they can be swapped */
+        uint32_t size = qpair->size * 2;
+        struct null_cmd *pend = (struct null_cmd *)realloc(qpair->pend, size * sizeof(struct null_cmd));
+        if (!pend) {
+            return -ENOMEM;
+        }
+        qpair->pend = pend;
+        struct null_cmd *run = (struct null_cmd *)realloc(qpair->run, size * sizeof(struct null_cmd));
+        if (!run) {
+            return -ENOMEM;
+        }
+        qpair->run = run;
+        qpair->size = size;
+    }
+    qpair->pend[qpair->num_pend].cb_fn = cb_fn;
+    qpair->pend[qpair->num_pend].cb_arg = cb_arg;
+    qpair->num_pend++;
+    return 0;
+}
+
+static int32_t
+null_poll(struct replay_qpair *replay_qpair)
+{
+    struct null_qpair *qpair = (struct null_qpair *)replay_qpair;
+    struct spdk_nvme_cpl cpl;
+
+    /* callbacks may submit again, those complete on the next poll */
+    struct null_cmd *run = qpair->pend;
+    uint32_t num_run = qpair->num_pend;
+    qpair->pend = qpair->run;
+    qpair->run = run;
+    qpair->num_pend = 0;
+
+    replay_backend_cpl(&cpl, true);
+    for (uint32_t i = 0; i < num_run; i++) {
+        run[i].cb_fn(run[i].cb_arg, &cpl);
+    }
+    return (int32_t)num_run;
+}
+
+static int
+null_rw(struct replay_qpair *qpair, void *buf, uint64_t slba, uint32_t nlb,
+        spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    if (slba + nlb > g_null_geo.num_blk) {
+        return -EINVAL;
+    }
+    return null_submit(qpair, cb_fn, cb_arg);
+}
+
+static int
+null_no_data(struct replay_qpair *qpair, uint64_t slba, uint32_t nlb,
+             spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return null_rw(qpair, NULL, slba, nlb, cb_fn, cb_arg);
+}
+
+static int
+null_zone_mgmt(struct replay_qpair *qpair, uint64_t zslba, uint8_t action, bool select_all,
+               spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return null_submit(qpair, cb_fn, cb_arg);
+}
+
+/* zones are always reported empty, the null device keeps no state */
+static int
+null_report_zones(struct replay_qpair *qpair, uint64_t slba, struct replay_zone_desc *desc,
+                  uint32_t *num_desc)
+{
+    uint64_t zone = slba / g_null_geo.zone_sz_blk;
+    uint32_t num = 0;
+
+    for (; num < *num_desc && zone < g_null_geo.num_zone; num++, zone++) {
+        desc[num].zslba = zone * g_null_geo.zone_sz_blk;
+        desc[num].cap = g_null_geo.zone_sz_blk;
+        desc[num].wp = desc[num].zslba;
+        desc[num].state = SPDK_NVME_ZONE_STATE_EMPTY;
+    }
+    *num_desc = num;
+    return 0;
+}
+
+const struct replay_backend g_replay_backend_null = {
+    .name = "null",
+    .open = null_open,
+    .close = null_close,
+    .alloc_qpair = null_alloc_qpair,
+    .free_qpair = null_free_qpair,
+    .poll = null_poll,
+    .read = null_rw,
+    .write = null_rw,
+    .write_zeroes = null_no_data,
+    .deallocate = null_no_data,
+    .zone_append = null_rw,
+    .zone_mgmt = null_zone_mgmt,
+    .report_zones = null_report_zones,
+};
@@ -0,0 +1,490 @@
+#include "spdk/stdinc.h"
+#include "spdk/env.h"
+#include "spdk/util.h"
+#include "spdk/nvme.h"
+#include "spdk/nvme_zns.h"
+#include "spdk/nvme_spec.h"
+#include "replay_backend.h"
+
+/* SPDK NVMe driver on the first namespace of the probed controllers */
+
+struct ctrlr_entry {
+    struct spdk_nvme_ctrlr *ctrlr;
+    TAILQ_ENTRY(ctrlr_entry) link;
+    char name[1024];
+};
+
+struct ns_entry {
+	struct spdk_nvme_ctrlr *ctrlr;
+	struct spdk_nvme_ns	*ns;
+	TAILQ_ENTRY(ns_entry) link;
+};
+
+static TAILQ_HEAD(, ctrlr_entry) g_controllers = TAILQ_HEAD_INITIALIZER(g_controllers);
+static TAILQ_HEAD(, ns_entry) g_namespaces = TAILQ_HEAD_INITIALIZER(g_namespaces);
+static struct spdk_nvme_transport_id g_trid = {};
+static struct ns_entry *g_ns_entry = NULL;
+static size_t g_zdes = 0;                   /* bytes of zone descriptor extension */
+
+static void
+register_ns(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_ns *ns)
+{
+    struct ns_entry *entry;
+
+    if (!spdk_nvme_ns_is_active(ns)) {
+        return;
+    }
+
+    entry = (struct ns_entry *)malloc(sizeof(struct ns_entry));
+    if (entry == NULL) {
+        perror("ns_entry malloc");
+        exit(1);
+    }
+
+    entry->ctrlr = ctrlr;
+    entry->ns = ns;
+    TAILQ_INSERT_TAIL(&g_namespaces, entry, link);
+
+    printf("  Namespace ID: %d size: %juGB\n", spdk_nvme_ns_get_id(ns),
+            spdk_nvme_ns_get_size(ns) / 1000000000);
+}
+
+static bool
+probe_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid,
+     struct spdk_nvme_ctrlr_opts *opts)
+{
+    printf("Attaching to %s\n", trid->traddr);
+
+    return true;
+}
+
+static void
+attach_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid,
+	  struct spdk_nvme_ctrlr *ctrlr, const struct spdk_nvme_ctrlr_opts *opts)
+{
+    int nsid;
+    struct ctrlr_entry *entry;
+    struct spdk_nvme_ns *ns;
+    const struct spdk_nvme_ctrlr_data *cdata;
+
+    /* register ctrlr */
+    entry = (struct ctrlr_entry *)malloc(sizeof(struct ctrlr_entry));
+    if (entry == NULL) {
+        perror("ctrlr_entry malloc");
+        exit(1);
+    }
+
+    printf("Attached to %s\n", trid->traddr);
+
+    cdata = spdk_nvme_ctrlr_get_data(ctrlr);
+
+    snprintf(entry->name, sizeof(entry->name), "%-20.20s (%-20.20s)", cdata->mn, cdata->sn);
+
+    entry->ctrlr = ctrlr;
+    TAILQ_INSERT_TAIL(&g_controllers, entry, link);
+
+    /*
+     * Each controller has one or more namespaces.
+     * Note that in NVMe, namespace IDs start at 1, not 0.
+     */
+    for (nsid = spdk_nvme_ctrlr_get_first_active_ns(ctrlr); nsid != 0;
+        nsid = spdk_nvme_ctrlr_get_next_active_ns(ctrlr, nsid)) {
+        ns = spdk_nvme_ctrlr_get_ns(ctrlr, nsid);
+        if (ns == NULL) {
+            continue;
+        }
+        register_ns(ctrlr, ns);
+    }
+}
+
+static void
+cleanup(void)
+{
+    struct ns_entry *ns_entry, *tmp_ns_entry;
+    struct ctrlr_entry *ctrlr_entry, *tmp_ctrlr_entry;
+    struct spdk_nvme_detach_ctx *detach_ctx = NULL;
+
+    TAILQ_FOREACH_SAFE(ns_entry, &g_namespaces, link, tmp_ns_entry) {
+        TAILQ_REMOVE(&g_namespaces, ns_entry, link);
+        free(ns_entry);
+    }
+
+    TAILQ_FOREACH_SAFE(ctrlr_entry, &g_controllers, link, tmp_ctrlr_entry) {
+        TAILQ_REMOVE(&g_controllers, ctrlr_entry, link);
+        spdk_nvme_detach_async(ctrlr_entry->ctrlr, &detach_ctx);
+        free(ctrlr_entry);
+    }
+
+    if (detach_ctx) {
+        spdk_nvme_detach_poll(detach_ctx);
+    }
+    g_ns_entry = NULL;
+}
+
+static void
+nvme_admin_done(void *cb_arg, const struct spdk_nvme_cpl *cpl)
+{
+    *(int *)cb_arg = spdk_nvme_cpl_is_error(cpl) ? 1 : 0;
+}
+
+/* WZSL of the NVM command set identify controller data, 0 if not reported */
+static uint64_t
+nvme_max_write_zeroes_blk(struct spdk_nvme_ctrlr *ctrlr, uint32_t block_byte)
+{
+    struct spdk_nvme_cmd cmd;
+    uint64_t max_blk = 0;
+    int rc = -1;
+
+    struct spdk_nvme_nvm_ctrlr_data *nvm = (struct spdk_nvme_nvm_ctrlr_data *)spdk_zmalloc(sizeof(*nvm), 4096,
+                                           NULL, SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
+    if (!nvm) {
+        return 0;
+    }
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opc = SPDK_NVME_OPC_IDENTIFY;
+    cmd.cdw10_bits.identify.cns = SPDK_NVME_IDENTIFY_CTRLR_IOCS;
+    cmd.cdw11_bits.identify.csi = SPDK_NVME_CSI_NVM;
+    if (spdk_nvme_ctrlr_cmd_admin_raw(ctrlr, &cmd, nvm, sizeof(*nvm), nvme_admin_done, &rc) == 0) {
+        while (rc < 0) {
+            spdk_nvme_ctrlr_process_admin_completions(ctrlr);
+        }
+        /* in units of the minimum memory page size */
+        if (rc == 0 && nvm->wzsl) {
+            union spdk_nvme_cap_register cap = spdk_nvme_ctrlr_get_regs_cap(ctrlr);
+            max_blk = ((uint64_t)1 << (12 + cap.bits.mpsmin + nvm->wzsl)) / block_byte;
+        }
+    }
+    spdk_free(nvm);
+    return max_blk;
+}
+
+/* target is an optional transport id, e.g. "trtype:PCIe traddr:0000:01:00.0" */
+static int
+nvme_open(const char *target, struct replay_geometry *geo)
+{
+    spdk_nvme_trid_populate_transport(&g_trid, SPDK_NVME_TRANSPORT_PCIE);
+    snprintf(g_trid.subnqn, sizeof(g_trid.subnqn), "%s", SPDK_NVMF_DISCOVERY_NQN);
+    if (target[0] && spdk_nvme_transport_id_parse(&g_trid, target) != 0) {
+        fprintf(stderr, "Invalid transport id %s\n", target);
+        return 1;
+    }
+
+    /* Register ctrlr & ns */
+    printf("Initializing NVMe Controllers\n");
+
+    if (spdk_nvme_probe(&g_trid, NULL, probe_cb, attach_cb, NULL) != 0) {
+        fprintf(stderr, "spdk_nvme_probe() failed\n");
+        cleanup();
+        return 1;
+    }
+    if (TAILQ_EMPTY(&g_controllers) || TAILQ_EMPTY(&g_namespaces)) {
+        fprintf(stderr, "no NVMe controllers found\n");
+        cleanup();
+        return 1;
+    }
+    printf("Initialization complete.\n");
+
+    g_ns_entry = TAILQ_FIRST(&g_namespaces);
+    struct spdk_nvme_ns *ns = g_ns_entry->ns;
+    struct spdk_nvme_io_qpair_opts qpair_opts;
+    spdk_nvme_ctrlr_get_default_io_qpair_opts(g_ns_entry->ctrlr, &qpair_opts, sizeof(qpair_opts));
+    uint32_t flags = spdk_nvme_ns_get_flags(ns);
+
+    memset(geo, 0, sizeof(*geo));
+    geo->nsid = spdk_nvme_ns_get_id(ns);
+    geo->num_blk = spdk_nvme_ns_get_num_sectors(ns);
+    geo->block_byte = spdk_nvme_ns_get_sector_size(ns);
+    geo->max_xfer_byte = spdk_nvme_ns_get_max_io_xfer_size(ns);
+    geo->queue_size = qpair_opts.io_queue_size;
+    geo->deallocate = (flags & SPDK_NVME_NS_DEALLOCATE_SUPPORTED) != 0;
+    geo->write_zeroes = (flags & SPDK_NVME_NS_WRITE_ZEROES_SUPPORTED) != 0;
+    if (geo->write_zeroes) {
+        geo->max_write_zeroes_blk = nvme_max_write_zeroes_blk(g_ns_entry->ctrlr, geo->block_byte);
+    }
+    if (spdk_nvme_ns_get_csi(ns) == SPDK_NVME_CSI_ZNS) {
+        const struct spdk_nvme_ns_data *nsdata = spdk_nvme_ns_get_data(ns);
+        const struct spdk_nvme_zns_ns_data *nsdata_zns = spdk_nvme_zns_ns_get_data(ns);
+
+        geo->zoned = true;
+        geo->num_zone = spdk_nvme_zns_ns_get_num_zones(ns);
+        geo->zone_sz_blk = spdk_nvme_zns_ns_get_zone_size_sectors(ns);
+        geo->max_append_byte = spdk_nvme_zns_ctrlr_get_max_zone_append_size(g_ns_entry->ctrlr);
+        geo->max_open_zone = spdk_nvme_zns_ns_get_max_open_zones(ns);
+        geo->max_active_zone = spdk_nvme_zns_ns_get_max_active_zones(ns);
+        g_zdes = nsdata_zns->lbafe[spdk_nvme_ns_get_format_index(nsdata)].zdes * 64;
+    }
+    return 0;
+}
+
+static void
+nvme_close(void)
+{
+    cleanup();
+}
+
+static struct replay_qpair *
+nvme_alloc_qpair(uint32_t depth)
+{
+    struct spdk_nvme_qpair *qpair = spdk_nvme_ctrlr_alloc_io_qpair(g_ns_entry->ctrlr, NULL, 0);
+
+    if (qpair == NULL) {
+        printf("ERROR: spdk_nvme_ctrlr_alloc_io_qpair() failed\n");
+    }
+    return (struct replay_qpair *)qpair;
+}
+
+static void
+nvme_free_qpair(struct replay_qpair *qpair)
+{
+    spdk_nvme_ctrlr_free_io_qpair((struct spdk_nvme_qpair *)qpair);
+}
+
+static int32_t
+nvme_poll(struct replay_qpair *qpair)
+{
+    return spdk_nvme_qpair_process_completions((struct spdk_nvme_qpair *)qpair, 0);
+}
+
+static int
+nvme_read(struct replay_qpair *qpair, void *buf, uint64_t slba, uint32_t nlb,
+          spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return spdk_nvme_ns_cmd_read(g_ns_entry->ns, (struct spdk_nvme_qpair *)qpair, buf, slba, nlb,
+                                 cb_fn, cb_arg, 0);
+}
+
+static int
+nvme_write(struct replay_qpair *qpair, void *buf, uint64_t slba, uint32_t nlb,
+           spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return spdk_nvme_ns_cmd_write(g_ns_entry->ns, (struct spdk_nvme_qpair *)qpair, buf, slba, nlb,
+                                  cb_fn, cb_arg, 0);
+}
+
+static int
+nvme_write_zeroes(struct replay_qpair *qpair, uint64_t slba, uint32_t nlb,
+                  spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return spdk_nvme_ns_cmd_write_zeroes(g_ns_entry->ns, (struct spdk_nvme_qpair *)qpair, slba, nlb,
+                                         cb_fn, cb_arg, 0);
+}
+
+static int
+nvme_deallocate(struct replay_qpair *qpair, uint64_t slba, uint32_t nlb,
+                spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    struct spdk_nvme_dsm_range range;
+
+    /* the range is copied into the command payload on submit */
+    memset(&range, 0, sizeof(range));
+    range.starting_lba = slba;
+    range.length = nlb;
+    return spdk_nvme_ns_cmd_dataset_management(g_ns_entry->ns, (struct spdk_nvme_qpair *)qpair,
+                                               SPDK_NVME_DSM_ATTR_DEALLOCATE, &range, 1, cb_fn, cb_arg);
+}
+
+static int
+nvme_zone_append(struct replay_qpair *qpair, void *buf, uint64_t zslba, uint32_t nlb,
+                 spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return spdk_nvme_zns_zone_append(g_ns_entry->ns, (struct spdk_nvme_qpair *)qpair, buf, zslba, nlb,
+                                     cb_fn, cb_arg, 0);
+}
+
+static int
+nvme_zone_mgmt(struct replay_qpair *qpair, uint64_t zslba, uint8_t action, bool select_all,
+               spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    struct spdk_nvme_ns *ns = g_ns_entry->ns;
+    struct spdk_nvme_qpair *nvme_qpair = (struct spdk_nvme_qpair *)qpair;
+
+    switch (action) {
+    case SPDK_NVME_ZONE_OPEN:
+        return spdk_nvme_zns_open_zone(ns, nvme_qpair, zslba, select_all, cb_fn, cb_arg);
+    case SPDK_NVME_ZONE_CLOSE:
+        return spdk_nvme_zns_close_zone(ns, nvme_qpair, zslba, select_all, cb_fn, cb_arg);
+    case SPDK_NVME_ZONE_FINISH:
+        return spdk_nvme_zns_finish_zone(ns, nvme_qpair, zslba, select_all, cb_fn, cb_arg);
+    case SPDK_NVME_ZONE_RESET:
+        return spdk_nvme_zns_reset_zone(ns, nvme_qpair, zslba, select_all, cb_fn, cb_arg);
+    case SPDK_NVME_ZONE_OFFLINE:
+        return spdk_nvme_zns_offline_zone(ns, nvme_qpair, zslba, select_all, cb_fn, cb_arg);
+    default:
+        return -EINVAL;
+    }
+}
+
+static void
+zone_report_completion(void *cb_arg, const struct spdk_nvme_cpl *cpl)
+{
+    int *rc = (int *)cb_arg;
+
+    if (spdk_nvme_cpl_is_error(cpl)) {
+        fprintf(stderr, "Zone report error - status = %s\n", spdk_nvme_cpl_get_status_string(&cpl->status));
+        *rc = 1;
+        return;
+    }
+    *rc = 0;
+}
+
+/* report zones into buf and wait for it */
+static int
+nvme_report_zones_buf(struct spdk_nvme_qpair *qpair, uint8_t *buf, size_t buf_byte, uint64_t slba)
+{
+    int rc = -1;
+    int err;
+
+    memset(buf, 0, buf_byte);
+    if (g_zdes) {
+        err = spdk_nvme_zns_ext_report_zones(g_ns_entry->ns, qpair, buf, buf_byte, slba,
+                                             SPDK_NVME_ZRA_LIST_ALL, true, zone_report_completion, &rc);
+    } else {
+        err = spdk_nvme_zns_report_zones(g_ns_entry->ns, qpair, buf, buf_byte, slba,
+                                         SPDK_NVME_ZRA_LIST_ALL, true, zone_report_completion, &rc);
+    }
+    if (err) {
+        fprintf(stderr, "Report zones failed\n");
+        return err;
+    }
+    while (rc < 0) {
+        spdk_nvme_qpair_process_completions(qpair, 0);
+    }
+    return rc;
+}
+
+static int
+nvme_report_zones(struct replay_qpair *qpair, uint64_t slba, struct replay_zone_desc *desc,
+                  uint32_t *num_desc)
+{
+    uint32_t zrs = sizeof(struct spdk_nvme_zns_zone_report);
+    uint32_t zds = sizeof(struct spdk_nvme_zns_zone_desc) + g_zdes;
+    size_t buf_byte = spdk_min(spdk_nvme_ns_get_max_io_xfer_size(g_ns_entry->ns), zrs + (size_t)*num_desc * zds);
+    uint8_t *buf = (uint8_t *)calloc(1, buf_byte);
+
+    if (!buf) {
+        fprintf(stderr, "Zone report allocation failed!\n");
+        return 1;
+    }
+    int rc = nvme_report_zones_buf((struct spdk_nvme_qpair *)qpair, buf, buf_byte, slba);
+    if (!rc) {
+        uint64_t nr_zones = spdk_min(((struct spdk_nvme_zns_zone_report *)buf)->nr_zones, (uint64_t)*num_desc);
+        for (uint64_t i = 0; i < nr_zones; i++) {
+            struct spdk_nvme_zns_zone_desc *d = (struct spdk_nvme_zns_zone_desc *)(buf + zrs + i * zds);
+            desc[i].zslba = d->zslba;
+            desc[i].cap = d->zcap;
+            desc[i].wp = d->wp;
+            desc[i].state = d->zs;
+        }
+        *num_desc = (uint32_t)nr_zones;
+    }
+    free(buf);
+    return rc;
+}
+
+static void print_zns_zone(uint8_t *report, uint32_t index, uint32_t zdes)
+{
+    uint32_t zrs = sizeof(struct spdk_nvme_zns_zone_report);
+    uint32_t zds = sizeof(struct spdk_nvme_zns_zone_desc);
+    uint32_t zd_index = zrs + index * (zds + zdes);
+    struct spdk_nvme_zns_zone_desc *desc = (struct spdk_nvme_zns_zone_desc *)(report + zd_index);
+
+    printf("ZSLBA: 0x%-18" PRIx64 " ZCAP: 0x%-18" PRIx64 " WP: 0x%-18" PRIx64 " ZS: ", desc->zslba,
+           desc->zcap, desc->wp);
+    switch (desc->zs)
+    {
+    case SPDK_NVME_ZONE_STATE_EMPTY:
+        printf("%-20s", "Empty");
+        break;
+    case SPDK_NVME_ZONE_STATE_IOPEN:
+        printf("%-20s", "Implicit open");
+        break;
+    case SPDK_NVME_ZONE_STATE_EOPEN:
+        printf("%-20s", "Explicit open");
+        break;
+    case SPDK_NVME_ZONE_STATE_CLOSED:
+        printf("%-20s", "Closed");
+        break;
+    case SPDK_NVME_ZONE_STATE_RONLY:
+        printf("%-20s", "Read only");
+        break;
+    case SPDK_NVME_ZONE_STATE_FULL:
+        printf("%-20s", "Full");
+        break;
+    case SPDK_NVME_ZONE_STATE_OFFLINE:
+        printf("%-20s", "Offline");
+        break;
+    default:
+        printf("%-20s", "Reserved");
+    }
+    printf(" ZT: %-20s", (desc->zt == SPDK_NVME_ZONE_TYPE_SEQWR) ? "SWR" : "Reserved");
+    // printf(" ZA: 0x%-18x\n", desc->za.raw);
+    printf("\n");
+
+    if (!desc->za.bits.zdev) {
+        return;
+    }
+    for (int i = 0; i < (int)zdes; i += 8) {
+        printf("zone_desc_ext[%d] : 0x%" PRIx64 "\n", i,
+               *(uint64_t *)(report + zd_index + zds + i));
+    }
+}
+
+static void
+nvme_print_zones(uint64_t zones_to_print)
+{
+    uint64_t zone_size_lba = spdk_nvme_zns_ns_get_zone_size_sectors(g_ns_entry->ns);
+    struct spdk_nvme_qpair *qpair;
+
+    /* specify namespace and allocate io qpair for the namespace */
+    qpair = spdk_nvme_ctrlr_alloc_io_qpair(g_ns_entry->ctrlr, NULL, 0);
+    if (qpair == NULL) {
+        printf("ERROR: spdk_nvme_ctrlr_alloc_io_qpair() failed\n");
+        return;
+    }
+
+    size_t report_bufsize = spdk_nvme_ns_get_max_io_xfer_size(g_ns_entry->ns);
+    uint8_t *report_buf = calloc(1, report_bufsize);
+    if (!report_buf) {
+        printf("Zone report allocation failed!\n");
+        exit(1);
+    }
+
+    uint64_t handled_zones = 0;
+    uint64_t slba = 0;
+    while (handled_zones < zones_to_print) {
+        if (nvme_report_zones_buf(qpair, report_buf, report_bufsize, slba)) {
+            break;
+        }
+
+        uint64_t nr_zones = ((struct spdk_nvme_zns_zone_report *)report_buf)->nr_zones;
+        if (nr_zones == 0) {
+            break;
+        }
+        for (uint64_t i = 0; i < nr_zones && handled_zones < zones_to_print; i++) {
+            print_zns_zone(report_buf, i, g_zdes);
+            slba += zone_size_lba;
+            handled_zones++;
+        }
+        printf("\n");
+    }
+
+    free(report_buf);
+    spdk_nvme_ctrlr_free_io_qpair(qpair);
+}
+
+const struct replay_backend g_replay_backend_nvme = {
+    .name = "nvme",
+    .open = nvme_open,
+    .close = nvme_close,
+    .alloc_qpair = nvme_alloc_qpair,
+    .free_qpair = nvme_free_qpair,
+    .poll = nvme_poll,
+    .read = nvme_read,
+    .write = nvme_write,
+    .write_zeroes = nvme_write_zeroes,
+    .deallocate = nvme_deallocate,
+    .zone_append = nvme_zone_append,
+    .zone_mgmt = nvme_zone_mgmt,
+    .report_zones = nvme_report_zones,
+    .print_zones = nvme_print_zones,
+};
@@ -0,0 +1,791 @@
+#include "spdk/stdinc.h"
+#include "spdk/config.h"
+#include "spdk/util.h"
+#include "spdk/nvme.h"
+#include "spdk/nvme_spec.h"
+#include "replay_backend.h"
+
+/*
+ * Linux io_uring on a block device or a regular file, opened with O_DIRECT. Zoned
+ * block devices are driven with the blkzoned ioctls; zone append is emulated by a
+ * write at the write pointer kept by the backend, one at a time per zone, an append
+ * to a busy zone waits on the qpair and is issued by a later poll. Discard, zero
+ * range and zone management block in the kernel, they run one at a time on an ioctl
+ * thread shared by all qpairs and are reported by the next poll after they return.
+ *
+ * Zone geometry comes from BLKREPORTZONE and the queue limits from sysfs, so zoned
+ * null_blk and zoned loop devices stand in for a ZNS SSD, e.g.
+ *   modprobe null_blk nr_devices=1 zoned=1 zone_size=64 zone_capacity=48 \
+ *       zone_max_open=14 zone_max_active=14 memory_backed=1
+ */
+
+#ifdef SPDK_CONFIG_URING
+
+#include <liburing.h>
+#include <sys/sysmacros.h>
+#include <linux/fs.h>
+#include <linux/blkzoned.h>
+
+#define URING_FILE_BLOCK_BYTE 4096
+#define URING_MAX_XFER_BYTE (128 * 1024)
+#define URING_QUEUE_SIZE 256
+#define URING_SECTOR_SHIFT 9
+#define URING_REPORT_ZONE_MAX 1024
+
+enum uring_ioctl_op {
+    URING_IOCTL_DISCARD = 0,
+    URING_IOCTL_ZEROES,
+    URING_IOCTL_ZONE_MGMT,
+};
+
+struct uring_qpair;
+
+struct uring_cmd {
+    spdk_nvme_cmd_cb cb_fn;
+    void *cb_arg;
+    uint32_t len;               /* expected bytes, 0 for commands without data */
+    int res;                    /* result of a command run on the ioctl thread */
+    uint64_t zone;              /* zone of a write on a zoned device, UINT64_MAX for other commands */
+    uint64_t slba;
+    bool append;                /* emulated zone append, holds the zone until it completes */
+    void *buf;                  /* data of an append waiting for its zone */
+    uint32_t nlb;
+    struct uring_qpair *qpair;
+    enum uring_ioctl_op op;     /* command run on the ioctl thread */
+    uint64_t range[2];          /* byte offset and length, or the first and the last zone */
+    unsigned long zone_req;
+    uint8_t zone_action;
+    struct uring_cmd *next;
+};
+
+struct uring_qpair {
+    struct io_uring ring;
+    struct uring_cmd *cmds;
+    struct uring_cmd *free;
+    struct uring_cmd *done;     /* commands the ioctl thread completed, newest first */
+    struct uring_cmd *append;   /* appends waiting for their zone, in submit order */
+    struct uring_cmd *append_tail;
+    uint32_t num_queued;        /* sqes not submitted yet */
+};
+
+static int g_fd = -1;
+static bool g_blkdev = false;
+static dev_t g_rdev;
+static struct replay_geometry g_uring_geo;
+static uint64_t *g_zone_wp = NULL;  /* write pointer of each zone for emulated zone append */
+static bool *g_zone_append = NULL;  /* an emulated zone append is in flight on the zone */
+
+static pthread_t g_ioctl_thread;
+static bool g_ioctl_started = false;
+static bool g_ioctl_stop = false;
+static pthread_mutex_t g_ioctl_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_ioctl_cond = PTHREAD_COND_INITIALIZER;
+static struct uring_cmd *g_ioctl_head = NULL;
+static struct uring_cmd *g_ioctl_tail = NULL;
+
+static int
+uring_zone_report(uint64_t slba, struct blk_zone_report *report, uint32_t nr_zones)
+{
+    memset(report, 0, sizeof(*report) + nr_zones * sizeof(struct blk_zone));
+    report->sector = (slba * g_uring_geo.block_byte) >> URING_SECTOR_SHIFT;
+    report->nr_zones = nr_zones;
+    if (ioctl(g_fd, BLKREPORTZONE, report) != 0) {
+        fprintf(stderr, "BLKREPORTZONE failed: %s\n", strerror(errno));
+        return 1;
+    }
+    return 0;
+}
+
+static uint64_t
+uring_sector_to_blk(uint64_t sector)
+{
+    return (sector << URING_SECTOR_SHIFT) / g_uring_geo.block_byte;
+}
+
+/* queue attribute of the block device in sysfs, 0 if it does not exist */
+static uint64_t
+uring_sysfs_queue(const char *attr)
+{
+    char path[128];
+    uint64_t val = 0;
+
+    snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/queue/%s", major(g_rdev), minor(g_rdev), attr);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return 0;
+    }
+    if (fscanf(f, "%" SCNu64, &val) != 1) {
+        val = 0;
+    }
+    fclose(f);
+    return val;
+}
+
+/* zone capacity is only reported by kernels that set BLK_ZONE_REP_CAPACITY */
+static uint64_t
+uring_zone_cap(const struct blk_zone_report *report, const struct blk_zone *zone)
+{
+#ifdef BLK_ZONE_REP_CAPACITY
+    if (report->flags & BLK_ZONE_REP_CAPACITY) {
+        return uring_sector_to_blk(zone->capacity);
+    }
+#endif
+    return uring_sector_to_blk(zone->len);
+}
+
+/* zone geometry, zone limits and the write pointers of a zoned block device */
+static int
+uring_open_zoned(struct replay_geometry *geo)
+{
+    uint32_t zone_sectors = 0, nr_zones = 0;
+
+    if (ioctl(g_fd, BLKGETZONESZ, &zone_sectors) != 0 || zone_sectors == 0) {
+        return 0;
+    }
+    if (ioctl(g_fd, BLKGETNRZONES, &nr_zones) != 0) {
+        fprintf(stderr, "BLKGETNRZONES failed: %s\n", strerror(errno));
+        return 1;
+    }
+    geo->zoned = true;
+    geo->num_zone = nr_zones;
+    geo->zone_sz_blk = uring_sector_to_blk(zone_sectors);
+    geo->max_open_zone = (uint32_t)uring_sysfs_queue("max_open_zones");
+    geo->max_active_zone = (uint32_t)uring_sysfs_queue("max_active_zones");
+    /* appends are emulated by writes, the kernel limit applies to in-kernel appends only */
+    uint64_t append_byte = uring_sysfs_queue("zone_append_max_bytes");
+    geo->max_append_byte = append_byte ? (uint32_t)spdk_min(append_byte, (uint64_t)geo->max_xfer_byte) :
+                           geo->max_xfer_byte;
+    g_uring_geo = *geo;
+
+    g_zone_wp = (uint64_t *)calloc(nr_zones, sizeof(uint64_t));
+    g_zone_append = (bool *)calloc(nr_zones, sizeof(bool));
+    struct blk_zone_report *report = (struct blk_zone_report *)calloc(1, sizeof(struct blk_zone_report) +
+                                     URING_REPORT_ZONE_MAX * sizeof(struct blk_zone));
+    if (!g_zone_wp || !g_zone_append || !report) {
+        fprintf(stderr, "Fail to allocate memory for zone report\n");
+        free(report);
+        return 1;
+    }
+    for (uint64_t zone = 0; zone < nr_zones;) {
+        if (uring_zone_report(zone * geo->zone_sz_blk, report, URING_REPORT_ZONE_MAX) || !report->nr_zones) {
+            free(report);
+            return 1;
+        }
+        for (uint32_t i = 0; i < report->nr_zones && zone < nr_zones; i++, zone++) {
+            g_zone_wp[zone] = uring_sector_to_blk(report->zones[i].wp);
+        }
+    }
+    free(report);
+    return 0;
+}
+
+/* report the command on the next poll of its qpair, which reverses the list */
+static void
+uring_cmd_done(struct uring_cmd *cmd, int res)
+{
+    struct uring_qpair *qpair = cmd->qpair;
+    struct uring_cmd *done = __atomic_load_n(&qpair->done, __ATOMIC_RELAXED);
+
+    cmd->res = res;
+    do {
+        cmd->next = done;
+    } while (!__atomic_compare_exchange_n(&qpair->done, &done, cmd, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* run a command that blocks, on the ioctl thread */
+static int
+uring_ioctl_run(struct uring_cmd *cmd)
+{
+    int res;
+
+    if (cmd->op == URING_IOCTL_ZONE_MGMT) {
+        uint64_t zone_sectors = (g_uring_geo.zone_sz_blk * g_uring_geo.block_byte) >> URING_SECTOR_SHIFT;
+        uint64_t first = cmd->range[0], last = cmd->range[1];
+        struct blk_zone_range range;
+        range.sector = first * zone_sectors;
+        /* the last zone may be smaller, a range of the whole device also skips conventional zones */
+        range.nr_sectors = spdk_min((last - first) * zone_sectors,
+                                    ((g_uring_geo.num_blk * g_uring_geo.block_byte) >> URING_SECTOR_SHIFT) - range.sector);
+        res = ioctl(g_fd, cmd->zone_req, &range);
+        if (res == 0 && (cmd->zone_action == SPDK_NVME_ZONE_RESET || cmd->zone_action == SPDK_NVME_ZONE_FINISH)) {
+            for (uint64_t zone = first; zone < last; zone++) {
+                __atomic_store_n(&g_zone_wp[zone], zone * g_uring_geo.zone_sz_blk +
+                                 (cmd->zone_action == SPDK_NVME_ZONE_FINISH ? g_uring_geo.zone_sz_blk : 0),
+                                 __ATOMIC_RELAXED);
+            }
+        }
+    } else if (g_blkdev) {
+        res = ioctl(g_fd, cmd->op == URING_IOCTL_ZEROES ? BLKZEROOUT : BLKDISCARD, cmd->range);
+    } else {
+        res = fallocate(g_fd, cmd->op == URING_IOCTL_ZEROES ? FALLOC_FL_ZERO_RANGE :
+                        FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)cmd->range[0], (off_t)cmd->range[1]);
+    }
+    return res < 0 ? -errno : 0;
+}
+
+static void *
+uring_ioctl_thread(void *arg)
+{
+    pthread_mutex_lock(&g_ioctl_lock);
+    while (true) {
+        while (!g_ioctl_head && !g_ioctl_stop) {
+            pthread_cond_wait(&g_ioctl_cond, &g_ioctl_lock);
+        }
+        struct uring_cmd *cmd = g_ioctl_head;
+        if (!cmd) {
+            break;
+        }
+        g_ioctl_head = cmd->next;
+        if (!g_ioctl_head) {
+            g_ioctl_tail = NULL;
+        }
+        pthread_mutex_unlock(&g_ioctl_lock);
+
+        uring_cmd_done(cmd, uring_ioctl_run(cmd));
+        pthread_mutex_lock(&g_ioctl_lock);
+    }
+    pthread_mutex_unlock(&g_ioctl_lock);
+    return NULL;
+}
+
+/* target is the path of a block device or a regular file */
+static int
+uring_open(const char *target, struct replay_geometry *geo)
+{
+    struct stat st;
+
+    g_fd = open(target, O_RDWR | O_DIRECT);
+    if (g_fd < 0 || fstat(g_fd, &st) != 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", target, strerror(errno));
+        return 1;
+    }
+
+    memset(geo, 0, sizeof(*geo));
+    geo->nsid = 1;
+    geo->max_xfer_byte = URING_MAX_XFER_BYTE;
+    geo->queue_size = URING_QUEUE_SIZE;
+    geo->deallocate = true;
+    geo->write_zeroes = true;
+    g_blkdev = S_ISBLK(st.st_mode);
+    if (g_blkdev) {
+        uint64_t byte = 0;
+        int block_byte = 0;
+        if (ioctl(g_fd, BLKGETSIZE64, &byte) != 0 || ioctl(g_fd, BLKSSZGET, &block_byte) != 0) {
+            fprintf(stderr, "Fail to get the size of %s: %s\n", target, strerror(errno));
+            return 1;
+        }
+        geo->block_byte = (uint32_t)block_byte;
+        geo->num_blk = byte / geo->block_byte;
+        g_rdev = st.st_rdev;
+        uint64_t max_sectors_kb = uring_sysfs_queue("max_sectors_kb");
+        if (max_sectors_kb) {
+            geo->max_xfer_byte = (uint32_t)spdk_min(max_sectors_kb * 1024, (uint64_t)UINT32_MAX / 2);
+        }
+        uint64_t nr_requests = uring_sysfs_queue("nr_requests");
+        if (nr_requests) {
+            geo->queue_size = (uint32_t)nr_requests;
+        }
+    } else {
+        geo->block_byte = URING_FILE_BLOCK_BYTE;
+        geo->num_blk = (uint64_t)st.st_size / geo->block_byte;
+    }
+    g_uring_geo = *geo;
+    if (g_blkdev && uring_open_zoned(geo)) {
+        return 1;
+    }
+    g_ioctl_stop = false;
+    if (pthread_create(&g_ioctl_thread, NULL, uring_ioctl_thread, NULL) != 0) {
+        fprintf(stderr, "Failed to create the ioctl thread\n");
+        return 1;
+    }
+    g_ioctl_started = true;
+    return 0;
+}
+
+static void
+uring_close(void)
+{
+    if (g_ioctl_started) {
+        pthread_mutex_lock(&g_ioctl_lock);
+        g_ioctl_stop = true;
+        pthread_cond_signal(&g_ioctl_cond);
+        pthread_mutex_unlock(&g_ioctl_lock);
+        pthread_join(g_ioctl_thread, NULL);
+        g_ioctl_started = false;
+    }
+    if (g_fd >= 0) {
+        close(g_fd);
+        g_fd = -1;
+    }
+    free(g_zone_wp);
+    g_zone_wp = NULL;
+    free(g_zone_append);
+    g_zone_append = NULL;
+}
+
+static struct replay_qpair *
+uring_alloc_qpair(uint32_t depth)
+{
+    struct uring_qpair *qpair = (struct uring_qpair *)calloc(1, sizeof(struct uring_qpair));
+    int rc;
+
+    if (!qpair) {
+        fprintf(stderr, "Fail to allocate memory for io_uring qpair\n");
+        return NULL;
+    }
+    depth = spdk_max(depth, 1);
+    qpair->cmds = (struct uring_cmd *)calloc(depth, sizeof(struct uring_cmd));
+    if (!qpair->cmds) {
+        fprintf(stderr, "Fail to allocate memory for io_uring qpair\n");
+        free(qpair);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < depth; i++) {
+        qpair->cmds[i].next = qpair->free;
+        qpair->free = &qpair->cmds[i];
+    }
+    rc = io_uring_queue_init(depth, &qpair->ring, 0);
+    if (rc != 0) {
+        fprintf(stderr, "io_uring_queue_init() failed: %s\n", strerror(-rc));
+        free(qpair->cmds);
+        free(qpair);
+        return NULL;
+    }
+    return (struct replay_qpair *)qpair;
+}
+
+static void
+uring_free_qpair(struct replay_qpair *replay_qpair)
+{
+    struct uring_qpair *qpair = (struct uring_qpair *)replay_qpair;
+
+    io_uring_queue_exit(&qpair->ring);
+    free(qpair->cmds);
+    free(qpair);
+}
+
+static struct uring_cmd *
+uring_cmd_get(struct uring_qpair *qpair, spdk_nvme_cmd_cb cb_fn, void *cb_arg, uint32_t len)
+{
+    struct uring_cmd *cmd = qpair->free;
+
+    if (cmd) {
+        qpair->free = cmd->next;
+        cmd->cb_fn = cb_fn;
+        cmd->cb_arg = cb_arg;
+        cmd->len = len;
+        cmd->res = 0;
+        cmd->zone = UINT64_MAX;
+        cmd->append = false;
+        cmd->qpair = qpair;
+        cmd->next = NULL;
+    }
+    return cmd;
+}
+
+/* move the write pointer of the zone forward past end */
+static void
+uring_zone_wp_advance(uint64_t zone, uint64_t end)
+{
+    uint64_t wp = __atomic_load_n(&g_zone_wp[zone], __ATOMIC_RELAXED);
+
+    while (wp < end && !__atomic_compare_exchange_n(&g_zone_wp[zone], &wp, end, true, __ATOMIC_RELAXED,
+            __ATOMIC_RELAXED));
+}
+
+static void
+uring_cmd_complete(struct uring_qpair *qpair, struct uring_cmd *cmd, int res)
+{
+    struct spdk_nvme_cpl cpl;
+    spdk_nvme_cmd_cb cb_fn = cmd->cb_fn;
+    void *cb_arg = cmd->cb_arg;
+    bool success = res >= 0 && (uint32_t)res == cmd->len;
+
+    replay_backend_cpl(&cpl, success);
+    /* write pointers move on completion, a failed write leaves them where they were */
+    if (cmd->zone != UINT64_MAX) {
+        if (success) {
+            uring_zone_wp_advance(cmd->zone, cmd->slba + cmd->len / g_uring_geo.block_byte);
+        }
+        if (cmd->append) {
+            cpl.cdw0 = (uint32_t)cmd->slba;
+            cpl.cdw1 = (uint32_t)(cmd->slba >> 32);
+            __atomic_store_n(&g_zone_append[cmd->zone], false, __ATOMIC_RELEASE);
+        }
+    }
+    cmd->next = qpair->free;
+    qpair->free = cmd;
+    cb_fn(cb_arg, &cpl);
+}
+
+/* queue a command that blocks to the ioctl thread, it is reported by a poll after it returns */
+static void
+uring_ioctl_submit(struct uring_cmd *cmd)
+{
+    pthread_mutex_lock(&g_ioctl_lock);
+    cmd->next = NULL;
+    if (g_ioctl_tail) {
+        g_ioctl_tail->next = cmd;
+    } else {
+        g_ioctl_head = cmd;
+    }
+    g_ioctl_tail = cmd;
+    pthread_cond_signal(&g_ioctl_cond);
+    pthread_mutex_unlock(&g_ioctl_lock);
+}
+
+/* prepare an sqe for the command, the command stays with the caller if there is none */
+static int
+uring_cmd_prep(struct uring_qpair *qpair, struct uring_cmd *cmd, bool write, void *buf, uint64_t slba)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&qpair->ring);
+
+    if (!sqe) {
+        io_uring_submit(&qpair->ring);
+        qpair->num_queued = 0;
+        sqe = io_uring_get_sqe(&qpair->ring);
+        if (!sqe) {
+            return -ENOMEM;
+        }
+    }
+    if (write) {
+        io_uring_prep_write(sqe, g_fd, buf, cmd->len, (off_t)(slba * g_uring_geo.block_byte));
+    } else {
+        io_uring_prep_read(sqe, g_fd, buf, cmd->len, (off_t)(slba * g_uring_geo.block_byte));
+    }
+    io_uring_sqe_set_data(sqe, cmd);
+    qpair->num_queued++;
+    return 0;
+}
+
+/* cmd_out, if not NULL, is set to the queued command */
+static int
+uring_rw(struct replay_qpair *replay_qpair, bool write, void *buf, uint64_t slba, uint32_t nlb,
+         spdk_nvme_cmd_cb cb_fn, void *cb_arg, struct uring_cmd **cmd_out)
+{
+    struct uring_qpair *qpair = (struct uring_qpair *)replay_qpair;
+
+    if (slba + nlb > g_uring_geo.num_blk) {
+        return -EINVAL;
+    }
+    /* the command first, an sqe taken but not prepared would still reach the kernel */
+    struct uring_cmd *cmd = uring_cmd_get(qpair, cb_fn, cb_arg, nlb * g_uring_geo.block_byte);
+    if (!cmd) {
+        return -ENOMEM;
+    }
+    if (uring_cmd_prep(qpair, cmd, write, buf, slba)) {
+        cmd->next = qpair->free;
+        qpair->free = cmd;
+        return -ENOMEM;
+    }
+    if (cmd_out) {
+        *cmd_out = cmd;
+    }
+    return 0;
+}
+
+/* issue the waiting appends whose zone is free, in order per zone */
+static void
+uring_append_issue(struct uring_qpair *qpair)
+{
+    struct uring_cmd **prev = &qpair->append, *cmd;
+
+    qpair->append_tail = NULL;
+    while ((cmd = *prev) != NULL) {
+        bool idle = false;
+        if (__atomic_compare_exchange_n(&g_zone_append[cmd->zone], &idle, true, false, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED)) {
+            cmd->slba = __atomic_load_n(&g_zone_wp[cmd->zone], __ATOMIC_RELAXED);
+            if (cmd->slba + cmd->nlb > g_uring_geo.num_blk) {
+                /* the zone is full, fails on the next poll */
+                *prev = cmd->next;
+                uring_cmd_done(cmd, -EINVAL);
+                continue;
+            }
+            if (!uring_cmd_prep(qpair, cmd, true, cmd->buf, cmd->slba)) {
+                *prev = cmd->next;
+                continue;
+            }
+            __atomic_store_n(&g_zone_append[cmd->zone], false, __ATOMIC_RELEASE);
+        }
+        qpair->append_tail = cmd;
+        prev = &cmd->next;
+    }
+}
+
+static int32_t
+uring_poll(struct replay_qpair *replay_qpair)
+{
+    struct uring_qpair *qpair = (struct uring_qpair *)replay_qpair;
+    struct io_uring_cqe *cqe;
+    int32_t num = 0;
+
+    if (qpair->append) {
+        uring_append_issue(qpair);
+    }
+    /* sqes are submitted in batches, once per poll */
+    if (qpair->num_queued) {
+        io_uring_submit(&qpair->ring);
+        qpair->num_queued = 0;
+    }
+    while (io_uring_peek_cqe(&qpair->ring, &cqe) == 0) {
+        struct uring_cmd *cmd = (struct uring_cmd *)io_uring_cqe_get_data(cqe);
+        int res = cqe->res;
+        io_uring_cqe_seen(&qpair->ring, cqe);
+        uring_cmd_complete(qpair, cmd, res);
+        num++;
+    }
+
+    /* completed by the ioctl thread newest first, report them in order */
+    struct uring_cmd *done = __atomic_exchange_n(&qpair->done, NULL, __ATOMIC_ACQUIRE), *order = NULL;
+    while (done) {
+        struct uring_cmd *next = done->next;
+        done->next = order;
+        order = done;
+        done = next;
+    }
+    while (order) {
+        struct uring_cmd *next = order->next;
+        uring_cmd_complete(qpair, order, order->res);
+        order = next;
+        num++;
+    }
+    return num;
+}
+
+static int
+uring_read(struct replay_qpair *qpair, void *buf, uint64_t slba, uint32_t nlb,
+           spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return uring_rw(qpair, false, buf, slba, nlb, cb_fn, cb_arg, NULL);
+}
+
+static int
+uring_write(struct replay_qpair *qpair, void *buf, uint64_t slba, uint32_t nlb,
+            spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    struct uring_cmd *cmd;
+    int rc = uring_rw(qpair, true, buf, slba, nlb, cb_fn, cb_arg, &cmd);
+
+    if (!rc && g_zone_wp && slba / g_uring_geo.zone_sz_blk < g_uring_geo.num_zone) {
+        cmd->zone = slba / g_uring_geo.zone_sz_blk;
+        cmd->slba = slba;
+    }
+    return rc;
+}
+
+/* discard, or zero range, through an ioctl on block devices and fallocate on files */
+static int
+uring_range(struct replay_qpair *qpair, bool zeroes, uint64_t slba, uint32_t nlb,
+            spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    struct uring_cmd *cmd = uring_cmd_get((struct uring_qpair *)qpair, cb_fn, cb_arg, 0);
+
+    if (!cmd) {
+        return -ENOMEM;
+    }
+    cmd->op = zeroes ? URING_IOCTL_ZEROES : URING_IOCTL_DISCARD;
+    cmd->range[0] = slba * g_uring_geo.block_byte;
+    cmd->range[1] = (uint64_t)nlb * g_uring_geo.block_byte;
+    uring_ioctl_submit(cmd);
+    return 0;
+}
+
+static int
+uring_write_zeroes(struct replay_qpair *qpair, uint64_t slba, uint32_t nlb,
+                   spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return uring_range(qpair, true, slba, nlb, cb_fn, cb_arg);
+}
+
+static int
+uring_deallocate(struct replay_qpair *qpair, uint64_t slba, uint32_t nlb,
+                 spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    return uring_range(qpair, false, slba, nlb, cb_fn, cb_arg);
+}
+
+/*
+ * Write at the write pointer kept for the zone. Writes of different qpairs may reach the device in
+ * any order, so only one emulated append is in flight per zone; the others wait on their qpair and
+ * are issued by a poll once it completes and moves the write pointer.
+ */
+static int
+uring_zone_append(struct replay_qpair *replay_qpair, void *buf, uint64_t zslba, uint32_t nlb,
+                  spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    struct uring_qpair *qpair = (struct uring_qpair *)replay_qpair;
+    uint64_t zone = zslba / g_uring_geo.zone_sz_blk;
+
+    if (!g_zone_wp || zone >= g_uring_geo.num_zone) {
+        return -EINVAL;
+    }
+    struct uring_cmd *cmd = uring_cmd_get(qpair, cb_fn, cb_arg, nlb * g_uring_geo.block_byte);
+    if (!cmd) {
+        return -ENOMEM;
+    }
+    cmd->zone = zone;
+    cmd->append = true;
+    cmd->buf = buf;
+    cmd->nlb = nlb;
+    if (qpair->append_tail) {
+        qpair->append_tail->next = cmd;
+    } else {
+        qpair->append = cmd;
+    }
+    qpair->append_tail = cmd;
+    uring_append_issue(qpair);
+    return 0;
+}
+
+static int
+uring_zone_mgmt(struct replay_qpair *qpair, uint64_t zslba, uint8_t action, bool select_all,
+                spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+    unsigned long req;
+    uint64_t first = select_all ? 0 : zslba / g_uring_geo.zone_sz_blk;
+
+    switch (action) {
+    case SPDK_NVME_ZONE_OPEN:
+        req = BLKOPENZONE;
+        break;
+    case SPDK_NVME_ZONE_CLOSE:
+        req = BLKCLOSEZONE;
+        break;
+    case SPDK_NVME_ZONE_FINISH:
+        req = BLKFINISHZONE;
+        break;
+    case SPDK_NVME_ZONE_RESET:
+        req = BLKRESETZONE;
+        break;
+    default:
+        /* offline is not available to user space */
+        return -ENOTSUP;
+    }
+
+    struct uring_cmd *cmd = uring_cmd_get((struct uring_qpair *)qpair, cb_fn, cb_arg, 0);
+    if (!cmd) {
+        return -ENOMEM;
+    }
+    cmd->op = URING_IOCTL_ZONE_MGMT;
+    cmd->range[0] = first;
+    cmd->range[1] = select_all ? g_uring_geo.num_zone : first + 1;
+    cmd->zone_req = req;
+    cmd->zone_action = action;
+    uring_ioctl_submit(cmd);
+    return 0;
+}
+
+static int
+uring_report_zones(struct replay_qpair *qpair, uint64_t slba, struct replay_zone_desc *desc,
+                   uint32_t *num_desc)
+{
+    struct blk_zone_report *report = (struct blk_zone_report *)calloc(1, sizeof(struct blk_zone_report) +
+                                     *num_desc * sizeof(struct blk_zone));
+
+    if (!report) {
+        fprintf(stderr, "Fail to allocate memory for zone report\n");
+        return 1;
+    }
+    if (uring_zone_report(slba, report, *num_desc)) {
+        free(report);
+        return 1;
+    }
+    for (uint32_t i = 0; i < report->nr_zones; i++) {
+        struct blk_zone *zone = &report->zones[i];
+        desc[i].zslba = uring_sector_to_blk(zone->start);
+        desc[i].cap = uring_zone_cap(report, zone);
+        desc[i].wp = uring_sector_to_blk(zone->wp);
+        /* blk_zone_cond uses the values of the ZNS zone states */
+        desc[i].state = zone->cond;
+    }
+    *num_desc = report->nr_zones;
+    free(report);
+    return 0;
+}
+
+static const char *
+uring_zone_cond_name(uint8_t cond)
+{
+    switch (cond) {
+    case BLK_ZONE_COND_NOT_WP:
+        return "Not write pointer";
+    case BLK_ZONE_COND_EMPTY:
+        return "Empty";
+    case BLK_ZONE_COND_IMP_OPEN:
+        return "Implicit open";
+    case BLK_ZONE_COND_EXP_OPEN:
+        return "Explicit open";
+    case BLK_ZONE_COND_CLOSED:
+        return "Closed";
+    case BLK_ZONE_COND_READONLY:
+        return "Read only";
+    case BLK_ZONE_COND_FULL:
+        return "Full";
+    case BLK_ZONE_COND_OFFLINE:
+        return "Offline";
+    default:
+        return "Reserved";
+    }
+}
+
+static void
+uring_print_zones(uint64_t zones_to_print)
+{
+    struct blk_zone_report *report = (struct blk_zone_report *)calloc(1, sizeof(struct blk_zone_report) +
+                                     URING_REPORT_ZONE_MAX * sizeof(struct blk_zone));
+    uint64_t handled_zones = 0;
+
+    if (!report) {
+        fprintf(stderr, "Fail to allocate memory for zone report\n");
+        return;
+    }
+    while (handled_zones < zones_to_print) {
+        if (uring_zone_report(handled_zones * g_uring_geo.zone_sz_blk, report, URING_REPORT_ZONE_MAX) ||
+            !report->nr_zones) {
+            break;
+        }
+        for (uint32_t i = 0; i < report->nr_zones && handled_zones < zones_to_print; i++, handled_zones++) {
+            struct blk_zone *zone = &report->zones[i];
+            printf("ZSLBA: 0x%-18" PRIx64 " ZCAP: 0x%-18" PRIx64 " WP: 0x%-18" PRIx64 " ZS: %-20s ZT: %-20s\n",
+                   uring_sector_to_blk(zone->start), uring_zone_cap(report, zone), uring_sector_to_blk(zone->wp),
+                   uring_zone_cond_name(zone->cond), zone->type == BLK_ZONE_TYPE_CONVENTIONAL ? "Conventional" :
+                   zone->type == BLK_ZONE_TYPE_SEQWRITE_REQ ? "SWR" : "SWP");
+        }
+        printf("\n");
+    }
+    free(report);
+}
+
+const struct replay_backend g_replay_backend_uring = {
+    .name = "uring",
+    .open = uring_open,
+    .close = uring_close,
+    .alloc_qpair = uring_alloc_qpair,
+    .free_qpair = uring_free_qpair,
+    .poll = uring_poll,
+    .read = uring_read,
+    .write = uring_write,
+    .write_zeroes = uring_write_zeroes,
+    .deallocate = uring_deallocate,
+    .zone_append = uring_zone_append,
+    .zone_mgmt = uring_zone_mgmt,
+    .report_zones = uring_report_zones,
+    .print_zones = uring_print_zones,
+};
+
+#else /* SPDK_CONFIG_URING */
+
+static int
+uring_open(const char *target, struct replay_geometry *geo)
+{
+    fprintf(stderr, "trace_replayer is built without io_uring, configure SPDK --with-uring\n");
+    return 1;
+}
+
+const struct replay_backend g_replay_backend_uring = {
+    .name = "uring",
+    .open = uring_open,
+};
+
+#endif /* SPDK_CONFIG_URING */
@@ -9,34 +9,246 @@
 #include "spdk/nvme_zns.h"
 #include "spdk/nvme_spec.h"
 #include "trace_io.h"
+#include "replay_backend.h"
 
 #define ENTRY_MAX 10000 /* number of trace_io_entry */
 
-struct ctrlr_entry {
-    struct spdk_nvme_ctrlr *ctrlr;
-    TAILQ_ENTRY(ctrlr_entry) link;
-    char name[1024];
-};
-
-struct ns_entry {
-	struct spdk_nvme_ctrlr *ctrlr;
-	struct spdk_nvme_ns	*ns;
-	TAILQ_ENTRY(ns_entry) link;
-	struct spdk_nvme_qpair *qpair;
-};
+struct replay_worker;
 
 struct io_task {
-    struct spdk_nvme_qpair *qpair;
+    struct replay_qpair *qpair;
+    struct replay_worker *worker;
     uint16_t opc;
     uint64_t slba;
     uint32_t nlb;
     void *buf;
+    void *pool_buf;             /* buffer owned by the pool, buf differs for oversized requests */
+    struct io_task *next_free;
+    uint64_t submit_tsc;
+    uint64_t tsc;               /* shifted recorded timestamp, UINT64_MAX when the task is free */
+    uint64_t obj_id;            /* id of the request in the result file */
+    uint32_t lcore;             /* recorded lcore */
+    uint32_t cdw13;
+    uint32_t loop;              /* iteration of the trace */
+    struct dep_entry *dep;      /* entry in the dependency index */
+    uint8_t data_gen;           /* generation of the pattern of a zone append */
+    bool data_reset_raced;      /* submitted while a zone reset was in flight */
+    uint64_t data_reset;        /* zone resets submitted when the read or zone append was submitted */
+    uint8_t *verify_gen;        /* generations a read must return, NULL if unknown */
+    uint16_t *verify_idx;       /* block index in the append that wrote each block, on ZNS */
+};
+
+/* request decoded from a trace_io_entry by the reader thread */
+struct replay_req {
+    uint64_t tsc;               /* recorded timestamp, shifted for the copy */
+    uint64_t slba;              /* remapped for the copy */
+    uint32_t nlb;
+    uint32_t cdw13;
+    uint32_t copy;
+    uint32_t lcore;
+    uint32_t loop;              /* iteration of the trace */
+    uint16_t opc;
+    bool     complete;          /* NVME_IO_COMPLETE entry */
+    struct dep_entry *dep;      /* set by the worker when dependencies are tracked */
+};
+
+/* lock-free single producer single consumer ring of requests */
+#define REQ_RING_SIZE (1 << 16)
+#define REQ_RING_ALIGN 64
+
+struct req_ring {
+    /* producer */
+    uint64_t head __attribute__((aligned(REQ_RING_ALIGN)));
+    uint64_t tail_cache;
+    /* consumer */
+    uint64_t tail __attribute__((aligned(REQ_RING_ALIGN)));
+    uint64_t head_cache;
+    bool     done __attribute__((aligned(REQ_RING_ALIGN)));   /* producer has no more requests */
+    struct replay_req req[REQ_RING_SIZE];
+};
+
+/* single producer single consumer ring of io tasks, large enough for every task of a pool */
+struct task_ring {
+    uint64_t head __attribute__((aligned(REQ_RING_ALIGN)));
+    uint64_t tail __attribute__((aligned(REQ_RING_ALIGN)));
+    uint64_t mask;
+    struct io_task **task;
+};
+
+/* per qpair free list of io tasks, each task owns a slice of one DMA buffer */
+struct io_task_pool {
+    struct io_task *tasks;
+    struct io_task *free;
+    void *buf;
+    uint32_t num_task;
+    uint32_t buf_byte;          /* data buffer size of each task */
+    uint64_t num_get;
+    uint64_t num_oversize;      /* requests larger than buf_byte, allocated on demand */
+    uint64_t get_tsc;           /* ticks spent in io_task_get() */
+};
+
+enum replay_opc_class {
+    REPLAY_OPC_READ = 0,
+    REPLAY_OPC_WRITE,
+    REPLAY_OPC_APPEND,
+    REPLAY_OPC_WRITE_ZEROES,
+    REPLAY_OPC_ZONE_MGMT,
+    REPLAY_OPC_OTHER,
+    REPLAY_OPC_MAX,
+};
+
+/* completions in one time-series window */
+struct replay_window {
+    uint64_t count;
+    uint64_t byte;
+    uint64_t latency_sum;
+    uint64_t latency_max;
+    uint64_t start_tsc;         /* iterations only: first submit */
+    uint64_t end_tsc;           /* iterations only: last completion */
+};
+
+/* request as seen by dependency tracking, from arrival until completion */
+#define DEP_CHUNK_BLK 4096          /* LBA granularity of the request index */
+#define DEP_NODE_MAX (65536 / DEP_CHUNK_BLK + 1)    /* chunks a request can span */
+
+enum dep_kind {
+    DEP_NONE = 0,               /* not tracked */
+    DEP_READ,
+    DEP_WRITE,
+    DEP_APPEND,
+    DEP_ALL,                    /* select all zone management */
+};
+
+struct dep_interval {
+    uint64_t slba;
+    uint64_t end;
+    enum dep_kind kind;
+};
+
+struct dep_node {
+    TAILQ_ENTRY(dep_node) link;
+    struct dep_entry *entry;
+};
+
+struct dep_entry {
+    struct dep_interval dep;
+    uint64_t seq;               /* arrival order */
+    TAILQ_ENTRY(dep_entry) order;
+    TAILQ_ENTRY(dep_entry) all;
+    uint32_t num_node;
+    struct dep_node node[DEP_NODE_MAX];
+    struct dep_entry *next_free;
+};
+
+struct dep_hold {
+    struct replay_req req;      /* dep is its index entry */
+    uint64_t tsc;               /* held since */
+};
+
+/* statistics a worker publishes for a checkpoint */
+struct replay_ckpt_stat {
+    uint64_t seq;               /* odd while the worker writes */
+    uint64_t epoch;             /* checkpoint request answered last */
+    uint64_t tsc;               /* shifted timestamp of the oldest request not completed */
+    uint64_t num_io;
+    uint64_t wp_mismatch;
+    struct trace_io_hist latency_hist[REPLAY_OPC_MAX];
+};
+
+/* token bucket limits, per qpair (worker) and global, with separate read and write budgets */
+enum rate_scope {
+    RATE_SCOPE_QPAIR = 0,
+    RATE_SCOPE_GLOBAL,
+    RATE_SCOPE_MAX,
+};
+
+enum rate_class {
+    RATE_READ = 0,
+    RATE_WRITE,
+    RATE_ALL,                   /* reads and writes together */
+    RATE_CLASS_MAX,
+};
+
+enum rate_unit {
+    RATE_IOPS = 0,
+    RATE_BW,                    /* bytes */
+    RATE_UNIT_MAX,
+};
+
+struct rate_bucket {
+    double tick_per_unit;       /* 0 is unlimited */
+    uint64_t burst_tsc;
+    uint64_t next_tsc;          /* the bucket is empty again at this tick */
+};
+
+struct rate_limit {
+    double rate[RATE_CLASS_MAX][RATE_UNIT_MAX];     /* per second, 0 is unlimited */
+    uint64_t burst_us;
+};
+
+/* per thread replay state, every worker replays the sub-stream of its recorded lcores on its own qpair */
+struct replay_worker {
+    uint32_t index;
+    uint32_t core;                  /* env core the worker runs on */
+    struct replay_qpair *qpair;
+    struct req_ring *ring;
+    uint32_t *copy_outstanding;     /* recorded queue depth of each copy, skips completions before the copy starts */
+    struct io_task_pool pool;
+    uint32_t outstanding;           /* outstanding requests on qpair */
+    uint64_t num_io;
+    uint32_t trace_outstanding;     /* recorded queue depth of the sub-stream */
+    uint64_t trace_end_tsc;
+    uint64_t replay_tsc;            /* ticks spent in replay */
+    struct trace_io_hist slip_hist;
+    struct trace_io_hist trace_qd_hist;
+    struct trace_io_hist replay_qd_hist;
+    struct trace_io_hist latency_hist[REPLAY_OPC_MAX];
+    struct replay_window *window;
+    uint64_t num_window;
+    struct replay_window *loop;     /* per iteration of the trace */
+    uint64_t num_loop;
+    uint64_t reset_blk;             /* blocks reset by this worker */
+    uint64_t reset_error;
+    uint64_t precondition_blk;      /* blocks written by the zone precondition */
+    uint64_t precondition_error;
+    uint64_t zone_wait_tsc;         /* ticks waiting for a busy zone in ordered zone write mode */
+    uint64_t wp_mismatch;           /* recorded writes not at the replay write pointer */
+    uint64_t zone_skip;             /* writes over the zone capacity or the open and active limits */
+    uint8_t data_gen;               /* generation of the last zone append pattern */
+    struct task_ring *verify_ring;  /* completed reads, worker to verifier */
+    struct task_ring *verified_ring;    /* verified reads, verifier to worker */
+    uint32_t verifying;             /* tasks held by the verifier */
+    uint8_t *verify_gen;            /* expected generations, verify_gen_blk per task of the pool */
+    uint16_t *verify_idx;           /* expected append block indexes, on ZNS */
+    uint32_t verify_gen_blk;
+    uint64_t verify_blk;            /* written by the verifier */
+    uint64_t verify_skip;
+    uint64_t verify_error;
+    struct rate_bucket rate_bucket[RATE_CLASS_MAX][RATE_UNIT_MAX];
+    struct trace_io_hist throttle_hist;
+    uint64_t rate_io[RATE_CLASS_MAX];
+    uint64_t rate_byte[RATE_CLASS_MAX];
+    struct dep_entry *dep_entries;  /* one per outstanding or held request */
+    struct dep_entry *dep_free;
+    struct dep_hold *hold;          /* requests waiting for their dependencies, in trace order */
+    uint32_t num_hold;
+    uint64_t dep_held;              /* requests that had to wait */
+    uint64_t dep_hold_tsc;
+    uint64_t dep_release_gen;       /* releases seen when the held requests were last checked */
+    int dep_rc;
+    struct replay_ckpt_stat ckpt;
+    uint64_t ckpt_retry_tsc;        /* shifted timestamp of a request being submitted or that failed to */
+    bool ckpt_exit;                 /* published its last checkpoint */
+    thread_start_fn fn;             /* started by replay_worker_foreach() */
+    FILE *result;                   /* trace_io format result file */
+    char result_name[256];
+    int rc;
 };
 
-/* variables for init nvme */
-static TAILQ_HEAD(, ctrlr_entry) g_controllers = TAILQ_HEAD_INITIALIZER(g_controllers);
-static TAILQ_HEAD(, ns_entry) g_namespaces = TAILQ_HEAD_INITIALIZER(g_namespaces);
-static struct spdk_nvme_transport_id g_trid = {};
+/* variables for replay backend */
+static const struct replay_backend *g_backend = &g_replay_backend_nvme;
+static const char *g_backend_target = "";
+static struct replay_geometry g_geo;
 static uint32_t g_queue_depth = 0;
 /* variables for parse_args */
 static bool g_input_file = false;
@@ -44,6 +256,94 @@ static bool g_report_zone = false;
 static uint64_t g_zone_report_limit = 0;
 static bool g_spdk_trace = false;
 static const char *g_tpoint_group_name = NULL;
+/* variables for replay timing */
+enum replay_mode {
+    REPLAY_MODE_AFAP = 0,       /* as fast as queue depth allows */
+    REPLAY_MODE_OPEN_LOOP,      /* issue at recorded submit time */
+    REPLAY_MODE_CLOSED_LOOP,    /* keep recorded queue depth */
+};
+static enum replay_mode g_replay_mode = REPLAY_MODE_AFAP;
+static double g_time_scale = 1.0;           /* open-loop speed up factor, 2 = twice as fast */
+static uint32_t g_load_multiplier = 1;      /* number of phase-shifted copies of the trace */
+/* variables for replay workers */
+#define WORKER_MAX 64
+static const char *g_core_list = NULL;      /* "auto" or comma separated env cores */
+static uint32_t g_num_worker = 1;
+static uint32_t g_worker_core[WORKER_MAX];
+static bool g_lcore_used[SPDK_TRACE_MAX_LCORE];        /* recorded lcores in the trace */
+static uint32_t g_lcore_worker[SPDK_TRACE_MAX_LCORE];  /* recorded lcore -> worker index */
+static char g_core_mask[WORKER_MAX * 4];
+static bool g_barrier = false;
+static uint64_t g_barrier_window_us = 0;
+/* variables for reset namespace */
+enum reset_mode {
+    RESET_MODE_FULL = 0,        /* whole namespace */
+    RESET_MODE_TOUCHED,         /* only LBAs the trace reads */
+    RESET_MODE_NONE,
+};
+static enum reset_mode g_reset_mode = RESET_MODE_FULL;
+/* variables for zone precondition */
+enum precondition_mode {
+    PRECONDITION_MODE_NONE = 0,
+    PRECONDITION_MODE_SCAN,     /* fill zones the trace reads before writing */
+    PRECONDITION_MODE_FILL,     /* scan, and fill a percentage of the zones the trace never writes */
+};
+static enum precondition_mode g_precondition_mode = PRECONDITION_MODE_NONE;
+static uint32_t g_precondition_fill_pct = 0;
+/* variables for ordered zone write */
+static bool g_zone_ordered = false;     /* regular writes at the write pointer instead of zone append */
+static pthread_mutex_t g_zone_lock = PTHREAD_MUTEX_INITIALIZER;    /* zone states and counts */
+static uint32_t g_zone_num_open = 0;
+static uint32_t g_zone_num_active = 0;
+static uint64_t g_zone_close_cursor = 0;    /* next zone to look at for an implicit close */
+static uint32_t g_zone_freeing = 0;     /* commands in flight that may close or finish zones */
+static uint64_t g_zone_wait_tsc = 0;
+static uint64_t g_wp_mismatch = 0;
+static uint64_t g_zone_skip = 0;
+/* variables for data pattern and verification */
+static bool g_data_pattern = false;     /* deterministic per LBA and generation patterns instead of a marker */
+static uint32_t g_data_zero_pct = 0;    /* share of each block left zero, for compression-capable drives */
+static bool g_data_verify = false;      /* verify reads against the generation map */
+/* variables for rate limit */
+#define RATE_BURST_US_DEFAULT 100
+static bool g_rate_limited = false;
+static struct rate_limit g_rate_limit[RATE_SCOPE_MAX] = {
+    {.burst_us = RATE_BURST_US_DEFAULT}, {.burst_us = RATE_BURST_US_DEFAULT},
+};
+/* variables for lba remap */
+enum remap_mode {
+    REMAP_MODE_NONE = 0,        /* recorded LBAs, wrapped only to split the load multiplier copies */
+    REMAP_MODE_WRAP,            /* LBA (zone index on ZNS) modulo the device */
+    REMAP_MODE_SCALE,           /* LBA (zone index on ZNS) scaled linearly from the recorded namespace */
+    REMAP_MODE_ZONE,            /* zone index modulo the device, offset scaled to zone capacity */
+};
+static enum remap_mode g_remap_mode = REMAP_MODE_NONE;
+static uint64_t g_remap_src_blk = 0;        /* scale: blocks of the recorded namespace, 0 scans the trace */
+static uint64_t g_remap_src_zone_blk = 0;   /* zone: zone size of the recorded namespace */
+static uint64_t g_remap_src_zone_cap = 0;   /* zone: zone capacity of the recorded namespace */
+static uint64_t g_remap_dst_blk = 0;        /* blocks (zones on ZNS) of the range owned by each copy */
+static uint64_t g_remap_dst_zone_cap = 0;
+static double g_remap_factor = 0;
+/* variables for replay loop */
+static uint32_t g_loop_count = 0;           /* iterations of the trace, 0 is one or unbounded with a duration */
+static double g_loop_duration_s = 0;        /* stop looping after this many seconds */
+static uint64_t g_loop_rotate_blk = 0;      /* LBA offset added per iteration, whole zones on ZNS */
+/* variables for dependency tracking */
+static bool g_dep_track = false;        /* hold requests until the overlapping ones before them complete */
+/* variables for checkpoint and resume */
+static const char *g_ckpt_file = NULL;      /* state file, no checkpoint if NULL */
+static double g_ckpt_interval_s = 60;
+static bool g_ckpt_resume = false;          /* continue from the state file */
+static uint64_t g_ckpt_resume_tsc = 0;      /* shifted timestamp the resumed replay starts at */
+/* variables for trace slice and filter */
+static double g_slice_start_s = 0;          /* replay only [start, end) seconds of the trace */
+static double g_slice_end_s = 0;            /* 0 is the end of the trace */
+static bool g_filter_by_lcore = false;
+static bool g_filter_lcore[SPDK_TRACE_MAX_LCORE];
+static uint32_t g_filter_opc_class = 0;     /* bit per replay_opc_class, 0 replays all */
+/* variables for replay latency */
+static const char *g_result_file_name = NULL;
+static uint64_t g_window_ms = 0;
 /* variables for io request */
 static uint64_t g_num_io = 0;
 static uint32_t outstanding_commands = 0;
@@ -68,157 +368,62 @@ print_uline(char marker, int line_len)
     putchar('\n');
 }
 
-static void
-register_ns(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_ns *ns)
-{
-    struct ns_entry *entry;
-
-    if (!spdk_nvme_ns_is_active(ns)) {
-        return;
-    }   
-
-    entry = (struct ns_entry *)malloc(sizeof(struct ns_entry));
-    if (entry == NULL) {
-        perror("ns_entry malloc");
-        exit(1);
-    }   
-
-    entry->ctrlr = ctrlr;
-    entry->ns = ns; 
-    TAILQ_INSERT_TAIL(&g_namespaces, entry, link);
-
-    printf("  Namespace ID: %d size: %juGB\n", spdk_nvme_ns_get_id(ns),
-            spdk_nvme_ns_get_size(ns) / 1000000000);
-}
-
-static bool
-probe_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid,
-     struct spdk_nvme_ctrlr_opts *opts)
-{
-    printf("Attaching to %s\n", trid->traddr);
-
-    return true;
-}
-
-static void
-attach_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid,
-	  struct spdk_nvme_ctrlr *ctrlr, const struct spdk_nvme_ctrlr_opts *opts)
-{
-    int nsid;
-    struct ctrlr_entry *entry;
-    struct spdk_nvme_ns *ns;
-    const struct spdk_nvme_ctrlr_data *cdata;
-
-    /* register ctrlr */
-    entry = (struct ctrlr_entry *)malloc(sizeof(struct ctrlr_entry));
-    if (entry == NULL) {
-        perror("ctrlr_entry malloc");
-        exit(1);
-    }
-
-    printf("Attached to %s\n", trid->traddr);
-
-    cdata = spdk_nvme_ctrlr_get_data(ctrlr);
-
-    snprintf(entry->name, sizeof(entry->name), "%-20.20s (%-20.20s)", cdata->mn, cdata->sn);
-
-    entry->ctrlr = ctrlr;
-    TAILQ_INSERT_TAIL(&g_controllers, entry, link);
-
-    /*
-     * Each controller has one or more namespaces.
-     * Note that in NVMe, namespace IDs start at 1, not 0.
-     */
-    for (nsid = spdk_nvme_ctrlr_get_first_active_ns(ctrlr); nsid != 0;
-        nsid = spdk_nvme_ctrlr_get_next_active_ns(ctrlr, nsid)) {
-        ns = spdk_nvme_ctrlr_get_ns(ctrlr, nsid);
-        if (ns == NULL) {
-            continue;
-        }
-        register_ns(ctrlr, ns);
-    }
-}
-
-static void
-cleanup(void)
+static float
+get_us_from_tick(double tick)
 {
-    struct ns_entry *ns_entry, *tmp_ns_entry;
-    struct ctrlr_entry *ctrlr_entry, *tmp_ctrlr_entry;
-    struct spdk_nvme_detach_ctx *detach_ctx = NULL;
-
-    TAILQ_FOREACH_SAFE(ns_entry, &g_namespaces, link, tmp_ns_entry) {
-        TAILQ_REMOVE(&g_namespaces, ns_entry, link);
-        free(ns_entry);
-    }
-
-    TAILQ_FOREACH_SAFE(ctrlr_entry, &g_controllers, link, tmp_ctrlr_entry) {
-        TAILQ_REMOVE(&g_controllers, ctrlr_entry, link);
-        spdk_nvme_detach_async(ctrlr_entry->ctrlr, &detach_ctx);
-        free(ctrlr_entry);
-    }
-
-    if (detach_ctx) {
-        spdk_nvme_detach_poll(detach_ctx);
-    }
+    return tick * 1000 * 1000 / spdk_get_ticks_hz();
 }
 
 /* allocate io qpair & free io qpair start */
 static void
-free_qpair(struct spdk_nvme_qpair *qpair)
+free_qpair(struct replay_qpair *qpair)
 {
-    spdk_nvme_ctrlr_free_io_qpair(qpair);
+    g_backend->free_qpair(qpair);
 }
 
-static struct ns_entry *
-alloc_qpair(struct spdk_env_opts *opts)
+static struct replay_qpair *
+alloc_qpair(void)
 {
-    struct ns_entry *ns_entry;
-
-    /* specify namespace and allocate io qpair for the namespace */
-    ns_entry = TAILQ_FIRST(&g_namespaces);
-    ns_entry->qpair = spdk_nvme_ctrlr_alloc_io_qpair(ns_entry->ctrlr, NULL, 0);
-    if (ns_entry->qpair == NULL) {
-        printf("ERROR: spdk_nvme_ctrlr_alloc_io_qpair() failed\n");
-        return NULL;
-    }
+    struct replay_qpair *qpair = g_backend->alloc_qpair(g_queue_depth);
 
-    struct spdk_nvme_io_qpair_opts qpair_opts;
-    spdk_nvme_ctrlr_get_default_io_qpair_opts(ns_entry->ctrlr, &qpair_opts, sizeof(opts));
-    if (g_queue_depth == 0) {
-        g_queue_depth = qpair_opts.io_queue_size;
+    if (qpair == NULL) {
+        fprintf(stderr, "ERROR: alloc_qpair() of %s backend failed\n", g_backend->name);
     }
-    printf("Queue depth is %d.\n", g_queue_depth);
-
-    return ns_entry;
+    return qpair;
 }
 /* allocate io qpair & free io qpair end */
 
 /* identify namespace start */
 static void
-identify_ns(struct ns_entry *ns_entry)
+identify_ns(const struct replay_geometry *geo)
 {
-    if (spdk_nvme_ns_get_csi(ns_entry->ns) == SPDK_NVME_CSI_ZNS) {
-        g_zone = true;
-    }
+    g_geo = *geo;
+    g_zone = geo->zoned;
 
     print_uline('=', printf("\nNVMe Namespace Information\n"));
-    g_block_byte = spdk_nvme_ns_get_sector_size(ns_entry->ns);
-    g_ns_blk =  spdk_nvme_ns_get_num_sectors(ns_entry->ns);
+    g_block_byte = geo->block_byte;
+    g_ns_blk = geo->num_blk;
+    printf("%-20s: %s\n", "Backend", g_backend->name);
     printf("%-20s: %lu (blocks)\n", "Size of namespace", g_ns_blk);
     printf("%-20s: %u (bytes)\n", "Size of LBA", g_block_byte);
 
     if (g_zone) {
-        g_num_zone = spdk_nvme_zns_ns_get_num_zones(ns_entry->ns);
-        g_zone_sz_blk = spdk_nvme_zns_ns_get_zone_size_sectors(ns_entry->ns);
-        g_max_append_byte = spdk_nvme_zns_ctrlr_get_max_zone_append_size(ns_entry->ctrlr);
-        g_max_open_zone = spdk_nvme_zns_ns_get_max_open_zones(ns_entry->ns);
-        g_max_active_zone = spdk_nvme_zns_ns_get_max_active_zones(ns_entry->ns);
+        g_num_zone = geo->num_zone;
+        g_zone_sz_blk = geo->zone_sz_blk;
+        g_max_append_byte = geo->max_append_byte;
+        g_max_open_zone = geo->max_open_zone;
+        g_max_active_zone = geo->max_active_zone;
         printf("%-20s: %lu\n", "Number of Zone", g_num_zone);
         printf("%-20s: 0x%lx (blocks)\n", "Size of Zone",g_zone_sz_blk);
         printf("%-20s: %u (blocks)\n", "Max Zone Append Size", g_max_append_byte / g_block_byte);
         printf("%-20s: %u\n", "Max Open Zone", g_max_open_zone);
         printf("%-20s: %u\n", "Max Active Zone", g_max_active_zone);
     }
+
+    if (g_queue_depth == 0) {
+        g_queue_depth = geo->queue_size;
+    }
+    printf("Queue depth is %d.\n", g_queue_depth);
 }
 /* identify namespace end */
 
@@ -229,7 +434,6 @@ reset_ns_complete(void *cb_arg, const struct spdk_nvme_cpl *cpl)
     struct io_task *task = (struct io_task *)cb_arg;
 
     if (spdk_nvme_cpl_is_error(cpl)) {
-        spdk_nvme_qpair_print_completion(task->qpair, (struct spdk_nvme_cpl *)cpl);
         fprintf(stderr, "Reset namespace error - opc = 0x%x, slba = 0x%lx, nlb = %d, status = %s\n",
                  task->opc, task->slba, task->nlb, spdk_nvme_cpl_get_status_string(&cpl->status));
     }
@@ -237,7 +441,7 @@ reset_ns_complete(void *cb_arg, const struct spdk_nvme_cpl *cpl)
 }
 
 static void
-reset_all_zone(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair)
+reset_all_zone(struct replay_qpair *qpair)
 {
     struct io_task task;
     task.qpair = qpair;
@@ -246,378 +450,4325 @@ reset_all_zone(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair)
     task.nlb = 0;
 
     outstanding_commands++;
-    int err = spdk_nvme_zns_reset_zone(ns, qpair, 0, true, reset_ns_complete, &task);
+    int err = g_backend->zone_mgmt(qpair, 0, SPDK_NVME_ZONE_RESET, true, reset_ns_complete, &task);
     if (err) {
             fprintf(stderr, "Reset all zones failed\n");
             exit(1);
     }
 
     while (outstanding_commands) {
-        spdk_nvme_qpair_process_completions(qpair, 0);
+        g_backend->poll(qpair);
     }
 }
 
-static void
-write_all_zero(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair)
+/* reset namespace end */
+
+/* report zone start */
+static void report_zone(void)
 {
-    struct io_task task;
-    task.qpair = qpair;
-    task.opc = SPDK_NVME_OPC_WRITE_ZEROES;
+    if (!g_zone) {
+        return;
+    }
 
-    uint64_t remain_ns_blk = g_ns_blk;
-    uint64_t xfer_blk = spdk_nvme_ns_get_max_io_xfer_size(ns) / g_block_byte;
-    uint64_t slba = 0;
-    uint32_t lba_count = 0;
+    uint64_t zones_to_print = g_zone_report_limit ? spdk_min(g_num_zone, (uint64_t)g_zone_report_limit) : \
+	                g_num_zone;
 
-    for (slba = 0; slba < g_ns_blk ; slba += lba_count) {
-        if (remain_ns_blk > xfer_blk) {
-            lba_count = xfer_blk;
-        } else {
-            lba_count = remain_ns_blk;
-        }
+    print_uline('=', printf("\nNVMe ZNS Zone Report (first %zu of %zu)\n", zones_to_print, g_num_zone));
+    if (!g_backend->print_zones) {
+        printf("Zone report is not supported by the %s backend\n", g_backend->name);
+        return;
+    }
+    g_backend->print_zones(zones_to_print);
+}
+/* report zone end */
 
-        task.slba = slba;
-        task.nlb = lba_count;
-        outstanding_commands++;
-        int err = spdk_nvme_ns_cmd_write_zeroes(ns, qpair, slba, lba_count, reset_ns_complete, &task, 0);
-        if (err) {
-            fprintf(stderr, "Write all zeros failed\n");
-            exit(1);
+/* zone info start */
+enum zone_scan_state {
+    ZONE_SCAN_UNSEEN = 0,
+    ZONE_SCAN_WRITTEN,          /* written, reset or finished by the trace */
+};
+
+/* per zone state of the device, loaded with report zones */
+struct zone_info {
+    uint64_t cap;               /* writable blocks of the zone */
+    uint64_t fill;              /* precondition target in blocks from zslba */
+    uint64_t submitted;         /* blocks written from zslba, starts at the write pointer */
+    uint32_t outstanding;
+    bool     closed;
+    uint8_t  scan;              /* enum zone_scan_state */
+    uint64_t wp;                /* replay write pointer in blocks from zslba */
+    uint8_t  state;             /* enum spdk_nvme_zns_zone_state of the replay */
+    bool     busy;              /* a write or zone management command is in flight */
+};
+
+static struct zone_info *g_zone_info = NULL;
+
+/* load zone capacity and write pointer of every zone */
+#define ZONE_REPORT_DESC 1024   /* zone descriptors per report */
+
+static int
+zone_info_load(struct replay_qpair *qpair)
+{
+    uint64_t zone = 0;
+    int rc = 0;
+
+    free(g_zone_info);
+    g_zone_info = (struct zone_info *)calloc(g_num_zone, sizeof(struct zone_info));
+    struct replay_zone_desc *desc = (struct replay_zone_desc *)calloc(ZONE_REPORT_DESC, sizeof(struct replay_zone_desc));
+    if (!g_zone_info || !desc) {
+        fprintf(stderr, "Fail to allocate memory for zone info\n");
+        free(desc);
+        return 1;
+    }
+
+    while (zone < g_num_zone) {
+        uint32_t nr_zones = ZONE_REPORT_DESC;
+        rc = g_backend->report_zones(qpair, zone * g_zone_sz_blk, desc, &nr_zones);
+        if (rc) {
+            fprintf(stderr, "Report zones failed\n");
+            break;
+        }
+        if (nr_zones == 0) {
+            fprintf(stderr, "Report zones returned no zone at 0x%lx\n", zone * g_zone_sz_blk);
+            rc = 1;
+            break;
         }
+        for (uint32_t i = 0; i < nr_zones && zone < g_num_zone; i++) {
+            struct zone_info *zi = &g_zone_info[zone++];
 
-        while (outstanding_commands) {
-            spdk_nvme_qpair_process_completions(qpair, 0);
+            zi->cap = spdk_min(desc[i].cap, g_zone_sz_blk);
+            switch (desc[i].state) {
+            case SPDK_NVME_ZONE_STATE_EMPTY:
+            case SPDK_NVME_ZONE_STATE_IOPEN:
+            case SPDK_NVME_ZONE_STATE_EOPEN:
+            case SPDK_NVME_ZONE_STATE_CLOSED:
+                zi->submitted = spdk_min(desc[i].wp - desc[i].zslba, zi->cap);
+                break;
+            default:
+                /* full, read only or offline zones are not writable */
+                zi->submitted = zi->cap;
+                break;
+            }
+            zi->wp = zi->submitted;
+            zi->state = desc[i].state;
         }
+    }
+    free(desc);
 
-        remain_ns_blk -= lba_count;
+    g_zone_num_open = 0;
+    g_zone_num_active = 0;
+    for (uint64_t i = 0; i < zone; i++) {
+        uint8_t state = g_zone_info[i].state;
+        g_zone_num_open += state == SPDK_NVME_ZONE_STATE_IOPEN || state == SPDK_NVME_ZONE_STATE_EOPEN;
+        g_zone_num_active += state == SPDK_NVME_ZONE_STATE_IOPEN || state == SPDK_NVME_ZONE_STATE_EOPEN ||
+                             state == SPDK_NVME_ZONE_STATE_CLOSED;
     }
+    return rc;
 }
+/* zone info end */
 
-static void
-reset_ns(struct ns_entry *ns_entry)
+/* io task pool start */
+#define IO_TASK_BUF_MAX (1024 * 1024) /* larger requests allocate their buffer on demand */
+
+static uint64_t g_pool_num_get = 0;
+static uint64_t g_pool_num_oversize = 0;
+static uint64_t g_pool_get_tsc = 0;
+
+static int
+io_task_pool_init(struct io_task_pool *pool, uint32_t num_task, uint32_t buf_byte)
 {
-    if (g_zone) {
-        reset_all_zone(ns_entry->ns, ns_entry->qpair);
-    } else {
-        write_all_zero(ns_entry->ns, ns_entry->qpair);
+    memset(pool, 0, sizeof(*pool));
+    pool->num_task = num_task;
+    pool->buf_byte = buf_byte;
+    pool->tasks = (struct io_task *)calloc(num_task, sizeof(struct io_task));
+    pool->buf = spdk_zmalloc((size_t)num_task * buf_byte, g_block_byte,
+                             NULL, SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
+    if (!pool->tasks || !pool->buf) {
+        fprintf(stderr, "Fail to allocate io task pool of %u x %u bytes\n", num_task, buf_byte);
+        free(pool->tasks);
+        spdk_free(pool->buf);
+        pool->tasks = NULL;
+        pool->buf = NULL;
+        return 1;
     }
 
-    printf("\nReset namespace complete.\n");
+    for (uint32_t i = 0; i < num_task; i++) {
+        struct io_task *task = &pool->tasks[i];
+        task->pool_buf = (char *)pool->buf + (size_t)i * buf_byte;
+        task->buf = task->pool_buf;
+        task->tsc = UINT64_MAX;
+        task->next_free = pool->free;
+        pool->free = task;
+    }
+    return 0;
 }
-/* reset namespace end */
 
-/* report zone start */
 static void
-zone_report_completion(void *cb_arg, const struct spdk_nvme_cpl *cpl)
+io_task_pool_fini(struct io_task_pool *pool)
 {
-    struct io_task *task = (struct io_task *)cb_arg;
-
-    if (spdk_nvme_cpl_is_error(cpl)) {
-        spdk_nvme_qpair_print_completion(task->qpair, (struct spdk_nvme_cpl *)cpl);
-        fprintf(stderr, "Zone report error - slba = 0x%lx, status = %s\n", 
-                task->slba, spdk_nvme_cpl_get_status_string(&cpl->status));
-    }
-    outstanding_commands--;
+    free(pool->tasks);
+    spdk_free(pool->buf);
+    pool->tasks = NULL;
+    pool->buf = NULL;
+    pool->free = NULL;
 }
 
-static void print_zns_zone(uint8_t *report, uint32_t index, uint32_t zdes)
+static void data_verify_reclaim(struct replay_worker *worker);
+static void dep_release(struct replay_worker *worker, struct io_task *task);
+static void replay_poll(struct replay_worker *worker);
+
+static struct io_task *
+io_task_get(struct replay_worker *worker, uint32_t nlb)
 {
-    uint32_t zrs = sizeof(struct spdk_nvme_zns_zone_report);
-    uint32_t zds = sizeof(struct spdk_nvme_zns_zone_desc);
-    uint32_t zd_index = zrs + index * (zds + zdes);
-    struct spdk_nvme_zns_zone_desc *desc = (struct spdk_nvme_zns_zone_desc *)(report + zd_index);
+    struct io_task_pool *pool = &worker->pool;
+    uint64_t start_tsc = spdk_get_ticks();
+    size_t byte = (size_t)nlb * g_block_byte;
 
-    printf("ZSLBA: 0x%-18" PRIx64 " ZCAP: 0x%-18" PRIx64 " WP: 0x%-18" PRIx64 " ZS: ", desc->zslba,
-           desc->zcap, desc->wp);
-    switch (desc->zs)
-    {
-    case SPDK_NVME_ZONE_STATE_EMPTY:
-        printf("%-20s", "Empty");
-        break;
-    case SPDK_NVME_ZONE_STATE_IOPEN:
-        printf("%-20s", "Implicit open");
-        break;
-    case SPDK_NVME_ZONE_STATE_EOPEN:
-        printf("%-20s", "Explicit open");
-        break;
-    case SPDK_NVME_ZONE_STATE_CLOSED:
-        printf("%-20s", "Closed");
-        break;
-    case SPDK_NVME_ZONE_STATE_RONLY:
-        printf("%-20s", "Read only");
-        break;
-    case SPDK_NVME_ZONE_STATE_FULL:
-        printf("%-20s", "Full");
-        break;
-    case SPDK_NVME_ZONE_STATE_OFFLINE:
-        printf("%-20s", "Offline");
-        break;
-    default:
-        printf("%-20s", "Reserved");
+    /* queue depth is capped to the pool size, so the pool is only empty while completions are pending */
+    while (spdk_unlikely(!pool->free)) {
+        g_backend->poll(worker->qpair);
+        /* or while reads are being verified */
+        data_verify_reclaim(worker);
     }
-    printf(" ZT: %-20s", (desc->zt == SPDK_NVME_ZONE_TYPE_SEQWR) ? "SWR" : "Reserved");
-    // printf(" ZA: 0x%-18x\n", desc->za.raw);
-    printf("\n");
+    struct io_task *task = pool->free;
+    pool->free = task->next_free;
 
-    if (!desc->za.bits.zdev) {
-        return;
-    }
-    for (int i = 0; i < (int)zdes; i += 8) {
-        printf("zone_desc_ext[%d] : 0x%" PRIx64 "\n", i,
-               *(uint64_t *)(report + zd_index + zds + i));
+    if (spdk_unlikely(byte > pool->buf_byte)) {
+        task->buf = spdk_zmalloc(byte, g_block_byte, NULL, SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
+        if (!task->buf) {
+            perror("Fail to malloc replay_buf");
+            exit(1);
+        }
+        pool->num_oversize++;
     }
+
+    uint64_t now = spdk_get_ticks();
+    pool->num_get++;
+    pool->get_tsc += now - start_tsc;
+    task->submit_tsc = now;
+    return task;
 }
 
-static void report_zone(void)
+static void
+io_task_put(struct replay_worker *worker, struct io_task *task)
 {
-    int rc = 0;
-    struct ns_entry *ns_entry = TAILQ_FIRST(&g_namespaces);
-    
-    if (spdk_nvme_ns_get_csi(ns_entry->ns) != SPDK_NVME_CSI_ZNS) {
-        return;
+    struct io_task_pool *pool = &worker->pool;
+
+    if (spdk_unlikely(task->buf != task->pool_buf)) {
+        spdk_free(task->buf);
+        task->buf = task->pool_buf;
     }
+    task->tsc = UINT64_MAX;
+    task->next_free = pool->free;
+    pool->free = task;
+}
 
-    uint64_t zone_size_lba = spdk_nvme_zns_ns_get_zone_size_sectors(ns_entry->ns);
-    uint64_t total_zones = spdk_nvme_zns_ns_get_num_zones(ns_entry->ns);
+static void
+io_task_pool_merge(struct io_task_pool *pool)
+{
+    g_pool_num_get += pool->num_get;
+    g_pool_num_oversize += pool->num_oversize;
+    g_pool_get_tsc += pool->get_tsc;
+}
+/* io task pool end */
 
-    /* specify namespace and allocate io qpair for the namespace */
-    ns_entry->qpair = spdk_nvme_ctrlr_alloc_io_qpair(ns_entry->ctrlr, NULL, 0);
-    if (ns_entry->qpair == NULL) {
-        printf("ERROR: spdk_nvme_ctrlr_alloc_io_qpair() failed\n");
-        return;
-    }
+/* data pattern start */
+#define DATA_TABLE_BYTE (1024 * 1024)   /* random bytes the block patterns are taken from */
+#define DATA_MAGIC 0x54524456           /* "VDRT" */
+#define DATA_KEY_APPEND (1ULL << 63)    /* key of an appended block is zslba + block index in the command */
+#define DATA_GEN_MAX 0x7F               /* generations cycle from 1, 0 is unknown */
+#define DATA_GEN_INFLIGHT 0x80          /* a write of the LBA is in flight */
+#define DATA_ERROR_PRINT_MAX 16
 
-    const struct spdk_nvme_ns_data *nsdata = spdk_nvme_ns_get_data(ns_entry->ns);
-    const struct spdk_nvme_zns_ns_data *nsdata_zns = spdk_nvme_zns_ns_get_data(ns_entry->ns);
+/* head of every block written with a pattern, the rest of the block is derived from it */
+struct data_block_hdr {
+    uint64_t key;               /* LBA, or zslba + index | DATA_KEY_APPEND for a zone append */
+    uint32_t magic;
+    uint32_t gen;
+};
 
-    //uint32_t zrs = sizeof(struct spdk_nvme_zns_zone_report);
-    //uint32_t zds = sizeof(struct spdk_nvme_zns_zone_desc);
+enum data_verify_result {
+    DATA_VERIFY_OK = 0,
+    DATA_VERIFY_SKIP,           /* content unknown, e.g. never written or raced with a write */
+    DATA_VERIFY_ERROR,
+};
 
-    uint32_t format_index = spdk_nvme_ns_get_format_index(nsdata);
-    size_t zdes = nsdata_zns->lbafe[format_index].zdes * 64;
+static uint8_t *g_data_table = NULL;
+static uint8_t *g_data_gen = NULL;          /* generation of the last write of every LBA */
+static uint16_t *g_data_append_idx = NULL;  /* block index in the append that wrote the LBA, on ZNS */
+static uint32_t g_data_random_byte = 0;     /* bytes of a block taken from the table, the rest is zero */
+static bool g_verify_stop = false;
+static uint64_t g_verify_error_print = 0;
+static uint64_t g_verify_blk = 0;
+static uint64_t g_verify_skip = 0;
+static uint64_t g_verify_error = 0;
+/* a read or an append racing with a zone reset may see it or not, its blocks are unknown */
+static uint64_t g_data_reset_submit = 0;
+static uint64_t g_data_reset_done = 0;
 
-    size_t report_bufsize = spdk_nvme_ns_get_max_io_xfer_size(ns_entry->ns);
-    uint8_t *report_buf = calloc(1, report_bufsize);
-    if (!report_buf) {
-        printf("Zone report allocation failed!\n");
-        exit(1);
+static int
+data_pattern_init(void)
+{
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+
+    if (!g_data_pattern) {
+        return 0;
+    }
+    /* the table is over-allocated by a block, so that a pattern can start anywhere in it */
+    g_data_table = (uint8_t *)malloc(DATA_TABLE_BYTE + g_block_byte);
+    g_data_gen = (uint8_t *)calloc(g_ns_blk, sizeof(uint8_t));
+    if (g_zone) {
+        g_data_append_idx = (uint16_t *)calloc(g_ns_blk, sizeof(uint16_t));
+    }
+    if (!g_data_table || !g_data_gen || (g_zone && !g_data_append_idx)) {
+        fprintf(stderr, "Fail to allocate memory for data patterns\n");
+        return 1;
+    }
+    for (uint64_t i = 0; i < (DATA_TABLE_BYTE + g_block_byte) / sizeof(uint64_t); i++) {
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        ((uint64_t *)g_data_table)[i] = x * 0x2545F4914F6CDD1DULL;
     }
+    g_data_random_byte = (uint32_t)((uint64_t)g_block_byte * (100 - g_data_zero_pct) / 100) & ~7U;
+    g_data_random_byte = spdk_max(g_data_random_byte, (uint32_t)sizeof(struct data_block_hdr));
+    return 0;
+}
 
-    uint64_t zones_to_print = g_zone_report_limit ? spdk_min(total_zones, (uint64_t)g_zone_report_limit) : \
-	                total_zones;
-    
-    print_uline('=', printf("\nNVMe ZNS Zone Report (first %zu of %zu)\n", zones_to_print, total_zones));
+static void
+data_pattern_fini(void)
+{
+    free(g_data_table);
+    free(g_data_gen);
+    free(g_data_append_idx);
+    g_data_table = NULL;
+    g_data_gen = NULL;
+    g_data_append_idx = NULL;
+}
 
-    outstanding_commands = 0;
-    uint64_t handled_zones = 0;
-    uint64_t slba = 0;
-    struct io_task task;
-    while (handled_zones < zones_to_print) {
-        task.qpair = ns_entry->qpair;
-        task.opc = SPDK_NVME_OPC_ZONE_MGMT_RECV;    
-        task.slba = slba;
-        task.nlb = 0;
-
-        memset(report_buf, 0, report_bufsize);
-
-        if (zdes) {
-            outstanding_commands++;
-            //uint64_t max_zones_per_buf = (report_bufsize - zrs) / (zds + zdes);
-            rc = spdk_nvme_zns_ext_report_zones(ns_entry->ns, ns_entry->qpair, report_buf, report_bufsize,
-                            slba, SPDK_NVME_ZRA_LIST_ALL, true, zone_report_completion, &task);
-        } else {
-            outstanding_commands++;
-            //uint64_t max_zones_per_buf = (report_bufsize - zrs) / zds;
-            rc = spdk_nvme_zns_report_zones(ns_entry->ns, ns_entry->qpair, report_buf, report_bufsize,
-                            slba, SPDK_NVME_ZRA_LIST_ALL, true, zone_report_completion, &task);
-        }
+static uint8_t
+data_gen_next(uint8_t gen)
+{
+    gen &= DATA_GEN_MAX;
+    return gen == DATA_GEN_MAX ? 1 : gen + 1;
+}
 
-        if (rc) {
-            fprintf(stderr, "Report zones failed\n");
-            exit(1);
-        }
+/* LBAs beyond the namespace fail on the device, they have no generation */
+static bool
+data_in_ns(uint64_t slba, uint64_t nlb)
+{
+    return slba < g_ns_blk && nlb <= g_ns_blk - slba;
+}
 
-        while (outstanding_commands) {
-            spdk_nvme_qpair_process_completions(ns_entry->qpair, 0);
-        }
+/* g_data_gen is shared by the workers, every access is an atomic byte operation */
+static inline uint8_t
+data_gen_get(uint64_t lba)
+{
+    return __atomic_load_n(&g_data_gen[lba], __ATOMIC_RELAXED);
+}
 
-        for (int i = 0; handled_zones < zones_to_print; i++) {
-            print_zns_zone(report_buf, i, zdes);
-            slba += zone_size_lba;
-            handled_zones++;
-        }
-        printf("\n");
+static void
+data_gen_set(uint64_t slba, uint64_t nlb, uint8_t gen)
+{
+    for (uint64_t i = 0; i < nlb; i++) {
+        __atomic_store_n(&g_data_gen[slba + i], gen, __ATOMIC_RELAXED);
     }
+}
+
+/* bump the generation and mark it in flight, concurrent writes of the LBA get different generations */
+static uint8_t
+data_gen_bump(uint64_t lba)
+{
+    uint8_t old = data_gen_get(lba);
+    uint8_t gen;
 
-    free(report_buf);
-    spdk_nvme_ctrlr_free_io_qpair(ns_entry->qpair);
+    do {
+        gen = data_gen_next(old);
+    } while (!__atomic_compare_exchange_n(&g_data_gen[lba], &old, gen | DATA_GEN_INFLIGHT, true, __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED));
+    return gen;
 }
-/* report zone end */
 
-/* replay workload start */
+/* the write of gen completed, unless a later write of the LBA is in flight */
 static void
-replay_complete(void *cb_arg, const struct spdk_nvme_cpl *cpl)
+data_gen_written(uint64_t lba, uint8_t gen)
 {
-    struct io_task *task = (struct io_task *)cb_arg;
-    if (spdk_nvme_cpl_is_error(cpl)) {
-        spdk_nvme_qpair_print_completion(task->qpair, (struct spdk_nvme_cpl *)cpl);
-        fprintf(stderr, "Replay error - opc = 0x%x, slba = 0x%lx, nlb = %d, status = %s\n",
-                 task->opc, task->slba, task->nlb, spdk_nvme_cpl_get_status_string(&cpl->status));
-    }
+    uint8_t inflight = gen | DATA_GEN_INFLIGHT;
 
-    if (task) {
-        if (task->buf) {
-            spdk_free(task->buf);
-        }
-        free(task);
-    }
+    __atomic_compare_exchange_n(&g_data_gen[lba], &inflight, gen, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
 
-    outstanding_commands--;
+static const uint8_t *
+data_block_random(uint64_t key, uint32_t gen)
+{
+    uint64_t h = (key ^ ((uint64_t)gen << 56)) * 0x9E3779B97F4A7C15ULL;
+
+    return g_data_table + ((h >> 32) % (DATA_TABLE_BYTE / sizeof(uint64_t))) * sizeof(uint64_t);
 }
 
-static int
-process_zns_replay(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair, struct trace_io_entry *d)
+static void
+data_block_fill(uint8_t *blk, uint64_t key, uint8_t gen)
 {
-    int err = 0;
-    uint64_t slba = (uint64_t)d->cdw10 | ((uint64_t)d->cdw11 & UINT32BIT_MASK) << 32;
-    uint32_t nlb = (uint32_t)(d->cdw12 & UINT16BIT_MASK) + 1;
-    uint64_t zslba = (slba / g_zone_sz_blk) * g_zone_sz_blk;
-    
-    /* allocate data buffers for SPDK NVMe I/O operations */
-    char *replay_buf = (char *)spdk_zmalloc(nlb * g_block_byte, g_block_byte,
-                             NULL, SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
-    if (!replay_buf) {
-        perror("Fail to malloc replay_buf");
-        exit(1);
-    }   
-    
-    /* read write replay */
-    struct io_task *task = (struct io_task *)malloc(sizeof(struct io_task));
-    task->qpair = qpair;
-    task->opc = d->opc;
-    task->nlb = nlb;
-    task->buf = replay_buf;
+    struct data_block_hdr *hdr = (struct data_block_hdr *)blk;
 
-    switch (d->opc) {
-    case SPDK_NVME_OPC_READ:
-    case SPDK_NVME_OPC_COMPARE:
-        task->slba = slba;
-        memset(replay_buf, 0, (size_t)nlb * g_block_byte);
-        g_num_io++;
-        outstanding_commands++;
-        err = spdk_nvme_ns_cmd_read(ns, qpair, replay_buf, slba, nlb, replay_complete, task, 0);
-        break;
-    case SPDK_NVME_OPC_WRITE:
+    memcpy(blk, data_block_random(key, gen), g_data_random_byte);
+    memset(blk + g_data_random_byte, 0, g_block_byte - g_data_random_byte);
+    hdr->key = key;
+    hdr->magic = DATA_MAGIC;
+    hdr->gen = gen;
+}
+
+/* fill a regular write, the generation of every block is bumped and marked in flight at submit */
+static void
+data_fill_write(void *buf, uint64_t slba, uint32_t nlb)
+{
+    bool in_ns = g_data_pattern && data_in_ns(slba, nlb);
+
+    if (!g_data_pattern) {
+        snprintf((char *)buf, (size_t)nlb * g_block_byte, "%s", "Hello World!\n");
+        return;
+    }
+    for (uint32_t i = 0; i < nlb; i++) {
+        uint8_t gen = in_ns ? data_gen_bump(slba + i) : 1;
+        data_block_fill((uint8_t *)buf + (size_t)i * g_block_byte, slba + i, gen);
+    }
+}
+
+static void
+data_reset_begin(uint8_t zone_action)
+{
+    if (g_data_pattern && zone_action == SPDK_NVME_ZONE_RESET) {
+        __atomic_add_fetch(&g_data_reset_submit, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void
+data_reset_end(uint8_t zone_action)
+{
+    if (g_data_pattern && zone_action == SPDK_NVME_ZONE_RESET) {
+        __atomic_add_fetch(&g_data_reset_done, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void
+data_reset_mark(struct io_task *task)
+{
+    task->data_reset = __atomic_load_n(&g_data_reset_submit, __ATOMIC_ACQUIRE);
+    task->data_reset_raced = __atomic_load_n(&g_data_reset_done, __ATOMIC_ACQUIRE) != task->data_reset;
+}
+
+static bool
+data_reset_raced(const struct io_task *task)
+{
+    return task->data_reset_raced || __atomic_load_n(&g_data_reset_submit, __ATOMIC_ACQUIRE) != task->data_reset;
+}
+
+/* fill a zone append, its LBAs are only known at completion */
+static void
+data_fill_append(struct replay_worker *worker, struct io_task *task, uint64_t zslba, uint32_t nlb)
+{
+    if (!g_data_pattern) {
+        snprintf((char *)task->buf, (size_t)nlb * g_block_byte, "%s", "Hello World!\n");
+        return;
+    }
+    worker->data_gen = data_gen_next(worker->data_gen);
+    task->data_gen = worker->data_gen;
+    data_reset_mark(task);
+    for (uint32_t i = 0; i < nlb; i++) {
+        data_block_fill((uint8_t *)task->buf + (size_t)i * g_block_byte, (zslba + i) | DATA_KEY_APPEND,
+                        task->data_gen);
+    }
+}
+
+/* the append completed at lba, the block index of each LBA is published before its generation */
+static void
+data_append_written(struct io_task *task, uint64_t lba)
+{
+    if (data_reset_raced(task)) {
+        data_gen_set(lba, task->nlb, 0);
+        return;
+    }
+    for (uint32_t i = 0; i < task->nlb; i++) {
+        __atomic_store_n(&g_data_append_idx[lba + i], (uint16_t)i, __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    data_gen_set(lba, task->nlb, task->data_gen);
+}
+
+/* blocks zeroed by the replay, or written with an error, hold no known pattern */
+static void
+data_forget(uint64_t slba, uint64_t nlb)
+{
+    if (g_data_pattern && data_in_ns(slba, nlb)) {
+        data_gen_set(slba, nlb, 0);
+    }
+}
+
+/* remember the generations a read must return, the task keeps them until it is verified */
+static void
+data_read_submit(struct replay_worker *worker, struct io_task *task)
+{
+    task->verify_gen = NULL;
+    task->verify_idx = NULL;
+    if (!g_data_verify || task->nlb > worker->verify_gen_blk || !data_in_ns(task->slba, task->nlb)) {
+        return;
+    }
+    task->verify_gen = worker->verify_gen + (size_t)(task - worker->pool.tasks) * worker->verify_gen_blk;
+    data_reset_mark(task);
+    for (uint32_t i = 0; i < task->nlb; i++) {
+        task->verify_gen[i] = data_gen_get(task->slba + i);
+    }
+    if (g_data_append_idx) {
+        /* pairs with the release of data_append_written, the index is not older than the generation */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        task->verify_idx = worker->verify_idx + (size_t)(task - worker->pool.tasks) * worker->verify_gen_blk;
+        for (uint32_t i = 0; i < task->nlb; i++) {
+            task->verify_idx[i] = __atomic_load_n(&g_data_append_idx[task->slba + i], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/* word-wise OR, vectorized by the compiler */
+static bool
+data_is_zero(const uint8_t *buf, size_t byte)
+{
+    const uint64_t *word = (const uint64_t *)buf;
+    uint64_t acc = 0;
+
+    for (size_t i = 0; i < byte / sizeof(uint64_t); i++) {
+        acc |= word[i];
+    }
+    return acc == 0;
+}
+
+/* idx is the block index in the append that wrote the LBA, the block then holds its zslba + idx */
+static enum data_verify_result
+data_block_verify(const uint8_t *blk, uint64_t lba, uint8_t gen, uint16_t idx)
+{
+    const struct data_block_hdr *hdr = (const struct data_block_hdr *)blk;
+    bool key_match;
+
+    if (!gen) {
+        return DATA_VERIFY_SKIP;
+    }
+    if (hdr->key & DATA_KEY_APPEND) {
+        key_match = g_zone && hdr->key == ((lba - lba % g_zone_sz_blk + idx) | DATA_KEY_APPEND);
+    } else {
+        key_match = hdr->key == lba;
+    }
+    if (hdr->magic != DATA_MAGIC || !key_match || hdr->gen != gen) {
+        return DATA_VERIFY_ERROR;
+    }
+    if (memcmp(blk + sizeof(*hdr), data_block_random(hdr->key, hdr->gen) + sizeof(*hdr),
+               g_data_random_byte - sizeof(*hdr)) != 0 ||
+        !data_is_zero(blk + g_data_random_byte, g_block_byte - g_data_random_byte)) {
+        return DATA_VERIFY_ERROR;
+    }
+    return DATA_VERIFY_OK;
+}
+
+/* runs on the verifier thread */
+static void
+data_verify_task(struct replay_worker *worker, struct io_task *task)
+{
+    if (!task->verify_gen) {
+        worker->verify_skip += task->nlb;
+        return;
+    }
+    for (uint32_t i = 0; i < task->nlb; i++) {
+        const uint8_t *blk = (const uint8_t *)task->buf + (size_t)i * g_block_byte;
+        const struct data_block_hdr *hdr = (const struct data_block_hdr *)blk;
+
+        switch (data_block_verify(blk, task->slba + i, task->verify_gen[i],
+                                  task->verify_idx ? task->verify_idx[i] : 0)) {
+        case DATA_VERIFY_OK:
+            worker->verify_blk++;
+            break;
+        case DATA_VERIFY_SKIP:
+            worker->verify_skip++;
+            break;
+        default:
+            worker->verify_error++;
+            if (g_verify_error_print++ < DATA_ERROR_PRINT_MAX) {
+                fprintf(stderr, "Data mismatch - lba = 0x%lx, generation = %u, read key = 0x%lx generation = %u\n",
+                        task->slba + i, task->verify_gen[i], hdr->key, hdr->gen);
+            }
+            break;
+        }
+    }
+}
+
+static struct task_ring *
+task_ring_alloc(uint32_t num_task)
+{
+    struct task_ring *ring = NULL;
+    uint64_t size = 1;
+
+    for (; size < num_task; size <<= 1);
+    if (posix_memalign((void **)&ring, REQ_RING_ALIGN, sizeof(struct task_ring)) != 0) {
+        fprintf(stderr, "Fail to allocate memory for task ring\n");
+        return NULL;
+    }
+    ring->head = 0;
+    ring->tail = 0;
+    ring->mask = size - 1;
+    ring->task = (struct io_task **)calloc(size, sizeof(struct io_task *));
+    if (!ring->task) {
+        fprintf(stderr, "Fail to allocate memory for task ring\n");
+        free(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+static void
+task_ring_free(struct task_ring *ring)
+{
+    if (ring) {
+        free(ring->task);
+        free(ring);
+    }
+}
+
+/* never full, a task is in at most one ring */
+static void
+task_ring_push(struct task_ring *ring, struct io_task *task)
+{
+    ring->task[ring->head & ring->mask] = task;
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+static bool
+task_ring_pop(struct task_ring *ring, struct io_task **task)
+{
+    uint64_t tail = ring->tail;
+
+    if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    *task = ring->task[tail & ring->mask];
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* called from the completion callback, returns true if the task is handed to the verifier */
+static bool
+data_complete(struct replay_worker *worker, struct io_task *task, const struct spdk_nvme_cpl *cpl)
+{
+    bool error = spdk_nvme_cpl_is_error(cpl);
+
+    switch (task->opc) {
+    case SPDK_NVME_OPC_READ:
+    case SPDK_NVME_OPC_COMPARE:
+        if (!g_data_verify || error) {
+            break;
+        }
+        /* blocks written or reset while the read was in flight may hold either content */
+        bool raced = task->verify_gen && data_reset_raced(task);
+        for (uint32_t i = 0; task->verify_gen && i < task->nlb; i++) {
+            uint8_t gen = data_gen_get(task->slba + i);
+            if (raced || gen != task->verify_gen[i] || (gen & DATA_GEN_INFLIGHT)) {
+                task->verify_gen[i] = 0;
+            }
+        }
+        worker->verifying++;
+        task_ring_push(worker->verify_ring, task);
+        return true;
+    case SPDK_NVME_OPC_WRITE:
+        if (error) {
+            data_forget(task->slba, task->nlb);
+        } else if (data_in_ns(task->slba, task->nlb)) {
+            for (uint32_t i = 0; i < task->nlb; i++) {
+                const struct data_block_hdr *hdr = (const struct data_block_hdr *)((uint8_t *)task->buf +
+                                                   (size_t)i * g_block_byte);
+                data_gen_written(task->slba + i, (uint8_t)hdr->gen);
+            }
+        }
+        break;
+    case SPDK_NVME_OPC_ZONE_APPEND: {
+        uint64_t lba = (uint64_t)cpl->cdw0 | (uint64_t)cpl->cdw1 << 32;
+        /* blocks stay unknown on backends that do not return the LBA */
+        if (!error && lba >= task->slba && lba + task->nlb <= task->slba + g_zone_sz_blk &&
+            data_in_ns(lba, task->nlb)) {
+            data_append_written(task, lba);
+        }
+        break;
+    }
+    case SPDK_NVME_OPC_ZONE_MGMT_SEND:
+        if (!error && (task->cdw13 & UINT8BIT_MASK) == SPDK_NVME_ZONE_RESET) {
+            if (task->cdw13 & (uint32_t)1 << 8) {
+                data_forget(0, g_ns_blk);
+            } else {
+                data_forget(task->slba, g_zone_sz_blk);
+            }
+        }
+        data_reset_end((uint8_t)(task->cdw13 & UINT8BIT_MASK));
+        break;
+    default:
+        break;
+    }
+    return false;
+}
+
+/* give verified reads back to the pool of the worker */
+static void
+data_verify_reclaim(struct replay_worker *worker)
+{
+    struct io_task *task;
+
+    while (worker->verifying && task_ring_pop(worker->verified_ring, &task)) {
+        io_task_put(worker, task);
+        worker->verifying--;
+    }
+}
+
+/* verify the reads of all workers off their polling threads */
+static void *
+replay_verifier_run(void *arg)
+{
+    struct replay_worker *workers = (struct replay_worker *)arg;
+    struct io_task *task;
+
+    for (;;) {
+        bool idle = true;
+        for (uint32_t i = 0; i < g_num_worker; i++) {
+            while (task_ring_pop(workers[i].verify_ring, &task)) {
+                data_verify_task(&workers[i], task);
+                task_ring_push(workers[i].verified_ring, task);
+                idle = false;
+            }
+        }
+        /* workers stop after their reads come back, so the rings are empty by then */
+        if (idle && __atomic_load_n(&g_verify_stop, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+    return NULL;
+}
+/* data pattern end */
+
+/* replay latency start */
+#define RESULT_FILE_BUF_SIZE (1024 * 1024)
+
+static const char *g_opc_class_name[REPLAY_OPC_MAX] = {
+    "Read", "Write", "Zone append", "Write zeroes", "Zone mgmt", "Other"
+};
+static uint64_t g_series_start_tsc = 0;
+static uint64_t g_window_tsc = 0;
+/* aggregated from the workers after replay */
+static struct trace_io_hist g_latency_hist[REPLAY_OPC_MAX];
+static struct replay_window *g_window = NULL;
+static uint64_t g_num_window = 0;
+static struct replay_window *g_loop = NULL;
+static uint64_t g_num_loop = 0;
+
+static enum replay_opc_class
+replay_opc_class(uint16_t opc)
+{
+    switch (opc) {
+    case SPDK_NVME_OPC_READ:
+    case SPDK_NVME_OPC_COMPARE:
+        return REPLAY_OPC_READ;
+    case SPDK_NVME_OPC_WRITE:
+        return REPLAY_OPC_WRITE;
     case SPDK_NVME_OPC_ZONE_APPEND:
-        task->slba = zslba;
-        snprintf(replay_buf, (size_t)nlb * g_block_byte, "%s", "Hello World!\n");
-        g_num_io++;
-        outstanding_commands++;
-        err = spdk_nvme_zns_zone_append(ns, qpair, replay_buf, zslba, nlb, replay_complete, task, 0);
+        return REPLAY_OPC_APPEND;
+    case SPDK_NVME_OPC_WRITE_ZEROES:
+        return REPLAY_OPC_WRITE_ZEROES;
+    case SPDK_NVME_OPC_ZONE_MGMT_SEND:
+        return REPLAY_OPC_ZONE_MGMT;
+    default:
+        return REPLAY_OPC_OTHER;
+    }
+}
+
+static void
+replay_latency_start(void)
+{
+    g_series_start_tsc = spdk_get_ticks();
+    g_window_tsc = g_window_ms * spdk_get_ticks_hz() / 1000;
+}
+
+static int
+replay_window_grow(struct replay_window **window, uint64_t *num_window, uint64_t idx)
+{
+    if (idx < *num_window) {
+        return 0;
+    }
+    uint64_t num = spdk_max(idx + 1, *num_window * 2);
+    struct replay_window *buf = (struct replay_window *)realloc(*window, num * sizeof(struct replay_window));
+    if (!buf) {
+        fprintf(stderr, "Fail to allocate memory for replay statistics\n");
+        return 1;
+    }
+    memset(&buf[*num_window], 0, (num - *num_window) * sizeof(struct replay_window));
+    *window = buf;
+    *num_window = num;
+    return 0;
+}
+
+static void
+replay_result_write(struct replay_worker *worker, struct io_task *task, bool complete,
+                    uint64_t tsc, const struct spdk_nvme_cpl *cpl)
+{
+    struct trace_io_entry entry;
+
+    memset(&entry, 0, sizeof(entry));
+    entry.lcore = task->lcore;
+    entry.tsc_rate = spdk_get_ticks_hz();
+    entry.tsc_timestamp = tsc;
+    entry.obj_id = task->obj_id;
+    entry.tsc_obj_submit = task->submit_tsc;
+    entry.tsc_sc_time = complete ? tsc - task->submit_tsc : 0;
+    snprintf(entry.tpoint_name, sizeof(entry.tpoint_name), "%s", complete ? "NVME_IO_COMPLETE" : "NVME_IO_SUBMIT");
+    entry.opc = task->opc;
+    entry.nsid = g_geo.nsid;
+    if (cpl) {
+        uint16_t status;
+        memcpy(&status, &cpl->status, sizeof(status));
+        entry.cid = cpl->cid;
+        entry.cpl = status;
+    }
+    entry.cdw10 = (uint32_t)task->slba;
+    entry.cdw11 = (uint32_t)(task->slba >> 32);
+    entry.cdw12 = task->nlb ? task->nlb - 1 : 0;
+    entry.cdw13 = task->cdw13;
+
+    if (fwrite(&entry, sizeof(entry), 1, worker->result) != 1) {
+        fprintf(stderr, "Fail to write result file\n");
+        fclose(worker->result);
+        worker->result = NULL;
+    }
+}
+
+/* called from the completion callback */
+static void
+replay_latency_record(struct replay_worker *worker, struct io_task *task, const struct spdk_nvme_cpl *cpl)
+{
+    uint64_t now = spdk_get_ticks();
+    uint64_t latency = now - task->submit_tsc;
+
+    trace_io_hist_record(&worker->latency_hist[replay_opc_class(task->opc)], latency);
+
+    if (g_window_tsc) {
+        uint64_t idx = (now - g_series_start_tsc) / g_window_tsc;
+        if (replay_window_grow(&worker->window, &worker->num_window, idx) == 0) {
+            struct replay_window *w = &worker->window[idx];
+            w->count++;
+            w->byte += (uint64_t)task->nlb * g_block_byte;
+            w->latency_sum += latency;
+            w->latency_max = spdk_max(w->latency_max, latency);
+        }
+    }
+
+    if (g_loop_count > 1 || g_loop_duration_s > 0) {
+        if (replay_window_grow(&worker->loop, &worker->num_loop, task->loop) == 0) {
+            struct replay_window *w = &worker->loop[task->loop];
+            w->count++;
+            w->byte += (uint64_t)task->nlb * g_block_byte;
+            w->latency_sum += latency;
+            w->latency_max = spdk_max(w->latency_max, latency);
+            w->start_tsc = w->start_tsc ? spdk_min(w->start_tsc, task->submit_tsc) : task->submit_tsc;
+            w->end_tsc = now;
+        }
+    }
+
+    if (worker->result) {
+        replay_result_write(worker, task, true, now, cpl);
+    }
+}
+
+static int
+replay_result_open(struct replay_worker *worker)
+{
+    if (!g_result_file_name) {
+        return 0;
+    }
+
+    /* with several workers each one writes its own file, merged after replay */
+    if (g_num_worker == 1) {
+        snprintf(worker->result_name, sizeof(worker->result_name), "%s", g_result_file_name);
+    } else {
+        snprintf(worker->result_name, sizeof(worker->result_name), "%s.%u", g_result_file_name, worker->index);
+    }
+    worker->result = fopen(worker->result_name, "wb");
+    if (worker->result == NULL) {
+        fprintf(stderr, "Failed to open result file %s\n", worker->result_name);
+        return 1;
+    }
+    setvbuf(worker->result, NULL, _IOFBF, RESULT_FILE_BUF_SIZE);
+    return 0;
+}
+
+/* merge the per worker result files by timestamp, each of them is already sorted */
+static int
+replay_result_merge(struct replay_worker *workers)
+{
+    struct trace_io_entry head[WORKER_MAX];
+    bool valid[WORKER_MAX] = {false};
+    FILE *in[WORKER_MAX] = {NULL};
+    int rc = 0;
+
+    if (!g_result_file_name || g_num_worker == 1) {
+        return 0;
+    }
+
+    FILE *out = fopen(g_result_file_name, "wb");
+    if (out == NULL) {
+        fprintf(stderr, "Failed to open result file %s\n", g_result_file_name);
+        return 1;
+    }
+    setvbuf(out, NULL, _IOFBF, RESULT_FILE_BUF_SIZE);
+
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        in[i] = fopen(workers[i].result_name, "rb");
+        if (in[i] == NULL) {
+            fprintf(stderr, "Failed to open result file %s\n", workers[i].result_name);
+            rc = 1;
+            goto out;
+        }
+        valid[i] = fread(&head[i], sizeof(struct trace_io_entry), 1, in[i]) == 1;
+    }
+
+    for (;;) {
+        int min = -1;
+        for (uint32_t i = 0; i < g_num_worker; i++) {
+            if (valid[i] && (min < 0 || head[i].tsc_timestamp < head[min].tsc_timestamp)) {
+                min = i;
+            }
+        }
+        if (min < 0) {
+            break;
+        }
+        if (fwrite(&head[min], sizeof(struct trace_io_entry), 1, out) != 1) {
+            fprintf(stderr, "Fail to write result file\n");
+            rc = 1;
+            goto out;
+        }
+        valid[min] = fread(&head[min], sizeof(struct trace_io_entry), 1, in[min]) == 1;
+    }
+
+out:
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        if (in[i]) {
+            fclose(in[i]);
+            remove(workers[i].result_name);
+        }
+    }
+    fclose(out);
+    return rc;
+}
+
+static void
+replay_latency_merge(struct replay_worker *worker)
+{
+    for (uint32_t i = 0; i < REPLAY_OPC_MAX; i++) {
+        trace_io_hist_merge(&g_latency_hist[i], &worker->latency_hist[i]);
+    }
+    if (worker->num_window && replay_window_grow(&g_window, &g_num_window, worker->num_window - 1) == 0) {
+        for (uint64_t i = 0; i < worker->num_window; i++) {
+            g_window[i].count += worker->window[i].count;
+            g_window[i].byte += worker->window[i].byte;
+            g_window[i].latency_sum += worker->window[i].latency_sum;
+            g_window[i].latency_max = spdk_max(g_window[i].latency_max, worker->window[i].latency_max);
+        }
+    }
+    if (worker->num_loop && replay_window_grow(&g_loop, &g_num_loop, worker->num_loop - 1) == 0) {
+        for (uint64_t i = 0; i < worker->num_loop; i++) {
+            struct replay_window *src = &worker->loop[i], *dst = &g_loop[i];
+            if (!src->count) {
+                continue;
+            }
+            dst->start_tsc = dst->count ? spdk_min(dst->start_tsc, src->start_tsc) : src->start_tsc;
+            dst->end_tsc = spdk_max(dst->end_tsc, src->end_tsc);
+            dst->count += src->count;
+            dst->byte += src->byte;
+            dst->latency_sum += src->latency_sum;
+            dst->latency_max = spdk_max(dst->latency_max, src->latency_max);
+        }
+    }
+    if (worker->result) {
+        fclose(worker->result);
+        worker->result = NULL;
+    }
+}
+
+static void
+print_replay_latency(void)
+{
+    print_uline('=', printf("\nReplay Latency (us)\n"));
+    for (uint32_t i = 0; i < REPLAY_OPC_MAX; i++) {
+        struct trace_io_hist *hist = &g_latency_hist[i];
+        if (!hist->count) {
+            continue;
+        }
+        printf("%-16s: %-10ju AVG %-10.3f P50 %-10.3f P99 %-10.3f P99.9 %-10.3f MAX %-10.3f\n",
+               g_opc_class_name[i], hist->count,
+               get_us_from_tick(trace_io_hist_mean(hist)),
+               get_us_from_tick(trace_io_hist_percentile(hist, 50)),
+               get_us_from_tick(trace_io_hist_percentile(hist, 99)),
+               get_us_from_tick(trace_io_hist_percentile(hist, 99.9)),
+               get_us_from_tick(hist->max));
+    }
+
+    if (!g_window_tsc || !g_num_window) {
+        return;
+    }
+    /* drop empty windows at the end */
+    uint64_t num_window = g_num_window;
+    while (num_window && !g_window[num_window - 1].count) {
+        num_window--;
+    }
+    print_uline('=', printf("\nReplay Time-series (window %ju ms)\n", g_window_ms));
+    printf("%12s %12s %12s %14s %14s\n", "Time (ms)", "IOPS", "MB/s", "Lat avg (us)", "Lat max (us)");
+    for (uint64_t i = 0; i < num_window; i++) {
+        struct replay_window *w = &g_window[i];
+        printf("%12ju %12.1f %12.3f %14.3f %14.3f\n", i * g_window_ms,
+               w->count * 1000.0 / g_window_ms, w->byte / 1000.0 / g_window_ms,
+               w->count ? get_us_from_tick((double)w->latency_sum / w->count) : 0,
+               get_us_from_tick(w->latency_max));
+    }
+}
+
+/* per iteration of the trace, shows the drift to steady state over a long replay */
+static void
+print_replay_loop(void)
+{
+    if (!g_num_loop) {
+        return;
+    }
+    print_uline('=', printf("\nReplay Iterations\n"));
+    printf("%8s %12s %12s %12s %12s %14s %14s\n", "Loop", "End (ms)", "Time (ms)", "IOPS", "MB/s",
+           "Lat avg (us)", "Lat max (us)");
+    for (uint64_t i = 0; i < g_num_loop; i++) {
+        struct replay_window *w = &g_loop[i];
+        float us = get_us_from_tick(w->end_tsc - w->start_tsc);
+        if (!w->count) {
+            continue;
+        }
+        printf("%8ju %12.3f %12.3f %12.1f %12.3f %14.3f %14.3f\n", i,
+               get_us_from_tick(w->end_tsc - g_series_start_tsc) / 1000, us / 1000,
+               us > 0 ? w->count * 1000000.0 / us : 0, us > 0 ? w->byte / us : 0,
+               get_us_from_tick((double)w->latency_sum / w->count), get_us_from_tick(w->latency_max));
+    }
+}
+/* replay latency end */
+
+/* replay workload start */
+/*
+ * Take the zone for one write or zone management command. Waits while a command is in flight on the
+ * zone, completions of the worker are polled meanwhile.
+ */
+static void
+zone_acquire(struct replay_worker *worker, uint64_t zone)
+{
+    struct zone_info *zi = &g_zone_info[zone];
+    uint64_t start_tsc = 0;
+    bool idle = false;
+
+    while (!__atomic_compare_exchange_n(&zi->busy, &idle, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        idle = false;
+        if (!start_tsc) {
+            start_tsc = spdk_get_ticks();
+        }
+        g_backend->poll(worker->qpair);
+    }
+    if (start_tsc) {
+        worker->zone_wait_tsc += spdk_get_ticks() - start_tsc;
+    }
+}
+
+static void
+zone_release(uint64_t zone)
+{
+    __atomic_store_n(&g_zone_info[zone].busy, false, __ATOMIC_RELEASE);
+}
+
+/* select-all commands hold every zone, zones are taken in order so that two of them do not deadlock */
+static void
+zone_acquire_all(struct replay_worker *worker)
+{
+    for (uint64_t i = 0; i < g_num_zone; i++) {
+        zone_acquire(worker, i);
+    }
+}
+
+static void
+zone_release_all(void)
+{
+    for (uint64_t i = 0; i < g_num_zone; i++) {
+        zone_release(i);
+    }
+}
+
+/*
+ * Zone states of the replay follow the ZNS state machine like the controller does, so that ordered
+ * writes stay within the open and active zone limits. Changed under g_zone_lock.
+ */
+static bool
+zone_is_open(uint8_t state)
+{
+    return state == SPDK_NVME_ZONE_STATE_IOPEN || state == SPDK_NVME_ZONE_STATE_EOPEN;
+}
+
+static bool
+zone_is_active(uint8_t state)
+{
+    return zone_is_open(state) || state == SPDK_NVME_ZONE_STATE_CLOSED;
+}
+
+/* change the state of a zone and keep the open and active counts */
+static void
+zone_set(uint64_t zone, uint8_t state)
+{
+    struct zone_info *zi = &g_zone_info[zone];
+
+    g_zone_num_open += (uint32_t)zone_is_open(state) - (uint32_t)zone_is_open(zi->state);
+    g_zone_num_active += (uint32_t)zone_is_active(state) - (uint32_t)zone_is_active(zi->state);
+    zi->state = state;
+}
+
+/* the controller may close an implicitly opened zone to open another one, closed tells which */
+static bool
+zone_close_implicit(uint64_t *closed)
+{
+    for (uint64_t i = 0; i < g_num_zone; i++) {
+        uint64_t zone = (g_zone_close_cursor + i) % g_num_zone;
+        if (g_zone_info[zone].state == SPDK_NVME_ZONE_STATE_IOPEN) {
+            zone_set(zone, SPDK_NVME_ZONE_STATE_CLOSED);
+            g_zone_close_cursor = zone + 1;
+            if (closed) {
+                *closed = zone;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/* open an empty, closed or open zone within the open and active limits */
+static bool
+zone_open(uint64_t zone, bool explicit, uint64_t *closed)
+{
+    uint8_t state = g_zone_info[zone].state;
+    uint8_t next = explicit ? SPDK_NVME_ZONE_STATE_EOPEN : SPDK_NVME_ZONE_STATE_IOPEN;
+
+    if (zone_is_open(state)) {
+        if (explicit) {
+            zone_set(zone, next);
+        }
+        return true;
+    }
+    if (state != SPDK_NVME_ZONE_STATE_EMPTY && state != SPDK_NVME_ZONE_STATE_CLOSED) {
+        return false;
+    }
+    if (state == SPDK_NVME_ZONE_STATE_EMPTY && g_max_active_zone && g_zone_num_active >= g_max_active_zone) {
+        return false;
+    }
+    if (g_max_open_zone && g_zone_num_open >= g_max_open_zone && !zone_close_implicit(closed)) {
+        return false;
+    }
+    zone_set(zone, next);
+    return true;
+}
+
+/* a write that fills the zone releases its open and active slot on completion */
+static bool
+zone_write_fills(uint64_t zone, uint64_t slba, uint32_t nlb)
+{
+    return slba - zone * g_zone_sz_blk + nlb == g_zone_info[zone].cap;
+}
+
+/*
+ * Open the acquired zone for a write of nlb blocks at the replay write pointer. While the limits are
+ * reached, waits for commands in flight that may close or finish zones. Returns false if the write
+ * does not fit into the zone or into the limits. prev and closed record what zone_write_undo needs.
+ */
+static bool
+zone_write_begin(struct replay_worker *worker, uint64_t zone, uint32_t nlb, uint8_t *prev, uint64_t *closed)
+{
+    struct zone_info *zi = &g_zone_info[zone];
+    uint64_t start_tsc = 0;
+    bool open;
+
+    if (zi->wp + nlb > zi->cap) {
+        return false;
+    }
+    *closed = UINT64_MAX;
+    for (;;) {
+        uint32_t freeing = __atomic_load_n(&g_zone_freeing, __ATOMIC_ACQUIRE);
+        pthread_mutex_lock(&g_zone_lock);
+        *prev = zi->state;
+        open = zone_open(zone, false, closed);
+        pthread_mutex_unlock(&g_zone_lock);
+        if (open || !freeing) {
+            break;
+        }
+        if (!start_tsc) {
+            start_tsc = spdk_get_ticks();
+        }
+        g_backend->poll(worker->qpair);
+    }
+    if (start_tsc) {
+        worker->zone_wait_tsc += spdk_get_ticks() - start_tsc;
+    }
+    if (open && zi->wp + nlb == zi->cap) {
+        __atomic_add_fetch(&g_zone_freeing, 1, __ATOMIC_RELAXED);
+    }
+    return open;
+}
+
+/* the write was never submitted, put back the zone states zone_write_begin changed */
+static void
+zone_write_undo(uint64_t zone, uint8_t prev, uint64_t closed)
+{
+    pthread_mutex_lock(&g_zone_lock);
+    zone_set(zone, prev);
+    if (closed != UINT64_MAX && g_zone_info[closed].state == SPDK_NVME_ZONE_STATE_CLOSED) {
+        zone_set(closed, SPDK_NVME_ZONE_STATE_IOPEN);
+    }
+    pthread_mutex_unlock(&g_zone_lock);
+}
+
+/* finish an ordered write on completion or failed submission, and release the zone */
+static void
+zone_write_end(uint64_t zone, uint64_t slba, uint32_t nlb, bool written)
+{
+    bool fill = zone_write_fills(zone, slba, nlb);
+
+    if (!written) {
+        /* the zone is held, nothing else moved the write pointer since */
+        g_zone_info[zone].wp -= nlb;
+    } else if (fill) {
+        pthread_mutex_lock(&g_zone_lock);
+        zone_set(zone, SPDK_NVME_ZONE_STATE_FULL);
+        pthread_mutex_unlock(&g_zone_lock);
+    }
+    if (fill) {
+        __atomic_sub_fetch(&g_zone_freeing, 1, __ATOMIC_RELEASE);
+    }
+    zone_release(zone);
+}
+
+/* zone management send on one zone of the replay, select_all skips zones the action does not apply to */
+static void
+zone_mgmt_apply(uint64_t zone, uint8_t action, bool select_all)
+{
+    struct zone_info *zi = &g_zone_info[zone];
+    uint8_t state = zi->state;
+
+    switch (action) {
+    case SPDK_NVME_ZONE_OPEN:
+        if (!select_all || state == SPDK_NVME_ZONE_STATE_CLOSED) {
+            zone_open(zone, true, NULL);
+        }
+        break;
+    case SPDK_NVME_ZONE_CLOSE:
+        if (zone_is_open(state)) {
+            zone_set(zone, zi->wp ? SPDK_NVME_ZONE_STATE_CLOSED : SPDK_NVME_ZONE_STATE_EMPTY);
+        }
+        break;
+    case SPDK_NVME_ZONE_FINISH:
+        if (zone_is_active(state) || (!select_all && state == SPDK_NVME_ZONE_STATE_EMPTY)) {
+            zi->wp = zi->cap;
+            zone_set(zone, SPDK_NVME_ZONE_STATE_FULL);
+        }
+        break;
+    case SPDK_NVME_ZONE_RESET:
+        if (zone_is_active(state) || state == SPDK_NVME_ZONE_STATE_FULL) {
+            zi->wp = 0;
+            zone_set(zone, SPDK_NVME_ZONE_STATE_EMPTY);
+        }
+        break;
+    case SPDK_NVME_ZONE_OFFLINE:
+        if (state == SPDK_NVME_ZONE_STATE_RONLY) {
+            zone_set(zone, SPDK_NVME_ZONE_STATE_OFFLINE);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* every zone management action but open may close or finish zones */
+static bool
+zone_mgmt_frees(uint8_t action)
+{
+    return action != SPDK_NVME_ZONE_OPEN;
+}
+
+/* finish a zone management command on completion or failed submission, and release its zones */
+static void
+zone_mgmt_end(uint64_t zone, uint8_t action, bool select_all, bool done)
+{
+    if (done) {
+        pthread_mutex_lock(&g_zone_lock);
+        for (uint64_t i = select_all ? 0 : zone; i < (select_all ? g_num_zone : zone + 1); i++) {
+            zone_mgmt_apply(i, action, select_all);
+        }
+        pthread_mutex_unlock(&g_zone_lock);
+    }
+    if (zone_mgmt_frees(action)) {
+        __atomic_sub_fetch(&g_zone_freeing, 1, __ATOMIC_RELEASE);
+    }
+    if (select_all) {
+        zone_release_all();
+    } else {
+        zone_release(zone);
+    }
+}
+
+/* update the zone table when an ordered write or zone management command completes */
+static void
+zone_complete(struct io_task *task, const struct spdk_nvme_cpl *cpl)
+{
+    uint64_t zone = task->slba / g_zone_sz_blk;
+    bool error = spdk_nvme_cpl_is_error(cpl);
+
+    if (task->opc == SPDK_NVME_OPC_WRITE) {
+        zone_write_end(zone, task->slba, task->nlb, !error);
+        return;
+    }
+    zone_mgmt_end(zone, (uint8_t)(task->cdw13 & UINT8BIT_MASK), (task->cdw13 & (uint32_t)1 << 8) ? true : false,
+                  !error);
+}
+
+static void
+replay_complete(void *cb_arg, const struct spdk_nvme_cpl *cpl)
+{
+    struct io_task *task = (struct io_task *)cb_arg;
+    if (spdk_nvme_cpl_is_error(cpl)) {
+        fprintf(stderr, "Replay error - opc = 0x%x, slba = 0x%lx, nlb = %d, status = %s\n",
+                 task->opc, task->slba, task->nlb, spdk_nvme_cpl_get_status_string(&cpl->status));
+    }
+
+    struct replay_worker *worker = task->worker;
+    if (g_zone_ordered && (task->opc == SPDK_NVME_OPC_WRITE || task->opc == SPDK_NVME_OPC_ZONE_MGMT_SEND)) {
+        zone_complete(task, cpl);
+    }
+    dep_release(worker, task);
+    replay_latency_record(worker, task, cpl);
+    if (!g_data_pattern || !data_complete(worker, task, cpl)) {
+        io_task_put(worker, task);
+    }
+    worker->outstanding--;
+}
+
+static int
+process_zns_replay(struct replay_worker *worker, struct replay_req *req)
+{
+    struct replay_qpair *qpair = worker->qpair;
+    int err = 0;
+    uint64_t slba = req->slba;
+    uint32_t nlb = req->nlb;
+    uint64_t zone = slba / g_zone_sz_blk;
+    uint64_t zslba = zone * g_zone_sz_blk;
+
+    /* get task and data buffer from the pool */
+    uint64_t num_io = worker->num_io;
+    struct io_task *task = io_task_get(worker, nlb);
+    char *replay_buf = (char *)task->buf;
+
+    /* read write replay */
+    task->qpair = qpair;
+    task->worker = worker;
+    task->opc = req->opc;
+    task->lcore = req->lcore;
+    task->loop = req->loop;
+    task->dep = req->dep;
+    task->tsc = req->tsc;
+    task->cdw13 = req->cdw13;
+    task->obj_id = (uint64_t)worker->index << 48 | num_io;
+    task->nlb = nlb;
+
+    switch (req->opc) {
+    case SPDK_NVME_OPC_READ:
+    case SPDK_NVME_OPC_COMPARE:
+        task->slba = slba;
+        data_read_submit(worker, task);
+        worker->num_io++;
+        worker->outstanding++;
+        err = g_backend->read(qpair, replay_buf, slba, nlb, replay_complete, task);
+        break;
+    case SPDK_NVME_OPC_WRITE:
+        if (g_zone_ordered) {
+            /* one write in flight per zone, at the write pointer of the replay */
+            zone_acquire(worker, zone);
+            struct zone_info *zi = &g_zone_info[zone];
+            uint64_t closed;
+            uint8_t prev;
+            if (zi->wp != slba - zslba) {
+                worker->wp_mismatch++;
+            }
+            if (!zone_write_begin(worker, zone, nlb, &prev, &closed)) {
+                worker->zone_skip++;
+                zone_release(zone);
+                break;
+            }
+            task->slba = zslba + zi->wp;
+            zi->wp += nlb;
+            data_fill_write(replay_buf, task->slba, nlb);
+            worker->num_io++;
+            worker->outstanding++;
+            err = g_backend->write(qpair, replay_buf, task->slba, nlb, replay_complete, task);
+            if (err) {
+                zone_write_undo(zone, prev, closed);
+                zone_write_end(zone, task->slba, nlb, false);
+            }
+            break;
+        }
+        /* fall through */
+    case SPDK_NVME_OPC_ZONE_APPEND:
+        task->slba = zslba;
+        task->opc = SPDK_NVME_OPC_ZONE_APPEND;
+        data_fill_append(worker, task, zslba, nlb);
+        worker->num_io++;
+        worker->outstanding++;
+        err = g_backend->zone_append(qpair, replay_buf, zslba, nlb, replay_complete, task);
+        break;
+    case SPDK_NVME_OPC_ZONE_MGMT_SEND:
+        task->slba = zslba;
+        bool select_all = (req->cdw13 & (uint32_t)1 << 8) ? true : false;
+        uint8_t zone_action = (uint8_t)(req->cdw13 & UINT8BIT_MASK);
+        if (g_zone_ordered) {
+            /* a select-all command changes every zone, no write may be in flight meanwhile */
+            if (select_all) {
+                zone_acquire_all(worker);
+            } else {
+                zone_acquire(worker, zone);
+            }
+            if (zone_mgmt_frees(zone_action)) {
+                __atomic_add_fetch(&g_zone_freeing, 1, __ATOMIC_RELAXED);
+            }
+        }
+        switch (zone_action) {
+        case SPDK_NVME_ZONE_OPEN:
+        case SPDK_NVME_ZONE_CLOSE:
+        case SPDK_NVME_ZONE_FINISH:
+        case SPDK_NVME_ZONE_RESET:
+        case SPDK_NVME_ZONE_OFFLINE:
+            worker->num_io++;
+            worker->outstanding++;
+            data_reset_begin(zone_action);
+            err = g_backend->zone_mgmt(qpair, zslba, zone_action, select_all, replay_complete, task);
+            if (err) {
+                data_reset_end(zone_action);
+            }
+            break;
+        default:
+            break;
+        }
+        if (g_zone_ordered && (err || worker->num_io == num_io)) {
+            zone_mgmt_end(zone, zone_action, select_all, false);
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (err) {
+            fprintf(stderr, "Replay failed, err = %d\n", err);
+            worker->num_io--;
+            worker->outstanding--;
+    }
+    /* nothing submitted, e.g. unsupported opcode */
+    if (worker->num_io == num_io) {
+        dep_release(worker, task);
+        io_task_put(worker, task);
+    } else if (worker->result) {
+        replay_result_write(worker, task, false, task->submit_tsc, NULL);
+    }
+    return err;
+}
+
+static int
+process_replay(struct replay_worker *worker, struct replay_req *req)
+{
+    struct replay_qpair *qpair = worker->qpair;
+    int err = 0;
+    uint64_t slba = req->slba;
+    uint32_t nlb = req->nlb;
+
+    /* get task and data buffer from the pool */
+    uint64_t num_io = worker->num_io;
+    struct io_task *task = io_task_get(worker, nlb);
+    char *replay_buf = (char *)task->buf;
+
+    /* read write replay */
+    task->qpair = qpair;
+    task->worker = worker;
+    task->opc = req->opc;
+    task->lcore = req->lcore;
+    task->loop = req->loop;
+    task->dep = req->dep;
+    task->tsc = req->tsc;
+    task->cdw13 = req->cdw13;
+    task->obj_id = (uint64_t)worker->index << 48 | num_io;
+    task->slba = slba;
+    task->nlb = nlb;
+
+    switch (req->opc) {
+    case SPDK_NVME_OPC_READ:
+    case SPDK_NVME_OPC_COMPARE:
+        data_read_submit(worker, task);
+        worker->num_io++;
+        worker->outstanding++;
+        err = g_backend->read(qpair, replay_buf, slba, nlb, replay_complete, task);
+        break;
+    case SPDK_NVME_OPC_WRITE:
+        data_fill_write(replay_buf, slba, nlb);
+        worker->num_io++;
+        worker->outstanding++;
+        err = g_backend->write(qpair, replay_buf, slba, nlb, replay_complete, task);
+        break;
+    case SPDK_NVME_OPC_WRITE_ZEROES:
+        data_forget(slba, nlb);
+        worker->num_io++;
+        worker->outstanding++;
+        err = g_backend->write_zeroes(qpair, slba, nlb, replay_complete, task);
+        break;
+    default:
+        break; 
+    }
+
+    if (err) {
+            fprintf(stderr, "Replay failed, err = %d\n", err);
+            worker->num_io--;
+            worker->outstanding--;
+    }
+    /* nothing submitted, e.g. unsupported opcode */
+    if (worker->num_io == num_io) {
+        dep_release(worker, task);
+        io_task_put(worker, task);
+    } else if (worker->result) {
+        replay_result_write(worker, task, false, task->submit_tsc, NULL);
+    }
+    return err;
+}
+/* replay workload end */
+
+/* dependency tracking start */
+/*
+ * Requests are indexed in a hash of LBA chunks (zones on ZNS) from arrival until completion, a
+ * request registers in every chunk it spans. A request depends on every earlier one it overlaps,
+ * unless both are reads or both are zone appends; zone appends, writes and management cover their
+ * whole zone, select all management everything. Dependent requests are held by their worker until
+ * the earlier ones complete while later independent ones go ahead. Held requests stay in the index,
+ * so that requests of other workers arriving later are ordered after them.
+ */
+#define DEP_BUCKET 4096
+#define DEP_HOLD_MAX 64             /* held requests before the worker stops reading ahead */
+
+TAILQ_HEAD(dep_list, dep_node);
+TAILQ_HEAD(dep_order, dep_entry);
+static struct dep_list g_dep_bucket[DEP_BUCKET];
+static struct dep_order g_dep_order;        /* all indexed requests, in arrival order */
+static struct dep_order g_dep_all;          /* indexed select all zone management, in arrival order */
+static bool g_dep_lock = false;
+static uint64_t g_dep_chunk_blk = DEP_CHUNK_BLK;
+static uint64_t g_dep_seq = 0;
+static uint64_t g_dep_release_gen = 0;      /* bumped on every release, held requests only change then */
+static uint64_t g_dep_held = 0;
+static uint64_t g_dep_hold_tsc = 0;
+
+static inline void
+dep_lock(void)
+{
+    while (__atomic_exchange_n(&g_dep_lock, true, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(&g_dep_lock, __ATOMIC_RELAXED));
+    }
+}
+
+static inline void
+dep_unlock(void)
+{
+    __atomic_store_n(&g_dep_lock, false, __ATOMIC_RELEASE);
+}
+
+static void
+dep_init(void)
+{
+    for (uint32_t i = 0; i < DEP_BUCKET; i++) {
+        TAILQ_INIT(&g_dep_bucket[i]);
+    }
+    TAILQ_INIT(&g_dep_order);
+    TAILQ_INIT(&g_dep_all);
+    /* a whole zone always falls into one chunk */
+    if (g_zone) {
+        g_dep_chunk_blk = g_zone_sz_blk * ((DEP_CHUNK_BLK + g_zone_sz_blk - 1) / g_zone_sz_blk);
+    }
+}
+
+static void
+dep_interval(const struct replay_req *req, struct dep_interval *dep)
+{
+    uint64_t zslba = g_zone ? req->slba / g_zone_sz_blk * g_zone_sz_blk : 0;
+
+    dep->slba = req->slba;
+    dep->end = req->slba + spdk_max(req->nlb, 1u);
+    switch (replay_opc_class(req->opc)) {
+    case REPLAY_OPC_READ:
+        dep->kind = DEP_READ;
+        return;
+    case REPLAY_OPC_WRITE:
+        /* replayed as a zone append, or at the write pointer of the replay */
+        dep->kind = g_zone && !g_zone_ordered ? DEP_APPEND : DEP_WRITE;
+        break;
+    case REPLAY_OPC_APPEND:
+        dep->kind = DEP_APPEND;
+        break;
+    case REPLAY_OPC_WRITE_ZEROES:
+        dep->kind = DEP_WRITE;
+        return;
+    case REPLAY_OPC_ZONE_MGMT:
+        dep->kind = (req->cdw13 & (uint32_t)1 << 8) ? DEP_ALL : DEP_WRITE;
+        break;
+    default:
+        dep->kind = DEP_NONE;
+        return;
+    }
+    if (g_zone) {
+        dep->slba = zslba;
+        dep->end = zslba + g_zone_sz_blk;
+    }
+}
+
+static inline bool
+dep_conflict(const struct dep_interval *a, const struct dep_interval *b)
+{
+    if (a->kind == DEP_ALL || b->kind == DEP_ALL) {
+        return true;
+    }
+    if (a->kind == b->kind && (a->kind == DEP_READ || a->kind == DEP_APPEND)) {
+        return false;
+    }
+    return a->slba < b->end && b->slba < a->end;
+}
+
+/* no earlier request it depends on is still indexed, called with the lock held */
+static bool
+dep_ready(struct dep_entry *entry)
+{
+    struct dep_entry *all = TAILQ_FIRST(&g_dep_all);
+
+    if (entry->dep.kind == DEP_ALL) {
+        return TAILQ_FIRST(&g_dep_order) == entry;
+    }
+    if (all && all->seq < entry->seq) {
+        return false;
+    }
+    for (uint32_t i = 0; i < entry->num_node; i++) {
+        struct dep_node *node;
+        TAILQ_FOREACH(node, &g_dep_bucket[(entry->dep.slba / g_dep_chunk_blk + i) % DEP_BUCKET], link) {
+            if (node->entry->seq < entry->seq && dep_conflict(&entry->dep, &node->entry->dep)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* called with the lock held */
+static void
+dep_insert(struct dep_entry *entry)
+{
+    entry->seq = g_dep_seq++;
+    entry->num_node = 0;
+    TAILQ_INSERT_TAIL(&g_dep_order, entry, order);
+    if (entry->dep.kind == DEP_ALL) {
+        TAILQ_INSERT_TAIL(&g_dep_all, entry, all);
+        return;
+    }
+    for (uint64_t chunk = entry->dep.slba / g_dep_chunk_blk; chunk <= (entry->dep.end - 1) / g_dep_chunk_blk;
+         chunk++) {
+        struct dep_node *node = &entry->node[entry->num_node++];
+        node->entry = entry;
+        TAILQ_INSERT_TAIL(&g_dep_bucket[chunk % DEP_BUCKET], node, link);
+    }
+}
+
+/* the request completed or was not submitted, the requests depending on it may go */
+static void
+dep_release(struct replay_worker *worker, struct io_task *task)
+{
+    struct dep_entry *entry = task->dep;
+    uint64_t chunk;
+
+    if (!entry) {
+        return;
+    }
+    task->dep = NULL;
+    dep_lock();
+    TAILQ_REMOVE(&g_dep_order, entry, order);
+    if (entry->dep.kind == DEP_ALL) {
+        TAILQ_REMOVE(&g_dep_all, entry, all);
+    }
+    chunk = entry->dep.slba / g_dep_chunk_blk;
+    for (uint32_t i = 0; i < entry->num_node; i++, chunk++) {
+        TAILQ_REMOVE(&g_dep_bucket[chunk % DEP_BUCKET], &entry->node[i], link);
+    }
+    g_dep_release_gen++;
+    dep_unlock();
+    entry->next_free = worker->dep_free;
+    worker->dep_free = entry;
+}
+
+static int
+dep_worker_init(struct replay_worker *worker)
+{
+    /* one per outstanding or held request */
+    uint32_t num_entry = g_queue_depth + DEP_HOLD_MAX;
+
+    worker->dep_entries = (struct dep_entry *)calloc(num_entry, sizeof(struct dep_entry));
+    worker->hold = (struct dep_hold *)calloc(DEP_HOLD_MAX, sizeof(struct dep_hold));
+    if (!worker->dep_entries || !worker->hold) {
+        fprintf(stderr, "Fail to allocate memory for dependency tracking\n");
+        return 1;
+    }
+    for (uint32_t i = 0; i < num_entry; i++) {
+        worker->dep_entries[i].next_free = worker->dep_free;
+        worker->dep_free = &worker->dep_entries[i];
+    }
+    return 0;
+}
+
+static int
+dep_issue(struct replay_worker *worker, struct replay_req *req)
+{
+    while (worker->outstanding >= g_queue_depth) {
+        g_backend->poll(worker->qpair);
+    }
+    return g_zone ? process_zns_replay(worker, req) : process_replay(worker, req);
+}
+
+static bool
+dep_hold_ready(struct dep_entry *entry)
+{
+    bool ready;
+
+    dep_lock();
+    ready = dep_ready(entry);
+    dep_unlock();
+    return ready;
+}
+
+/* issue the held requests whose dependencies completed, in order */
+static int
+dep_issue_held(struct replay_worker *worker)
+{
+    uint64_t release_gen = __atomic_load_n(&g_dep_release_gen, __ATOMIC_RELAXED);
+    int rc = 0;
+
+    if (release_gen == worker->dep_release_gen) {
+        return 0;
+    }
+    worker->dep_release_gen = release_gen;
+    for (uint32_t i = 0; i < worker->num_hold && !rc;) {
+        if (!dep_hold_ready(worker->hold[i].req.dep)) {
+            i++;
+            continue;
+        }
+        struct dep_hold hold = worker->hold[i];
+        uint64_t retry_tsc = worker->ckpt_retry_tsc;
+        memmove(&worker->hold[i], &worker->hold[i + 1], (worker->num_hold - i - 1) * sizeof(struct dep_hold));
+        worker->num_hold--;
+        worker->dep_hold_tsc += spdk_get_ticks() - hold.tsc;
+        /* out of the hold list and not yet in a task while issuing, keep it in the checkpoint */
+        worker->ckpt_retry_tsc = spdk_min(retry_tsc, hold.req.tsc);
+        rc = dep_issue(worker, &hold.req);
+        if (!rc) {
+            worker->ckpt_retry_tsc = retry_tsc;
+        }
+    }
+    return rc;
+}
+
+/* poll completions and issue the held requests they unblocked */
+static void
+dep_poll(struct replay_worker *worker)
+{
+    g_backend->poll(worker->qpair);
+    if (g_dep_track && worker->num_hold && !worker->dep_rc) {
+        worker->dep_rc = dep_issue_held(worker);
+    }
+}
+
+/* index the request, issue it now if it is independent, else hold it until its dependencies complete */
+static int
+dep_submit(struct replay_worker *worker, struct replay_req *req)
+{
+    struct dep_entry *entry;
+    bool ready;
+
+    while (!worker->dep_rc && worker->num_hold == DEP_HOLD_MAX) {
+        dep_poll(worker);
+    }
+    if (worker->dep_rc) {
+        return worker->dep_rc;
+    }
+
+    entry = worker->dep_free;
+    dep_interval(req, &entry->dep);
+    if (entry->dep.kind == DEP_NONE) {
+        return dep_issue(worker, req);
+    }
+    worker->dep_free = entry->next_free;
+    dep_lock();
+    dep_insert(entry);
+    ready = dep_ready(entry);
+    dep_unlock();
+
+    req->dep = entry;
+    if (ready) {
+        return dep_issue(worker, req);
+    }
+    worker->hold[worker->num_hold].req = *req;
+    worker->hold[worker->num_hold].tsc = spdk_get_ticks();
+    worker->num_hold++;
+    worker->dep_held++;
+    return 0;
+}
+
+/* the trace is done, wait for the held requests */
+static int
+dep_drain(struct replay_worker *worker)
+{
+    while (!worker->dep_rc && worker->num_hold) {
+        dep_poll(worker);
+    }
+    return worker->dep_rc;
+}
+/* dependency tracking end */
+
+/* rate limit start */
+/*
+ * Token buckets in GCRA form: a bucket holds the tick at which it is empty again (next_tsc), a
+ * request may go once now >= next_tsc - burst and pushes next_tsc by its cost in ticks. Global
+ * buckets are shared by the workers through a compare and swap, qpair buckets are per worker.
+ */
+static struct rate_bucket g_rate_global[RATE_CLASS_MAX][RATE_UNIT_MAX];
+static struct trace_io_hist g_throttle_hist;    /* issue delay caused by the limiters */
+static uint64_t g_rate_io[RATE_CLASS_MAX];
+static uint64_t g_rate_byte[RATE_CLASS_MAX];
+
+static void
+rate_bucket_init(struct rate_bucket *bucket, double rate, uint64_t burst_tsc, uint64_t now)
+{
+    bucket->tick_per_unit = rate > 0 ? spdk_get_ticks_hz() / rate : 0;
+    bucket->burst_tsc = burst_tsc;
+    bucket->next_tsc = now;
+}
+
+/* charge the bucket, return the tick from which the request conforms */
+static uint64_t
+rate_bucket_reserve(struct rate_bucket *bucket, uint64_t now, uint64_t unit)
+{
+    uint64_t cost = (uint64_t)(unit * bucket->tick_per_unit);
+    uint64_t next = __atomic_load_n(&bucket->next_tsc, __ATOMIC_RELAXED);
+
+    while (!__atomic_compare_exchange_n(&bucket->next_tsc, &next, spdk_max(next, now) + cost, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return next > now + bucket->burst_tsc ? next - bucket->burst_tsc : now;
+}
+
+/* called once before the workers start */
+static void
+rate_limit_start(struct replay_worker *workers)
+{
+    uint64_t now = spdk_get_ticks();
+
+    for (uint32_t scope = 0; scope < RATE_SCOPE_MAX; scope++) {
+        struct rate_limit *limit = &g_rate_limit[scope];
+        uint64_t burst_tsc = limit->burst_us * spdk_get_ticks_hz() / (1000 * 1000);
+
+        for (uint32_t cls = 0; cls < RATE_CLASS_MAX; cls++) {
+            for (uint32_t unit = 0; unit < RATE_UNIT_MAX; unit++) {
+                if (scope == RATE_SCOPE_GLOBAL) {
+                    rate_bucket_init(&g_rate_global[cls][unit], limit->rate[cls][unit], burst_tsc, now);
+                    continue;
+                }
+                for (uint32_t i = 0; i < g_num_worker; i++) {
+                    rate_bucket_init(&workers[i].rate_bucket[cls][unit], limit->rate[cls][unit], burst_tsc, now);
+                }
+            }
+        }
+    }
+}
+
+static int
+rate_class(uint16_t opc)
+{
+    switch (replay_opc_class(opc)) {
+    case REPLAY_OPC_READ:
+        return RATE_READ;
+    case REPLAY_OPC_WRITE:
+    case REPLAY_OPC_APPEND:
+    case REPLAY_OPC_WRITE_ZEROES:
+        return RATE_WRITE;
+    default:
+        /* zone management and others are not limited */
+        return -1;
+    }
+}
+
+/* hold the request until every bucket it draws from conforms, polling completions meanwhile */
+static void
+rate_limit_wait(struct replay_worker *worker, const struct replay_req *req)
+{
+    int cls = rate_class(req->opc);
+    uint64_t now = spdk_get_ticks();
+    uint64_t issue_tsc = now;
+    uint64_t unit[RATE_UNIT_MAX];
+
+    if (cls < 0) {
+        return;
+    }
+    /* write zeroes moves no data */
+    unit[RATE_IOPS] = 1;
+    unit[RATE_BW] = req->opc == SPDK_NVME_OPC_WRITE_ZEROES ? 0 : (uint64_t)req->nlb * g_block_byte;
+
+    for (uint32_t u = 0; u < RATE_UNIT_MAX; u++) {
+        const int classes[] = {cls, RATE_ALL};
+        for (uint32_t c = 0; c < SPDK_COUNTOF(classes); c++) {
+            struct rate_bucket *bucket[] = {&worker->rate_bucket[classes[c]][u], &g_rate_global[classes[c]][u]};
+            for (uint32_t b = 0; b < SPDK_COUNTOF(bucket); b++) {
+                if (bucket[b]->tick_per_unit > 0) {
+                    uint64_t tsc = rate_bucket_reserve(bucket[b], now, unit[u]);
+                    issue_tsc = spdk_max(issue_tsc, tsc);
+                }
+            }
+        }
+    }
+
+    while (spdk_get_ticks() < issue_tsc) {
+        g_backend->poll(worker->qpair);
+    }
+    trace_io_hist_record(&worker->throttle_hist, issue_tsc - now);
+    worker->rate_io[cls]++;
+    worker->rate_byte[cls] += unit[RATE_BW];
+}
+
+static void
+rate_limit_merge(struct replay_worker *worker)
+{
+    trace_io_hist_merge(&g_throttle_hist, &worker->throttle_hist);
+    for (uint32_t cls = 0; cls < RATE_CLASS_MAX; cls++) {
+        g_rate_io[cls] += worker->rate_io[cls];
+        g_rate_byte[cls] += worker->rate_byte[cls];
+    }
+}
+
+static void
+print_rate_limit(uint64_t replay_tsc)
+{
+    static const char *class_name[RATE_CLASS_MAX] = {"Read", "Write", "All"};
+    static const char *scope_name[RATE_SCOPE_MAX] = {"qpair", "global"};
+    float replay_us = get_us_from_tick(replay_tsc);
+
+    for (uint32_t scope = 0; scope < RATE_SCOPE_MAX; scope++) {
+        for (uint32_t cls = 0; cls < RATE_CLASS_MAX; cls++) {
+            const double *rate = g_rate_limit[scope].rate[cls];
+            if (rate[RATE_IOPS] > 0 || rate[RATE_BW] > 0) {
+                printf("%-16s: %15s %-5s IOPS %-12.0f MB/s %-12.3f burst %ju (us)\n", "Rate limit",
+                       scope_name[scope], class_name[cls], rate[RATE_IOPS], rate[RATE_BW] / 1000000,
+                       g_rate_limit[scope].burst_us);
+            }
+        }
+    }
+    g_rate_io[RATE_ALL] = g_rate_io[RATE_READ] + g_rate_io[RATE_WRITE];
+    g_rate_byte[RATE_ALL] = g_rate_byte[RATE_READ] + g_rate_byte[RATE_WRITE];
+    for (uint32_t cls = 0; cls < RATE_CLASS_MAX && replay_us > 0; cls++) {
+        printf("%-16s: %15s IOPS %-12.3f MB/s %-12.3f\n", "Achieved rate", class_name[cls],
+               g_rate_io[cls] * 1000000.0 / replay_us, g_rate_byte[cls] / replay_us);
+    }
+    if (g_throttle_hist.count) {
+        printf("%-16s: AVG %-12.3f P50 %-12.3f P99 %-12.3f P99.9 %-12.3f MAX %-12.3f\n", "Throttle (us)",
+               get_us_from_tick(trace_io_hist_mean(&g_throttle_hist)),
+               get_us_from_tick(trace_io_hist_percentile(&g_throttle_hist, 50)),
+               get_us_from_tick(trace_io_hist_percentile(&g_throttle_hist, 99)),
+               get_us_from_tick(trace_io_hist_percentile(&g_throttle_hist, 99.9)),
+               get_us_from_tick(g_throttle_hist.max));
+    }
+}
+
+/* <qpair|global>:<key>=<value>,..., keys are iops, riops, wiops, bw, rbw, wbw (MB/s) and burst (us) */
+static int
+parse_rate_limit(const char *arg)
+{
+    static const char *key[RATE_UNIT_MAX][RATE_CLASS_MAX] = {
+        {"riops", "wiops", "iops"},
+        {"rbw", "wbw", "bw"},
+    };
+    struct rate_limit *limit;
+    char *buf, *save = NULL;
+    int rc = 0;
+
+    if (strncmp(arg, "qpair:", 6) == 0) {
+        limit = &g_rate_limit[RATE_SCOPE_QPAIR];
+    } else if (strncmp(arg, "global:", 7) == 0) {
+        limit = &g_rate_limit[RATE_SCOPE_GLOBAL];
+    } else {
+        fprintf(stderr, "Unknown rate limit scope %s\n", arg);
+        return 1;
+    }
+    buf = strdup(strchr(arg, ':') + 1);
+    if (!buf) {
+        return 1;
+    }
+    for (char *kv = strtok_r(buf, ",", &save); kv && !rc; kv = strtok_r(NULL, ",", &save)) {
+        char *val = strchr(kv, '=');
+        uint32_t unit, cls = RATE_CLASS_MAX;
+
+        if (!val) {
+            rc = 1;
+            break;
+        }
+        *val++ = '\0';
+        if (strcmp(kv, "burst") == 0) {
+            limit->burst_us = strtoull(val, NULL, 10);
+            continue;
+        }
+        for (unit = 0; unit < RATE_UNIT_MAX; unit++) {
+            for (cls = 0; cls < RATE_CLASS_MAX && strcmp(kv, key[unit][cls]) != 0; cls++);
+            if (cls < RATE_CLASS_MAX) {
+                break;
+            }
+        }
+        if (unit == RATE_UNIT_MAX || atof(val) < 0) {
+            rc = 1;
+            break;
+        }
+        limit->rate[cls][unit] = atof(val) * (unit == RATE_BW ? 1000000 : 1);
+    }
+    free(buf);
+    if (rc) {
+        fprintf(stderr, "Invalid rate limit %s\n", arg);
+        return 1;
+    }
+    g_rate_limited = true;
+    return 0;
+}
+/* rate limit end */
+
+/* replay timing start */
+static bool g_replay_started = false;
+static uint64_t g_replay_start_tsc = 0;     /* spdk_get_ticks() when the replay starts */
+static uint64_t g_trace_start_tsc = 0;      /* recorded timestamp of the first entry */
+static double g_tsc_scale = 0;              /* replay ticks per recorded tick */
+static uint64_t g_barrier_window_tsc = 0;   /* barrier window in recorded ticks */
+static uint64_t g_worker_progress[WORKER_MAX];  /* recorded timestamp of the next request of each worker */
+static uint64_t g_worker_pushed[WORKER_MAX];    /* recorded timestamp of the last request pushed to each worker */
+static uint64_t g_reader_progress = 0;          /* recorded timestamp of the last request pushed by the reader */
+/* aggregated from the workers after replay */
+static struct trace_io_hist g_slip_hist;    /* open-loop: issue time - scheduled time */
+static struct trace_io_hist g_trace_qd_hist;    /* closed-loop: recorded queue depth */
+static struct trace_io_hist g_replay_qd_hist;   /* replay queue depth at submit */
+static uint64_t g_trace_end_tsc = 0;
+
+/* called once before the workers start, all workers share the same time base */
+static void
+replay_timing_start(uint64_t trace_start_tsc, uint64_t tsc_rate)
+{
+    g_replay_started = true;
+    g_trace_start_tsc = trace_start_tsc;
+    g_trace_end_tsc = trace_start_tsc;
+    g_tsc_scale = (double)spdk_get_ticks_hz() / tsc_rate / g_time_scale;
+    g_barrier_window_tsc = g_barrier_window_us * tsc_rate / (1000 * 1000);
+    for (uint32_t i = 0; i < WORKER_MAX; i++) {
+        g_worker_progress[i] = 0;
+        g_worker_pushed[i] = 0;
+    }
+    g_reader_progress = 0;
+    g_replay_start_tsc = spdk_get_ticks();
+}
+
+static void
+replay_timing_complete(struct replay_worker *worker, struct replay_req *req)
+{
+    if (worker->trace_outstanding) {
+        worker->trace_outstanding--;
+    }
+    worker->trace_end_tsc = req->tsc;
+}
+
+/* called by the reader before a request is pushed to the ring of the worker */
+static void
+replay_timing_push(uint32_t index, uint64_t tsc)
+{
+    __atomic_store_n(&g_worker_pushed[index], tsc, __ATOMIC_RELEASE);
+}
+
+/* called by the reader after a request is pushed */
+static void
+replay_timing_pushed(uint64_t tsc)
+{
+    __atomic_store_n(&g_reader_progress, tsc, __ATOMIC_RELEASE);
+}
+
+/*
+ * Earliest recorded timestamp the worker may still issue. A worker that has taken every request
+ * pushed to it waits for the reader, its next request is not earlier than what the reader pushed.
+ */
+static uint64_t
+replay_timing_progress(uint32_t index)
+{
+    uint64_t reader = __atomic_load_n(&g_reader_progress, __ATOMIC_ACQUIRE);
+    uint64_t progress = __atomic_load_n(&g_worker_progress[index], __ATOMIC_ACQUIRE);
+
+    if (progress >= __atomic_load_n(&g_worker_pushed[index], __ATOMIC_ACQUIRE)) {
+        return spdk_max(progress, reader);
+    }
+    return progress;
+}
+
+/* hold the request until no other worker is behind it by more than the barrier window */
+static void
+replay_timing_barrier(struct replay_worker *worker, uint64_t tsc)
+{
+    __atomic_store_n(&g_worker_progress[worker->index], tsc, __ATOMIC_RELEASE);
+    if (tsc <= g_barrier_window_tsc) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        while (i != worker->index && replay_timing_progress(i) < tsc - g_barrier_window_tsc) {
+            g_backend->poll(worker->qpair);
+        }
+    }
+}
+
+/* the worker has no more requests, release the barrier */
+static void
+replay_timing_finish(struct replay_worker *worker)
+{
+    __atomic_store_n(&g_worker_progress[worker->index], UINT64_MAX, __ATOMIC_RELEASE);
+}
+
+/* wait until the request can be issued, polling completions meanwhile */
+static void
+replay_timing_wait(struct replay_worker *worker, struct replay_req *req)
+{
+    struct replay_qpair *qpair = worker->qpair;
+    uint64_t target_tsc = 0;
+
+    worker->trace_outstanding++;
+    worker->trace_end_tsc = req->tsc;
+
+    if (g_barrier && g_num_worker > 1) {
+        replay_timing_barrier(worker, req->tsc);
+    }
+
+    switch (g_replay_mode) {
+    case REPLAY_MODE_OPEN_LOOP:
+        target_tsc = g_replay_start_tsc + (uint64_t)((req->tsc - g_trace_start_tsc) * g_tsc_scale);
+        while (spdk_get_ticks() < target_tsc) {
+            replay_poll(worker);
+        }
+        break;
+    case REPLAY_MODE_CLOSED_LOOP:
+        trace_io_hist_record(&worker->trace_qd_hist, worker->trace_outstanding);
+        while (worker->outstanding >= worker->trace_outstanding) {
+            replay_poll(worker);
+        }
+        break;
+    default:
+        break;
+    }
+
+    while (worker->outstanding >= g_queue_depth) {
+        g_backend->poll(qpair);
+    }
+
+    if (g_rate_limited) {
+        rate_limit_wait(worker, req);
+    }
+
+    if (g_replay_mode == REPLAY_MODE_OPEN_LOOP) {
+        uint64_t now = spdk_get_ticks();
+        trace_io_hist_record(&worker->slip_hist, now > target_tsc ? now - target_tsc : 0);
+    }
+    trace_io_hist_record(&worker->replay_qd_hist, worker->outstanding + 1);
+}
+
+static void
+replay_timing_merge(struct replay_worker *worker)
+{
+    trace_io_hist_merge(&g_slip_hist, &worker->slip_hist);
+    trace_io_hist_merge(&g_trace_qd_hist, &worker->trace_qd_hist);
+    trace_io_hist_merge(&g_replay_qd_hist, &worker->replay_qd_hist);
+    g_trace_end_tsc = spdk_max(g_trace_end_tsc, worker->trace_end_tsc);
+    g_num_io += worker->num_io;
+}
+
+static void
+print_replay_timing(uint64_t replay_tsc)
+{
+    static const char *mode_name[] = {"as fast as possible", "open-loop", "closed-loop"};
+
+    printf("%-16s: %15s\n", "Replay mode", mode_name[g_replay_mode]);
+    if (g_replay_started) {
+        printf("%-16s: %15.3f (ms) \n", "Trace time",
+               get_us_from_tick((g_trace_end_tsc - g_trace_start_tsc) * g_tsc_scale) / 1000);
+    }
+    printf("%-16s: %15.3f (ms) \n", "Replay time", get_us_from_tick(replay_tsc) / 1000);
+
+    if (g_replay_mode == REPLAY_MODE_OPEN_LOOP && g_slip_hist.count) {
+        printf("%-16s: AVG %-12.3f P50 %-12.3f P99 %-12.3f P99.9 %-12.3f MAX %-12.3f\n", "Slip (us)",
+               get_us_from_tick(trace_io_hist_mean(&g_slip_hist)),
+               get_us_from_tick(trace_io_hist_percentile(&g_slip_hist, 50)),
+               get_us_from_tick(trace_io_hist_percentile(&g_slip_hist, 99)),
+               get_us_from_tick(trace_io_hist_percentile(&g_slip_hist, 99.9)),
+               get_us_from_tick(g_slip_hist.max));
+    }
+    if (g_replay_mode == REPLAY_MODE_CLOSED_LOOP && g_trace_qd_hist.count) {
+        printf("%-16s: AVG %-12.3f MAX %-12ju\n", "Recorded QD",
+               trace_io_hist_mean(&g_trace_qd_hist), g_trace_qd_hist.max);
+    }
+    if (g_replay_qd_hist.count) {
+        printf("%-16s: AVG %-12.3f MAX %-12ju\n", "Replay QD",
+               trace_io_hist_mean(&g_replay_qd_hist), g_replay_qd_hist.max);
+    }
+
+    printf("%-16s: %15.3f\n", "Time scale", g_time_scale);
+    printf("%-16s: %15u\n", "Load multiplier", g_load_multiplier);
+    float trace_us = get_us_from_tick((g_trace_end_tsc - g_trace_start_tsc) * g_tsc_scale);
+    float replay_us = get_us_from_tick(replay_tsc);
+    if (g_replay_started && trace_us > 0) {
+        printf("%-16s: %15.3f\n", "Target IOPS", g_num_io * 1000000.0 / trace_us);
+    }
+    if (replay_us > 0) {
+        printf("%-16s: %15.3f\n", "Achieved IOPS", g_num_io * 1000000.0 / replay_us);
+    }
+    if (g_pool_num_get) {
+        printf("%-16s: %15.3f (ns/IO) %ju oversized\n", "Alloc cost",
+               get_us_from_tick((double)g_pool_get_tsc / g_pool_num_get) * 1000, g_pool_num_oversize);
+    }
+}
+/* replay timing end */
+
+/* lba remap start */
+/* highest block referenced by the trace, the recorded namespace size for linear scaling */
+static int
+replay_remap_scan(const char *file_name, uint64_t *max_blk)
+{
+    FILE *fptr = fopen(file_name, "rb");
+    size_t num_entry;
+    int rc = 0;
+
+    *max_blk = 0;
+    if (fptr == NULL) {
+        fprintf(stderr, "Failed to open input file %s\n", file_name);
+        return 1;
+    }
+    struct trace_io_entry *buf = (struct trace_io_entry *)malloc(ENTRY_MAX * sizeof(struct trace_io_entry));
+    if (!buf) {
+        fprintf(stderr, "Fail to allocate memory for remap scan\n");
+        fclose(fptr);
+        return 1;
+    }
+    while ((num_entry = fread(buf, sizeof(struct trace_io_entry), ENTRY_MAX, fptr)) > 0) {
+        for (size_t i = 0; i < num_entry; i++) {
+            struct trace_io_entry *d = &buf[i];
+            if (strcmp(d->tpoint_name, "NVME_IO_SUBMIT") != 0) {
+                continue;
+            }
+            uint64_t slba = (uint64_t)d->cdw10 | ((uint64_t)d->cdw11 & UINT32BIT_MASK) << 32;
+            *max_blk = spdk_max(*max_blk, slba + (d->cdw12 & UINT16BIT_MASK) + 1);
+        }
+    }
+    if (ferror(fptr)) {
+        fprintf(stderr, "Fail to read input file\n");
+        rc = 1;
+    }
+    free(buf);
+    fclose(fptr);
+    return rc;
+}
+
+/* precompute the mapping, the per request cost is a few integer operations */
+static int
+replay_remap_init(struct replay_qpair *qpair, const char *file_name)
+{
+    g_remap_dst_blk = g_zone ? g_num_zone / g_load_multiplier : g_ns_blk / g_load_multiplier;
+
+    switch (g_remap_mode) {
+    case REMAP_MODE_SCALE:
+        if (!g_remap_src_blk && replay_remap_scan(file_name, &g_remap_src_blk)) {
+            return 1;
+        }
+        if (!g_remap_src_blk) {
+            g_remap_src_blk = 1;
+        }
+        /* on ZNS the zone index is scaled */
+        if (g_zone) {
+            g_remap_factor = (double)g_remap_dst_blk / ((g_remap_src_blk + g_zone_sz_blk - 1) / g_zone_sz_blk);
+        } else {
+            g_remap_factor = (double)g_remap_dst_blk / g_remap_src_blk;
+        }
+        printf("%-20s: scale %lu blocks x %.6f\n", "LBA remap", g_remap_src_blk, g_remap_factor);
+        break;
+    case REMAP_MODE_ZONE:
+        if (!g_zone) {
+            fprintf(stderr, "Zone remap needs a ZNS namespace\n");
+            return 1;
+        }
+        if (zone_info_load(qpair)) {
+            return 1;
+        }
+        g_remap_dst_zone_cap = g_zone_info[0].cap;
+        free(g_zone_info);
+        g_zone_info = NULL;
+        /* same geometry as the device unless told otherwise */
+        if (!g_remap_src_zone_blk) {
+            g_remap_src_zone_blk = g_zone_sz_blk;
+            g_remap_src_zone_cap = g_remap_src_zone_cap ? g_remap_src_zone_cap : g_remap_dst_zone_cap;
+        }
+        if (!g_remap_src_zone_cap || g_remap_src_zone_cap > g_remap_src_zone_blk) {
+            g_remap_src_zone_cap = g_remap_src_zone_blk;
+        }
+        g_remap_factor = (double)g_remap_dst_zone_cap / g_remap_src_zone_cap;
+        printf("%-20s: zone 0x%lx/0x%lx -> 0x%lx/0x%lx blocks\n", "LBA remap", g_remap_src_zone_blk,
+               g_remap_src_zone_cap, g_zone_sz_blk, g_remap_dst_zone_cap);
+        break;
+    case REMAP_MODE_WRAP:
+        printf("%-20s: wrap\n", "LBA remap");
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+/* keep [offset, offset + nlb) inside [0, size) */
+static inline uint64_t
+replay_remap_clamp(uint64_t offset, uint32_t nlb, uint64_t size)
+{
+    if (spdk_unlikely(offset + nlb > size)) {
+        offset = (nlb < size) ? size - nlb : 0;
+    }
+    return offset;
+}
+
+/* map a recorded LBA into the LBA range (zone range on ZNS) owned by the copy */
+static inline uint64_t
+replay_remap(uint32_t copy, uint64_t slba, uint32_t nlb)
+{
+    if (g_remap_mode == REMAP_MODE_NONE && g_load_multiplier == 1) {
+        return slba;
+    }
+
+    if (g_zone) {
+        uint64_t zone_base = copy * g_remap_dst_blk;
+        switch (g_remap_mode) {
+        case REMAP_MODE_ZONE: {
+            uint64_t offset = (uint64_t)(slba % g_remap_src_zone_blk * g_remap_factor);
+            uint64_t zone = slba / g_remap_src_zone_blk % g_remap_dst_blk + zone_base;
+            return zone * g_zone_sz_blk + replay_remap_clamp(offset, nlb, g_remap_dst_zone_cap);
+        }
+        case REMAP_MODE_SCALE: {
+            uint64_t zone = spdk_min((uint64_t)(slba / g_zone_sz_blk * g_remap_factor), g_remap_dst_blk - 1);
+            return (zone + zone_base) * g_zone_sz_blk + slba % g_zone_sz_blk;
+        }
+        default:
+            return (slba / g_zone_sz_blk % g_remap_dst_blk + zone_base) * g_zone_sz_blk + slba % g_zone_sz_blk;
+        }
+    }
+
+    uint64_t offset;
+    if (g_remap_mode == REMAP_MODE_SCALE) {
+        offset = (uint64_t)(slba * g_remap_factor);
+    } else {
+        offset = slba % g_remap_dst_blk;
+    }
+    return copy * g_remap_dst_blk + replay_remap_clamp(offset, nlb, g_remap_dst_blk);
+}
+
+/* shift a remapped LBA by the rotation of the iteration, wrapping inside the range of the copy */
+static inline uint64_t
+replay_rotate(uint32_t copy, uint64_t slba, uint32_t nlb, uint32_t loop)
+{
+    if (g_zone) {
+        uint64_t rotate = (g_loop_rotate_blk + g_zone_sz_blk - 1) / g_zone_sz_blk * loop;
+        uint64_t zone = (slba / g_zone_sz_blk - copy * g_remap_dst_blk + rotate) % g_remap_dst_blk;
+        return (zone + copy * g_remap_dst_blk) * g_zone_sz_blk + slba % g_zone_sz_blk;
+    }
+
+    uint64_t offset = (slba - copy * g_remap_dst_blk + g_loop_rotate_blk * loop) % g_remap_dst_blk;
+    return copy * g_remap_dst_blk + replay_remap_clamp(offset, nlb, g_remap_dst_blk);
+}
+/* lba remap end */
+
+/* load multiplier start */
+/*
+ * Each copy is a cursor over the trace file. Copy k starts at k/N of the trace
+ * span, wraps around at the end of file, and is shifted so that every copy
+ * starts at the first recorded timestamp. Copies replay into disjoint LBA
+ * ranges (zone ranges on ZNS) and are merged by their shifted timestamps.
+ * When looping, every iteration of a copy reads the whole file once and is
+ * shifted right after the previous one.
+ */
+static uint64_t g_loop_end_tsc = 0;         /* spdk_get_ticks() when looping stops, 0 is never */
+/* the reader filters entries before decode, the trace index lets it seek and skip whole blocks */
+#define FILTER_SET_BITS 16
+#define FILTER_SET_SIZE (1U << FILTER_SET_BITS)    /* filtered out requests in flight per copy */
+#define FILTER_SET_EMPTY UINT64_MAX
+static struct trace_io_index g_index;
+static uint64_t g_filter_lcore_mask[TRACE_IO_INDEX_LCORE_WORD];
+static uint32_t g_filter_opc_mask = 0;      /* bit (opc & 31) of opcodes in the filtered classes */
+struct replay_copy {
+    FILE     *fptr;
+    struct trace_io_entry *buf;
+    size_t   buf_entry;         /* number of valid entries in buf */
+    size_t   buf_idx;           /* next entry in buf */
+    size_t   file_idx;          /* file index of the next entry to read */
+    size_t   begin_idx;         /* slice of the file replayed, [begin_idx, end_idx) */
+    size_t   end_idx;
+    size_t   total_entry;       /* entries of the slice */
+    size_t   remain_entry;      /* entries left to read, over all iterations */
+    size_t   loop_entry;        /* entries left to read in this iteration */
+    uint32_t loop;              /* iteration of the trace */
+    int64_t  shift_tsc;         /* added to recorded timestamps of buf */
+    uint64_t first_tsc;         /* recorded timestamp of the first entry in file */
+    uint64_t start_tsc;         /* recorded timestamp where this copy starts */
+    uint64_t last_tsc;          /* recorded timestamp of the last entry in file */
+    uint64_t tsc_rate;
+    uint32_t index;
+    uint64_t *dropped;          /* ids of filtered out requests in flight, their completions are dropped too */
+    uint32_t num_dropped;
+};
+
+static int
+read_entry_at(FILE *fptr, size_t idx, struct trace_io_entry *d)
+{
+    if (fseek(fptr, (long)(idx * sizeof(struct trace_io_entry)), SEEK_SET) != 0 ||
+        fread(d, sizeof(struct trace_io_entry), 1, fptr) != 1) {
+        return 1;
+    }
+    return 0;
+}
+
+/* index of the first entry in [lo, hi) with timestamp not less than tsc, hi if none, entries are sorted by timestamp */
+static int
+find_entry_by_tsc(FILE *fptr, size_t lo, size_t hi, uint64_t tsc, size_t *idx)
+{
+    struct trace_io_entry d;
+
+    /* the index narrows the search down to one block */
+    if (g_index.block) {
+        size_t index_lo, index_hi;
+        trace_io_index_range(&g_index, tsc, &index_lo, &index_hi);
+        lo = spdk_min(spdk_max(lo, index_lo), hi);
+        hi = spdk_max(spdk_min(hi, index_hi), lo);
+    }
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (read_entry_at(fptr, mid, &d)) {
+            return 1;
+        }
+        if (d.tsc_timestamp < tsc) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *idx = lo;
+    return 0;
+}
+
+/* the block holding entry idx may have entries the filters pass */
+static bool
+replay_filter_block(size_t idx)
+{
+    const struct trace_io_index_block *block = &g_index.block[idx / TRACE_IO_INDEX_STRIDE];
+    bool lcore = !g_filter_by_lcore;
+
+    for (uint32_t i = 0; i < TRACE_IO_INDEX_LCORE_WORD && !lcore; i++) {
+        lcore = (block->lcore_mask[i] & g_filter_lcore_mask[i]) != 0;
+    }
+    /* the index does not know the opcode of completions, closed-loop needs all of them */
+    return lcore && (!g_filter_opc_mask || g_replay_mode == REPLAY_MODE_CLOSED_LOOP ||
+                     (block->opc_mask & g_filter_opc_mask) != 0);
+}
+
+static inline uint32_t
+filter_set_home(uint64_t key)
+{
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> (64 - FILTER_SET_BITS));
+}
+
+static void
+filter_set_add(struct replay_copy *copy, uint64_t key)
+{
+    uint32_t i = filter_set_home(key);
+
+    /* a full set only lets a few completions through */
+    if (copy->num_dropped == FILTER_SET_SIZE - 1) {
+        return;
+    }
+    for (; copy->dropped[i] != FILTER_SET_EMPTY; i = (i + 1) & (FILTER_SET_SIZE - 1)) {
+        if (copy->dropped[i] == key) {
+            return;
+        }
+    }
+    copy->dropped[i] = key;
+    copy->num_dropped++;
+}
+
+static bool
+filter_set_del(struct replay_copy *copy, uint64_t key)
+{
+    uint32_t i = filter_set_home(key);
+
+    for (; copy->dropped[i] != key; i = (i + 1) & (FILTER_SET_SIZE - 1)) {
+        if (copy->dropped[i] == FILTER_SET_EMPTY) {
+            return false;
+        }
+    }
+    /* backward shift deletion, keeps linear probing intact without tombstones */
+    for (uint32_t j = (i + 1) & (FILTER_SET_SIZE - 1); copy->dropped[j] != FILTER_SET_EMPTY;
+         j = (j + 1) & (FILTER_SET_SIZE - 1)) {
+        uint32_t home = filter_set_home(copy->dropped[j]);
+        if (((j - home) & (FILTER_SET_SIZE - 1)) >= ((j - i) & (FILTER_SET_SIZE - 1))) {
+            copy->dropped[i] = copy->dropped[j];
+            i = j;
+        }
+    }
+    copy->dropped[i] = FILTER_SET_EMPTY;
+    copy->num_dropped--;
+    return true;
+}
+
+/* applied by the reader before decode, completions follow their submit */
+static bool
+replay_filter_pass(struct replay_copy *copy, const struct trace_io_entry *d)
+{
+    if (g_filter_by_lcore && (d->lcore >= SPDK_TRACE_MAX_LCORE || !g_filter_lcore[d->lcore])) {
+        return false;
+    }
+    if (!g_filter_opc_class) {
+        return true;
+    }
+    if (strcmp(d->tpoint_name, "NVME_IO_COMPLETE") == 0) {
+        return !filter_set_del(copy, d->obj_id);
+    }
+    if (g_filter_opc_class & (1U << replay_opc_class(d->opc))) {
+        return true;
+    }
+    filter_set_add(copy, d->obj_id);
+    return false;
+}
+
+/* called once from main, the index is shared by the replay and the pre-scans until exit */
+static int
+replay_filter_init(const char *file_name)
+{
+    /* a resumed replay seeks through the index too */
+    if (g_slice_start_s <= 0 && g_slice_end_s <= 0 && !g_filter_by_lcore && !g_filter_opc_class && !g_ckpt_resume) {
+        return 0;
+    }
+    if (trace_io_index_load(file_name, &g_index)) {
+        return 1;
+    }
+    for (uint32_t i = 0; i < SPDK_TRACE_MAX_LCORE; i++) {
+        if (g_filter_lcore[i]) {
+            g_filter_lcore_mask[i / 64] |= 1ULL << (i % 64);
+        }
+    }
+    for (uint32_t opc = 0; opc <= UINT8BIT_MASK && g_filter_opc_class; opc++) {
+        if (g_filter_opc_class & (1U << replay_opc_class((uint16_t)opc))) {
+            g_filter_opc_mask |= 1U << (opc & 31);
+        }
+    }
+    return 0;
+}
+
+/* [begin, end) of the file covering the slice of the trace */
+static int
+replay_slice_find(FILE *fptr, size_t total_entry, size_t *begin, size_t *end)
+{
+    struct trace_io_entry first;
+
+    *begin = 0;
+    *end = total_entry;
+    if (g_slice_start_s <= 0 && g_slice_end_s <= 0) {
+        return 0;
+    }
+    if (read_entry_at(fptr, 0, &first)) {
+        return 1;
+    }
+    if (g_slice_start_s > 0 &&
+        find_entry_by_tsc(fptr, 0, total_entry, first.tsc_timestamp + (uint64_t)(g_slice_start_s * first.tsc_rate),
+                          begin)) {
+        return 1;
+    }
+    if (g_slice_end_s > 0 &&
+        find_entry_by_tsc(fptr, *begin, total_entry, first.tsc_timestamp + (uint64_t)(g_slice_end_s * first.tsc_rate),
+                          end)) {
+        return 1;
+    }
+    return 0;
+}
+
+static void
+replay_copy_free(struct replay_copy *copies)
+{
+    if (!copies) {
+        return;
+    }
+    for (uint32_t i = 0; i < g_load_multiplier; i++) {
+        if (copies[i].fptr) {
+            fclose(copies[i].fptr);
+        }
+        free(copies[i].buf);
+        free(copies[i].dropped);
+    }
+    free(copies);
+}
+
+/* resume: move the copy to its first entry at or after the shifted timestamp tsc */
+static int
+replay_copy_seek(struct replay_copy *copy, uint64_t tsc)
+{
+    uint64_t span = copy->last_tsc - copy->first_tsc + 1;
+    /* in recorded timestamps of the first pass, from the start of the copy to the end of the slice */
+    uint64_t target = tsc + (copy->start_tsc - copy->first_tsc);
+    size_t start_idx = copy->file_idx, idx = copy->end_idx, consumed;
+    uint64_t wrap = 0;
+
+    if (tsc <= copy->first_tsc) {
+        return 0;
+    }
+    if (target <= copy->last_tsc && find_entry_by_tsc(copy->fptr, start_idx, copy->end_idx, target, &idx)) {
+        return 1;
+    }
+    if (idx < copy->end_idx) {
+        consumed = idx - start_idx;
+    } else {
+        /* in a later pass over the whole slice */
+        wrap = (target - copy->last_tsc + span - 1) / span;
+        if (find_entry_by_tsc(copy->fptr, copy->begin_idx, copy->end_idx, target - wrap * span, &idx)) {
+            return 1;
+        }
+        consumed = (copy->end_idx - start_idx) + (wrap - 1) * copy->total_entry + (idx - copy->begin_idx);
+    }
+
+    copy->file_idx = idx;
+    copy->shift_tsc += (int64_t)(wrap * span);
+    copy->loop = (uint32_t)(consumed / copy->total_entry);
+    copy->loop_entry = copy->total_entry - consumed % copy->total_entry;
+    if (copy->remain_entry != SIZE_MAX) {
+        copy->remain_entry = copy->remain_entry > consumed ? copy->remain_entry - consumed : 0;
+    }
+    fseek(copy->fptr, (long)(copy->file_idx * sizeof(struct trace_io_entry)), SEEK_SET);
+    return 0;
+}
+
+/* pre-scans read one iteration, the replay loops as asked */
+static struct replay_copy *
+replay_copy_alloc(const char *file_name, bool scan)
+{
+    struct trace_io_entry first, last;
+    size_t start_idx = 0, begin_idx = 0, end_idx = 0;
+
+    struct replay_copy *copies = (struct replay_copy *)calloc(g_load_multiplier, sizeof(struct replay_copy));
+    if (!copies) {
+        fprintf(stderr, "Fail to allocate memory for replay copies\n");
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < g_load_multiplier; i++) {
+        struct replay_copy *copy = &copies[i];
+
+        copy->index = i;
+        copy->fptr = fopen(file_name, "rb");
+        if (copy->fptr == NULL) {
+            fprintf(stderr, "Failed to open input file %s\n", file_name);
+            goto err;
+        }
+        copy->buf = (struct trace_io_entry *)malloc(ENTRY_MAX * sizeof(struct trace_io_entry));
+        if (!copy->buf) {
+            fprintf(stderr, "Fail to allocate memory for replay buffer\n");
+            goto err;
+        }
+
+        if (g_filter_opc_class) {
+            copy->dropped = (uint64_t *)malloc(FILTER_SET_SIZE * sizeof(uint64_t));
+            if (!copy->dropped) {
+                fprintf(stderr, "Fail to allocate memory for replay filter\n");
+                goto err;
+            }
+            memset(copy->dropped, 0xFF, FILTER_SET_SIZE * sizeof(uint64_t));
+        }
+
+        fseek(copy->fptr, 0, SEEK_END);
+        if (i == 0 && replay_slice_find(copy->fptr, ftell(copy->fptr) / sizeof(struct trace_io_entry),
+                                        &begin_idx, &end_idx)) {
+            fprintf(stderr, "Fail to read input file\n");
+            goto err;
+        }
+        copy->begin_idx = begin_idx;
+        copy->end_idx = end_idx;
+        copy->total_entry = end_idx > begin_idx ? end_idx - begin_idx : 0;
+        copy->loop_entry = copy->total_entry;
+        if (scan) {
+            copy->remain_entry = copy->total_entry;
+        } else if (g_loop_count) {
+            copy->remain_entry = copy->total_entry * g_loop_count;
+        } else {
+            copy->remain_entry = g_loop_duration_s > 0 ? SIZE_MAX : copy->total_entry;
+        }
+        if (!copy->total_entry) {
+            continue;
+        }
+        if (read_entry_at(copy->fptr, begin_idx, &first) ||
+            read_entry_at(copy->fptr, end_idx - 1, &last)) {
+            fprintf(stderr, "Fail to read input file\n");
+            goto err;
+        }
+        copy->first_tsc = first.tsc_timestamp;
+        copy->last_tsc = last.tsc_timestamp;
+        copy->tsc_rate = first.tsc_rate;
+
+        uint64_t start_tsc = first.tsc_timestamp + (last.tsc_timestamp - first.tsc_timestamp) / g_load_multiplier * i;
+        if (find_entry_by_tsc(copy->fptr, begin_idx, end_idx, start_tsc, &start_idx) ||
+            read_entry_at(copy->fptr, start_idx, &first)) {
+            fprintf(stderr, "Fail to read input file\n");
+            goto err;
+        }
+        copy->start_tsc = first.tsc_timestamp;
+        copy->file_idx = start_idx;
+        copy->shift_tsc = (int64_t)(copy->first_tsc - copy->start_tsc);
+        fseek(copy->fptr, (long)(start_idx * sizeof(struct trace_io_entry)), SEEK_SET);
+        if (!scan && g_ckpt_resume && replay_copy_seek(copy, g_ckpt_resume_tsc)) {
+            fprintf(stderr, "Fail to read input file\n");
+            goto err;
+        }
+    }
+    if (!scan && g_index.block) {
+        printf("%-20s: entries %zu to %zu of %ju, %ju index blocks\n", "Trace slice", begin_idx, end_idx,
+               g_index.hdr.num_entry, g_index.hdr.num_block);
+    }
+    return copies;
+
+err:
+    replay_copy_free(copies);
+    return NULL;
+}
+
+/* called once before the reader starts */
+static void
+replay_loop_start(void)
+{
+    g_loop_end_tsc = 0;
+    if (g_loop_duration_s > 0) {
+        g_loop_end_tsc = spdk_get_ticks() + (uint64_t)(g_loop_duration_s * spdk_get_ticks_hz());
+    }
+}
+
+/* the duration is over, requests read ahead are dropped */
+static inline bool
+replay_loop_expired(void)
+{
+    return g_loop_end_tsc && spdk_get_ticks() >= g_loop_end_tsc;
+}
+
+static int
+replay_copy_fill(struct replay_copy *copy)
+{
+    if (copy->file_idx == copy->end_idx) {
+        /* wrap around, continue right after the last entry of the slice */
+        copy->file_idx = copy->begin_idx;
+        copy->shift_tsc += (int64_t)(copy->last_tsc - copy->first_tsc + 1);
+        fseek(copy->fptr, (long)(copy->file_idx * sizeof(struct trace_io_entry)), SEEK_SET);
+    }
+    if (!copy->loop_entry) {
+        copy->loop++;
+        copy->loop_entry = copy->total_entry;
+    }
+
+    /* a buffer never spans two iterations */
+    size_t buffer_entry = spdk_min(copy->remain_entry, copy->end_idx - copy->file_idx);
+    buffer_entry = spdk_min(buffer_entry, copy->loop_entry);
+    buffer_entry = spdk_min(buffer_entry, (size_t)ENTRY_MAX);
+
+    /* nor an index block when filtering, blocks the filters reject are skipped without reading */
+    if (g_index.block) {
+        buffer_entry = spdk_min(buffer_entry, TRACE_IO_INDEX_STRIDE - copy->file_idx % TRACE_IO_INDEX_STRIDE);
+        if (!replay_filter_block(copy->file_idx)) {
+            copy->buf_entry = 0;
+            copy->buf_idx = 0;
+            copy->file_idx += buffer_entry;
+            copy->remain_entry -= buffer_entry;
+            copy->loop_entry -= buffer_entry;
+            fseek(copy->fptr, (long)(copy->file_idx * sizeof(struct trace_io_entry)), SEEK_SET);
+            return 0;
+        }
+    }
+    size_t read_entry = fread(copy->buf, sizeof(struct trace_io_entry), buffer_entry, copy->fptr);
+    if (buffer_entry != read_entry) {
+        fprintf(stderr, "Fail to read input file\n");
+        return 1;
+    }
+    copy->buf_entry = read_entry;
+    copy->buf_idx = 0;
+    copy->file_idx += read_entry;
+    copy->remain_entry -= read_entry;
+    copy->loop_entry -= read_entry;
+    return 0;
+}
+
+/* next entry of the copy, *d is NULL when the copy is done */
+static int
+replay_copy_peek(struct replay_copy *copy, struct trace_io_entry **d)
+{
+    *d = NULL;
+    /* a fill may skip a block and leave the buffer empty */
+    while (copy->buf_idx == copy->buf_entry) {
+        if (replay_loop_expired()) {
+            copy->remain_entry = 0;
+        }
+        if (!copy->remain_entry) {
+            return 0;
+        }
+        if (replay_copy_fill(copy)) {
+            return 1;
+        }
+    }
+    *d = &copy->buf[copy->buf_idx];
+    return 0;
+}
+
+/* pop the entry with the earliest shifted timestamp of all copies, *copy is NULL when done */
+static int
+replay_copy_next(struct replay_copy *copies, struct replay_copy **copy, struct trace_io_entry **d)
+{
+    struct trace_io_entry *next;
+    uint64_t min_tsc = UINT64_MAX;
+
+    *copy = NULL;
+    for (uint32_t i = 0; i < g_load_multiplier; i++) {
+        if (replay_copy_peek(&copies[i], &next)) {
+            return 1;
+        }
+        if (next && next->tsc_timestamp + copies[i].shift_tsc < min_tsc) {
+            min_tsc = next->tsc_timestamp + copies[i].shift_tsc;
+            *copy = &copies[i];
+        }
+    }
+
+    if (*copy) {
+        *d = &(*copy)->buf[(*copy)->buf_idx++];
+    }
+    return 0;
+}
+
+/* decode the entry and remap it into the LBA range (zone range on ZNS) owned by the copy */
+static void
+replay_copy_decode(struct replay_copy *copy, struct trace_io_entry *d, struct replay_req *req)
+{
+    uint64_t slba = (uint64_t)d->cdw10 | ((uint64_t)d->cdw11 & UINT32BIT_MASK) << 32;
+    uint32_t nlb = (uint32_t)(d->cdw12 & UINT16BIT_MASK) + 1;
+
+    req->tsc = d->tsc_timestamp + copy->shift_tsc;
+    req->nlb = nlb;
+    req->cdw13 = d->cdw13;
+    req->copy = copy->index;
+    req->lcore = d->lcore;
+    req->opc = d->opc;
+    req->loop = copy->loop;
+    req->complete = (strcmp(d->tpoint_name, "NVME_IO_COMPLETE") == 0);
+    req->slba = replay_remap(copy->index, slba, nlb);
+    if (g_loop_rotate_blk && copy->loop) {
+        req->slba = replay_rotate(copy->index, req->slba, nlb, copy->loop);
+    }
+}
+/* load multiplier end */
+
+/* request ring start */
+#define REQ_RING_FULL_WAIT_US 10
+
+static bool g_replay_abort = false;         /* set on error, stops reader and workers */
+
+static struct req_ring *
+req_ring_alloc(void)
+{
+    struct req_ring *ring = NULL;
+
+    if (posix_memalign((void **)&ring, REQ_RING_ALIGN, sizeof(struct req_ring)) != 0) {
+        fprintf(stderr, "Fail to allocate memory for request ring\n");
+        return NULL;
+    }
+    ring->head = 0;
+    ring->tail_cache = 0;
+    ring->tail = 0;
+    ring->head_cache = 0;
+    ring->done = false;
+    return ring;
+}
+
+/* producer side, waits while the ring is full; returns false if the replay is aborted or over */
+static bool
+req_ring_push(struct req_ring *ring, const struct replay_req *req)
+{
+    uint64_t head = ring->head;
+
+    while (spdk_unlikely(head - ring->tail_cache == REQ_RING_SIZE)) {
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head - ring->tail_cache == REQ_RING_SIZE) {
+            if (__atomic_load_n(&g_replay_abort, __ATOMIC_RELAXED) || replay_loop_expired()) {
+                return false;
+            }
+            usleep(REQ_RING_FULL_WAIT_US);
+        }
+    }
+    ring->req[head & (REQ_RING_SIZE - 1)] = *req;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* consumer side, returns false if the ring is empty */
+static bool
+req_ring_pop(struct req_ring *ring, struct replay_req *req)
+{
+    uint64_t tail = ring->tail;
+
+    if (tail == ring->head_cache) {
+        ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail == ring->head_cache) {
+            return false;
+        }
+    }
+    *req = ring->req[tail & (REQ_RING_SIZE - 1)];
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+/* request ring end */
+
+/* checkpoint start */
+/*
+ * Every checkpoint interval, each worker publishes two things: the shifted timestamp of its oldest
+ * request that has not completed, and a snapshot of its statistics. A checkpoint thread writes
+ * the earliest position of all workers, together with the statistics and the write pointers of
+ * the ordered zone write mode, to the state file. The file is replaced by rename, so a crash leaves
+ * either the old or the new checkpoint. On resume every copy seeks, through the trace index, to
+ * its first entry at or after the position. Requests that were in flight at the checkpoint are
+ * replayed again.
+ */
+#define CKPT_MAGIC 0x54504b4359414c50ULL      /* "PLAYCKPT" */
+#define CKPT_DONE UINT64_MAX                /* position of a completed replay */
+#define CKPT_WAIT_US 1000
+#define CKPT_PUBLISH_WAIT_MS 100            /* workers busy longer than this keep their last position */
+
+struct replay_ckpt_hdr {
+    uint64_t magic;
+    uint64_t trace_entry;       /* entries of the trace file */
+    uint64_t trace_first_tsc;   /* recorded timestamp of its first entry */
+    uint32_t load_multiplier;
+    uint32_t num_zone;          /* write pointers following the latency histograms */
+    uint64_t tsc;               /* shifted timestamp to resume at, CKPT_DONE when complete */
+    uint64_t replay_us;         /* replay time so far, over all resumes */
+    uint64_t num_io;
+    uint64_t wp_mismatch;
+    uint32_t num_resume;
+    uint32_t rsvd;
+};
+
+static uint64_t g_ckpt_epoch = 0;           /* bumped by the checkpoint thread to ask workers to publish */
+static bool g_ckpt_stop = false;
+static uint64_t g_ckpt_reader_tsc = 0;      /* shifted timestamp of the last request pushed by the reader */
+static uint64_t g_ckpt_start_tsc = 0;       /* spdk_get_ticks() when this run started replaying */
+static struct replay_ckpt_hdr g_ckpt_base;  /* loaded on resume, progress of the earlier runs */
+static struct trace_io_hist g_ckpt_base_hist[REPLAY_OPC_MAX];
+static uint64_t *g_ckpt_wp = NULL;
+
+/* earliest shifted timestamp of the requests of the worker that have not completed */
+static uint64_t
+replay_ckpt_position(struct replay_worker *worker)
+{
+    /* read before the ring, later pushes are not earlier */
+    uint64_t tsc = __atomic_load_n(&g_ckpt_reader_tsc, __ATOMIC_ACQUIRE);
+    uint64_t tail = worker->ring->tail;
+
+    if (tail != __atomic_load_n(&worker->ring->head, __ATOMIC_ACQUIRE)) {
+        tsc = worker->ring->req[tail & (REQ_RING_SIZE - 1)].tsc;
+    }
+    tsc = spdk_min(tsc, worker->ckpt_retry_tsc);
+    for (uint32_t i = 0; i < worker->pool.num_task; i++) {
+        tsc = spdk_min(tsc, worker->pool.tasks[i].tsc);
+    }
+    for (uint32_t i = 0; i < worker->num_hold; i++) {
+        tsc = spdk_min(tsc, worker->hold[i].req.tsc);
+    }
+    return tsc;
+}
+
+/* seqlock writer, only the worker itself publishes */
+static void
+replay_ckpt_publish(struct replay_worker *worker, uint64_t epoch, bool done)
+{
+    struct replay_ckpt_stat *stat = &worker->ckpt;
+    uint64_t tsc = done ? CKPT_DONE : replay_ckpt_position(worker);
+
+    __atomic_store_n(&stat->seq, stat->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    stat->tsc = tsc;
+    stat->num_io = worker->num_io;
+    stat->wp_mismatch = worker->wp_mismatch;
+    memcpy(stat->latency_hist, worker->latency_hist, sizeof(stat->latency_hist));
+    __atomic_store_n(&stat->seq, stat->seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&stat->epoch, epoch, __ATOMIC_RELEASE);
+}
+
+static inline void
+replay_ckpt_tick(struct replay_worker *worker)
+{
+    uint64_t epoch;
+
+    if (g_ckpt_file && (epoch = __atomic_load_n(&g_ckpt_epoch, __ATOMIC_ACQUIRE)) != worker->ckpt.epoch) {
+        replay_ckpt_publish(worker, epoch, false);
+    }
+}
+
+/* poll completions, issue unblocked requests and publish a checkpoint if asked */
+static void
+replay_poll(struct replay_worker *worker)
+{
+    dep_poll(worker);
+    replay_ckpt_tick(worker);
+}
+
+/* seqlock reader */
+static void
+replay_ckpt_read(struct replay_worker *worker, struct replay_ckpt_stat *stat)
+{
+    uint64_t seq;
+
+    do {
+        while ((seq = __atomic_load_n(&worker->ckpt.seq, __ATOMIC_ACQUIRE)) & 1);
+        memcpy(stat, &worker->ckpt, sizeof(*stat));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&worker->ckpt.seq, __ATOMIC_RELAXED) != seq);
+}
+
+static int
+replay_ckpt_save(const struct replay_ckpt_hdr *hdr, const struct trace_io_hist *hist, const uint64_t *wp)
+{
+    char tmp_name[PATH_MAX];
+
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", g_ckpt_file);
+    FILE *fptr = fopen(tmp_name, "wb");
+    if (fptr == NULL) {
+        fprintf(stderr, "Failed to open checkpoint file %s\n", tmp_name);
+        return 1;
+    }
+    if (fwrite(hdr, sizeof(*hdr), 1, fptr) != 1 ||
+        fwrite(hist, sizeof(struct trace_io_hist), REPLAY_OPC_MAX, fptr) != REPLAY_OPC_MAX ||
+        (hdr->num_zone && fwrite(wp, sizeof(uint64_t), hdr->num_zone, fptr) != hdr->num_zone)) {
+        fprintf(stderr, "Fail to write checkpoint file %s\n", tmp_name);
+        fclose(fptr);
+        return 1;
+    }
+    /* the state must be on disk before it replaces the previous one */
+    if (fflush(fptr) != 0 || fsync(fileno(fptr)) != 0) {
+        fprintf(stderr, "Fail to write checkpoint file %s\n", tmp_name);
+        fclose(fptr);
+        return 1;
+    }
+    fclose(fptr);
+    if (rename(tmp_name, g_ckpt_file) != 0) {
+        fprintf(stderr, "Failed to rename %s to %s: %s\n", tmp_name, g_ckpt_file, strerror(errno));
+        return 1;
+    }
+    return 0;
+}
+
+/* merge what the workers published with the earlier runs and write it out */
+static int
+replay_ckpt_write(struct replay_worker *workers, struct replay_ckpt_stat *stat, uint64_t *wp)
+{
+    struct replay_ckpt_hdr hdr = g_ckpt_base;
+    struct trace_io_hist hist[REPLAY_OPC_MAX];
+
+    memcpy(hist, g_ckpt_base_hist, sizeof(hist));
+    hdr.tsc = CKPT_DONE;
+    hdr.replay_us += (uint64_t)get_us_from_tick(spdk_get_ticks() - g_ckpt_start_tsc);
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        replay_ckpt_read(&workers[i], stat);
+        hdr.tsc = spdk_min(hdr.tsc, stat->tsc);
+        hdr.num_io += stat->num_io;
+        hdr.wp_mismatch += stat->wp_mismatch;
+        for (uint32_t j = 0; j < REPLAY_OPC_MAX; j++) {
+            trace_io_hist_merge(&hist[j], &stat->latency_hist[j]);
+        }
+    }
+    hdr.num_zone = 0;
+    if (g_zone_info) {
+        hdr.num_zone = (uint32_t)g_num_zone;
+        for (uint64_t i = 0; i < g_num_zone; i++) {
+            wp[i] = __atomic_load_n(&g_zone_info[i].wp, __ATOMIC_RELAXED);
+        }
+    }
+    return replay_ckpt_save(&hdr, hist, wp);
+}
+
+/* ask the workers to publish and wait a little for them */
+static void
+replay_ckpt_request(struct replay_worker *workers)
+{
+    uint64_t epoch = __atomic_add_fetch(&g_ckpt_epoch, 1, __ATOMIC_RELEASE);
+    uint64_t end_tsc = spdk_get_ticks() + CKPT_PUBLISH_WAIT_MS * spdk_get_ticks_hz() / 1000;
+
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        while (__atomic_load_n(&workers[i].ckpt.epoch, __ATOMIC_ACQUIRE) != epoch &&
+               !__atomic_load_n(&workers[i].ckpt_exit, __ATOMIC_ACQUIRE) && spdk_get_ticks() < end_tsc) {
+            usleep(CKPT_WAIT_US);
+        }
+    }
+}
+
+static void *
+replay_ckpt_run(void *arg)
+{
+    struct replay_worker *workers = (struct replay_worker *)arg;
+    uint64_t interval_tsc = (uint64_t)(g_ckpt_interval_s * spdk_get_ticks_hz());
+    uint64_t next_tsc = spdk_get_ticks() + interval_tsc;
+    struct replay_ckpt_stat *stat = (struct replay_ckpt_stat *)malloc(sizeof(struct replay_ckpt_stat));
+    uint64_t *wp = (uint64_t *)calloc(g_num_zone ? g_num_zone : 1, sizeof(uint64_t));
+
+    if (!stat || !wp) {
+        fprintf(stderr, "Fail to allocate memory for checkpoint, no checkpoint is written\n");
+        free(stat);
+        free(wp);
+        return NULL;
+    }
+    while (!__atomic_load_n(&g_ckpt_stop, __ATOMIC_ACQUIRE)) {
+        if (spdk_get_ticks() < next_tsc) {
+            usleep(CKPT_WAIT_US);
+            continue;
+        }
+        replay_ckpt_request(workers);
+        replay_ckpt_write(workers, stat, wp);
+        next_tsc = spdk_get_ticks() + interval_tsc;
+    }
+    /* the workers published their last position on exit */
+    replay_ckpt_write(workers, stat, wp);
+    free(stat);
+    free(wp);
+    return NULL;
+}
+
+/* called once before the reader starts */
+static void
+replay_ckpt_start(struct replay_worker *workers)
+{
+    g_ckpt_stop = false;
+    g_ckpt_epoch = 0;
+    g_ckpt_reader_tsc = g_ckpt_base.tsc;
+    g_ckpt_start_tsc = spdk_get_ticks();
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        memset(&workers[i].ckpt, 0, sizeof(workers[i].ckpt));
+        workers[i].ckpt.tsc = g_ckpt_base.tsc;
+        workers[i].ckpt_retry_tsc = UINT64_MAX;
+        workers[i].ckpt_exit = false;
+    }
+}
+
+/* count of entries and first timestamp identify the trace */
+static int
+replay_ckpt_trace(const char *file_name, uint64_t *trace_entry, struct trace_io_entry *first)
+{
+    FILE *fptr = fopen(file_name, "rb");
+    if (fptr == NULL) {
+        fprintf(stderr, "Failed to open input file %s\n", file_name);
+        return 1;
+    }
+    fseek(fptr, 0, SEEK_END);
+    *trace_entry = ftell(fptr) / sizeof(struct trace_io_entry);
+    if (*trace_entry == 0 || read_entry_at(fptr, 0, first)) {
+        fprintf(stderr, "Fail to read input file\n");
+        fclose(fptr);
+        return 1;
+    }
+    fclose(fptr);
+    return 0;
+}
+
+static int
+replay_ckpt_load(struct replay_ckpt_hdr *hdr)
+{
+    FILE *fptr = fopen(g_ckpt_file, "rb");
+    if (fptr == NULL) {
+        fprintf(stderr, "Failed to open checkpoint file %s\n", g_ckpt_file);
+        return 1;
+    }
+    if (fread(hdr, sizeof(*hdr), 1, fptr) != 1 || hdr->magic != CKPT_MAGIC ||
+        fread(g_ckpt_base_hist, sizeof(struct trace_io_hist), REPLAY_OPC_MAX, fptr) != REPLAY_OPC_MAX) {
+        fprintf(stderr, "Invalid checkpoint file %s\n", g_ckpt_file);
+        fclose(fptr);
+        return 1;
+    }
+    if (hdr->num_zone) {
+        g_ckpt_wp = (uint64_t *)malloc(hdr->num_zone * sizeof(uint64_t));
+        if (!g_ckpt_wp || fread(g_ckpt_wp, sizeof(uint64_t), hdr->num_zone, fptr) != hdr->num_zone) {
+            fprintf(stderr, "Invalid checkpoint file %s\n", g_ckpt_file);
+            fclose(fptr);
+            return 1;
+        }
+    }
+    fclose(fptr);
+    return 0;
+}
+
+/* identify the trace in the state, and on resume load it; *done is set if there is nothing left to replay */
+static int
+replay_ckpt_init(const char *file_name, bool *done)
+{
+    struct trace_io_entry first;
+    struct replay_ckpt_hdr hdr;
+    uint64_t trace_entry = 0;
+
+    *done = false;
+    if (replay_ckpt_trace(file_name, &trace_entry, &first)) {
+        return 1;
+    }
+    if (!g_ckpt_resume) {
+        memset(&g_ckpt_base, 0, sizeof(g_ckpt_base));
+        g_ckpt_base.magic = CKPT_MAGIC;
+        g_ckpt_base.trace_entry = trace_entry;
+        g_ckpt_base.trace_first_tsc = first.tsc_timestamp;
+        g_ckpt_base.load_multiplier = g_load_multiplier;
+        for (uint32_t i = 0; i < REPLAY_OPC_MAX; i++) {
+            trace_io_hist_init(&g_ckpt_base_hist[i]);
+        }
+        return 0;
+    }
+
+    if (replay_ckpt_load(&hdr)) {
+        return 1;
+    }
+    if (hdr.trace_entry != trace_entry || hdr.trace_first_tsc != first.tsc_timestamp ||
+        hdr.load_multiplier != g_load_multiplier) {
+        fprintf(stderr, "Checkpoint %s was taken with another trace or load multiplier\n", g_ckpt_file);
+        return 1;
+    }
+    g_ckpt_base = hdr;
+    g_ckpt_base.num_resume++;
+    g_ckpt_resume_tsc = hdr.tsc;
+    /* the duration covers all runs */
+    if (g_loop_duration_s > 0) {
+        g_loop_duration_s -= hdr.replay_us / 1000000.0;
+        *done = g_loop_duration_s <= 0;
+    }
+    if (hdr.tsc == CKPT_DONE || *done) {
+        *done = true;
+        printf("%-20s: %s, the replay completed\n", "Resume", g_ckpt_file);
+        return 0;
+    }
+    /* the state of the device is kept */
+    g_reset_mode = RESET_MODE_NONE;
+    g_precondition_mode = PRECONDITION_MODE_NONE;
+    printf("%-20s: %s at %.3f s of the trace, %ju requests in %.3f s before\n", "Resume", g_ckpt_file,
+           (double)(hdr.tsc - first.tsc_timestamp) / first.tsc_rate, hdr.num_io, hdr.replay_us / 1000000.0);
+    return 0;
+}
+
+/* write pointers that moved since the checkpoint, on resume in the ordered zone write mode */
+static void
+replay_ckpt_zone_check(void)
+{
+    uint64_t moved = 0;
+
+    if (!g_ckpt_resume || !g_zone_info || !g_ckpt_wp) {
+        return;
+    }
+    if (g_ckpt_base.num_zone != g_num_zone) {
+        printf("%-20s: checkpoint of %u zones, namespace has %ju\n", "Zone WP", g_ckpt_base.num_zone, g_num_zone);
+        return;
+    }
+    for (uint64_t i = 0; i < g_num_zone; i++) {
+        if (g_zone_info[i].wp != g_ckpt_wp[i]) {
+            moved++;
+        }
+    }
+    printf("%-20s: %ju zones moved since the checkpoint\n", "Zone WP", moved);
+}
+
+static void
+print_replay_ckpt(void)
+{
+    if (!g_ckpt_file) {
+        return;
+    }
+    printf("%-16s: %15s", "Checkpoint", g_ckpt_file);
+    if (g_ckpt_base.num_resume) {
+        printf(" resumed %u times, %ju requests in %.3f (ms) before", g_ckpt_base.num_resume,
+               g_ckpt_base.num_io, g_ckpt_base.replay_us / 1000.0);
+    }
+    printf("\n");
+}
+/* checkpoint end */
+
+/* replay worker start */
+struct replay_reader {
+    pthread_t thread;
+    struct replay_copy *copies;
+    struct replay_worker *workers;
+    int rc;
+};
+
+static uint32_t
+replay_lcore_worker(uint32_t lcore)
+{
+    return (lcore < SPDK_TRACE_MAX_LCORE) ? g_lcore_worker[lcore] : 0;
+}
+
+/* read and decode the trace ahead of the workers, route each request to the ring of its worker */
+static void *
+replay_reader_run(void *arg)
+{
+    struct replay_reader *reader = (struct replay_reader *)arg;
+    struct replay_copy *copy;
+    struct trace_io_entry *entry;
+    struct replay_req req;
+    uint32_t index;
+    int rc;
+
+    while ((rc = replay_copy_next(reader->copies, &copy, &entry)) == 0 && copy) {
+        if (!replay_filter_pass(copy, entry)) {
+            continue;
+        }
+        replay_copy_decode(copy, entry, &req);
+        index = replay_lcore_worker(entry->lcore);
+        if (g_barrier && !req.complete) {
+            replay_timing_push(index, req.tsc);
+        }
+        if (!req_ring_push(reader->workers[index].ring, &req)) {
+            break;
+        }
+        if (g_barrier) {
+            replay_timing_pushed(req.tsc);
+        }
+        if (g_ckpt_file) {
+            __atomic_store_n(&g_ckpt_reader_tsc, req.tsc, __ATOMIC_RELEASE);
+        }
+    }
+    if (rc != 0) {
+        __atomic_store_n(&g_replay_abort, true, __ATOMIC_RELAXED);
+    }
+    reader->rc = rc;
+
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        __atomic_store_n(&reader->workers[i].ring->done, true, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/* next request of the worker, polls completions while the ring is empty; returns false when done */
+static bool
+replay_worker_next(struct replay_worker *worker, struct replay_req *req)
+{
+    while (!req_ring_pop(worker->ring, req)) {
+        if (__atomic_load_n(&worker->ring->done, __ATOMIC_ACQUIRE)) {
+            /* the reader may have pushed right before done */
+            return req_ring_pop(worker->ring, req);
+        }
+        if (__atomic_load_n(&g_replay_abort, __ATOMIC_RELAXED)) {
+            return false;
+        }
+        replay_poll(worker);
+    }
+    return true;
+}
+
+static int
+replay_worker_run(void *arg)
+{
+    struct replay_worker *worker = (struct replay_worker *)arg;
+    struct replay_req req;
+    uint64_t start_tsc = spdk_get_ticks();
+    int rc = 0;
+
+    while (replay_worker_next(worker, &req) && !replay_loop_expired()) {
+        if (req.complete) {
+            /* skip completions of requests submitted before the copy starts */
+            if (worker->copy_outstanding[req.copy]) {
+                worker->copy_outstanding[req.copy]--;
+                replay_timing_complete(worker, &req);
+            }
+            continue;
+        }
+        worker->copy_outstanding[req.copy]++;
+        /* out of the ring and not yet in a task, the wait below may publish a checkpoint */
+        worker->ckpt_retry_tsc = spdk_min(worker->ckpt_retry_tsc, req.tsc);
+        replay_ckpt_tick(worker);
+
+        replay_timing_wait(worker, &req);
+
+        req.dep = NULL;
+        if (g_dep_track) {
+            rc = dep_submit(worker, &req);
+        } else if (g_zone) {
+            rc = process_zns_replay(worker, &req);
+        } else {
+            rc = process_replay(worker, &req);
+        }
+
+        if (rc != 0) {
+            /* it is replayed again on resume */
+            __atomic_store_n(&g_replay_abort, true, __ATOMIC_RELAXED);
+            break;
+        }
+        if (!worker->dep_rc) {
+            /* a held request that failed to issue stays in the checkpoint */
+            worker->ckpt_retry_tsc = UINT64_MAX;
+        }
+    }
+    if (!rc && g_dep_track) {
+        rc = dep_drain(worker);
+    }
+    replay_timing_finish(worker);
+    for (; worker->outstanding; g_backend->poll(worker->qpair));
+    for (; worker->verifying; data_verify_reclaim(worker));
+    if (g_ckpt_file) {
+        replay_ckpt_publish(worker, worker->ckpt.epoch, !rc && !__atomic_load_n(&g_replay_abort, __ATOMIC_RELAXED));
+        __atomic_store_n(&worker->ckpt_exit, true, __ATOMIC_RELEASE);
+    }
+
+    worker->replay_tsc = spdk_get_ticks() - start_tsc;
+    worker->rc = rc;
+    return rc;
+}
+
+/* collect recorded lcores and map them to workers, must be called before spdk_env_init() */
+static int
+replay_worker_map(const char *file_name)
+{
+    uint32_t num_lcore = 0;
+    int len = 0;
+
+    if (!g_core_list) {
+        return 0;
+    }
+
+    FILE *fptr = fopen(file_name, "rb");
+    if (fptr == NULL) {
+        fprintf(stderr, "Failed to open input file %s\n", file_name);
+        return 1;
+    }
+    struct trace_io_entry *buffer = (struct trace_io_entry *)malloc(ENTRY_MAX * sizeof(struct trace_io_entry));
+    if (!buffer) {
+        fprintf(stderr, "Fail to allocate memory for replay buffer\n");
+        fclose(fptr);
+        return 1;
+    }
+    size_t read_entry;
+    while ((read_entry = fread(buffer, sizeof(struct trace_io_entry), ENTRY_MAX, fptr)) > 0) {
+        for (size_t i = 0; i < read_entry; i++) {
+            uint32_t lcore = buffer[i].lcore;
+            if (lcore < SPDK_TRACE_MAX_LCORE && (!g_filter_by_lcore || g_filter_lcore[lcore])) {
+                g_lcore_used[lcore] = true;
+            }
+        }
+    }
+    free(buffer);
+    fclose(fptr);
+
+    g_num_worker = 0;
+    if (strcmp(g_core_list, "auto") == 0) {
+        /* one worker per recorded lcore */
+        for (uint32_t i = 0; i < SPDK_TRACE_MAX_LCORE; i++) {
+            if (g_lcore_used[i] && g_num_worker < WORKER_MAX) {
+                g_worker_core[g_num_worker] = g_num_worker;
+                g_num_worker++;
+            }
+        }
+    } else {
+        char *list = strdup(g_core_list);
+        char *saveptr = NULL;
+        for (char *core = strtok_r(list, ",", &saveptr); core; core = strtok_r(NULL, ",", &saveptr)) {
+            if (g_num_worker == WORKER_MAX) {
+                fprintf(stderr, "At most %d replay cores are supported\n", WORKER_MAX);
+                free(list);
+                return 1;
+            }
+            g_worker_core[g_num_worker] = (uint32_t)atoi(core);
+            for (uint32_t i = 0; i < g_num_worker; i++) {
+                if (g_worker_core[i] == g_worker_core[g_num_worker]) {
+                    fprintf(stderr, "Core %u is listed more than once\n", g_worker_core[i]);
+                    free(list);
+                    return 1;
+                }
+            }
+            g_num_worker++;
+        }
+        free(list);
+    }
+    if (g_num_worker == 0) {
+        g_num_worker = 1;
+        g_worker_core[0] = 0;
+    }
+
+    /* recorded lcores are assigned to workers round-robin in lcore order */
+    for (uint32_t i = 0; i < SPDK_TRACE_MAX_LCORE; i++) {
+        if (g_lcore_used[i]) {
+            g_lcore_worker[i] = num_lcore++ % g_num_worker;
+        }
+    }
+
+    len += snprintf(g_core_mask + len, sizeof(g_core_mask) - len, "[");
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        len += snprintf(g_core_mask + len, sizeof(g_core_mask) - len, i ? ",%u" : "%u", g_worker_core[i]);
+    }
+    snprintf(g_core_mask + len, sizeof(g_core_mask) - len, "]");
+    return 0;
+}
+
+static void
+replay_worker_free(struct replay_worker *workers)
+{
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        free(workers[i].ring);
+        free(workers[i].copy_outstanding);
+        free(workers[i].window);
+        free(workers[i].loop);
+        if (workers[i].result) {
+            fclose(workers[i].result);
+        }
+        io_task_pool_fini(&workers[i].pool);
+        task_ring_free(workers[i].verify_ring);
+        task_ring_free(workers[i].verified_ring);
+        free(workers[i].verify_gen);
+        free(workers[i].verify_idx);
+        free(workers[i].dep_entries);
+        free(workers[i].hold);
+        /* qpair of worker 0 belongs to main */
+        if (i && workers[i].qpair) {
+            free_qpair(workers[i].qpair);
+        }
+    }
+    free(workers);
+}
+
+static struct replay_worker *
+replay_worker_alloc(struct replay_qpair *qpair)
+{
+    struct replay_worker *workers = (struct replay_worker *)calloc(g_num_worker, sizeof(struct replay_worker));
+    if (!workers) {
+        fprintf(stderr, "Fail to allocate memory for replay workers\n");
+        return NULL;
+    }
+    /* one task per queue slot, each with a buffer of the max transfer size */
+    uint32_t buf_byte = spdk_min(g_geo.max_xfer_byte, (uint32_t)IO_TASK_BUF_MAX);
+    buf_byte = spdk_max(buf_byte, g_block_byte);
+
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        struct replay_worker *worker = &workers[i];
+
+        worker->index = i;
+        worker->core = g_core_list ? g_worker_core[i] : spdk_env_get_current_core();
+        worker->qpair = i ? alloc_qpair() : qpair;
+        if (worker->qpair == NULL) {
+            goto err;
+        }
+        worker->ring = req_ring_alloc();
+        worker->copy_outstanding = (uint32_t *)calloc(g_load_multiplier, sizeof(uint32_t));
+        if (!worker->ring || !worker->copy_outstanding) {
+            fprintf(stderr, "Fail to allocate memory for replay workers\n");
+            goto err;
+        }
+        if (io_task_pool_init(&worker->pool, g_queue_depth, buf_byte)) {
+            goto err;
+        }
+        if (g_data_verify) {
+            worker->verify_ring = task_ring_alloc(g_queue_depth);
+            worker->verified_ring = task_ring_alloc(g_queue_depth);
+            worker->verify_gen_blk = buf_byte / g_block_byte;
+            worker->verify_gen = (uint8_t *)calloc(g_queue_depth, worker->verify_gen_blk);
+            if (g_zone) {
+                worker->verify_idx = (uint16_t *)calloc((size_t)g_queue_depth * worker->verify_gen_blk,
+                                                        sizeof(uint16_t));
+            }
+            if (!worker->verify_ring || !worker->verified_ring || !worker->verify_gen ||
+                (g_zone && !worker->verify_idx)) {
+                fprintf(stderr, "Fail to allocate memory for data verification\n");
+                goto err;
+            }
+        }
+        if (g_dep_track && dep_worker_init(worker)) {
+            goto err;
+        }
+        if (replay_result_open(worker)) {
+            goto err;
+        }
+    }
+    return workers;
+
+err:
+    replay_worker_free(workers);
+    return NULL;
+}
+
+enum launch_state {
+    LAUNCH_WAIT = 0,
+    LAUNCH_GO,
+    LAUNCH_CANCEL,
+};
+
+static int g_launch_state = LAUNCH_WAIT;
+
+/* launched workers wait until every worker is launched, they wait on each other once running */
+static int
+replay_worker_start(void *arg)
+{
+    struct replay_worker *worker = (struct replay_worker *)arg;
+    int state;
+
+    while ((state = __atomic_load_n(&g_launch_state, __ATOMIC_ACQUIRE)) == LAUNCH_WAIT) {
+        spdk_pause();
+    }
+    if (state == LAUNCH_CANCEL) {
+        return 0;
+    }
+    return worker->fn(worker);
+}
+
+/*
+ * run fn for every worker on its core and wait for all of them, the worker on the main core runs in
+ * place. Nothing runs unless every worker is launched.
+ */
+static int
+replay_worker_foreach(struct replay_worker *workers, thread_start_fn fn)
+{
+    uint32_t main_core = spdk_env_get_current_core();
+    struct replay_worker *in_place = NULL;
+    int rc = 0;
+
+    g_launch_state = LAUNCH_WAIT;
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        workers[i].fn = fn;
+        if (workers[i].core == main_core) {
+            in_place = &workers[i];
+        } else if (spdk_env_thread_launch_pinned(workers[i].core, replay_worker_start, &workers[i]) != 0) {
+            fprintf(stderr, "Failed to launch replay worker on core %u\n", workers[i].core);
+            rc = 1;
+            break;
+        }
+    }
+    __atomic_store_n(&g_launch_state, rc ? LAUNCH_CANCEL : LAUNCH_GO, __ATOMIC_RELEASE);
+    if (!rc && in_place) {
+        fn(in_place);
+    }
+    spdk_env_thread_wait_all();
+    return rc;
+}
+
+/* start the reader, launch workers on their cores */
+static int
+replay_worker_launch(struct replay_worker *workers, struct replay_copy *copies)
+{
+    struct replay_reader reader = {.copies = copies, .workers = workers, .rc = 0};
+    pthread_t verifier, checkpoint;
+    int rc = 0;
+
+    if (copies[0].total_entry) {
+        /* a resumed replay starts at the checkpoint */
+        replay_timing_start(spdk_max(copies[0].first_tsc, g_ckpt_resume_tsc), copies[0].tsc_rate);
+    }
+    replay_latency_start();
+    replay_loop_start();
+    if (g_dep_track) {
+        dep_init();
+    }
+    if (g_rate_limited) {
+        rate_limit_start(workers);
+    }
+    if (g_ckpt_file) {
+        replay_ckpt_start(workers);
+    }
+
+    if (pthread_create(&reader.thread, NULL, replay_reader_run, &reader) != 0) {
+        fprintf(stderr, "Failed to create replay reader thread\n");
+        return 1;
+    }
+    g_verify_stop = false;
+    if (g_data_verify && pthread_create(&verifier, NULL, replay_verifier_run, workers) != 0) {
+        fprintf(stderr, "Failed to create data verifier thread\n");
+        __atomic_store_n(&g_replay_abort, true, __ATOMIC_RELAXED);
+        pthread_join(reader.thread, NULL);
+        return 1;
+    }
+    if (g_ckpt_file && pthread_create(&checkpoint, NULL, replay_ckpt_run, workers) != 0) {
+        fprintf(stderr, "Failed to create checkpoint thread\n");
+        __atomic_store_n(&g_replay_abort, true, __ATOMIC_RELAXED);
+        pthread_join(reader.thread, NULL);
+        if (g_data_verify) {
+            __atomic_store_n(&g_verify_stop, true, __ATOMIC_RELEASE);
+            pthread_join(verifier, NULL);
+        }
+        return 1;
+    }
+
+    if (replay_worker_foreach(workers, replay_worker_run) != 0) {
+        /* stops the reader */
+        __atomic_store_n(&g_replay_abort, true, __ATOMIC_RELAXED);
+        rc = 1;
+    }
+    pthread_join(reader.thread, NULL);
+    if (g_data_verify) {
+        __atomic_store_n(&g_verify_stop, true, __ATOMIC_RELEASE);
+        pthread_join(verifier, NULL);
+    }
+    if (g_ckpt_file) {
+        /* writes the last checkpoint */
+        __atomic_store_n(&g_ckpt_stop, true, __ATOMIC_RELEASE);
+        pthread_join(checkpoint, NULL);
+    }
+
+    if (reader.rc != 0) {
+        rc = reader.rc;
+    }
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        replay_timing_merge(&workers[i]);
+        io_task_pool_merge(&workers[i].pool);
+        replay_latency_merge(&workers[i]);
+        rate_limit_merge(&workers[i]);
+        g_verify_blk += workers[i].verify_blk;
+        g_verify_skip += workers[i].verify_skip;
+        g_verify_error += workers[i].verify_error;
+        if (workers[i].rc != 0) {
+            rc = workers[i].rc;
+        }
+    }
+    /* latency and mismatches cover all runs of a resumed replay */
+    if (g_ckpt_resume) {
+        for (uint32_t i = 0; i < REPLAY_OPC_MAX; i++) {
+            trace_io_hist_merge(&g_latency_hist[i], &g_ckpt_base_hist[i]);
+        }
+        g_wp_mismatch += g_ckpt_base.wp_mismatch;
+    }
+    if (replay_result_merge(workers) != 0) {
+        rc = 1;
+    }
+    return rc;
+}
+
+static void
+print_replay_worker(struct replay_worker *workers)
+{
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        g_zone_wait_tsc += workers[i].zone_wait_tsc;
+        g_wp_mismatch += workers[i].wp_mismatch;
+        g_zone_skip += workers[i].zone_skip;
+        g_dep_held += workers[i].dep_held;
+        g_dep_hold_tsc += workers[i].dep_hold_tsc;
+    }
+    if (g_zone_ordered) {
+        printf("%-16s: %15ju \n", "WP mismatch", g_wp_mismatch);
+        printf("%-16s: %15ju \n", "Zone skip", g_zone_skip);
+        printf("%-16s: %15.3f (ms) \n", "Zone wait", get_us_from_tick(g_zone_wait_tsc) / 1000);
+    }
+    if (g_dep_track) {
+        printf("%-16s: %15ju held %.3f (ms) total hold\n", "Dependency", g_dep_held,
+               get_us_from_tick(g_dep_hold_tsc) / 1000);
+    }
+    if (g_data_verify) {
+        printf("%-16s: %15ju (blocks) %ju unknown %ju mismatch\n", "Data verify", g_verify_blk, g_verify_skip,
+               g_verify_error);
+    }
+    if (g_num_worker == 1) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < g_num_worker; i++) {
+        float replay_us = get_us_from_tick(workers[i].replay_tsc);
+        printf("Worker %-2u core %-3u: %12ju requests %15.3f IOPS  lcore", i, workers[i].core,
+               workers[i].num_io, replay_us > 0 ? workers[i].num_io * 1000000.0 / replay_us : 0);
+        for (uint32_t lcore = 0; lcore < SPDK_TRACE_MAX_LCORE; lcore++) {
+            if (g_lcore_used[lcore] && g_lcore_worker[lcore] == i) {
+                printf(" %u", lcore);
+            }
+        }
+        printf("\n");
+    }
+}
+/* replay worker end */
+
+/* parallel reset start */
+#define RESET_DSM_BLK (1ULL << 24)      /* blocks per deallocate command */
+#define RESET_WRITE_ZEROES_BLK (1ULL << 16) /* max NLB of a write zeroes command */
+
+struct reset_range {
+    uint64_t slba;
+    uint64_t nlb;
+};
+
+static struct reset_range *g_reset_range = NULL;
+static uint64_t g_num_reset_range = 0;
+static uint64_t g_reset_range_size = 0;
+static uint16_t g_reset_opc = 0;
+
+static int
+reset_range_add(uint64_t slba, uint64_t nlb)
+{
+    /* extend the last range if contiguous, sequential reads collapse on the fly */
+    if (g_num_reset_range) {
+        struct reset_range *last = &g_reset_range[g_num_reset_range - 1];
+        if (slba >= last->slba && slba <= last->slba + last->nlb) {
+            last->nlb = spdk_max(last->nlb, slba + nlb - last->slba);
+            return 0;
+        }
+    }
+    if (g_num_reset_range == g_reset_range_size) {
+        uint64_t size = spdk_max(g_reset_range_size * 2, 4096);
+        struct reset_range *buf = (struct reset_range *)realloc(g_reset_range, size * sizeof(struct reset_range));
+        if (!buf) {
+            fprintf(stderr, "Fail to allocate memory for reset ranges\n");
+            return 1;
+        }
+        g_reset_range = buf;
+        g_reset_range_size = size;
+    }
+    g_reset_range[g_num_reset_range].slba = slba;
+    g_reset_range[g_num_reset_range].nlb = nlb;
+    g_num_reset_range++;
+    return 0;
+}
+
+static int
+reset_range_cmp(const void *a, const void *b)
+{
+    const struct reset_range *ra = (const struct reset_range *)a;
+    const struct reset_range *rb = (const struct reset_range *)b;
+
+    return (ra->slba > rb->slba) - (ra->slba < rb->slba);
+}
+
+/* sort and merge overlapping ranges */
+static void
+reset_range_merge(void)
+{
+    uint64_t num = 0;
+
+    qsort(g_reset_range, g_num_reset_range, sizeof(struct reset_range), reset_range_cmp);
+    for (uint64_t i = 0; i < g_num_reset_range; i++) {
+        struct reset_range *r = &g_reset_range[i];
+        if (num && r->slba <= g_reset_range[num - 1].slba + g_reset_range[num - 1].nlb) {
+            struct reset_range *last = &g_reset_range[num - 1];
+            last->nlb = spdk_max(last->nlb, r->slba + r->nlb - last->slba);
+        } else {
+            g_reset_range[num++] = *r;
+        }
+    }
+    g_num_reset_range = num;
+}
+
+/* on ZNS the ranges are whole zones, of every request that reads or writes them */
+static int
+reset_zone_touched(const struct replay_req *req)
+{
+    uint64_t first = req->slba / g_zone_sz_blk;
+    uint64_t last = (req->slba + spdk_max(req->nlb, 1) - 1) / g_zone_sz_blk;
+
+    switch (replay_opc_class(req->opc)) {
+    case REPLAY_OPC_READ:
+    case REPLAY_OPC_WRITE:
+    case REPLAY_OPC_APPEND:
+    case REPLAY_OPC_WRITE_ZEROES:
+        break;
+    case REPLAY_OPC_ZONE_MGMT:
+        if (req->opc == SPDK_NVME_OPC_ZONE_MGMT_SEND && (req->cdw13 & (uint32_t)1 << 8)) {
+            first = 0;
+            last = g_num_zone - 1;
+        }
+        break;
+    default:
+        return 0;
+    }
+    if (first >= g_num_zone) {
+        return 0;
+    }
+    last = spdk_min(last, g_num_zone - 1);
+    return reset_range_add(first * g_zone_sz_blk, (last - first + 1) * g_zone_sz_blk);
+}
+
+/* pre-scan the trace, with the same copies and remap as the replay, for LBAs that are read, or zones touched on ZNS */
+static int
+reset_scan_touched(const char *file_name)
+{
+    struct replay_copy *copy;
+    struct trace_io_entry *entry;
+    struct replay_req req;
+    int rc;
+
+    struct replay_copy *copies = replay_copy_alloc(file_name, true);
+    if (!copies) {
+        return 1;
+    }
+    while ((rc = replay_copy_next(copies, &copy, &entry)) == 0 && copy) {
+        if (!replay_filter_pass(copy, entry)) {
+            continue;
+        }
+        replay_copy_decode(copy, entry, &req);
+        if (req.complete) {
+            continue;
+        }
+        if (g_zone) {
+            rc = reset_zone_touched(&req);
+            if (rc) {
+                break;
+            }
+            continue;
+        }
+        if (replay_opc_class(req.opc) != REPLAY_OPC_READ) {
+            continue;
+        }
+        rc = reset_range_add(req.slba, spdk_min(req.nlb, g_ns_blk - spdk_min(req.slba, g_ns_blk)));
+        if (rc) {
+            break;
+        }
+    }
+    replay_copy_free(copies);
+
+    reset_range_merge();
+    return rc;
+}
+
+static void
+reset_range_complete(void *cb_arg, const struct spdk_nvme_cpl *cpl)
+{
+    struct io_task *task = (struct io_task *)cb_arg;
+    struct replay_worker *worker = task->worker;
+
+    if (spdk_nvme_cpl_is_error(cpl)) {
+        fprintf(stderr, "Reset namespace error - opc = 0x%x, slba = 0x%lx, nlb = %d, status = %s\n",
+                 task->opc, task->slba, task->nlb, spdk_nvme_cpl_get_status_string(&cpl->status));
+        worker->reset_error++;
+    }
+    io_task_put(worker, task);
+    worker->outstanding--;
+}
+
+static int
+reset_range_submit(struct replay_worker *worker, uint64_t slba, uint32_t nlb)
+{
+    struct io_task *task = io_task_get(worker, 0);
+    int err = 0;
+
+    task->qpair = worker->qpair;
+    task->worker = worker;
+    task->opc = g_reset_opc;
+    task->slba = slba;
+    task->nlb = nlb;
+
+    worker->outstanding++;
+    switch (g_reset_opc) {
+    case SPDK_NVME_OPC_DATASET_MANAGEMENT:
+        err = g_backend->deallocate(worker->qpair, slba, nlb, reset_range_complete, task);
+        break;
+    case SPDK_NVME_OPC_WRITE_ZEROES:
+        err = g_backend->write_zeroes(worker->qpair, slba, nlb, reset_range_complete, task);
         break;
     case SPDK_NVME_OPC_ZONE_MGMT_SEND:
-        task->slba = zslba;
-        bool select_all = (d->cdw13 & (uint32_t)1 << 8) ? true : false;
-        uint8_t zone_action = (uint8_t)(d->cdw13 & UINT8BIT_MASK);
-        if (zone_action == SPDK_NVME_ZONE_OPEN) {
-            g_num_io++;
-            outstanding_commands++;
-            err = spdk_nvme_zns_open_zone(ns, qpair, zslba, select_all, replay_complete, task);
-        } else if (zone_action == SPDK_NVME_ZONE_CLOSE) {
-            g_num_io++;
-            outstanding_commands++;
-            err = spdk_nvme_zns_close_zone(ns, qpair, zslba, select_all, replay_complete, task);
-        } else if (zone_action == SPDK_NVME_ZONE_FINISH) {
-            g_num_io++;
-            outstanding_commands++;
-            err = spdk_nvme_zns_finish_zone(ns, qpair, zslba, select_all, replay_complete, task);
-        } else if (zone_action == SPDK_NVME_ZONE_RESET) {
-            g_num_io++;
-            outstanding_commands++;
-            err = spdk_nvme_zns_reset_zone(ns, qpair, zslba, select_all, replay_complete, task);
-        } else if (zone_action == SPDK_NVME_ZONE_OFFLINE) {
-            g_num_io++;
-            outstanding_commands++;
-            err = spdk_nvme_zns_offline_zone(ns, qpair, zslba, select_all, replay_complete, task);
+        err = g_backend->zone_mgmt(worker->qpair, slba, SPDK_NVME_ZONE_RESET, false, reset_range_complete, task);
+        break;
+    default:
+        /* pool buffers are still zero before replay */
+        err = g_backend->write(worker->qpair, task->buf, slba, nlb, reset_range_complete, task);
+        break;
+    }
+    if (err) {
+        fprintf(stderr, "Reset namespace failed, err = %d\n", err);
+        worker->outstanding--;
+        io_task_put(worker, task);
+        return err;
+    }
+    worker->reset_blk += nlb;
+    return 0;
+}
+
+/* reset the ranges of the worker at full queue depth, ranges are assigned round-robin */
+static int
+reset_worker_run(void *arg)
+{
+    struct replay_worker *worker = (struct replay_worker *)arg;
+    uint64_t cmd_blk;
+    int rc = 0;
+
+    switch (g_reset_opc) {
+    case SPDK_NVME_OPC_DATASET_MANAGEMENT:
+        cmd_blk = RESET_DSM_BLK;
+        break;
+    case SPDK_NVME_OPC_WRITE_ZEROES:
+        cmd_blk = RESET_WRITE_ZEROES_BLK;
+        if (g_geo.max_write_zeroes_blk) {
+            cmd_blk = spdk_min(cmd_blk, g_geo.max_write_zeroes_blk);
         }
         break;
+    case SPDK_NVME_OPC_ZONE_MGMT_SEND:
+        cmd_blk = g_zone_sz_blk;
+        break;
     default:
+        cmd_blk = worker->pool.buf_byte / g_block_byte;
         break;
     }
 
-    if (err) {
-            fprintf(stderr, "Replay failed, err = %d\n", err);
+    for (uint64_t i = worker->index; i < g_num_reset_range && !rc; i += g_num_worker) {
+        struct reset_range *r = &g_reset_range[i];
+        for (uint64_t blk = 0; blk < r->nlb && !rc; blk += cmd_blk) {
+            while (worker->outstanding >= g_queue_depth) {
+                g_backend->poll(worker->qpair);
+            }
+            rc = reset_range_submit(worker, r->slba + blk, (uint32_t)spdk_min(cmd_blk, r->nlb - blk));
+        }
+    }
+    for (; worker->outstanding; g_backend->poll(worker->qpair));
+
+    worker->rc = rc;
+    return rc;
+}
+
+static int
+reset_ns(struct replay_qpair *qpair, struct replay_worker *workers, const char *file_name)
+{
+    static const char *mode_name[] = {"full", "touched", "none"};
+    uint64_t start_tsc = spdk_get_ticks();
+    uint64_t reset_blk = 0, reset_error = 0;
+    int rc = 0;
+
+    if (g_reset_mode == RESET_MODE_NONE) {
+        return 0;
+    }
+    if (g_zone && g_reset_mode == RESET_MODE_FULL) {
+        reset_all_zone(qpair);
+        printf("\nReset namespace complete.\n");
+        return 0;
+    }
+
+    if (g_zone) {
+        g_reset_opc = SPDK_NVME_OPC_ZONE_MGMT_SEND;
+    } else if (g_geo.deallocate) {
+        g_reset_opc = SPDK_NVME_OPC_DATASET_MANAGEMENT;
+    } else if (g_geo.write_zeroes) {
+        g_reset_opc = SPDK_NVME_OPC_WRITE_ZEROES;
+    } else {
+        g_reset_opc = SPDK_NVME_OPC_WRITE;
+    }
+
+    if (g_reset_mode == RESET_MODE_TOUCHED) {
+        rc = reset_scan_touched(file_name);
+    } else {
+        /* one slice of the namespace per worker */
+        uint64_t slice = spdk_max(g_ns_blk / g_num_worker, 1);
+        for (uint64_t slba = 0; slba < g_ns_blk && !rc; slba += slice) {
+            rc = reset_range_add(slba, spdk_min(slice, g_ns_blk - slba));
+        }
+    }
+
+    if (!rc) {
+        rc = replay_worker_foreach(workers, reset_worker_run);
+        for (uint32_t i = 0; i < g_num_worker; i++) {
+            reset_blk += workers[i].reset_blk;
+            reset_error += workers[i].reset_error;
+            if (workers[i].rc) {
+                rc = workers[i].rc;
+            }
+            workers[i].rc = 0;
+        }
+    }
+    free(g_reset_range);
+    g_reset_range = NULL;
+    g_num_reset_range = 0;
+    g_reset_range_size = 0;
+
+    printf("\nReset namespace complete. Mode %s, %s, %ju blocks, %ju errors, %.3f ms\n",
+           mode_name[g_reset_mode],
+           g_reset_opc == SPDK_NVME_OPC_DATASET_MANAGEMENT ? "deallocate" :
+           g_reset_opc == SPDK_NVME_OPC_WRITE_ZEROES ? "write zeroes" :
+           g_reset_opc == SPDK_NVME_OPC_ZONE_MGMT_SEND ? "zone reset" : "write",
+           reset_blk, reset_error, get_us_from_tick(spdk_get_ticks() - start_tsc) / 1000);
+    return rc;
+}
+/* parallel reset end */
+
+/* zone precondition start */
+/* mark every zone written by a zone management command of the trace */
+static void
+zone_scan_mgmt(uint64_t zone, const struct replay_req *req)
+{
+    uint8_t zone_action = (uint8_t)(req->cdw13 & UINT8BIT_MASK);
+    bool select_all = (req->cdw13 & (uint32_t)1 << 8) ? true : false;
+
+    if (zone_action != SPDK_NVME_ZONE_RESET && zone_action != SPDK_NVME_ZONE_FINISH &&
+        zone_action != SPDK_NVME_ZONE_OFFLINE) {
+        return;
+    }
+    for (uint64_t i = select_all ? 0 : zone; i < (select_all ? g_num_zone : zone + 1); i++) {
+        g_zone_info[i].scan = ZONE_SCAN_WRITTEN;
+    }
+}
+
+/*
+ * Pre-scan the trace with the same copies and remap as the replay. Every zone read before it is
+ * written is filled up to the highest block read, or up to the first recorded write, which is where
+ * the write pointer was when the trace was recorded.
+ */
+static int
+zone_scan(const char *file_name)
+{
+    struct replay_copy *copy;
+    struct trace_io_entry *entry;
+    struct replay_req req;
+    int rc;
+
+    struct replay_copy *copies = replay_copy_alloc(file_name, true);
+    if (!copies) {
+        return 1;
+    }
+    while ((rc = replay_copy_next(copies, &copy, &entry)) == 0 && copy) {
+        if (!replay_filter_pass(copy, entry)) {
+            continue;
+        }
+        replay_copy_decode(copy, entry, &req);
+        uint64_t zone = req.slba / g_zone_sz_blk;
+        if (req.complete || zone >= g_num_zone) {
+            continue;
+        }
+        struct zone_info *zi = &g_zone_info[zone];
+        uint64_t offset = req.slba % g_zone_sz_blk;
+
+        switch (req.opc) {
+        case SPDK_NVME_OPC_READ:
+        case SPDK_NVME_OPC_COMPARE:
+            if (zi->scan == ZONE_SCAN_UNSEEN) {
+                zi->fill = spdk_max(zi->fill, spdk_min(offset + req.nlb, zi->cap));
+            }
+            break;
+        case SPDK_NVME_OPC_WRITE:
+        case SPDK_NVME_OPC_WRITE_ZEROES:
+            if (zi->scan == ZONE_SCAN_UNSEEN) {
+                zi->fill = spdk_max(zi->fill, spdk_min(offset, zi->cap));
+            }
+            zi->scan = ZONE_SCAN_WRITTEN;
+            break;
+        case SPDK_NVME_OPC_ZONE_APPEND:
+            zi->scan = ZONE_SCAN_WRITTEN;
+            break;
+        case SPDK_NVME_OPC_ZONE_MGMT_SEND:
+            zone_scan_mgmt(zone, &req);
+            break;
+        default:
+            break;
+        }
     }
+    replay_copy_free(copies);
+    return rc;
+}
 
 /*
-    while (outstanding_commands) {
-        spdk_nvme_qpair_process_completions(qpair, 0);
+ * Zones the trace reads but never writes are filled completely, so that they do not hold active
+ * resources, as well as a percentage of the untouched zones, spread evenly over the namespace. Zones
+ * the trace writes later are filled up to their target and closed, those over the active zone limit
+ * are left empty.
+ */
+static void
+zone_plan(uint64_t *num_full, uint64_t *num_partial, uint64_t *num_skip)
+{
+    uint64_t num_unwritten = 0;
+
+    for (uint64_t i = 0; i < g_num_zone; i++) {
+        struct zone_info *zi = &g_zone_info[i];
+
+        if (zi->scan == ZONE_SCAN_UNSEEN) {
+            if (zi->fill) {
+                zi->fill = zi->cap;
+            } else if (g_precondition_mode == PRECONDITION_MODE_FILL) {
+                if ((num_unwritten + 1) * g_precondition_fill_pct / 100 != num_unwritten * g_precondition_fill_pct / 100) {
+                    zi->fill = zi->cap;
+                }
+                num_unwritten++;
+            }
+        }
+        if (zi->fill <= zi->submitted) {
+            zi->fill = 0;
+        } else if (zi->fill == zi->cap) {
+            (*num_full)++;
+        } else if (g_max_active_zone && *num_partial >= g_max_active_zone) {
+            zi->fill = 0;
+            (*num_skip)++;
+        } else {
+            (*num_partial)++;
+        }
+    }
+}
+
+static void
+zone_fill_complete(void *cb_arg, const struct spdk_nvme_cpl *cpl)
+{
+    struct io_task *task = (struct io_task *)cb_arg;
+    struct replay_worker *worker = task->worker;
+
+    if (spdk_nvme_cpl_is_error(cpl)) {
+        fprintf(stderr, "Precondition error - opc = 0x%x, slba = 0x%lx, nlb = %d, status = %s\n",
+                 task->opc, task->slba, task->nlb, spdk_nvme_cpl_get_status_string(&cpl->status));
+        worker->precondition_error++;
+    }
+    g_zone_info[task->slba / g_zone_sz_blk].outstanding--;
+    io_task_put(worker, task);
+    worker->outstanding--;
+}
+
+/* submit the next command of the zone, appends until the target, then a close for partial zones */
+static int
+zone_fill_submit(struct replay_worker *worker, uint64_t zone, uint32_t cmd_blk)
+{
+    struct zone_info *zi = &g_zone_info[zone];
+    struct io_task *task = io_task_get(worker, 0);
+    int err;
+
+    task->qpair = worker->qpair;
+    task->worker = worker;
+    task->slba = zone * g_zone_sz_blk;
+
+    zi->outstanding++;
+    worker->outstanding++;
+    if (zi->submitted < zi->fill) {
+        task->opc = SPDK_NVME_OPC_ZONE_APPEND;
+        task->nlb = (uint32_t)spdk_min(cmd_blk, zi->fill - zi->submitted);
+        err = g_backend->zone_append(worker->qpair, task->buf, task->slba, task->nlb, zone_fill_complete, task);
+        if (!err) {
+            zi->submitted += task->nlb;
+            worker->precondition_blk += task->nlb;
+        }
+    } else {
+        /* release the open zone resource for the replay */
+        task->opc = SPDK_NVME_OPC_ZONE_MGMT_SEND;
+        task->nlb = 0;
+        err = g_backend->zone_mgmt(worker->qpair, task->slba, SPDK_NVME_ZONE_CLOSE, false, zone_fill_complete, task);
+        zi->closed = true;
+    }
+    if (err) {
+        fprintf(stderr, "Precondition failed, err = %d\n", err);
+        zi->outstanding--;
+        worker->outstanding--;
+        io_task_put(worker, task);
     }
-    //printf("opc = 0x%x g_num_io = %ld\n", d->opc, g_num_io);
-    spdk_free(replay_buf);
-*/
     return err;
 }
 
+static bool
+zone_fill_done(struct zone_info *zi)
+{
+    return zi->submitted >= zi->fill && !zi->outstanding && (zi->fill == zi->cap || zi->closed);
+}
+
+/* fill the zones of the worker, zones are assigned round-robin and filled in parallel up to the open zone limit */
 static int
-process_replay(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair, struct trace_io_entry *d)
+zone_fill_run(void *arg)
 {
-    int err = 0;
-    uint64_t slba = (uint64_t)d->cdw10 | ((uint64_t)d->cdw11 & UINT32BIT_MASK) << 32;
-    uint32_t nlb = (uint32_t)(d->cdw12 & UINT16BIT_MASK) + 1;
+    struct replay_worker *worker = (struct replay_worker *)arg;
+    uint32_t zone_limit = g_max_open_zone ? g_max_open_zone : g_queue_depth;
+    uint32_t cmd_blk = spdk_min(worker->pool.buf_byte, g_max_append_byte) / g_block_byte;
+    uint32_t num_slot = 0;
+    int rc = 0;
 
-    /* allocate data buffers for SPDK NVMe I/O operations */
-    char *replay_buf = (char *)spdk_zmalloc(nlb * g_block_byte, g_block_byte,
-                             NULL, SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
-    if (!replay_buf) {
-        perror("Fail to malloc replay_buf");
-        exit(1); 
+    if (g_max_active_zone) {
+        zone_limit = spdk_min(zone_limit, g_max_active_zone);
     }
+    zone_limit = spdk_max(zone_limit / g_num_worker, 1);
+    cmd_blk = spdk_max(cmd_blk, 1);
 
-    /* read write replay */
-    struct io_task *task = (struct io_task *)malloc(sizeof(struct io_task));
-    task->qpair = qpair;
-    task->opc = d->opc;
-    task->slba = slba;
-    task->nlb = nlb;
-    task->buf = replay_buf;
+    uint64_t *slot = (uint64_t *)calloc(zone_limit, sizeof(uint64_t));
+    if (!slot) {
+        fprintf(stderr, "Fail to allocate memory for precondition\n");
+        worker->rc = 1;
+        return 1;
+    }
 
-    switch (d->opc) {
-    case SPDK_NVME_OPC_READ:
-    case SPDK_NVME_OPC_COMPARE:
-        memset(replay_buf, 0, (size_t)nlb * g_block_byte);
-        g_num_io++;
-        outstanding_commands++;
-        err = spdk_nvme_ns_cmd_read(ns, qpair, replay_buf, slba, nlb, replay_complete, task, 0);
-        break;
-    case SPDK_NVME_OPC_WRITE:
-        snprintf(replay_buf, (size_t)nlb * g_block_byte, "%s", "Hello World!\n");
-        g_num_io++;
-        outstanding_commands++;
-        err = spdk_nvme_ns_cmd_write(ns, qpair, replay_buf, slba, nlb, replay_complete, task, 0);
-        break;
-    case SPDK_NVME_OPC_WRITE_ZEROES:
-        g_num_io++;
-        outstanding_commands++;
-        err = spdk_nvme_ns_cmd_write_zeroes(ns, qpair, slba, nlb, replay_complete, task, 0);
-        break;
-    default:
-        break; 
+    /* zones of this worker are index, index + g_num_worker, ... among the zones to fill */
+    uint64_t zone = 0;
+    uint64_t num_fill = 0;
+    while (!rc) {
+        /* start new zones while there are free slots */
+        while (num_slot < zone_limit) {
+            for (; zone < g_num_zone && !g_zone_info[zone].fill; zone++);
+            if (zone == g_num_zone) {
+                break;
+            }
+            if (num_fill++ % g_num_worker == worker->index) {
+                slot[num_slot++] = zone;
+            }
+            zone++;
+        }
+        if (!num_slot) {
+            break;
+        }
+
+        for (uint32_t i = 0; i < num_slot && !rc; i++) {
+            struct zone_info *zi = &g_zone_info[slot[i]];
+            while (!rc && worker->outstanding < g_queue_depth &&
+                   (zi->submitted < zi->fill || (zi->fill < zi->cap && !zi->closed && !zi->outstanding))) {
+                rc = zone_fill_submit(worker, slot[i], cmd_blk);
+            }
+        }
+        g_backend->poll(worker->qpair);
+
+        /* release slots of finished zones */
+        for (uint32_t i = 0; i < num_slot;) {
+            if (zone_fill_done(&g_zone_info[slot[i]])) {
+                slot[i] = slot[--num_slot];
+            } else {
+                i++;
+            }
+        }
     }
+    for (; worker->outstanding; g_backend->poll(worker->qpair));
 
-    if (err) {
-            fprintf(stderr, "Replay failed, err = %d\n", err);
+    free(slot);
+    worker->rc = rc;
+    return rc;
+}
+
+static int
+precondition_ns(struct replay_qpair *qpair, struct replay_worker *workers, const char *file_name)
+{
+    uint64_t start_tsc = spdk_get_ticks();
+    uint64_t num_full = 0, num_partial = 0, num_skip = 0;
+    uint64_t precondition_blk = 0, precondition_error = 0;
+    int rc;
+
+    if (g_precondition_mode == PRECONDITION_MODE_NONE) {
+        return 0;
     }
-/*
-    while (outstanding_commands) {
-        spdk_nvme_qpair_process_completions(qpair, 0);
+    if (!g_zone) {
+        printf("\nPrecondition is only supported on ZNS namespaces, skipped.\n");
+        return 0;
     }
-    
-    spdk_free(replay_buf);
-*/
-    return err;
+
+    rc = zone_info_load(qpair);
+    if (!rc) {
+        rc = zone_scan(file_name);
+    }
+    if (!rc) {
+        zone_plan(&num_full, &num_partial, &num_skip);
+        rc = replay_worker_foreach(workers, zone_fill_run);
+        for (uint32_t i = 0; i < g_num_worker; i++) {
+            precondition_blk += workers[i].precondition_blk;
+            precondition_error += workers[i].precondition_error;
+            if (workers[i].rc) {
+                rc = workers[i].rc;
+            }
+            workers[i].rc = 0;
+        }
+    }
+    free(g_zone_info);
+    g_zone_info = NULL;
+
+    printf("\nPrecondition complete. %ju full zones, %ju partial zones, %ju skipped over active limit, "
+           "%ju blocks, %ju errors, %.3f ms\n", num_full, num_partial, num_skip, precondition_blk,
+           precondition_error, get_us_from_tick(spdk_get_ticks() - start_tsc) / 1000);
+    return rc;
 }
-/* replay workload end */
+/* zone precondition end */
 
 static void
 usage(const char *program_name)
@@ -628,15 +4779,135 @@ usage(const char *program_name)
     printf(" -f, specify the input file which generated by trace_io_record\n");
     printf(" -z, to display zone. 0 indicate displaying all zone\n");
     printf(" -q, Queue depth between 1 to 256. If non specify, default queue depth is 256.\n");
+    printf(" -m, replay mode: afap (default, as fast as queue depth allows),\n");
+    printf("     open (issue at recorded submit time) or closed (keep recorded queue depth)\n");
+    printf(" -x, open-loop time scale factor, e.g. 2 replays twice as fast, 0.5 half as fast. Default is 1\n");
+    printf(" -l, load multiplier, replay N phase-shifted copies of the trace on disjoint LBA ranges\n");
+    printf(" -c, replay cores, e.g. 0,2,4,6. One worker with its own qpair per core, recorded lcores are\n");
+    printf("     assigned round-robin. auto runs one worker per recorded lcore. Default is a single worker\n");
+    printf(" -b, barrier window in us, workers do not run ahead of each other by more than the window\n");
+    printf(" -o, write replayed requests to a trace_io format result file, which trace_analyzer can read\n");
+    printf(" -w, latency time-series window in ms\n");
+    printf(" -r, reset before replay: full (default), touched (only LBAs the trace reads,\n");
+    printf("     or the zones it touches on ZNS) or none\n");
+    printf(" -p, ZNS precondition: scan fills zones the trace reads before writing,\n");
+    printf("     fill:<pct> also fills pct%% of the zones the trace never writes. Default is none\n");
+    printf(" -L, LBA remap: wrap (modulo the device), scale[:<blocks>] (linear from a recorded namespace\n");
+    printf("     of blocks, default is the highest LBA of the trace) or zone[:<zone size>[:<zone capacity>]]\n");
+    printf("     (zone index modulo the device, offset scaled to zone capacity, the recorded geometry defaults\n");
+    printf("     to the device). Default is none\n");
+    printf(" -P, write deterministic per LBA and generation data patterns, pct%% of each block is left zero\n");
+    printf("     so that compression-capable drives see compressible data. Default is a fixed marker\n");
+    printf(" -V, verify the data of reads against the last generation written by the replay, implies -P 0.\n");
+    printf("     Reads are checked on a separate thread; appends are checked on backends returning their LBA\n");
+    printf(" -d, preserve ordering dependencies: a request overlapping an in-flight one (zone-wide for ZNS\n");
+    printf("     writes, appends and zone management) waits for it, unless both are reads or both are appends,\n");
+    printf("     later independent requests are issued in the meantime\n");
+    printf(" -a, ZNS write mode: append (default) replays writes as zone appends, ordered issues regular\n");
+    printf("     writes at the write pointer, one in flight per zone; writes over the zone capacity or the\n");
+    printf("     open and active zone limits are skipped\n");
+    printf(" -B, replay backend: nvme[:<transport id>] (default, SPDK NVMe driver), bdev:<config.json>:<bdev name>\n");
+    printf("     (SPDK bdev), uring:<block device or file> (Linux io_uring, zoned block devices such as\n");
+    printf("     zoned null_blk included, use -a ordered on them), null[:<blocks>[:<zone blocks>]]\n");
+    printf("     (completes instantly, measures replayer overhead) or emu[:<key>=<value>,...] (emulated\n");
+    printf("     namespace in memory with a latency model, keys are blocks, bs, zone, cap, open, active, ch,\n");
+    printf("     stripe, rlat, wlat, mlat, olat and data, latencies are fixed:<us>, uniform:<min>:<max> or exp:<mean>)\n");
+    printf(" -n, iterations, loop the trace N times. Each iteration is reported separately\n");
+    printf(" -t, duration in seconds, loop the trace until it elapses, or until -n iterations if also given\n");
+    printf(" -R, LBA offset in blocks added per iteration so that loops do not rewrite the same blocks,\n");
+    printf("     rounded up to zones on ZNS and wrapping inside the device (or the range of a -l copy)\n");
+    printf(" -s, slice <start>[:<end>] in seconds from the start of the trace, replay only that time window.\n");
+    printf("     The trace index (<trace>.idx, written by trace_catcher or built on first use) seeks to it directly\n");
+    printf(" -F, filter lcore=<lcore>+...,op=<class>+... replays only requests of the listed recorded lcores and\n");
+    printf("     opcode classes (read, write, append, zeroes, mgmt, other). Index blocks without them are skipped\n");
+    printf(" -k, --checkpoint <state file>[:<interval s>] writes the replay position, statistics and ordered zone\n");
+    printf("     write pointers every interval (default 60 s) and when the replay ends\n");
+    printf(" -K, --resume from the -k state file: skips to the checkpointed entry through the trace index,\n");
+    printf("     without reset or precondition. Requests in flight at the checkpoint are replayed again\n");
+    printf(" -T, rate limit: <qpair|global>:<key>=<value>,... token buckets per qpair or shared by all workers,\n");
+    printf("     keys are iops, riops, wiops, bw, rbw and wbw (MB/s) for all, read and write requests, and\n");
+    printf("     burst (us, default %u). May be given once per scope. Throttle delay is reported apart from latency\n",
+           RATE_BURST_US_DEFAULT);
     spdk_trace_mask_usage(stdout, "-e");
 }
 
+/* lcore=<lcore>+...,op=<class>+..., each key replays only the listed values */
+static int
+parse_filter(const char *arg)
+{
+    static const char *class_name[REPLAY_OPC_MAX] = {"read", "write", "append", "zeroes", "mgmt", "other"};
+    char *buf = strdup(arg);
+    char *save = NULL, *val_save = NULL;
+    int rc = 0;
+
+    if (!buf) {
+        return 1;
+    }
+    for (char *kv = strtok_r(buf, ",", &save); kv && !rc; kv = strtok_r(NULL, ",", &save)) {
+        char *val = strchr(kv, '=');
+        if (!val) {
+            rc = 1;
+            break;
+        }
+        *val++ = '\0';
+        for (char *v = strtok_r(val, "+", &val_save); v && !rc; v = strtok_r(NULL, "+", &val_save)) {
+            if (strcmp(kv, "lcore") == 0) {
+                uint32_t lcore = (uint32_t)strtoul(v, NULL, 10);
+                rc = lcore >= SPDK_TRACE_MAX_LCORE;
+                if (!rc) {
+                    g_filter_by_lcore = true;
+                    g_filter_lcore[lcore] = true;
+                }
+            } else if (strcmp(kv, "op") == 0) {
+                uint32_t cls;
+                for (cls = 0; cls < REPLAY_OPC_MAX && strcmp(v, class_name[cls]) != 0; cls++);
+                rc = cls == REPLAY_OPC_MAX;
+                g_filter_opc_class |= rc ? 0 : 1U << cls;
+            } else {
+                rc = 1;
+            }
+        }
+    }
+    free(buf);
+    if (rc) {
+        fprintf(stderr, "Invalid filter %s\n", arg);
+    }
+    return rc;
+}
+
+/* <backend>[:<target>], the target is parsed by the backend */
+static int
+parse_backend(const char *arg)
+{
+    static const struct replay_backend *backends[] = {
+        &g_replay_backend_nvme, &g_replay_backend_bdev, &g_replay_backend_uring, &g_replay_backend_null,
+        &g_replay_backend_emu,
+    };
+    size_t len = strcspn(arg, ":");
+
+    for (size_t i = 0; i < SPDK_COUNTOF(backends); i++) {
+        if (strlen(backends[i]->name) == len && strncmp(arg, backends[i]->name, len) == 0) {
+            g_backend = backends[i];
+            g_backend_target = arg[len] ? arg + len + 1 : "";
+            return 0;
+        }
+    }
+    fprintf(stderr, "Unknown backend %s\n", arg);
+    return 1;
+}
+
 static int
 parse_args(int argc, char **argv, char *file_name, size_t file_name_size)
 {
     int op;
+    static const struct option long_options[] = {
+        {"checkpoint", required_argument, NULL, 'k'},
+        {"resume", no_argument, NULL, 'K'},
+        {NULL, 0, NULL, 0},
+    };
 
-    while ((op = getopt(argc, argv, "f:z:e:q:")) != -1) {
+    while ((op = getopt_long(argc, argv, "f:z:e:q:m:x:l:c:b:o:w:r:p:a:L:B:P:VT:n:t:R:s:F:dk:K", long_options,
+                             NULL)) != -1) {
         switch (op) {
         case 'f':
             g_input_file = true;
@@ -653,6 +4924,186 @@ parse_args(int argc, char **argv, char *file_name, size_t file_name_size)
         case 'q':
             g_queue_depth = atoi(optarg);
             break;
+        case 'm':
+            if (strcmp(optarg, "afap") == 0) {
+                g_replay_mode = REPLAY_MODE_AFAP;
+            } else if (strcmp(optarg, "open") == 0) {
+                g_replay_mode = REPLAY_MODE_OPEN_LOOP;
+            } else if (strcmp(optarg, "closed") == 0) {
+                g_replay_mode = REPLAY_MODE_CLOSED_LOOP;
+            } else {
+                fprintf(stderr, "Unknown replay mode %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'x':
+            g_time_scale = atof(optarg);
+            if (g_time_scale <= 0) {
+                fprintf(stderr, "Time scale must be greater than 0\n");
+                return 1;
+            }
+            break;
+        case 'l':
+            g_load_multiplier = atoi(optarg);
+            if (g_load_multiplier == 0) {
+                fprintf(stderr, "Load multiplier must be greater than 0\n");
+                return 1;
+            }
+            break;
+        case 'c':
+            g_core_list = optarg;
+            break;
+        case 'b':
+            g_barrier = true;
+            g_barrier_window_us = strtoull(optarg, NULL, 10);
+            break;
+        case 'o':
+            g_result_file_name = optarg;
+            break;
+        case 'w':
+            g_window_ms = strtoull(optarg, NULL, 10);
+            break;
+        case 'r':
+            if (strcmp(optarg, "full") == 0) {
+                g_reset_mode = RESET_MODE_FULL;
+            } else if (strcmp(optarg, "touched") == 0) {
+                g_reset_mode = RESET_MODE_TOUCHED;
+            } else if (strcmp(optarg, "none") == 0) {
+                g_reset_mode = RESET_MODE_NONE;
+            } else {
+                fprintf(stderr, "Unknown reset mode %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'L':
+            if (strcmp(optarg, "none") == 0) {
+                g_remap_mode = REMAP_MODE_NONE;
+            } else if (strcmp(optarg, "wrap") == 0) {
+                g_remap_mode = REMAP_MODE_WRAP;
+            } else if (strncmp(optarg, "scale", 5) == 0 && (optarg[5] == '\0' || optarg[5] == ':')) {
+                g_remap_mode = REMAP_MODE_SCALE;
+                g_remap_src_blk = optarg[5] ? strtoull(optarg + 6, NULL, 0) : 0;
+            } else if (strncmp(optarg, "zone", 4) == 0 && (optarg[4] == '\0' || optarg[4] == ':')) {
+                char *end = optarg + 4;
+                g_remap_mode = REMAP_MODE_ZONE;
+                if (*end == ':') {
+                    g_remap_src_zone_blk = strtoull(end + 1, &end, 0);
+                }
+                if (*end == ':') {
+                    g_remap_src_zone_cap = strtoull(end + 1, &end, 0);
+                }
+            } else {
+                fprintf(stderr, "Unknown LBA remap %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'a':
+            if (strcmp(optarg, "ordered") == 0) {
+                g_zone_ordered = true;
+            } else if (strcmp(optarg, "append") == 0) {
+                g_zone_ordered = false;
+            } else {
+                fprintf(stderr, "Unknown ZNS write mode %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'B':
+            if (parse_backend(optarg)) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'P':
+            g_data_pattern = true;
+            g_data_zero_pct = (uint32_t)atoi(optarg);
+            if (g_data_zero_pct >= 100) {
+                fprintf(stderr, "-P pct must be less than 100\n");
+                return 1;
+            }
+            break;
+        case 'V':
+            g_data_pattern = true;
+            g_data_verify = true;
+            break;
+        case 'd':
+            g_dep_track = true;
+            break;
+        case 'k': {
+            /* cut the interval off, optarg outlives the replay */
+            char *colon = strrchr(optarg, ':');
+            if (colon) {
+                g_ckpt_interval_s = atof(colon + 1);
+                *colon = '\0';
+            }
+            g_ckpt_file = optarg;
+            if (g_ckpt_interval_s <= 0 || !*g_ckpt_file) {
+                fprintf(stderr, "Invalid checkpoint %s\n", optarg);
+                return 1;
+            }
+            break;
+        }
+        case 'K':
+            g_ckpt_resume = true;
+            break;
+        case 'n':
+            g_loop_count = (uint32_t)strtoul(optarg, NULL, 10);
+            if (g_loop_count == 0) {
+                fprintf(stderr, "Iterations must be greater than 0\n");
+                return 1;
+            }
+            break;
+        case 't':
+            g_loop_duration_s = atof(optarg);
+            if (g_loop_duration_s <= 0) {
+                fprintf(stderr, "Duration must be greater than 0\n");
+                return 1;
+            }
+            break;
+        case 'R':
+            g_loop_rotate_blk = strtoull(optarg, NULL, 0);
+            break;
+        case 's': {
+            char *end = NULL;
+            g_slice_start_s = strtod(optarg, &end);
+            g_slice_end_s = (*end == ':') ? strtod(end + 1, NULL) : 0;
+            if (g_slice_start_s < 0 || g_slice_end_s < 0 || (g_slice_end_s > 0 && g_slice_end_s <= g_slice_start_s)) {
+                fprintf(stderr, "Invalid slice %s\n", optarg);
+                return 1;
+            }
+            break;
+        }
+        case 'F':
+            if (parse_filter(optarg)) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'T':
+            if (parse_rate_limit(optarg)) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'p':
+            if (strcmp(optarg, "scan") == 0) {
+                g_precondition_mode = PRECONDITION_MODE_SCAN;
+            } else if (strncmp(optarg, "fill:", 5) == 0) {
+                g_precondition_mode = PRECONDITION_MODE_FILL;
+                g_precondition_fill_pct = (uint32_t)strtoul(optarg + 5, NULL, 10);
+                if (g_precondition_fill_pct > 100) {
+                    fprintf(stderr, "Fill percentage should be 0 to 100\n");
+                    return 1;
+                }
+            } else if (strcmp(optarg, "none") != 0) {
+                fprintf(stderr, "Unknown precondition mode %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
         default:
             usage(argv[0]);
             return 1;
@@ -679,13 +5130,38 @@ main(int argc, char **argv)
         exit(1);
     }
 
-    /* Get trid */
-    spdk_nvme_trid_populate_transport(&g_trid, SPDK_NVME_TRANSPORT_PCIE);
-    snprintf(g_trid.subnqn, sizeof(g_trid.subnqn), "%s", SPDK_NVMF_DISCOVERY_NQN);
+    /* Identify the trace for checkpoints, or continue from the last one */
+    if (g_ckpt_resume && !g_ckpt_file) {
+        fprintf(stderr, "--resume needs the state file given with --checkpoint\n");
+        return 1;
+    }
+    if (g_ckpt_file) {
+        bool done = false;
+        if (replay_ckpt_init(input_file_name, &done) != 0) {
+            return 1;
+        }
+        if (done) {
+            free(g_ckpt_wp);
+            return 0;
+        }
+    }
+
+    /* Map recorded lcores to replay workers */
+    if (replay_worker_map(input_file_name) != 0) {
+        return 1;
+    }
 
     /* Initialize env */
     spdk_env_opts_init(&env_opts);
     env_opts.name = "trace_replayer";
+    if (g_core_list) {
+        env_opts.core_mask = g_core_mask;
+    }
+    /* io_uring, null and emulated backends do not use PCI devices */
+    if (g_backend == &g_replay_backend_uring || g_backend == &g_replay_backend_null ||
+        g_backend == &g_replay_backend_emu) {
+        env_opts.no_pci = true;
+    }
     if (spdk_env_init(&env_opts) < 0) {
         fprintf(stderr, "Unable to initialize SPDK env\n");
         return 1;
@@ -700,89 +5176,117 @@ main(int argc, char **argv)
         }
     }
 
-    /* Register ctrlr & ns */
-    printf("Initializing NVMe Controllers\n");
-    
-    rc = spdk_nvme_probe(&g_trid, NULL, probe_cb, attach_cb, NULL);
+    /* Open the device & allocate io qpair */
+    struct replay_geometry geo;
+    rc = g_backend->open(g_backend_target, &geo);
     if (rc != 0) {
-        fprintf(stderr, "spdk_nvme_probe() failed\n");
+        fprintf(stderr, "Failed to open %s backend\n", g_backend->name);
         goto exit;
     }
-    
-    if (TAILQ_EMPTY(&g_controllers)) {
-        fprintf(stderr, "no NVMe controllers found\n");
+
+    /* Identify namespace */
+    identify_ns(&geo);
+
+    struct replay_qpair *qpair = alloc_qpair();
+    if (!qpair) {
+        rc = -1;
         goto exit;
     }
-    printf("Initialization complete.\n");
-    
-    /* Get namspace entry & allocate io qpair */
-    struct ns_entry *ns_entry = alloc_qpair(&env_opts);
-    if (!ns_entry) {
-        fprintf(stderr, "Failed to alloc_qpair()\n");
-        return -1;
+
+    /* Check the namespace can be split between the copies */
+    if ((g_zone && g_num_zone < g_load_multiplier) || (!g_zone && g_ns_blk < g_load_multiplier)) {
+        fprintf(stderr, "Namespace is too small for load multiplier %u\n", g_load_multiplier);
+        free_qpair(qpair);
+        rc = -1;
+        goto exit;
     }
 
-    /* Identify namespace */
-    identify_ns(ns_entry);
-    
-    /* Reset namespace */
-    reset_ns(ns_entry);
+    /* Map recorded LBAs onto the device */
+    rc = replay_remap_init(qpair, input_file_name);
+    if (rc != 0) {
+        free_qpair(qpair);
+        goto exit;
+    }
 
-    /* Read file and replay workload */
-    FILE *fptr = fopen(input_file_name, "rb");
-    if (fptr == NULL) {
-        fprintf(stderr, "Failed to open input file %s\n", input_file_name);
-        return -1; 
+    /* Generation map of the data patterns */
+    rc = data_pattern_init();
+    if (rc != 0) {
+        free_qpair(qpair);
+        goto exit;
     }
-    fseek(fptr, 0, SEEK_END);
-    size_t file_size = ftell(fptr);
-    rewind(fptr);
-    size_t total_entry = file_size / sizeof(struct trace_io_entry); /* Get number of requests */
-    //printf("Total number of request = %ld\n", total_entry >> 1);
-   
-    /* Workload repaly start */
-    print_uline('=', printf("\nWorkload Replay Information\n"));
-    uint64_t start_tsc = spdk_get_ticks();
- 
-    size_t remain_entry = total_entry;
-    while (!feof(fptr) && remain_entry) {
-        size_t buffer_entry = (remain_entry > ENTRY_MAX) ? ENTRY_MAX : remain_entry;
-        remain_entry -= buffer_entry;
-        struct trace_io_entry buffer[buffer_entry]; /* Allocate buffer for read file */
-        size_t read_entry = fread(&buffer, sizeof(struct trace_io_entry), buffer_entry, fptr);
-        if (buffer_entry != read_entry) {
-                fprintf(stderr, "Fail to read input file\n");
-                free_qpair(ns_entry->qpair);
-                fclose(fptr);
-                break;
-        }
 
-        for (size_t i = 0; i < read_entry; i++) {
-            if (strcmp(buffer[i].tpoint_name, "NVME_IO_COMPLETE") == 0) {
-                continue;
-            }
+    /* Trace index for slices, filters and resume */
+    rc = replay_filter_init(input_file_name);
+    if (rc != 0) {
+        free_qpair(qpair);
+        goto exit;
+    }
 
-            for (; outstanding_commands >= g_queue_depth; spdk_nvme_qpair_process_completions(ns_entry->qpair, 0));
+    /* Open a trace cursor for every copy and allocate workers */
+    struct replay_copy *copies = replay_copy_alloc(input_file_name, false);
+    if (!copies) {
+        free_qpair(qpair);
+        rc = -1;
+        goto exit;
+    }
+    struct replay_worker *workers = replay_worker_alloc(qpair);
+    if (!workers) {
+        replay_copy_free(copies);
+        free_qpair(qpair);
+        rc = -1;
+        goto exit;
+    }
 
-            if (g_zone) {
-                rc = process_zns_replay(ns_entry->ns, ns_entry->qpair, &buffer[i]);
-            } else {
-                rc = process_replay(ns_entry->ns, ns_entry->qpair, &buffer[i]);
-            }
+    /* Reset namespace */
+    rc = reset_ns(qpair, workers, input_file_name);
+    if (rc != 0) {
+        fprintf(stderr, "Reset namespace failed\n");
+        replay_worker_free(workers);
+        replay_copy_free(copies);
+        free_qpair(qpair);
+        goto exit;
+    }
 
-            if (rc != 0) {
-                fprintf(stderr, "Replay workload failed\n");
-                free_qpair(ns_entry->qpair);
-                fclose(fptr);
-                return rc;
-            }
+    /* Bring zones the trace reads into a written state */
+    rc = precondition_ns(qpair, workers, input_file_name);
+    if (rc != 0) {
+        fprintf(stderr, "Precondition failed\n");
+        replay_worker_free(workers);
+        replay_copy_free(copies);
+        free_qpair(qpair);
+        goto exit;
+    }
+
+    /* Write pointer table of the ordered zone write mode */
+    if (g_zone_ordered && !g_zone) {
+        printf("\nOrdered zone write is only supported on ZNS namespaces, ignored.\n");
+        g_zone_ordered = false;
+    }
+    if (g_zone_ordered) {
+        rc = zone_info_load(qpair);
+        if (rc != 0) {
+            replay_worker_free(workers);
+            replay_copy_free(copies);
+            free_qpair(qpair);
+            goto exit;
         }
-        for (; outstanding_commands; spdk_nvme_qpair_process_completions(ns_entry->qpair, 0));
+        replay_ckpt_zone_check();
     }
+
+    /* Workload repaly start */
+    print_uline('=', printf("\nWorkload Replay Information\n"));
+    uint64_t start_tsc = spdk_get_ticks();
+    rc = replay_worker_launch(workers, copies);
     /* Workload repaly finish */
     uint64_t end_tsc = spdk_get_ticks();
 
-    fclose(fptr);
+    if (rc != 0) {
+        fprintf(stderr, "Replay workload failed\n");
+        replay_worker_free(workers);
+        replay_copy_free(copies);
+        free_qpair(qpair);
+        goto exit;
+    }
 
     uint64_t tsc_diff = end_tsc - start_tsc;
     uint64_t tsc_rate = spdk_get_ticks_hz();
@@ -790,9 +5294,27 @@ main(int argc, char **argv)
 
     printf("%-16s: %15ld \n", "Requests number", g_num_io);
     printf("%-16s: %15.3f (ms) \n", "Total time", sec_diff);
+    print_replay_timing(tsc_diff);
+    if (g_rate_limited) {
+        print_rate_limit(tsc_diff);
+    }
+    print_replay_worker(workers);
+    print_replay_ckpt();
+    print_replay_latency();
+    print_replay_loop();
+    if (g_verify_error) {
+        fprintf(stderr, "Data verification failed\n");
+        rc = 1;
+    }
+    replay_worker_free(workers);
+    replay_copy_free(copies);
+    free(g_window);
+    free(g_loop);
+    free(g_zone_info);
+    free(g_ckpt_wp);
     
     /* Free io qpair after workload replay */
-    free_qpair(ns_entry->qpair);  
+    free_qpair(qpair);
 
     /* Report zone */
     if (g_report_zone) {
@@ -800,7 +5322,9 @@ main(int argc, char **argv)
     }
  
     exit:
-    cleanup();
+    trace_io_index_free(&g_index);
+    data_pattern_fini();
+    g_backend->close();
     spdk_env_fini();
     return rc;
 }